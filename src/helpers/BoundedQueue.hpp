@@ -0,0 +1,179 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file BoundedQueue.hpp
+ */
+
+#ifndef BOUNDEDQUEUE_HPP_
+#define BOUNDEDQUEUE_HPP_
+
+#include <pthread.h>
+#include <deque>
+
+/*!
+ * @brief namespace OpenAB
+ */
+namespace OpenAB {
+
+/**
+ * @brief Fixed capacity FIFO queue for passing items between producer and consumer threads.
+ * Producer is blocked when queue is full, so memory used by items waiting for consumer
+ * stays bounded even if consumer is slower than producer.
+ * Consumer is blocked when queue is empty until new item is available or queue gets closed.
+ * @note items are copied into the queue under its lock, so T should be cheap to copy
+ * (e.g. raw pointers with ownership passed through the queue).
+ */
+template<typename T>
+class BoundedQueue
+{
+  public:
+    /**
+     * @brief Constructor
+     * @param [in] capacity maximal number of items stored in the queue.
+     */
+    BoundedQueue(unsigned int capacity) :
+      capacity(capacity ? capacity : 1),
+      closed(false)
+    {
+      pthread_mutex_init(&mutex, NULL);
+      pthread_cond_init(&notEmptyCond, NULL);
+      pthread_cond_init(&notFullCond, NULL);
+    }
+
+    /**
+     * @brief Destructor
+     */
+    ~BoundedQueue()
+    {
+      pthread_cond_destroy(&notFullCond);
+      pthread_cond_destroy(&notEmptyCond);
+      pthread_mutex_destroy(&mutex);
+    }
+
+    /**
+     * @brief Adds item at the end of queue, blocks while queue is full.
+     * @param [in] item item to be added.
+     * @return true if item was added, false if queue was closed.
+     */
+    bool push(const T& item)
+    {
+      pthread_mutex_lock(&mutex);
+      while (items.size() >= capacity && !closed)
+      {
+        pthread_cond_wait(&notFullCond, &mutex);
+      }
+      if (closed)
+      {
+        pthread_mutex_unlock(&mutex);
+        return false;
+      }
+      items.push_back(item);
+      pthread_cond_signal(&notEmptyCond);
+      pthread_mutex_unlock(&mutex);
+      return true;
+    }
+
+    /**
+     * @brief Removes item from the beginning of queue, blocks while queue is empty and not closed.
+     * @param [out] item removed item.
+     * @return true if item was removed, false if queue was closed and there are no more items.
+     */
+    bool pop(T& item)
+    {
+      pthread_mutex_lock(&mutex);
+      while (items.empty() && !closed)
+      {
+        pthread_cond_wait(&notEmptyCond, &mutex);
+      }
+      if (items.empty())
+      {
+        pthread_mutex_unlock(&mutex);
+        return false;
+      }
+      item = items.front();
+      items.pop_front();
+      pthread_cond_signal(&notFullCond);
+      pthread_mutex_unlock(&mutex);
+      return true;
+    }
+
+    /**
+     * @brief Closes queue - no more items can be added, blocked producer and consumer are woken up.
+     * Items already stored in the queue still can be removed using @ref pop.
+     */
+    void close()
+    {
+      pthread_mutex_lock(&mutex);
+      closed = true;
+      pthread_cond_broadcast(&notEmptyCond);
+      pthread_cond_broadcast(&notFullCond);
+      pthread_mutex_unlock(&mutex);
+    }
+
+    /**
+     * @brief Returns true if queue was closed using @ref close.
+     */
+    bool isClosed()
+    {
+      pthread_mutex_lock(&mutex);
+      bool c = closed;
+      pthread_mutex_unlock(&mutex);
+      return c;
+    }
+
+    /**
+     * @brief Removes all items and reopens queue.
+     * @note items are not freed, if they own any resources those needs to be released by calling @ref pop first.
+     */
+    void reset()
+    {
+      pthread_mutex_lock(&mutex);
+      items.clear();
+      closed = false;
+      pthread_mutex_unlock(&mutex);
+    }
+
+    /**
+     * @brief Returns number of items currently stored in the queue.
+     */
+    unsigned int size()
+    {
+      pthread_mutex_lock(&mutex);
+      unsigned int s = items.size();
+      pthread_mutex_unlock(&mutex);
+      return s;
+    }
+
+    /**
+     * @brief Returns capacity of the queue.
+     */
+    unsigned int getCapacity() const
+    {
+      return capacity;
+    }
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    BoundedQueue(BoundedQueue const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    BoundedQueue& operator=(BoundedQueue const &other);
+
+    std::deque<T>   items;
+    unsigned int    capacity;
+    bool            closed;
+    pthread_mutex_t mutex;
+    pthread_cond_t  notEmptyCond;
+    pthread_cond_t  notFullCond;
+};
+
+} // namespace OpenAB
+
+#endif // BOUNDEDQUEUE_HPP_
@@ -0,0 +1,119 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file FileHelper.cpp
+ */
+
+#include "FileHelper.hpp"
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace OpenAB {
+
+bool makeDirs(const std::string& path)
+{
+  std::string::size_type pos = 0;
+  do
+  {
+    pos = path.find('/', pos + 1);
+    std::string dir = path.substr(0, pos);
+    if (dir.empty())
+    {
+      continue;
+    }
+    if (0 != mkdir(dir.c_str(), 0700) && EEXIST != errno)
+    {
+      return false;
+    }
+  } while (pos != std::string::npos);
+
+  struct stat st;
+  return (0 == stat(path.c_str(), &st) && S_ISDIR(st.st_mode));
+}
+
+std::string hashFileName(const std::string& str)
+{
+  uint64_t h = 14695981039346656037ULL;
+  for (std::string::size_type i = 0; i < str.size(); ++i)
+  {
+    h ^= (unsigned char)str[i];
+    h *= 1099511628211ULL;
+  }
+
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+  return buf;
+}
+
+AtomicFileWriter::AtomicFileWriter(const std::string& path,
+                                   bool binary) :
+    path(path),
+    tmpPath(path + ".tmp"),
+    committed(false)
+{
+  std::ios_base::openmode mode = std::ios_base::out | std::ios_base::trunc;
+  if (binary)
+  {
+    mode |= std::ios_base::binary;
+  }
+  file.open(tmpPath.c_str(), mode);
+}
+
+AtomicFileWriter::~AtomicFileWriter()
+{
+  if (!committed)
+  {
+    if (file.is_open())
+    {
+      file.close();
+    }
+    unlink(tmpPath.c_str());
+  }
+}
+
+bool AtomicFileWriter::isOpen() const
+{
+  return file.is_open();
+}
+
+std::ostream& AtomicFileWriter::stream()
+{
+  return file;
+}
+
+bool AtomicFileWriter::commit()
+{
+  if (committed || !file.is_open())
+  {
+    return false;
+  }
+
+  file.close();
+  if (file.fail() || 0 != rename(tmpPath.c_str(), path.c_str()))
+  {
+    unlink(tmpPath.c_str());
+    return false;
+  }
+  committed = true;
+  return true;
+}
+
+bool writeFileAtomically(const std::string& path, const std::string& data)
+{
+  AtomicFileWriter writer(path);
+  if (!writer.isOpen())
+  {
+    return false;
+  }
+  writer.stream()<<data;
+  return writer.commit();
+}
+
+} // namespace OpenAB
@@ -0,0 +1,100 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file FileHelper.hpp
+ */
+
+#ifndef FILEHELPER_HPP_
+#define FILEHELPER_HPP_
+#include <string>
+#include <fstream>
+
+/*!
+ * @brief namespace OpenAB
+ */
+namespace OpenAB {
+
+/*!
+ * @brief Creates directory together with all missing parent directories (accessible only by owner).
+ * @param [in] path path of directory.
+ * @return true if directory exists or was created, false otherwise.
+ */
+bool makeDirs(const std::string& path);
+
+/*!
+ * @brief Returns hex encoded 64 bit FNV-1a hash of given string,
+ * can be used to derive file names from arbitrary keys (URLs, handles etc.).
+ * @param [in] str string to be hashed.
+ * @return 16 characters long hash.
+ */
+std::string hashFileName(const std::string& str);
+
+/*!
+ * @brief Writes file atomically.
+ * Data is written to temporary file placed next to target file, which replaces target file
+ * only when all data was written successfully, so partially written files will never be read.
+ * If @ref commit is not called temporary file is removed on destruction.
+ */
+class AtomicFileWriter
+{
+  public:
+    /*!
+     *  @brief Constructor, opens temporary file.
+     *  @param [in] path path of target file.
+     *  @param [in] binary should file be opened in binary mode.
+     */
+    AtomicFileWriter(const std::string& path,
+                     bool binary = true);
+
+    /*!
+     *  @brief Destructor, removes temporary file if it was not committed.
+     */
+    ~AtomicFileWriter();
+
+    /*!
+     * @brief Returns true if temporary file was opened successfully.
+     */
+    bool isOpen() const;
+
+    /*!
+     * @brief Returns stream to which data should be written.
+     */
+    std::ostream& stream();
+
+    /*!
+     * @brief Closes temporary file and replaces target file with it.
+     * @return true if all data was written and target file was replaced, false otherwise.
+     */
+    bool commit();
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    AtomicFileWriter(AtomicFileWriter const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    AtomicFileWriter& operator=(AtomicFileWriter const &other);
+
+    std::string   path;
+    std::string   tmpPath;
+    std::ofstream file;
+    bool          committed;
+};
+
+/*!
+ * @brief Writes whole file atomically using @ref AtomicFileWriter.
+ * @param [in] path path of file.
+ * @param [in] data contents of file.
+ * @return true if file was written, false otherwise.
+ */
+bool writeFileAtomically(const std::string& path, const std::string& data);
+
+} // namespace OpenAB
+
+#endif // FILEHELPER_HPP_
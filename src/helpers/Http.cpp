@@ -224,7 +224,6 @@ std::string HttpMessage::responseCodeDescription(long code)
 HttpSession::HttpSession() :
     curl (NULL),
     internalHeader (NULL),
-    writeBuffer(NULL),
     currentWriteOffset(0),
     traceEnabled(false)
 {
@@ -346,7 +345,7 @@ bool HttpSession::execute(HttpMessage* msg)
     curl_easy_setopt(curl, CURLOPT_UPLOAD, 1);
 
     currentWriteOffset = 0;
-    writeBuffer = msg->getData().c_str();
+    writeBuffer = msg->getData();
   }
   //set url
   curl_easy_setopt(curl, CURLOPT_URL, msg->getURL().c_str());
@@ -477,13 +476,13 @@ size_t HttpSession::writeData(void *ptr, size_t size, size_t nmemb, HttpSession*
     return 0;
   }
 
-  size_t dataLeft = strlen(curl->writeBuffer) - curl->currentWriteOffset;
+  size_t dataLeft = curl->writeBuffer.size() - curl->currentWriteOffset;
   size_t readRequestSize = size * nmemb;
 
   size_t toRead = (dataLeft > readRequestSize) ? readRequestSize : dataLeft;
   if (toRead > 0)
   {
-    memcpy((char*)ptr, curl->writeBuffer + curl->currentWriteOffset, toRead);
+    memcpy((char*)ptr, curl->writeBuffer.data() + curl->currentWriteOffset, toRead);
     curl->currentWriteOffset += toRead;
   }
 
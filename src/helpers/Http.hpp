@@ -75,7 +75,8 @@ class HttpSession
     std::string lastErrorStr;
     std::string responseBuffer;
     std::string responseHeaders;
-    const char* writeBuffer;
+    /*copy of data being sent, it has to stay valid until request is executed*/
+    std::string writeBuffer;
     unsigned int currentWriteOffset;
     bool traceEnabled;
 
@@ -10,6 +10,7 @@
 #include "Log.hpp"
 #include "StringHelper.hpp"
 #include <algorithm>
+#include <string.h>
 
 namespace OpenAB {
 
@@ -299,5 +300,24 @@ std::string percentDecode(const std::string& uri)
   return decoded;
 }
 
+const char* findAtLineStart(const char* data, const char* end, const char* from,
+                            const char* marker, size_t markerLen)
+{
+  while (from < end)
+  {
+    const char* found = static_cast<const char*>(memmem(from, end - from, marker, markerLen));
+    if (NULL == found)
+    {
+      return NULL;
+    }
+    if (found == data || '\n' == *(found - 1))
+    {
+      return found;
+    }
+    from = found + 1;
+  }
+  return NULL;
+}
+
 
 } // namespace IasOpenAB
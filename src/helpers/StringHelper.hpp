@@ -134,6 +134,18 @@ void unquoteSpecialCharacters(std::string& str);
 
 std::string percentDecode(const std::string& uri);
 
+/*!
+ * @brief Finds marker (e.g. BEGIN:VCARD) placed at the beginning of line in [from, end) range of buffer.
+ * @param [in] data beginning of buffer, which is always considered beginning of line
+ * @param [in] end end of searched range
+ * @param [in] from beginning of searched range
+ * @param [in] marker marker to be found
+ * @param [in] markerLen length of marker
+ * @return pointer to found marker or NULL if it was not found
+ */
+const char* findAtLineStart(const char* data, const char* end, const char* from,
+                            const char* marker, size_t markerLen);
+
 
 } // namespace OpenAB
 
@@ -49,6 +49,8 @@ namespace OpenAB_Source {
  *  - @ref Source::cancel (@copybrief Source::cancel)
  *
  *  - @ref Source::getTotalCount (@copybrief Source::getTotalCount)
+ *  - @ref Source::isDelta (@copybrief Source::isDelta)
+ *  - @ref Source::commitDelta (@copybrief Source::commitDelta)
  *
  ### Quick Browse functions ###
  * These functions are required to quickly retrieve a complete set of PIM
@@ -176,6 +178,26 @@ class Source
      */
     virtual int getTotalCount() const = 0;
 
+    /**
+     * @brief Checks if Source provides only items that are new since previous synchronization.
+     * Items that were provided before are not provided again, so they should not be removed from Storage
+     * just because they were not provided. Result is valid after successful initialization.
+     * @return true if only new items are provided, false if all items are provided (default)
+     */
+    virtual bool isDelta() const
+    {
+      return false;
+    }
+
+    /**
+     * @brief Informs Source providing only new items, that all provided items were stored, so they
+     * do not need to be provided again. Until it is called, Source provides the same items again
+     * after each initialization.
+     */
+    virtual void commitDelta()
+    {
+    }
+
     /**
      * @brief Returns type of PIM Item supported by Source
      * @return type of supported PIM Item (@ref OpenAB::PIMItem)
@@ -0,0 +1,251 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file VCardParseStage.cpp
+ */
+
+#include "VCardParseStage.hpp"
+#include <helpers/Log.hpp>
+#include <unistd.h>
+
+/*Maximal number of workers started when number of workers is not specified*/
+#define MAX_DEFAULT_WORKERS 4
+
+namespace OpenAB_Source {
+
+VCardParseStage::VCardParseStage(unsigned int workersCount, unsigned int window) :
+    slots(window ? window : 1),
+    head(0),
+    next(0),
+    tail(0),
+    inProgress(0),
+    closed(false),
+    stopping(false)
+{
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&workCond, NULL);
+  pthread_cond_init(&parsedCond, NULL);
+  pthread_cond_init(&spaceCond, NULL);
+
+  if (0 == workersCount)
+  {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    workersCount = (cpus > 0) ? cpus : 1;
+    if (workersCount > MAX_DEFAULT_WORKERS)
+    {
+      workersCount = MAX_DEFAULT_WORKERS;
+    }
+  }
+
+  for (unsigned int i = 0; i < workersCount; ++i)
+  {
+    pthread_t thread;
+    if (0 != pthread_create(&thread, NULL, workerFuncWrapper, this))
+    {
+      LOG_ERROR()<<"Cannot create parser thread"<<std::endl;
+      break;
+    }
+    workers.push_back(thread);
+  }
+}
+
+VCardParseStage::~VCardParseStage()
+{
+  pthread_mutex_lock(&mutex);
+  stopping = true;
+  closed = true;
+  pthread_cond_broadcast(&workCond);
+  pthread_cond_broadcast(&spaceCond);
+  pthread_cond_broadcast(&parsedCond);
+  pthread_mutex_unlock(&mutex);
+
+  for (unsigned int i = 0; i < workers.size(); ++i)
+  {
+    pthread_join(workers[i], NULL);
+  }
+
+  reset();
+
+  pthread_cond_destroy(&spaceCond);
+  pthread_cond_destroy(&parsedCond);
+  pthread_cond_destroy(&workCond);
+  pthread_mutex_destroy(&mutex);
+}
+
+unsigned int VCardParseStage::getWorkersCount() const
+{
+  return workers.size();
+}
+
+bool VCardParseStage::push(std::string* vCard)
+{
+  pthread_mutex_lock(&mutex);
+  while (tail - head >= slots.size() && !closed)
+  {
+    pthread_cond_wait(&spaceCond, &mutex);
+  }
+  if (closed)
+  {
+    pthread_mutex_unlock(&mutex);
+    delete vCard;
+    return false;
+  }
+
+  Slot& slot = slots[tail % slots.size()];
+  slot.vCard = vCard;
+  slot.item = NULL;
+  slot.parsed = false;
+  ++tail;
+
+  //without workers vCards are parsed by consumer
+  if (workers.empty())
+  {
+    pthread_cond_signal(&parsedCond);
+  }
+  pthread_cond_signal(&workCond);
+  pthread_mutex_unlock(&mutex);
+  return true;
+}
+
+bool VCardParseStage::pop(OpenAB::PIMContactItem*& item)
+{
+  pthread_mutex_lock(&mutex);
+  while (true)
+  {
+    if (head == tail)
+    {
+      if (closed)
+      {
+        pthread_mutex_unlock(&mutex);
+        return false;
+      }
+    }
+    else if (slots[head % slots.size()].parsed || workers.empty())
+    {
+      break;
+    }
+    pthread_cond_wait(&parsedCond, &mutex);
+  }
+
+  Slot& slot = slots[head % slots.size()];
+  if (!slot.parsed)
+  {
+    //no workers are available (e.g. they could not be started), parse in consumer thread
+    std::string* vCard = slot.vCard;
+    slot.vCard = NULL;
+    pthread_mutex_unlock(&mutex);
+    item = parse(vCard);
+    pthread_mutex_lock(&mutex);
+  }
+  else
+  {
+    item = slot.item;
+    slot.item = NULL;
+  }
+  slot.parsed = false;
+  ++head;
+  pthread_cond_signal(&spaceCond);
+  pthread_mutex_unlock(&mutex);
+  return true;
+}
+
+void VCardParseStage::close()
+{
+  pthread_mutex_lock(&mutex);
+  closed = true;
+  pthread_cond_broadcast(&spaceCond);
+  pthread_cond_broadcast(&parsedCond);
+  pthread_mutex_unlock(&mutex);
+}
+
+bool VCardParseStage::isClosed()
+{
+  pthread_mutex_lock(&mutex);
+  bool c = closed;
+  pthread_mutex_unlock(&mutex);
+  return c;
+}
+
+void VCardParseStage::reset()
+{
+  pthread_mutex_lock(&mutex);
+  //wait for vCards that are being parsed
+  while (inProgress > 0)
+  {
+    pthread_cond_wait(&parsedCond, &mutex);
+  }
+
+  for (; head != tail; ++head)
+  {
+    Slot& slot = slots[head % slots.size()];
+    delete slot.vCard;
+    delete slot.item;
+    slot.vCard = NULL;
+    slot.item = NULL;
+    slot.parsed = false;
+  }
+  head = next = tail = 0;
+  closed = stopping;
+  pthread_mutex_unlock(&mutex);
+}
+
+OpenAB::PIMContactItem* VCardParseStage::parse(std::string* vCard)
+{
+  if (NULL == vCard)
+  {
+    return NULL;
+  }
+
+  OpenAB::PIMContactItem* item = new OpenAB::PIMContactItem();
+  if (!item->parse(*vCard))
+  {
+    delete item;
+    item = NULL;
+  }
+  delete vCard;
+  return item;
+}
+
+void* VCardParseStage::workerFuncWrapper(void* ptr)
+{
+  VCardParseStage* stage = static_cast<VCardParseStage*>(ptr);
+  stage->workerFunc();
+  return NULL;
+}
+
+void VCardParseStage::workerFunc()
+{
+  pthread_mutex_lock(&mutex);
+  while (true)
+  {
+    while (next == tail && !stopping)
+    {
+      pthread_cond_wait(&workCond, &mutex);
+    }
+    if (stopping)
+    {
+      break;
+    }
+
+    Slot& slot = slots[next % slots.size()];
+    ++next;
+    ++inProgress;
+    std::string* vCard = slot.vCard;
+    slot.vCard = NULL;
+    pthread_mutex_unlock(&mutex);
+
+    OpenAB::PIMContactItem* item = parse(vCard);
+
+    pthread_mutex_lock(&mutex);
+    slot.item = item;
+    slot.parsed = true;
+    --inProgress;
+    pthread_cond_broadcast(&parsedCond);
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+} // namespace OpenAB_Source
@@ -0,0 +1,137 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file VCardParseStage.hpp
+ */
+
+#ifndef VCARDPARSESTAGE_HPP_
+#define VCARDPARSESTAGE_HPP_
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <PIMItem/Contact/PIMContactItem.hpp>
+
+/*!
+ * @brief namespace OpenAB_Source
+ */
+namespace OpenAB_Source {
+
+/**
+ * @brief Parses vCards provided by Source plugin using pool of worker threads.
+ *
+ * Producer (usually download thread of Source) passes raw vCards using @ref push,
+ * consumer (usually Source::getItem) receives parsed OpenAB::PIMContactItem items using @ref pop
+ * in the same order in which vCards were pushed.
+ * At most window vCards can be pushed and not yet popped, so memory used by stage stays bounded
+ * and producer is blocked when consumer is slower than it.
+ *
+ * Source plugins can opt in by pushing downloaded vCards into the stage instead of parsing them
+ * in getItem, which keeps getItem contract unchanged while parsing is spread over available CPU cores.
+ */
+class VCardParseStage
+{
+  public:
+    /**
+     * @brief Constructor, starts worker threads.
+     * @param [in] workers number of worker threads, when 0 it is based on number of available CPUs.
+     * @param [in] window maximal number of vCards pushed and not yet popped.
+     */
+    VCardParseStage(unsigned int workers = 0, unsigned int window = 64);
+
+    /**
+     * @brief Destructor, stops worker threads and frees items that were not popped.
+     */
+    ~VCardParseStage();
+
+    /**
+     * @brief Adds vCard to be parsed, blocks while window is full.
+     * @param [in] vCard vCard to be parsed, ownership is passed to stage (also if false is returned),
+     *                   NULL can be used to report vCard that could not be read, it is popped as NULL item.
+     * @return true if vCard was added, false if stage was closed.
+     */
+    bool push(std::string* vCard);
+
+    /**
+     * @brief Returns next parsed item in order in which vCards were pushed, blocks until it is parsed.
+     * @param [out] item parsed item, ownership is passed to caller, NULL if vCard could not be parsed.
+     * @return true if item was returned, false if stage was closed and all items were already returned.
+     */
+    bool pop(OpenAB::PIMContactItem*& item);
+
+    /**
+     * @brief Closes stage - no more vCards can be pushed, blocked producer and consumer are woken up.
+     * vCards already pushed are still parsed and can be popped.
+     */
+    void close();
+
+    /**
+     * @brief Returns true if stage was closed using @ref close.
+     */
+    bool isClosed();
+
+    /**
+     * @brief Frees all vCards and items that were not popped yet and reopens stage.
+     * @note it can be called only when there is no active producer nor consumer.
+     */
+    void reset();
+
+    /**
+     * @brief Returns number of worker threads.
+     */
+    unsigned int getWorkersCount() const;
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    VCardParseStage(VCardParseStage const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    VCardParseStage& operator=(VCardParseStage const &other);
+
+    static void* workerFuncWrapper(void* ptr);
+    void workerFunc();
+
+    /*!
+     * @brief Parses vCard and frees it.
+     * @return parsed item, NULL if vCard is NULL or could not be parsed.
+     */
+    static OpenAB::PIMContactItem* parse(std::string* vCard);
+
+    struct Slot
+    {
+      std::string* vCard;
+      OpenAB::PIMContactItem* item;
+      bool parsed;
+    };
+
+    /*ring buffer of window size, slots in [head, tail) are occupied,
+      [head, next) were taken by workers and [next, tail) are waiting for worker*/
+    std::vector<Slot>       slots;
+    unsigned long           head;
+    unsigned long           next;
+    unsigned long           tail;
+    /*number of slots taken by workers and not parsed yet*/
+    unsigned int            inProgress;
+    bool                    closed;
+    bool                    stopping;
+
+    std::vector<pthread_t>  workers;
+    pthread_mutex_t         mutex;
+    /*signaled when vCard was pushed*/
+    pthread_cond_t          workCond;
+    /*signaled when vCard was parsed*/
+    pthread_cond_t          parsedCond;
+    /*signaled when item was popped*/
+    pthread_cond_t          spaceCond;
+};
+
+} // namespace OpenAB_Source
+
+#endif // VCARDPARSESTAGE_HPP_
@@ -68,6 +68,22 @@ class StorageItem
     {
     }
 
+    /**
+     * @brief Exchanges content of two instances without copying underlying OpenAB::PIMItem.
+     * Can be used to take over item returned by @ref StorageItemIterator::next.
+     * @param [in,out] other instance to exchange content with.
+     */
+    void swap(StorageItem& other)
+    {
+      id.swap(other.id);
+      OpenAB::SmartPtr<OpenAB::PIMItem> tmpItem = item;
+      item = other.item;
+      other.item = tmpItem;
+      eStatus tmpStatus = status;
+      status = other.status;
+      other.status = tmpStatus;
+    }
+
     /**
      * @brief Comparison operator.
      * Compares id, status and OpenAB::PIMItemIndex of both instance.
@@ -81,7 +97,7 @@ class StorageItem
     std::string   id;      /**< @brief OpenAB_Storage::Storage unique ID of the item*/
     OpenAB::SmartPtr<OpenAB::PIMItem> item;    /**< @brief PIMItem*/
 
-    enum{
+    enum eStatus{
       ITEM_ADDED,
       ITEM_MODIFIED,
       ITEM_FOUND,
@@ -102,6 +118,9 @@ class StorageItemIterator
 
     /**
      * @brief  Retrieve the next StorageItem
+     * @note Returned StorageItem is owned by iterator and stays valid only until next call to next().
+     * Its OpenAB::PIMItem is not copied by iterator, so caller can keep it by copying StorageItem
+     * (which only shares OpenAB::SmartPtr) or take it over using @ref StorageItem::swap.
      * @return The next StorageItem or NULL if no more StorageItem are available
      */
     virtual StorageItem*  next() = 0;
@@ -0,0 +1,347 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file WriteBufferedStorage.cpp
+ */
+
+#include "WriteBufferedStorage.hpp"
+#include <helpers/Log.hpp>
+
+namespace OpenAB_Storage {
+
+WriteBufferedStorage::WriteBufferedStorage(Storage* s,
+                                           unsigned int items,
+                                           unsigned int bytes,
+                                           unsigned int delay) :
+    Storage(s->getItemType()),
+    storage(s),
+    maxItems(items),
+    maxBytes(bytes),
+    maxDelayMs(delay),
+    removedBytes(0),
+    addedBytes(0),
+    modifiedBytes(0)
+{
+  stats.requestedCalls = 0;
+  stats.writtenOperations = 0;
+  stats.writtenBytes = 0;
+  stats.commits = 0;
+}
+
+WriteBufferedStorage::~WriteBufferedStorage()
+{
+  if (!flush())
+  {
+    LOG_ERROR()<<"Cannot flush "<<getPendingCount()<<" pending operations"<<std::endl;
+  }
+}
+
+bool WriteBufferedStorage::flush()
+{
+  if (0 == getPendingCount())
+  {
+    return true;
+  }
+
+  //each kind of operations is passed as single batch, kinds that were written are not pending anymore
+  if (!removedIds.empty())
+  {
+    if (eRemoveItemOk != storage->removeItems(removedIds))
+    {
+      LOG_ERROR()<<"Cannot remove "<<removedIds.size()<<" items"<<std::endl;
+      return false;
+    }
+    stats.writtenOperations += removedIds.size();
+    stats.writtenBytes += removedBytes;
+    removedIds.clear();
+    removedBytes = 0;
+  }
+
+  if (!addedItems.empty())
+  {
+    OpenAB::PIMItem::IDs newIds;
+    OpenAB::PIMItem::Revisions revisions;
+    if (eAddItemOk != storage->addItems(addedItems, newIds, revisions))
+    {
+      LOG_ERROR()<<"Cannot add "<<addedItems.size()<<" items"<<std::endl;
+      return false;
+    }
+    stats.writtenOperations += addedItems.size();
+    stats.writtenBytes += addedBytes;
+    addedItems.clear();
+    addedBytes = 0;
+  }
+
+  if (!modifiedItems.empty())
+  {
+    OpenAB::PIMItem::Revisions revisions;
+    if (eModifyItemOk != storage->modifyItems(modifiedItems, modifiedIds, revisions))
+    {
+      LOG_ERROR()<<"Cannot modify "<<modifiedItems.size()<<" items"<<std::endl;
+      return false;
+    }
+    stats.writtenOperations += modifiedItems.size();
+    stats.writtenBytes += modifiedBytes;
+    modifiedIds.clear();
+    modifiedItems.clear();
+    modifiedBytes = 0;
+  }
+
+  pendingIds.clear();
+  ++stats.commits;
+  return true;
+}
+
+unsigned int WriteBufferedStorage::getPendingCount() const
+{
+  return removedIds.size() + addedItems.size() + modifiedItems.size();
+}
+
+const WriteBufferedStorage::Stats& WriteBufferedStorage::getStats() const
+{
+  return stats;
+}
+
+enum Storage::eInit WriteBufferedStorage::init()
+{
+  return storage->init();
+}
+
+enum Storage::eSuspendRet WriteBufferedStorage::suspend()
+{
+  return storage->suspend();
+}
+
+enum Storage::eResumeRet WriteBufferedStorage::resume()
+{
+  return storage->resume();
+}
+
+enum Storage::eCancelRet WriteBufferedStorage::cancel()
+{
+  return storage->cancel();
+}
+
+enum Storage::eGetItemRet WriteBufferedStorage::getItem(OpenAB::SmartPtr<OpenAB::PIMItem> &item)
+{
+  if (!flush())
+  {
+    return eGetItemRetError;
+  }
+  return storage->getItem(item);
+}
+
+int WriteBufferedStorage::getTotalCount() const
+{
+  return storage->getTotalCount();
+}
+
+enum Storage::eAddItem WriteBufferedStorage::addItem(const OpenAB::SmartPtr<OpenAB::PIMItem>& item,
+                                                     OpenAB::PIMItem::ID & newId,
+                                                     OpenAB::PIMItem::Revision & revision)
+{
+  std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > items;
+  items.push_back(item);
+  OpenAB::PIMItem::IDs newIds;
+  OpenAB::PIMItem::Revisions revisions;
+
+  enum eAddItem res = addItems(items, newIds, revisions);
+  if (eAddItemOk == res)
+  {
+    newId = newIds.front();
+    revision = revisions.front();
+  }
+  return res;
+}
+
+enum Storage::eAddItem WriteBufferedStorage::addItems(const std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items,
+                                                      OpenAB::PIMItem::IDs & newIds,
+                                                      OpenAB::PIMItem::Revisions & revisions)
+{
+  ++stats.requestedCalls;
+  startPending();
+  for (unsigned int i = 0; i < items.size(); ++i)
+  {
+    addedItems.push_back(items[i]);
+    addedBytes += items[i]->getRawData().size();
+  }
+
+  //ids and revisions are not known until additions are written
+  newIds.assign(items.size(), "");
+  revisions.assign(items.size(), "");
+
+  return flushIfNeeded() ? eAddItemOk : eAddItemFail;
+}
+
+enum Storage::eModifyItem WriteBufferedStorage::modifyItem(const OpenAB::SmartPtr<OpenAB::PIMItem>& item,
+                                                           const OpenAB::PIMItem::ID & id,
+                                                           OpenAB::PIMItem::Revision & revision)
+{
+  std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > items;
+  items.push_back(item);
+  OpenAB::PIMItem::IDs ids;
+  ids.push_back(id);
+  OpenAB::PIMItem::Revisions revisions;
+
+  enum eModifyItem res = modifyItems(items, ids, revisions);
+  if (eModifyItemOk == res)
+  {
+    revision = revisions.front();
+  }
+  return res;
+}
+
+enum Storage::eModifyItem WriteBufferedStorage::modifyItems(const std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items,
+                                                            const OpenAB::PIMItem::IDs & ids,
+                                                            OpenAB::PIMItem::Revisions & revisions)
+{
+  if (items.size() != ids.size())
+  {
+    return eModifyItemFail;
+  }
+
+  ++stats.requestedCalls;
+  if (!flushIfPending(ids))
+  {
+    return eModifyItemFail;
+  }
+
+  startPending();
+  for (unsigned int i = 0; i < items.size(); ++i)
+  {
+    modifiedIds.push_back(ids[i]);
+    modifiedItems.push_back(items[i]);
+    modifiedBytes += items[i]->getRawData().size();
+    pendingIds.insert(ids[i]);
+  }
+  revisions.assign(items.size(), "");
+
+  return flushIfNeeded() ? eModifyItemOk : eModifyItemFail;
+}
+
+enum Storage::eRemoveItem WriteBufferedStorage::removeItem(const OpenAB::PIMItem::ID & id)
+{
+  OpenAB::PIMItem::IDs ids;
+  ids.push_back(id);
+  return removeItems(ids);
+}
+
+enum Storage::eRemoveItem WriteBufferedStorage::removeItems(const OpenAB::PIMItem::IDs & ids)
+{
+  ++stats.requestedCalls;
+  if (!flushIfPending(ids))
+  {
+    return eRemoveItemFail;
+  }
+
+  startPending();
+  for (unsigned int i = 0; i < ids.size(); ++i)
+  {
+    removedIds.push_back(ids[i]);
+    removedBytes += ids[i].size();
+    pendingIds.insert(ids[i]);
+  }
+
+  return flushIfNeeded() ? eRemoveItemOk : eRemoveItemFail;
+}
+
+enum Storage::eGetItem WriteBufferedStorage::getItem(const OpenAB::PIMItem::ID & id,
+                                                     OpenAB::SmartPtr<OpenAB::PIMItem>& item)
+{
+  if (!flush())
+  {
+    return eGetItemFail;
+  }
+  return storage->getItem(id, item);
+}
+
+enum Storage::eGetItem WriteBufferedStorage::getItems(const OpenAB::PIMItem::IDs & ids,
+                                                      std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items)
+{
+  if (!flush())
+  {
+    return eGetItemFail;
+  }
+  return storage->getItems(ids, items);
+}
+
+enum Storage::eGetSyncToken WriteBufferedStorage::getLatestSyncToken(std::string& token)
+{
+  if (!flush())
+  {
+    return eGetSyncTokenFail;
+  }
+  return storage->getLatestSyncToken(token);
+}
+
+enum Storage::eGetRevisions WriteBufferedStorage::getRevisions(std::map<std::string, std::string>& revisions)
+{
+  if (!flush())
+  {
+    return eGetRevisionsFail;
+  }
+  return storage->getRevisions(revisions);
+}
+
+enum Storage::eGetRevisions WriteBufferedStorage::getChangedRevisions(const std::string& token,
+                                                                      std::map<std::string, std::string>& revisions,
+                                                                      std::vector<OpenAB::PIMItem::ID>& removed)
+{
+  if (!flush())
+  {
+    return eGetRevisionsFail;
+  }
+  return storage->getChangedRevisions(token, revisions, removed);
+}
+
+StorageItemIterator* WriteBufferedStorage::newStorageItemIterator()
+{
+  if (!flush())
+  {
+    return NULL;
+  }
+  return storage->newStorageItemIterator();
+}
+
+bool WriteBufferedStorage::flushIfPending(const OpenAB::PIMItem::IDs& ids)
+{
+  for (unsigned int i = 0; i < ids.size(); ++i)
+  {
+    if (pendingIds.find(ids[i]) != pendingIds.end())
+    {
+      //keep operations on the same item in order they were requested
+      return flush();
+    }
+  }
+  return true;
+}
+
+void WriteBufferedStorage::startPending()
+{
+  if (0 == getPendingCount())
+  {
+    firstPendingTime = OpenAB::TimeStamp(true);
+  }
+}
+
+bool WriteBufferedStorage::flushIfNeeded()
+{
+  unsigned int pendingCount = getPendingCount();
+  if (0 == pendingCount)
+  {
+    return true;
+  }
+
+  if ((maxItems && pendingCount >= maxItems) ||
+      (maxBytes && removedBytes + addedBytes + modifiedBytes >= maxBytes) ||
+      (maxDelayMs && (OpenAB::TimeStamp(true) - firstPendingTime).toMs() >= maxDelayMs))
+  {
+    return flush();
+  }
+  return true;
+}
+
+} // namespace OpenAB_Storage
@@ -0,0 +1,170 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file WriteBufferedStorage.hpp
+ */
+
+#ifndef WRITEBUFFEREDSTORAGE_HPP_
+#define WRITEBUFFEREDSTORAGE_HPP_
+
+#include "Storage.hpp"
+#include <helpers/TimeStamp.hpp>
+#include <set>
+
+/*!
+ * @brief namespace OpenAB_Storage
+ */
+namespace OpenAB_Storage {
+
+/*!
+ * @brief Storage decorator that merges batches of write operations before passing them to wrapped Storage.
+ *
+ * Additions, modifications and removals are kept in memory until buffer budget (number of pending items,
+ * their size or time since first pending operation) is exceeded, until any read operation is requested,
+ * or until @ref flush is called. Then all pending removals, additions and modifications are passed to wrapped
+ * Storage using single batch call of each kind, so many small batches of client are written in few big commits.
+ *
+ * Operations are not coalesced, every requested operation is written. If item that already has pending
+ * modification or removal is modified or removed again, pending operations are flushed first,
+ * so operations on the same item are written in order they were requested.
+ *
+ * Ids and revisions of buffered additions are not known until they are written, so additions return empty ids
+ * and revisions, and so do modifications. Because of that it should be used only by clients that do not use
+ * ids and revisions returned by write operations.
+ *
+ * Statistics of written operations, their size and number of commits can be used to quantify commit reduction.
+ */
+class WriteBufferedStorage : public Storage
+{
+  public:
+    /*!
+     * @brief Statistics of write operations.
+     */
+    struct Stats
+    {
+      unsigned int       requestedCalls;      /**< @brief Number of write calls requested by client */
+      unsigned int       writtenOperations;   /**< @brief Number of item operations passed to wrapped Storage */
+      unsigned long long writtenBytes;        /**< @brief Size of items (or ids in case of removals) passed to wrapped Storage */
+      unsigned int       commits;             /**< @brief Number of flushes that passed any operation to wrapped Storage */
+    };
+
+    /*!
+     *  @brief Constructor.
+     *  @param [in] storage wrapped Storage, it is not owned by WriteBufferedStorage and has to outlive it.
+     *  @param [in] maxItems maximal number of pending items, 0 for no limit.
+     *  @param [in] maxBytes maximal size of pending items, 0 for no limit.
+     *  @param [in] maxDelayMs maximal time in milliseconds since first pending operation, 0 for no limit
+     *  (checked only when new write operation is requested).
+     */
+    WriteBufferedStorage(Storage* storage,
+                         unsigned int maxItems,
+                         unsigned int maxBytes,
+                         unsigned int maxDelayMs);
+
+    /*!
+     *  @brief Destructor, flushes pending operations.
+     */
+    virtual ~WriteBufferedStorage();
+
+    /*!
+     * @brief Passes all pending operations to wrapped Storage.
+     * @return true if all pending operations were written, false otherwise
+     * (operations that were not written stay pending).
+     */
+    bool flush();
+
+    /*!
+     * @brief Returns number of pending items.
+     */
+    unsigned int getPendingCount() const;
+
+    /*!
+     * @brief Returns statistics of write operations.
+     */
+    const Stats& getStats() const;
+
+    enum eInit init();
+    enum eSuspendRet suspend();
+    enum eResumeRet resume();
+    enum eCancelRet cancel();
+    enum eGetItemRet getItem(OpenAB::SmartPtr<OpenAB::PIMItem> &item);
+    int getTotalCount() const;
+
+    enum eAddItem addItem(const OpenAB::SmartPtr<OpenAB::PIMItem>& item,
+                          OpenAB::PIMItem::ID & newId,
+                          OpenAB::PIMItem::Revision & revision);
+    enum eAddItem addItems(const std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items,
+                           OpenAB::PIMItem::IDs & newIds,
+                           OpenAB::PIMItem::Revisions & revisions);
+    enum eModifyItem modifyItem(const OpenAB::SmartPtr<OpenAB::PIMItem>& item,
+                                const OpenAB::PIMItem::ID & id,
+                                OpenAB::PIMItem::Revision & revision);
+    enum eModifyItem modifyItems(const std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items,
+                                 const OpenAB::PIMItem::IDs & ids,
+                                 OpenAB::PIMItem::Revisions & revisions);
+    enum eRemoveItem removeItem(const OpenAB::PIMItem::ID & id);
+    enum eRemoveItem removeItems(const OpenAB::PIMItem::IDs & ids);
+    enum eGetItem getItem(const OpenAB::PIMItem::ID & id,
+                          OpenAB::SmartPtr<OpenAB::PIMItem>& item);
+    enum eGetItem getItems(const OpenAB::PIMItem::IDs & ids,
+                           std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items);
+    enum eGetSyncToken getLatestSyncToken(std::string& token);
+    enum eGetRevisions getRevisions(std::map<std::string, std::string>& revisions);
+    enum eGetRevisions getChangedRevisions(const std::string& token,
+                                           std::map<std::string, std::string>& revisions,
+                                           std::vector<OpenAB::PIMItem::ID>& removed);
+    StorageItemIterator* newStorageItemIterator();
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    WriteBufferedStorage(WriteBufferedStorage const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    WriteBufferedStorage& operator=(WriteBufferedStorage const &other);
+
+    /*!
+     * @brief Flushes pending operations if any of given ids has pending modification or removal.
+     * @return false if flush was needed and failed, true otherwise.
+     */
+    bool flushIfPending(const OpenAB::PIMItem::IDs& ids);
+
+    /*!
+     * @brief Marks start of buffering if nothing is pending yet.
+     */
+    void startPending();
+
+    /*!
+     * @brief Flushes pending operations if buffer budget was exceeded.
+     * @return false if flush was needed and failed, true otherwise.
+     */
+    bool flushIfNeeded();
+
+    Storage*                storage;
+    unsigned int            maxItems;
+    unsigned int            maxBytes;
+    unsigned int            maxDelayMs;
+
+    /*pending operations in order they were requested*/
+    OpenAB::PIMItem::IDs    removedIds;
+    std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > addedItems;
+    OpenAB::PIMItem::IDs    modifiedIds;
+    std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > modifiedItems;
+    /*ids with pending modification or removal*/
+    std::set<OpenAB::PIMItem::ID> pendingIds;
+    unsigned long long      removedBytes;
+    unsigned long long      addedBytes;
+    unsigned long long      modifiedBytes;
+    OpenAB::TimeStamp       firstPendingTime;
+    Stats                   stats;
+};
+
+} // namespace OpenAB_Storage
+
+#endif // WRITEBUFFEREDSTORAGE_HPP_
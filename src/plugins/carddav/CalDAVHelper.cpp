@@ -19,6 +19,7 @@ CalDAVHelper::CalDAVHelper(const std::string& serverUrl,
   serverUrl(serverUrl),
   httpSession(httpSession),
   httpAuthorizer(httpAuthorizer),
+  calendarMoved(false),
   userAgent(DAV_USER_AGENT)
 {
   //if we have calendar url, parse princpialCalendarSetHostUrl from it
@@ -259,6 +260,7 @@ bool CalDAVHelper::findCalendars()
         return false;
       }
 
+      calendarMoved = false;
       return true;
     }
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
@@ -316,6 +318,21 @@ bool CalDAVHelper::queryCalendarInfo(const std::string& calendarURL, CalendarInf
   }
 }
 
+void CalDAVHelper::restoreCalendarUrl(const std::string& calendarURL)
+{
+  principalCalendarSetHostUrl = OpenAB::parseURLHostPart(calendarURL);
+  calendarMoved = false;
+}
+
+void CalDAVHelper::checkCalendarMoved(long code)
+{
+  if (OpenAB::HttpMessage::NOT_FOUND == code ||
+      OpenAB::HttpMessage::MOVED_PERMAMENTLY == code)
+  {
+    calendarMoved = true;
+  }
+}
+
 bool CalDAVHelper::queryCalendarMetadata(const std::string& calendarURL)
 {
   OpenAB::HttpMessage msg;
@@ -355,6 +372,7 @@ bool CalDAVHelper::queryCalendarMetadata(const std::string& calendarURL)
       LOG_DEBUG()<<"CTAG: "<<calendarCTag<<" SyncToken "<<calendarSyncToken<<std::endl;
       return true;
     }
+    checkCalendarMoved(msg.getResponseCode());
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
     LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
     return false;
@@ -366,7 +384,121 @@ bool CalDAVHelper::queryCalendarMetadata(const std::string& calendarURL)
   }
 }
 
+void CalDAVHelper::setTimeRange(const std::string& component,
+                                const std::string& start,
+                                const std::string& end)
+{
+  timeRangeComponent = component;
+  timeRangeStart = start;
+  timeRangeEnd = end;
+}
+
+std::string CalDAVHelper::formatTimeRangeDate(time_t time)
+{
+  struct tm tmTime;
+  char buf[32];
+  gmtime_r(&time, &tmTime);
+  strftime(buf, sizeof(buf), "%Y%m%dT%H%M%SZ", &tmTime);
+  return buf;
+}
+
+void CalDAVHelper::getTimeRange(time_t now,
+                                int pastDays,
+                                int futureDays,
+                                std::string& start,
+                                std::string& end)
+{
+  start.clear();
+  end.clear();
+  if (pastDays >= 0)
+  {
+    start = formatTimeRangeDate(now - (time_t)pastDays * 24 * 60 * 60);
+  }
+  if (futureDays >= 0)
+  {
+    end = formatTimeRangeDate(now + (time_t)futureDays * 24 * 60 * 60);
+  }
+}
+
 bool CalDAVHelper::queryEventsMetadata(const std::string& calendarURL)
+{
+  if (hasTimeRange())
+  {
+    return queryTimeRangeMetadata(calendarURL);
+  }
+  return queryResourcesMetadata(calendarURL);
+}
+
+bool CalDAVHelper::queryTimeRangeMetadata(const std::string& calendarURL)
+{
+  eventsMetadata.clear();
+  OpenAB::HttpMessage msg;
+  msg.setRequestType("REPORT");
+  msg.appendHeader("Content-Type", "text/xml");
+  msg.appendHeader("Depth", "1");
+  msg.appendHeader("User-Agent", userAgent);
+  msg.setURL(calendarURL);
+
+  httpAuthorizer->authorizeMessage(&msg);
+
+  std::stringstream oss;
+  oss<<"<C:calendar-query xmlns:D='DAV:' xmlns:C='urn:ietf:params:xml:ns:caldav'>";
+  oss<<"<D:prop><D:getetag/></D:prop>";
+  oss<<"<C:filter><C:comp-filter name='VCALENDAR'><C:comp-filter name='"<<timeRangeComponent<<"'>";
+  oss<<"<C:time-range";
+  if (!timeRangeStart.empty())
+  {
+    oss<<" start='"<<timeRangeStart<<"'";
+  }
+  if (!timeRangeEnd.empty())
+  {
+    oss<<" end='"<<timeRangeEnd<<"'";
+  }
+  oss<<"/></C:comp-filter></C:comp-filter></C:filter></C:calendar-query>";
+
+  msg.setData(oss.str());
+
+  if (httpSession->execute(&msg))
+  {
+    LOG_DEBUG()<<msg.getResponse()<<std::endl;
+    if (OpenAB::HttpMessage::MULTISTATUS == msg.getResponseCode())
+    {
+      std::string resp = msg.getResponse();
+      std::vector<DAVHelper::DAVResponse> responses;
+      if (!davHelper.parseDAVMultistatus(resp, responses))
+      {
+        LOG_ERROR()<<"Cannot parse server response"<<std::endl;
+        return false;
+      }
+      std::vector<DAVHelper::DAVResponse>::iterator it = responses.begin();
+
+      for (; it != responses.end(); ++it)
+      {
+        //calendar-query returns only calendar object resources matching filter
+        if ((*it).hasProperty(davHelper.PROPERTY_ETAG))
+        {
+          EventMetadata metadata;
+          metadata.uri = (*it).href;
+          metadata.etag = (*it).getProperty(davHelper.PROPERTY_ETAG);
+          eventsMetadata.push_back(metadata);
+        }
+      }
+      LOG_DEBUG()<<"Got "<<eventsMetadata.size()<<" events in time range "<<timeRangeStart<<" - "<<timeRangeEnd<<std::endl;
+      return true;
+    }
+    checkCalendarMoved(msg.getResponseCode());
+    LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
+    LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
+    return false;
+  }
+  else
+  {
+   LOG_ERROR()<<"CardDAV request error: " << msg.getErrorString() <<std::endl;
+   return false;
+  }
+}
+
+bool CalDAVHelper::queryResourcesMetadata(const std::string& url)
 {
   eventsMetadata.clear();
   OpenAB::HttpMessage msg;
@@ -375,7 +507,7 @@ bool CalDAVHelper::queryEventsMetadata(const std::string& calendarURL)
   msg.appendHeader("Depth", "1");
   msg.appendHeader("User-Agent", userAgent);
   msg.setData("<d:propfind xmlns:d='DAV:'><d:prop><d:getetag/><d:resourcetype/></d:prop></d:propfind>");
-  msg.setURL(calendarURL);
+  msg.setURL(url);
 
   httpAuthorizer->authorizeMessage(&msg);
 
@@ -406,6 +538,7 @@ bool CalDAVHelper::queryEventsMetadata(const std::string& calendarURL)
       }
       return true;
     }
+    checkCalendarMoved(msg.getResponseCode());
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
     LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
     return false;
@@ -476,6 +609,7 @@ bool CalDAVHelper::queryChangedEventsMetadata(const std::string& calendarURL,
       LOG_DEBUG() << "Got  " << eventsMetadata.size() << " events SyncToken "<<calendarSyncToken<<std::endl;
       return true;
     }
+    checkCalendarMoved(msg.getResponseCode());
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
     LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
     return false;
@@ -490,6 +624,15 @@ bool CalDAVHelper::queryChangedEventsMetadata(const std::string& calendarURL,
 bool CalDAVHelper::downloadEvents(const std::string& calendarURL,
                                   std::vector<std::string>& uris,
                                   std::vector<std::string>& iCals)
+{
+  std::vector<std::string> etags;
+  return downloadEvents(calendarURL, uris, iCals, etags);
+}
+
+bool CalDAVHelper::downloadEvents(const std::string& calendarURL,
+                                  const std::vector<std::string>& uris,
+                                  std::vector<std::string>& iCals,
+                                  std::vector<std::string>& etags)
 {
   OpenAB::HttpMessage msg;
   msg.setRequestType("REPORT");
@@ -519,6 +662,8 @@ bool CalDAVHelper::downloadEvents(const std::string& calendarURL,
   //resize output buffer and place iCals in right place
   iCals.clear();
   iCals.resize(uris.size());
+  etags.clear();
+  etags.resize(uris.size());
 
   if (httpSession->execute(&msg))
   {
@@ -537,15 +682,20 @@ bool CalDAVHelper::downloadEvents(const std::string& calendarURL,
         if ((*it).hasProperty(davHelper.PROPERTY_CALENDAR_DATA))
         {
           std::string iCal = (*it).getProperty(davHelper.PROPERTY_CALENDAR_DATA);
-          if (!iCal.empty())
+          int idx = getIndexFromUris(uris, (*it).href);
+          if (!iCal.empty() && idx >= 0)
           {
-            int idx = getIndexFromUris(uris, (*it).href);
             iCals[idx] = iCal;
+            if ((*it).hasProperty(davHelper.PROPERTY_ETAG))
+            {
+              etags[idx] = (*it).getProperty(davHelper.PROPERTY_ETAG);
+            }
           }
         }
       }
       return true;
     }
+    checkCalendarMoved(msg.getResponseCode());
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
     LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
     return false;
@@ -620,15 +770,16 @@ bool CalDAVHelper::downloadEvents(const std::string& calendarURL,
         if ((*it).hasProperty(davHelper.PROPERTY_CALENDAR_DATA))
         {
           std::string iCal = (*it).getProperty(davHelper.PROPERTY_CALENDAR_DATA);
-          if (!iCal.empty())
+          int idx = getIndexFromUris(uris, (*it).href);
+          if (!iCal.empty() && idx >= 0)
           {
-            int idx = getIndexFromUris(uris, (*it).href);
             iCals[idx] = iCal;
           }
         }
       }
       return true;
     }
+    checkCalendarMoved(msg.getResponseCode());
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
     LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
     return false;
@@ -690,7 +841,7 @@ bool CalDAVHelper::addEvent(const std::string& calendarURL,
       if (uri.empty() || etag.empty())
       {
         EventsMetadata oldMetadata = eventsMetadata;
-        queryEventsMetadata(calendarURL + uid + ".ics");
+        queryResourcesMetadata(calendarURL + uid + ".ics");
         if (!eventsMetadata.empty())
         {
           uri = (*eventsMetadata.begin()).uri;
@@ -840,7 +991,7 @@ bool CalDAVHelper::modifyEvent(const std::string& uri,
       if (etag.empty())
       {
         EventsMetadata oldMetadata = eventsMetadata;
-        queryEventsMetadata(principalCalendarSetHostUrl + uri);
+        queryResourcesMetadata(principalCalendarSetHostUrl + uri);
         if (!eventsMetadata.empty())
         {
           etag = (*eventsMetadata.begin()).etag;
@@ -13,6 +13,7 @@
 #include "helpers/Http.hpp"
 #include "DAVHelper.hpp"
 #include "PIMItem/PIMItem.hpp"
+#include <time.h>
 
 /*!
  * @brief Documentation for class CalDAVHelper.
@@ -84,10 +85,52 @@ class CalDAVHelper
      * @brief Queries events/tasks metadata (list of IDs and revisions).
      * After calling this function metadata can be obtained by using @ref getContactsMetadata() and @ref getTotalCount().
      * @param [in] calendarURL calendar to be queried.
+     * @note when time range was set using @ref setTimeRange only events/tasks overlapping it are queried.
      * @return true if contacts metadata was queried successfully, false otherwise.
      */
     bool queryEventsMetadata(const std::string& calendarURL);
 
+    /*!
+     * @brief Limits @ref queryEventsMetadata to events/tasks overlapping given time range,
+     * by using calendar-query REPORT with time-range filter instead of listing whole calendar.
+     * As iCalendars are downloaded based on queried metadata, only objects from time range will be downloaded.
+     * @param [in] component name of calendar component to be queried ("VEVENT" or "VTODO").
+     * @param [in] start start of time range in UTC (in format returned by @ref formatTimeRangeDate), empty for unbounded.
+     * @param [in] end end of time range in UTC (in format returned by @ref formatTimeRangeDate), empty for unbounded.
+     * @note when both start and end are empty time range is disabled.
+     */
+    void setTimeRange(const std::string& component,
+                      const std::string& start,
+                      const std::string& end);
+
+    /*!
+     * @brief Returns true if time range was set using @ref setTimeRange.
+     */
+    bool hasTimeRange() const
+    {
+      return !timeRangeStart.empty() || !timeRangeEnd.empty();
+    }
+
+    /*!
+     * @brief Converts time to UTC date-time format used by CalDAV time-range filter (e.g. 20150101T000000Z).
+     * @param [in] time time to be converted.
+     */
+    static std::string formatTimeRangeDate(time_t time);
+
+    /*!
+     * @brief Computes time range of given number of days around given time, in format expected by @ref setTimeRange.
+     * @param [in] now time around which time range is computed.
+     * @param [in] pastDays number of days before now, -1 for unbounded start.
+     * @param [in] futureDays number of days after now, -1 for unbounded end.
+     * @param [out] start start of time range, empty if unbounded.
+     * @param [out] end end of time range, empty if unbounded.
+     */
+    static void getTimeRange(time_t now,
+                             int pastDays,
+                             int futureDays,
+                             std::string& start,
+                             std::string& end);
+
     /*!
      * @brief Queries only metadata of events/tasks that were modified since provided sync token was created.
      * After calling this function metadata can be obtained by using @ref getEventsMetadata() and @ref getTotalCount().
@@ -126,6 +169,20 @@ class CalDAVHelper
                         std::vector<std::string>& uris,
                         std::vector<std::string>& icals);
 
+    /*!
+     * @brief Downloads iCalendar objects with given uris together with their current etags.
+     * @param [in] calendarURL calendar to be used.
+     * @param [in] uris list of iCalendar uri (from EventMetadata) to be downloaded.
+     * @param [out] icals downloaded iCalendar objects, each placed at index of uri it was returned for,
+     * empty if server did not return object for given uri.
+     * @param [out] etags etags returned together with objects, empty if server did not return etag for given uri.
+     * @return true if objects were downloaded successfully.
+     */
+    bool downloadEvents(const std::string& calendarURL,
+                        const std::vector<std::string>& uris,
+                        std::vector<std::string>& icals,
+                        std::vector<std::string>& etags);
+
     /*!
      * @brief Creates new event/task.
      * @note Provided iCalendar object needs to have UID field set.
@@ -186,6 +243,33 @@ class CalDAVHelper
       return calendarSyncToken;
     }
 
+    /*!
+     * @brief Returns CTag queried by @ref queryCalendarMetadata().
+     * @return CTag
+     */
+    std::string getCTag() const
+    {
+      return calendarCTag;
+    }
+
+    /*!
+     * @brief Restores calendar url found by previous service discovery, so it does not need to be repeated.
+     * Restored url is not revalidated, if calendar was moved or removed, requests to it will fail
+     * and @ref isCalendarMoved will return true.
+     * @param [in] calendarURL calendar url.
+     */
+    void restoreCalendarUrl(const std::string& calendarURL);
+
+    /*!
+     * @brief Checks if last request to calendar failed because it was moved or removed (404 or 301 response).
+     * In such case service discovery needs to be repeated.
+     * @return true if calendar was moved.
+     */
+    bool isCalendarMoved() const
+    {
+      return calendarMoved;
+    }
+
     /*!
      * @brief Simple struct describing items in metadata
      */
@@ -298,6 +382,21 @@ class CalDAVHelper
     //list of available calendars
     Calendars calendars;
 
+    /*!
+     * @brief Marks calendar as moved if server responded with 404 or 301 code.
+     */
+    void checkCalendarMoved(long code);
+
+    /*!
+     * @brief Queries metadata of all resources under given url using PROPFIND request.
+     */
+    bool queryResourcesMetadata(const std::string& url);
+
+    /*!
+     * @brief Queries metadata of events/tasks overlapping configured time range using calendar-query REPORT.
+     */
+    bool queryTimeRangeMetadata(const std::string& calendarURL);
+
     /*!
      * @brief Helper function that returns index of provided uri in list of provided uris.
      * @param [in] uris list of uris to be searched
@@ -324,6 +423,11 @@ class CalDAVHelper
     EventsMetadata eventsMetadata;
     std::string calendarCTag;
     std::string calendarSyncToken;
+    bool calendarMoved;
+
+    std::string timeRangeComponent;
+    std::string timeRangeStart;
+    std::string timeRangeEnd;
 
     std::string userAgent;
 };
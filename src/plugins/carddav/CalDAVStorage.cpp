@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <math.h>
 #include <locale>
+#include <sstream>
 #include <unistd.h>
 #include "helpers/OAuth2HttpAuthorizer.hpp"
 #include "helpers/BasicHttpAuthorizer.hpp"
@@ -28,7 +29,11 @@ CalDAVStorage::CalDAVStorage(const std::string& url,
                              const OpenAB::SecureString& password,
                              const std::string& calendarURL,
                              const std::string& calName,
-                             OpenAB::PIMItemType type)
+                             OpenAB::PIMItemType type,
+                             const std::string& cacheDir,
+                             bool refreshDiscovery,
+                             int timeRangePastDays,
+                             int timeRangeFutureDays)
     : OpenAB_Storage::CalendarStorage(type),
       serverUrl (url),
       calendarUrl(calendarURL),
@@ -39,6 +44,11 @@ CalDAVStorage::CalDAVStorage(const std::string& url,
       clientSecret(),
       refreshToken(),
       syncToken(),
+      cacheDir(cacheDir),
+      refreshDiscovery(refreshDiscovery),
+      calendarDiscovered(false),
+      timeRangePastDays(timeRangePastDays),
+      timeRangeFutureDays(timeRangeFutureDays),
       authorizer(NULL),
       calDavHelper(NULL),
       sourceIterator(NULL)
@@ -53,7 +63,11 @@ CalDAVStorage::CalDAVStorage(const std::string& url,
                              const OpenAB::SecureString& refreshToken,
                              const std::string& calendarURL,
                              const std::string& calName,
-                             OpenAB::PIMItemType type)
+                             OpenAB::PIMItemType type,
+                             const std::string& cacheDir,
+                             bool refreshDiscovery,
+                             int timeRangePastDays,
+                             int timeRangeFutureDays)
     : OpenAB_Storage::CalendarStorage(type),
       serverUrl (url),
       calendarUrl(calendarURL),
@@ -64,6 +78,11 @@ CalDAVStorage::CalDAVStorage(const std::string& url,
       clientSecret(clientSecret),
       refreshToken(refreshToken),
       syncToken(),
+      cacheDir(cacheDir),
+      refreshDiscovery(refreshDiscovery),
+      calendarDiscovered(false),
+      timeRangePastDays(timeRangePastDays),
+      timeRangeFutureDays(timeRangeFutureDays),
       authorizer(NULL),
       calDavHelper(NULL),
       sourceIterator(NULL)
@@ -90,6 +109,8 @@ CalDAVStorage::~CalDAVStorage()
 
 void CalDAVStorage::cleanup()
 {
+  cache = OpenAB::SmartPtr<DAVCache>();
+
   if (calDavHelper)
   {
     delete calDavHelper;
@@ -181,70 +202,160 @@ enum OpenAB_Storage::Storage::eInit CalDAVStorage::init()
   else
   {
     calDavHelper = new CalDAVHelper(serverUrl, false, &curlSession, authorizer);
-
-    if (!calDavHelper->findPrincipalUrl())
+    calendarDiscovered = true;
+
+    //try to reuse calendar selected by previous service discovery, it will be revalidated
+    //by first request to calendar
+    DAVCache::State state;
+    if (!cacheDir.empty() && !refreshDiscovery &&
+        DAVCache::loadState(cacheDir, discoveryKey(), state) &&
+        !state["calendar_url"].empty())
     {
-      LOG_ERROR() << "Cannot connect to CardDAV server"<<std::endl;
-      return eInitFail;
+      LOG_DEBUG()<<"Using cached service discovery results"<<std::endl;
+      calendarUrl = state["calendar_url"];
+      calDavHelper->restoreCalendarUrl(calendarUrl);
     }
-
-    if (!calDavHelper->findCalendarHomeSet())
+    else if (!discoverCalendar())
     {
-      LOG_ERROR() << "Cannot connect to CardDAV server"<<std::endl;
       return eInitFail;
     }
+    refreshDiscovery = false;
+  }
+
+  setupCache();
+
+  return eInitOk;
+}
 
-    if (!calDavHelper->findCalendars())
+bool CalDAVStorage::discoverCalendar()
+{
+  calendarUrl.clear();
+
+  if (!calDavHelper->findPrincipalUrl())
+  {
+    LOG_ERROR() << "Cannot connect to CardDAV server"<<std::endl;
+    return false;
+  }
+
+  if (!calDavHelper->findCalendarHomeSet())
+  {
+    LOG_ERROR() << "Cannot connect to CardDAV server"<<std::endl;
+    return false;
+  }
+
+  if (!calDavHelper->findCalendars())
+  {
+    LOG_ERROR() << "Cannot connect to CardDAV server"<<std::endl;
+    return false;
+  }
+
+  // if user didn't provided calendar name to use,
+  // use first one that supports given type of items
+  CalDAVHelper::Calendars calendars = calDavHelper->getCalendars();
+  if (calendarName.empty())
+  {
+    if (selectFirstCalendar(calendars, calendarInfo))
     {
-      LOG_ERROR() << "Cannot connect to CardDAV server"<<std::endl;
-      return eInitFail;
+      calendarUrl = calendarInfo.getUrl();
     }
-
-    // if user didn't provided calendar name to use,
-    // use first one that supports given type of items
-    CalDAVHelper::Calendars calendars = calDavHelper->getCalendars();
-    if (calendarName.empty())
+  }
+  else
+  {
+    // otherwise look for calendar with given name
+    CalDAVHelper::CalendarItemTypes t =
+        (OpenAB::eEvent == getItemType()) ? CalDAVHelper::EVENT : CalDAVHelper::TODO;
+    CalDAVHelper::Calendars::const_iterator it;
+    for (it = calendars.begin(); it != calendars.end(); ++it)
     {
-      if (selectFirstCalendar(calendars, calendarInfo))
+      if ((*it).getDisplayName() == calendarName &&
+          (*it).supportsType(t))
       {
+        calendarInfo = (*it);
         calendarUrl = calendarInfo.getUrl();
+        break;
       }
     }
-    else
+    if (calendarUrl.empty())
     {
-      // otherwise look for calendar with given name
-      CalDAVHelper::CalendarItemTypes t =
-          (OpenAB::eEvent == getItemType()) ? CalDAVHelper::EVENT : CalDAVHelper::TODO;
-      CalDAVHelper::Calendars::const_iterator it;
-      for (it = calendars.begin(); it != calendars.end(); ++it)
-      {
-        if ((*it).getDisplayName() == calendarName &&
-            (*it).supportsType(t))
-        {
-          calendarInfo = (*it);
-          calendarUrl = calendarInfo.getUrl();
-          break;
-        }
-      }
-      if (calendarUrl.empty())
+      // if calendar with given name does not exist, use first one
+      if (selectFirstCalendar(calendars, calendarInfo))
       {
-        // if calendar with given name does not exist, use first one
-        if (selectFirstCalendar(calendars, calendarInfo))
-        {
-          calendarUrl = calendarInfo.getUrl();
-        }
+        calendarUrl = calendarInfo.getUrl();
       }
     }
+  }
 
-    //check if we found any calendar that is matching requested params
-    if (calendarUrl.empty())
+  //check if we found any calendar that is matching requested params
+  if (calendarUrl.empty())
+  {
+    LOG_ERROR()<<"Couldn't found any calendar that will match provided parameters"<<std::endl;
+    return false;
+  }
+
+  saveDiscoveryInfo();
+  return true;
+}
+
+bool CalDAVStorage::rediscoverIfMoved()
+{
+  if (!calendarDiscovered || !calDavHelper->isCalendarMoved())
+  {
+    return false;
+  }
+
+  LOG_DEBUG()<<"Calendar was moved, repeating service discovery"<<std::endl;
+  if (!discoverCalendar())
+  {
+    if (!cacheDir.empty())
     {
-      LOG_ERROR()<<"Couldn't found any calendar that will match provided parameters"<<std::endl;
-      return eInitFail;
+      DAVCache::removeState(cacheDir, discoveryKey());
     }
+    return false;
   }
+  setupCache();
+  return true;
+}
 
-  return eInitOk;
+void CalDAVStorage::saveDiscoveryInfo()
+{
+  if (cacheDir.empty() || !calendarDiscovered)
+  {
+    return;
+  }
+
+  DAVCache::State state;
+  state["calendar_url"] = calendarUrl;
+  state["ctag"] = calDavHelper->getCTag();
+  state["sync_token"] = calDavHelper->getSyncToken();
+  DAVCache::saveState(cacheDir, discoveryKey(), state);
+}
+
+std::string CalDAVStorage::discoveryKey() const
+{
+  std::stringstream key;
+  key<<serverUrl<<" "<<(userLogin.empty() ? clientId : userLogin)<<" "<<calendarName<<" "<<getItemType();
+  return key.str();
+}
+
+void CalDAVStorage::setupCache()
+{
+  //iterators that are still running keep their own reference to previous cache,
+  //it is freed when last of them is destroyed
+  cache = OpenAB::SmartPtr<DAVCache>();
+
+  if (!cacheDir.empty())
+  {
+    DAVCache* newCache = new DAVCache(cacheDir, calendarUrl);
+    if (!newCache->init())
+    {
+      LOG_ERROR() << "Cannot initialize iCalendars cache, continuing without it"<<std::endl;
+      delete newCache;
+    }
+    else
+    {
+      cache = newCache;
+    }
+  }
 }
 
 enum OpenAB_Storage::Storage::eAddItem CalDAVStorage::addObject(const std::string& iCal,
@@ -314,6 +425,10 @@ enum OpenAB_Storage::Storage::eRemoveItem CalDAVStorage::removeObject( const Ope
   {
     return eRemoveItemFail;
   }
+  if (cache.getPointer())
+  {
+    cache->remove(id);
+  }
   return eRemoveItemOk;
 }
 
@@ -501,9 +616,23 @@ enum OpenAB_Storage::Storage::eGetItem CalDAVStorage::getTasks (const OpenAB::PI
   return eGetItemOk;
 }
 
+void CalDAVStorage::updateTimeRange()
+{
+  if (!hasTimeRange())
+  {
+    return;
+  }
+
+  std::string start, end;
+  CalDAVHelper::getTimeRange(time(NULL), timeRangePastDays, timeRangeFutureDays, start, end);
+  calDavHelper->setTimeRange((OpenAB::eEvent == getItemType()) ? "VEVENT" : "VTODO", start, end);
+}
+
 enum OpenAB_Storage::Storage::eGetRevisions CalDAVStorage::getRevisions(std::map<std::string, std::string>& revisions)
 {
-  if (!calDavHelper->queryEventsMetadata(calendarUrl))
+  updateTimeRange();
+  if (!calDavHelper->queryEventsMetadata(calendarUrl) &&
+      (!rediscoverIfMoved() || !calDavHelper->queryEventsMetadata(calendarUrl)))
   {
     LOG_FUNC()<<" Cannot query metadata"<<std::endl;
     return eGetRevisionsFail;
@@ -522,12 +651,15 @@ enum OpenAB_Storage::Storage::eGetRevisions CalDAVStorage::getChangedRevisions(c
                                                                             std::map<std::string, std::string>& revisions,
                                                                             std::vector<OpenAB::PIMItem::ID>& removed)
 {
-  if (token.empty())
+  //sync-collection report cannot be limited to time window, items that moved across
+  //window edges have to be found by comparing revisions of all items in window
+  if (token.empty() || hasTimeRange())
   {
     return eGetRevisionsFail;
   }
 
-  if (!calDavHelper->queryChangedEventsMetadata(calendarUrl, token, removed))
+  if (!calDavHelper->queryChangedEventsMetadata(calendarUrl, token, removed) &&
+      (!rediscoverIfMoved() || !calDavHelper->queryChangedEventsMetadata(calendarUrl, token, removed)))
   {
     LOG_FUNC()<<" Cannot query metadata"<<std::endl;
     return eGetRevisionsFail;
@@ -545,18 +677,21 @@ enum OpenAB_Storage::Storage::eGetRevisions CalDAVStorage::getChangedRevisions(c
 
 enum OpenAB_Storage::Storage::eGetSyncToken CalDAVStorage::getLatestSyncToken(std::string& token)
 {
-  if (!calDavHelper->queryCalendarMetadata(calendarUrl))
+  if (!calDavHelper->queryCalendarMetadata(calendarUrl) &&
+      (!rediscoverIfMoved() || !calDavHelper->queryCalendarMetadata(calendarUrl)))
   {
     return eGetSyncTokenFail;
   }
 
   token = calDavHelper->getSyncToken();
+  saveDiscoveryInfo();
 
   return eGetSyncTokenOk;
 }
 
 OpenAB_Storage::StorageItemIterator* CalDAVStorage::newStorageItemIterator()
 {
+  updateTimeRange();
   CalDAVStorageItemIterator * ie = new CalDAVStorageItemIterator();
   if (NULL == ie)
   {
@@ -564,7 +699,8 @@ OpenAB_Storage::StorageItemIterator* CalDAVStorage::newStorageItemIterator()
     return NULL;
   }
 
-  if (ie->eCursorInitOK != ie->cursorInit(calDavHelper, calendarUrl, getItemType()))
+  if (ie->eCursorInitOK != ie->cursorInit(calDavHelper, calendarUrl, getItemType(), cache) &&
+      (!rediscoverIfMoved() || ie->eCursorInitOK != ie->cursorInit(calDavHelper, calendarUrl, getItemType(), cache)))
   {
     LOG_ERROR() << "Error Cannot Init the CalDAV IndexElemIterator"<<std::endl;
     delete ie;
@@ -624,32 +760,39 @@ CalDAVStorageItemIterator::CalDAVStorageItemIterator() :
     total(0),
     offset(0),
     offsetOfCachedICals(0),
+    cachedEvents(QUERY_SIZE),
     paused(false),
     cancelled(false),
     threadCreated(false),
     transferStatus(OpenAB_Source::Source::eGetItemRetOk),
     itemsType(OpenAB::eEvent)
 {
-  pthread_mutex_init(&mutex, NULL);
-  pthread_cond_init(&bufferReadyCond, NULL);
 }
 
 CalDAVStorageItemIterator::~CalDAVStorageItemIterator()
 {
   cancelled = true;
-  pthread_mutex_destroy(&mutex);
-  pthread_cond_destroy(&bufferReadyCond);
+  //wake up download thread if it is waiting for free space in queue
+  cachedEvents.close();
   if (threadCreated)
   {
     pthread_join(downloadThread, NULL);
   }
+
+  OpenAB::PIMCalendarItem* item;
+  while (cachedEvents.pop(item))
+  {
+    delete item;
+  }
 }
 
 enum CalDAVStorageItemIterator::eCursorInit CalDAVStorageItemIterator::cursorInit(CalDAVHelper* helper,
                                                                                   const std::string& calURL,
-                                                                                  OpenAB::PIMItemType type)
+                                                                                  OpenAB::PIMItemType type,
+                                                                                  const OpenAB::SmartPtr<DAVCache>& davCache)
 {
   calDavHelper = helper;
+  cache = davCache;
   calendarURL = calURL;
 
   itemsType = type;
@@ -661,9 +804,20 @@ enum CalDAVStorageItemIterator::eCursorInit CalDAVStorageItemIterator::cursorIni
   eventsMetadata = calDavHelper->getEventsMetadata();
   total = eventsMetadata.size();
 
+  if (cache.getPointer())
+  {
+    //drop cached iCalendars of items that were removed from server
+    std::vector<std::string> uris;
+    for (unsigned int i = 0; i < eventsMetadata.size(); ++i)
+    {
+      uris.push_back(eventsMetadata[i].uri);
+    }
+    cache->prune(uris);
+  }
+
   offsetOfCachedICals = 0;
   offset = 0;
-  cachedEvents.clear();
+  cachedEvents.reset();
 
   cancelled = false;
   transferStatus = OpenAB_Source::Source::eGetItemRetOk;
@@ -687,9 +841,7 @@ void* CalDAVStorageItemIterator::downloadThreadFunc(void* ptr)
 
     if (iterator.cancelled)
     {
-      pthread_mutex_lock(&iterator.mutex);
-      pthread_cond_signal(&iterator.bufferReadyCond);
-      pthread_mutex_unlock(&iterator.mutex);
+      iterator.cachedEvents.close();
       return NULL;
     }
 
@@ -697,18 +849,14 @@ void* CalDAVStorageItemIterator::downloadThreadFunc(void* ptr)
     {
       LOG_DEBUG()<<"DownloadThread download error"<<std::endl;
       iterator.transferStatus = OpenAB_Source::Source::eGetItemRetError;
-      pthread_mutex_lock(&iterator.mutex);
-      pthread_cond_signal(&iterator.bufferReadyCond);
-      pthread_mutex_unlock(&iterator.mutex);
+      iterator.cachedEvents.close();
       return NULL;
     }
     offset += QUERY_SIZE;
   }
 
-  pthread_mutex_lock(&iterator.mutex);
   iterator.transferStatus = OpenAB_Source::Source::eGetItemRetEnd;
-  pthread_cond_signal(&iterator.bufferReadyCond);
-  pthread_mutex_unlock(&iterator.mutex);
+  iterator.cachedEvents.close();
   return NULL;
 }
 
@@ -716,7 +864,7 @@ bool CalDAVStorageItemIterator::downloadICals(unsigned int offset, unsigned int
 {
   LOG_FUNC();
   std::vector<std::string> ids;
-  std::vector<std::string> icals;
+  std::vector<unsigned int> missing;
 
   unsigned int len = offset + size;
   if (len > eventsMetadata.size())
@@ -724,19 +872,53 @@ bool CalDAVStorageItemIterator::downloadICals(unsigned int offset, unsigned int
     len = eventsMetadata.size();
   }
 
+  std::vector<std::string> icals(len - offset);
+
+  //replay from cache all iCalendars which etag didn't change, download only remaining ones
   for (unsigned int i = offset; i < len; ++i)
   {
+    if (cache.getPointer() && cache->lookup(eventsMetadata[i].uri, eventsMetadata[i].etag, icals[i - offset]))
+    {
+      continue;
+    }
     LOG_DEBUG()<<"Adding items to be downloaded "<<eventsMetadata[i].uri<<std::endl;
     ids.push_back(eventsMetadata[i].uri);
+    missing.push_back(i - offset);
   }
-  if (!calDavHelper->downloadEvents(calendarURL, ids, icals))
+  LOG_DEBUG()<<"Found "<<(icals.size() - ids.size())<<" of "<<icals.size()<<" iCalendars in cache"<<std::endl;
+
+  if (!ids.empty())
   {
-    return false;
+    std::vector<std::string> downloaded;
+    std::vector<std::string> etags;
+    if (!calDavHelper->downloadEvents(calendarURL, ids, downloaded, etags))
+    {
+      return false;
+    }
+
+    //downloaded iCalendars are placed under uri they were returned for,
+    //cache only those returned with etag that was listed in metadata
+    for (unsigned int i = 0; i < missing.size(); ++i)
+    {
+      unsigned int index = missing[i];
+      icals[index].swap(downloaded[i]);
+      if (cache.getPointer() && !icals[index].empty() &&
+          etags[i] == eventsMetadata[offset + index].etag)
+      {
+        cache->store(eventsMetadata[offset + index].uri,
+                     eventsMetadata[offset + index].etag,
+                     icals[index]);
+      }
+    }
   }
 
-  pthread_mutex_lock(&mutex);
+  //parse without holding any lock, queue blocks when consumer is not keeping up
   for (unsigned int i = 0; i < icals.size(); ++i)
   {
+    if (icals[i].empty())
+    {
+      continue;
+    }
     OpenAB::PIMCalendarItem* newItem;
     if (OpenAB::eEvent == itemsType)
       newItem = new OpenAB::PIMCalendarEventItem();
@@ -748,60 +930,38 @@ bool CalDAVStorageItemIterator::downloadICals(unsigned int offset, unsigned int
     newItem->parse(icals.at(i));
     newItem->setId(eventsMetadata[offset + i].uri);
     newItem->setRevision(eventsMetadata[offset + i].etag);
-    cachedEvents.push_back(newItem);
+    std::string().swap(icals[i]);
+
+    if (!cachedEvents.push(newItem))
+    {
+      //iterator was destroyed
+      delete newItem;
+      return true;
+    }
   }
-  pthread_cond_signal(&bufferReadyCond);
-  pthread_mutex_unlock(&mutex);
 
   return true;
 }
 
 OpenAB_Storage::StorageItem* CalDAVStorageItemIterator::next()
 {
-  pthread_mutex_lock(&mutex);
-
-  if (cachedEvents.empty())
-  {
-    if (OpenAB_Source::Source::eGetItemRetEnd == transferStatus)
-    {
-      LOG_DEBUG()<<"download finished"<<std::endl;
-      //Cache empty, download finished
-      pthread_mutex_unlock(&mutex);
-      return NULL;
-    }
-    //Cache empty, waiting for new batch
-    pthread_cond_wait(&bufferReadyCond, &mutex);
-  }
-
-  if (OpenAB_Source::Source::eGetItemRetEnd == transferStatus && cachedEvents.empty())
-  {
-    //Download end
-    pthread_mutex_unlock(&mutex);
-    return NULL;
-  }
-
   if (OpenAB_Source::Source::eGetItemRetError == transferStatus)
   {
     //Download error
-    pthread_mutex_unlock(&mutex);
     return NULL;
   }
-  OpenAB::SmartPtr<OpenAB::PIMCalendarItem> nextItem = cachedEvents.front();
-  cachedEvents.pop_front();
-  LOG_DEBUG()<<"Getting next element from CalDAVStorageItemIterator "<<nextItem->getRawData()<<std::endl;
-  pthread_mutex_unlock(&mutex);
 
-  if (OpenAB::eEvent == itemsType)
+  OpenAB::PIMCalendarItem* item = NULL;
+  if (!cachedEvents.pop(item))
   {
-    OpenAB::PIMCalendarEventItem* it = (OpenAB::PIMCalendarEventItem*)nextItem.getPointer();
-    elem.item = new OpenAB::PIMCalendarEventItem(*it);
-  }
-  else
-  {
-    OpenAB::PIMCalendarTaskItem* it = (OpenAB::PIMCalendarTaskItem*)nextItem.getPointer();
-    elem.item = new OpenAB::PIMCalendarTaskItem(*it);
+    LOG_DEBUG()<<"download finished"<<std::endl;
+    return NULL;
   }
-  elem.id = nextItem->getId();
+  LOG_DEBUG()<<"Getting next element from CalDAVStorageItemIterator "<<item->getRawData()<<std::endl;
+
+  //ownership of item is passed from download thread to elem, no need to copy it
+  elem.id = item->getId();
+  elem.item = item;
 
   return &elem;
 }
@@ -835,6 +995,10 @@ OpenAB_Storage::Storage * createInstance(const OpenAB_Storage::Parameters & para
   std::string serverUrl = "";
   std::string calendarUrl = "";
   std::string calendarName = "";
+  std::string cacheDir = "";
+  bool refreshDiscovery = false;
+  int timeRangePastDays = -1;
+  int timeRangeFutureDays = -1;
 
   OpenAB::PIMItemType type;
 
@@ -901,6 +1065,30 @@ OpenAB_Storage::Storage * createInstance(const OpenAB_Storage::Parameters & para
     calendarName = param.getString();
   }
 
+  param = params.getValue("cache_dir");
+  if (!param.invalid() && OpenAB::Variant::STRING == param.getType())
+  {
+    cacheDir = param.getString();
+  }
+
+  param = params.getValue("refresh_discovery");
+  if (!param.invalid() && OpenAB::Variant::BOOL == param.getType())
+  {
+    refreshDiscovery = param.getBool();
+  }
+
+  param = params.getValue("time_range_past_days");
+  if (!param.invalid() && OpenAB::Variant::INTEGER == param.getType())
+  {
+    timeRangePastDays = param.getInt();
+  }
+
+  param = params.getValue("time_range_future_days");
+  if (!param.invalid() && OpenAB::Variant::INTEGER == param.getType())
+  {
+    timeRangeFutureDays = param.getInt();
+  }
+
   param = params.getValue("item_type");
   if (param.invalid() || param.getType() != OpenAB::Variant::INTEGER)
   {
@@ -928,7 +1116,11 @@ OpenAB_Storage::Storage * createInstance(const OpenAB_Storage::Parameters & para
                             refreshToken,
                             calendarUrl,
                             calendarName,
-                            type);
+                            type,
+                            cacheDir,
+                            refreshDiscovery,
+                            timeRangePastDays,
+                            timeRangeFutureDays);
   }
   else
   {
@@ -937,7 +1129,11 @@ OpenAB_Storage::Storage * createInstance(const OpenAB_Storage::Parameters & para
                             password,
                             calendarUrl,
                             calendarName,
-                            type);
+                            type,
+                            cacheDir,
+                            refreshDiscovery,
+                            timeRangePastDays,
+                            timeRangeFutureDays);
   }
   if (NULL == src)
   {
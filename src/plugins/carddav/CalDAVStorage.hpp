@@ -13,7 +13,9 @@
 #include <plugin/storage/CalendarStorage.hpp>
 #include <list>
 #include "helpers/Http.hpp"
+#include "helpers/BoundedQueue.hpp"
 #include "CalDAVHelper.hpp"
+#include "DAVCache.hpp"
 
 class CalDAVStorageItemIterator;
 
@@ -37,6 +39,10 @@ class CalDAVStorageItemIterator;
  * | String  | "client_id"     | Id of client application (registered in Google)     | Yes       |
  * | String  | "client_secret" | Secret of client application (registered in Google) | Yes       |
  * | String  | "refresh_token" | OAuth2 user refresh token                           | Yes       |
+ * | String  | "cache_dir"     | Directory where downloaded iCalendars will be cached | No       |
+ * | Bool | "refresh_discovery" | When set to true cached service discovery results are ignored | No |
+ * | Integer | "time_range_past_days"   | Synchronize only items that end no earlier than given number of days ago | No |
+ * | Integer | "time_range_future_days" | Synchronize only items that start no later than given number of days from now | No |
  *
  * CalDAV can support multiple calendars for single account, when only "server_url" is provided,
  * first found calendar will be used.
@@ -50,6 +56,17 @@ class CalDAVStorageItemIterator;
  *  are mandatory to provide, depending on authorization method used by CardDAV server.
  *  When using OAuth2 refresh token it has to have required scope (for Google calendar this is https://www.googleapis.com/auth/calendar).
  *
+ *@note When "cache_dir" is provided, iCalendars are cached on disk together with their etags,
+ *  and only iCalendars whose etag has changed since last sync are downloaded from server.
+ *  When calendar is selected by service discovery (no "calendar_url" provided), url of selected calendar
+ *  is persisted in the same directory and reused on next initialization, discovery is repeated only when
+ *  calendar was moved/removed (server responded with 404 or 301) or "refresh_discovery" was requested.
+ *@note When "time_range_past_days" and/or "time_range_future_days" are provided only items overlapping
+ *  time window relative to current time are queried and downloaded (using CalDAV calendar-query with time-range filter).
+ *  Window is moved on every synchronization, items that left it are reported as removed and items that entered it as added,
+ *  all other items are compared using their etags as usual. Incremental changes based on sync token are not reported in this mode,
+ *  as they are not limited to time window.
+ *
  */
 class CalDAVStorage : public OpenAB_Storage::CalendarStorage
 {
@@ -62,13 +79,21 @@ class CalDAVStorage : public OpenAB_Storage::CalendarStorage
      *  @param[in] calendarURL direct calendar url
      *  @param[in] calendarName optional name of calendar to be used
      *  @param[in] type type of items to use (either OpenAB::eEvent or OpenAB::eTask)
+     *  @param[in] cacheDir optional directory where downloaded iCalendars will be cached
+     *  @param[in] refreshDiscovery ignore persisted results of service discovery
+     *  @param[in] timeRangePastDays synchronize only items not older than given number of days, -1 for no limit
+     *  @param[in] timeRangeFutureDays synchronize only items not further in future than given number of days, -1 for no limit
      */
     CalDAVStorage(const std::string& url,
                   const std::string& login,
                   const OpenAB::SecureString& password,
                   const std::string& calendarURL,
                   const std::string& calendarName,
-                  OpenAB::PIMItemType type);
+                  OpenAB::PIMItemType type,
+                  const std::string& cacheDir = "",
+                  bool refreshDiscovery = false,
+                  int timeRangePastDays = -1,
+                  int timeRangeFutureDays = -1);
 
     /*!
      *  @brief Constructor.
@@ -79,6 +104,10 @@ class CalDAVStorage : public OpenAB_Storage::CalendarStorage
      *  @param[in] calendarURL direct calendar url
      *  @param[in] calendarName optional name of calendar to be used
      *  @param[in] type type of items to use (either OpenAB::eEvent or OpenAB::eTask)
+     *  @param[in] cacheDir optional directory where downloaded iCalendars will be cached
+     *  @param[in] refreshDiscovery ignore persisted results of service discovery
+     *  @param[in] timeRangePastDays synchronize only items not older than given number of days, -1 for no limit
+     *  @param[in] timeRangeFutureDays synchronize only items not further in future than given number of days, -1 for no limit
      */
     CalDAVStorage(const std::string& url,
                   const std::string& clientId,
@@ -86,7 +115,11 @@ class CalDAVStorage : public OpenAB_Storage::CalendarStorage
                   const OpenAB::SecureString& refreshToken,
                   const std::string& calendarURL,
                   const std::string& calendarName,
-                  OpenAB::PIMItemType type);
+                  OpenAB::PIMItemType type,
+                  const std::string& cacheDir = "",
+                  bool refreshDiscovery = false,
+                  int timeRangePastDays = -1,
+                  int timeRangeFutureDays = -1);
 
     virtual ~CalDAVStorage();
 
@@ -163,6 +196,45 @@ class CalDAVStorage : public OpenAB_Storage::CalendarStorage
     bool selectFirstCalendar(const CalDAVHelper::Calendars cals,
                              CalDAVHelper::CalendarInfo& selectedCalendar);
 
+    /*!
+     * @brief Runs service discovery, selects calendar to be used and persists its url if cache directory was provided.
+     */
+    bool discoverCalendar();
+
+    /*!
+     * @brief Runs service discovery again if last request failed because calendar was moved.
+     * @return true if calendar was moved and discovered again successfully.
+     */
+    bool rediscoverIfMoved();
+
+    /*!
+     * @brief Persists url of discovered calendar together with its CTag/sync token.
+     */
+    void saveDiscoveryInfo();
+
+    /*!
+     * @brief Key under which discovery results are persisted (server url, user, calendar name and items type).
+     */
+    std::string discoveryKey() const;
+
+    /*!
+     * @brief (Re)creates iCalendars cache for currently used calendar.
+     */
+    void setupCache();
+
+    /*!
+     * @brief Moves time window of synchronized items relative to current time.
+     */
+    void updateTimeRange();
+
+    /*!
+     * @brief Returns true if synchronization is limited to time window.
+     */
+    bool hasTimeRange() const
+    {
+      return timeRangePastDays >= 0 || timeRangeFutureDays >= 0;
+    }
+
     std::string       serverUrl;
     std::string       calendarUrl;
     std::string       calendarName;
@@ -175,12 +247,18 @@ class CalDAVStorage : public OpenAB_Storage::CalendarStorage
     OpenAB::SecureString refreshToken;
 
     std::string syncToken;
+    std::string cacheDir;
+    bool refreshDiscovery;
+    bool calendarDiscovered;
+    int timeRangePastDays;
+    int timeRangeFutureDays;
 
     CalDAVHelper::CalendarInfo calendarInfo;
 
     OpenAB::HttpSession curlSession;
     OpenAB::HttpAuthorizer* authorizer;
     CalDAVHelper* calDavHelper;
+    OpenAB::SmartPtr<DAVCache> cache;
     CalDAVStorageItemIterator* sourceIterator;
 };
 
@@ -201,9 +279,17 @@ class CalDAVStorageItemIterator : public OpenAB_Storage::StorageItemIterator
       eCursorInitOK,
       eCursorInitFail
     };
+    /*!
+     * @brief Initializes iterator.
+     * @param [in] calDAVHelper helper used to download items.
+     * @param [in] calendarURL url of calendar.
+     * @param [in] type type of items.
+     * @param [in] cache optional cache of iCalendars, if provided only iCalendars with changed etag will be downloaded.
+     */
     enum eCursorInit cursorInit(CalDAVHelper* calDAVHelper,
                                 const std::string& calendarURL,
-                                OpenAB::PIMItemType type);
+                                OpenAB::PIMItemType type,
+                                const OpenAB::SmartPtr<DAVCache>& cache = OpenAB::SmartPtr<DAVCache>());
 
     OpenAB_Storage::StorageItem* next();
 
@@ -239,21 +325,21 @@ class CalDAVStorageItemIterator : public OpenAB_Storage::StorageItemIterator
 
     OpenAB_Storage::StorageItem    elem;
     CalDAVHelper*               calDavHelper;
+    OpenAB::SmartPtr<DAVCache>  cache;
     std::string                 calendarURL;
 
     unsigned                    total;
     unsigned int                offset;
     unsigned int                offsetOfCachedICals;
 
-    std::list<OpenAB::SmartPtr<OpenAB::PIMCalendarItem> >  cachedEvents;
+    //items parsed by download thread waiting to be returned by next(), ownership is passed through the queue
+    OpenAB::BoundedQueue<OpenAB::PIMCalendarItem*> cachedEvents;
     std::vector<CalDAVHelper::EventMetadata> eventsMetadata;
 
     bool                 paused;
     bool                 cancelled;
     bool                 threadCreated;
     pthread_t            downloadThread;
-    pthread_mutex_t      mutex;
-    pthread_cond_t       bufferReadyCond;
     OpenAB_Source::Source::eGetItemRet transferStatus;
     OpenAB::PIMItemType     itemsType;
 };
@@ -17,7 +17,8 @@ CardDAVHelper::CardDAVHelper(const std::string& serverUrl,
                              OpenAB::HttpAuthorizer* httpAuthorizer) :
   serverUrl(serverUrl),
   httpSession(httpSession),
-  httpAuthorizer(httpAuthorizer)
+  httpAuthorizer(httpAuthorizer),
+  addressbookMoved(false)
 {
   serverHostUrl = OpenAB::parseURLHostPart(serverUrl);
 }
@@ -206,6 +207,62 @@ bool CardDAVHelper::findAddressbooks()
   }
 }
 
+bool CardDAVHelper::discover()
+{
+  if (!findPrincipalUrl() ||
+      !findAddressbookSet() ||
+      !findAddressbooks())
+  {
+    return false;
+  }
+  addressbookMoved = false;
+  return true;
+}
+
+CardDAVHelper::DiscoveryInfo CardDAVHelper::getDiscoveryInfo() const
+{
+  DiscoveryInfo info;
+  info["principal_url"] = principalUrl;
+  info["addressbook_set_url"] = principalAddressbookSetUrl;
+  info["addressbook_url"] = principalAddressbookUrl;
+  info["ctag"] = addressbookCTag;
+  info["sync_token"] = addressbookSyncToken;
+  return info;
+}
+
+bool CardDAVHelper::restoreDiscoveryInfo(const DiscoveryInfo& info)
+{
+  DiscoveryInfo::const_iterator it = info.find("addressbook_url");
+  if (it == info.end() || (*it).second.empty())
+  {
+    return false;
+  }
+  principalAddressbookUrl = (*it).second;
+
+  it = info.find("principal_url");
+  principalUrl = (it != info.end()) ? (*it).second : "";
+  it = info.find("addressbook_set_url");
+  principalAddressbookSetUrl = (it != info.end()) ? (*it).second : "";
+  principalAddressbookSetHostUrl = OpenAB::parseURLHostPart(principalAddressbookSetUrl);
+  it = info.find("ctag");
+  addressbookCTag = (it != info.end()) ? (*it).second : "";
+  it = info.find("sync_token");
+  addressbookSyncToken = (it != info.end()) ? (*it).second : "";
+
+  addressbookMoved = false;
+  LOG_DEBUG()<<"Restored address book "<<principalAddressbookUrl<<std::endl;
+  return true;
+}
+
+void CardDAVHelper::checkAddressbookMoved(long code)
+{
+  if (OpenAB::HttpMessage::NOT_FOUND == code ||
+      OpenAB::HttpMessage::MOVED_PERMAMENTLY == code)
+  {
+    LOG_DEBUG()<<"Address book "<<principalAddressbookUrl<<" was moved or removed"<<std::endl;
+    addressbookMoved = true;
+  }
+}
 
 bool CardDAVHelper::queryAddressbookMetadata()
 {
@@ -245,6 +302,7 @@ bool CardDAVHelper::queryAddressbookMetadata()
       LOG_DEBUG()<<"CTAG: "<<addressbookCTag<<" SyncToken "<<addressbookSyncToken<<std::endl;
       return true;
     }
+    checkAddressbookMoved(msg.getResponseCode());
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
     LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
     return false;
@@ -296,6 +354,7 @@ bool CardDAVHelper::queryContactsMetadata()
       LOG_DEBUG() << "Got  " << contactsMetadata.size() << " contacts"<<std::endl;
       return true;
     }
+    checkAddressbookMoved(msg.getResponseCode());
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
     LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
     return false;
@@ -363,6 +422,7 @@ bool CardDAVHelper::queryChangedContactsMetadata(const std::string& syncToken,
       LOG_DEBUG() << "Got  " << contactsMetadata.size() << " contacts SyncToken "<<addressbookSyncToken<<std::endl;
       return true;
     }
+    checkAddressbookMoved(msg.getResponseCode());
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
     LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
     return false;
@@ -376,6 +436,27 @@ bool CardDAVHelper::queryChangedContactsMetadata(const std::string& syncToken,
 
 bool CardDAVHelper::downloadVCards(std::vector<std::string>& uris,
                                    std::vector<std::string>& vcards)
+{
+  std::vector<std::string> found;
+  std::vector<std::string> etags;
+  if (!downloadVCards(uris, found, etags))
+  {
+    return false;
+  }
+
+  for (unsigned int i = 0; i < found.size(); ++i)
+  {
+    if (!found[i].empty())
+    {
+      vcards.push_back(found[i]);
+    }
+  }
+  return true;
+}
+
+bool CardDAVHelper::downloadVCards(const std::vector<std::string>& uris,
+                                   std::vector<std::string>& vcards,
+                                   std::vector<std::string>& etags)
 {
   OpenAB::HttpMessage msg;
   msg.setRequestType("REPORT");
@@ -391,15 +472,24 @@ bool CardDAVHelper::downloadVCards(std::vector<std::string>& uris,
   oss<<"<D:prop><D:getetag/><C:address-data>";
   oss<<"</C:address-data></D:prop>";
 
+  std::map<std::string, unsigned int> indexes;
   for (unsigned int i = 0; i < uris.size(); ++i)
   {
     oss<<"<D:href>"<<uris[i]<<"</D:href>";
+    indexes[uris[i]] = i;
   }
 
   oss<<"</C:addressbook-multiget>";
 
   msg.setData(oss.str());
 
+  //servers are not required to keep order of requested hrefs,
+  //place each vCard under href it was returned for
+  vcards.clear();
+  vcards.resize(uris.size());
+  etags.clear();
+  etags.resize(uris.size());
+
   if (httpSession->execute(&msg))
   {
     if (msg.MULTISTATUS == msg.getResponseCode())
@@ -417,42 +507,22 @@ bool CardDAVHelper::downloadVCards(std::vector<std::string>& uris,
       {
         if ((*it).hasProperty(davHelper.PROPERTY_ADDRESS_DATA))
         {
-          std::string vCard = (*it).getProperty(davHelper.PROPERTY_ADDRESS_DATA);
-          if (!vCard.empty())
+          std::map<std::string, unsigned int>::iterator idx = indexes.find((*it).href);
+          if (idx == indexes.end())
           {
-            //Google unnecessary escapes ':' character
-            OpenAB::substituteAll(vCard, "\\:", ":");
-            //Convert any encoded XML characters (can occur in NOTE field)
-            OpenAB::substituteAll(vCard, "&lt;", "<");
-            OpenAB::substituteAll(vCard, "&gt;", ">");
-            std::istringstream input(vCard);
-            std::ostringstream output;
-
-            //Google and iCloud are grouping some fields with custom labels
-            //creating new fields that are beginning with "item#.FIELD_NAME" and "item#.LABEL"
-            //For now custom labels are ignored and item#.FIELD_NAME fields are converted to FIELD_NAME fields.
-            std::string line;
-            while (std::getline(input, line))
-            {
-              if(OpenAB::beginsWith(line, "item"))
-              {
-
-                std::string::size_type pos = 0;
-                OpenAB::cut(line, "item", ".", pos);
-                if (pos != std::string::npos)
-                {
-                  line = line.substr(pos+1);
-                }
-              }
-              output<<line<<std::endl;
-            }
-
-            vcards.push_back(output.str());
+            LOG_DEBUG()<<"Ignoring vCard of not requested contact "<<(*it).href<<std::endl;
+            continue;
+          }
+          vcards[(*idx).second] = fixupVCard((*it).getProperty(davHelper.PROPERTY_ADDRESS_DATA));
+          if ((*it).hasProperty(davHelper.PROPERTY_ETAG))
+          {
+            etags[(*idx).second] = (*it).getProperty(davHelper.PROPERTY_ETAG);
           }
         }
       }
       return true;
     }
+    checkAddressbookMoved(msg.getResponseCode());
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
     LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
     return false;
@@ -463,6 +533,42 @@ bool CardDAVHelper::downloadVCards(std::vector<std::string>& uris,
     return false;
   }
 }
+
+std::string CardDAVHelper::fixupVCard(std::string vCard)
+{
+  if (vCard.empty())
+  {
+    return vCard;
+  }
+  //Google unnecessary escapes ':' character
+  OpenAB::substituteAll(vCard, "\\:", ":");
+  //Convert any encoded XML characters (can occur in NOTE field)
+  OpenAB::substituteAll(vCard, "&lt;", "<");
+  OpenAB::substituteAll(vCard, "&gt;", ">");
+  std::istringstream input(vCard);
+  std::ostringstream output;
+
+  //Google and iCloud are grouping some fields with custom labels
+  //creating new fields that are beginning with "item#.FIELD_NAME" and "item#.LABEL"
+  //For now custom labels are ignored and item#.FIELD_NAME fields are converted to FIELD_NAME fields.
+  std::string line;
+  while (std::getline(input, line))
+  {
+    if(OpenAB::beginsWith(line, "item"))
+    {
+
+      std::string::size_type pos = 0;
+      OpenAB::cut(line, "item", ".", pos);
+      if (pos != std::string::npos)
+      {
+        line = line.substr(pos+1);
+      }
+    }
+    output<<line<<std::endl;
+  }
+  return output.str();
+}
+
 bool CardDAVHelper::downloadVCards(unsigned int offset, unsigned int size,
                                    std::vector<std::string>& vcards)
 {
@@ -543,6 +649,7 @@ bool CardDAVHelper::downloadVCards(unsigned int offset, unsigned int size,
       }
       return true;
     }
+    checkAddressbookMoved(msg.getResponseCode());
     LOG_ERROR()<<"Server returned "<<msg.getResponseCode()<<" code - ";
     LOG_ERROR()<<OpenAB::HttpMessage::responseCodeDescription(msg.getResponseCode())<<std::endl;
     return false;
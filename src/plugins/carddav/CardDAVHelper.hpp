@@ -13,6 +13,7 @@
 #include "helpers/Http.hpp"
 #include "DAVHelper.hpp"
 #include "PIMItem/PIMItem.hpp"
+#include <map>
 /*!
  * @brief Documentation for class CardDAVHelper
  */
@@ -52,6 +53,42 @@ class CardDAVHelper
      */
     bool findAddressbooks();
 
+    /*!
+     * @brief Runs complete service discovery (@ref findPrincipalUrl, @ref findAddressbookSet and @ref findAddressbooks).
+     * @return true if address book was found successfully, false otherwise.
+     */
+    bool discover();
+
+    /*!
+     * @brief Type used to save and restore results of service discovery.
+     */
+    typedef std::map<std::string, std::string> DiscoveryInfo;
+
+    /*!
+     * @brief Returns results of service discovery together with last known CTag and sync token of address book.
+     * @return discovery information that can be later passed to @ref restoreDiscoveryInfo.
+     */
+    DiscoveryInfo getDiscoveryInfo() const;
+
+    /*!
+     * @brief Restores results of previous service discovery, so @ref discover does not need to be called.
+     * Restored information is not revalidated, if address book was moved or removed, requests to it will fail
+     * and @ref isAddressbookMoved will return true.
+     * @param [in] info discovery information obtained by @ref getDiscoveryInfo.
+     * @return true if information was restored successfully, false if it was incomplete.
+     */
+    bool restoreDiscoveryInfo(const DiscoveryInfo& info);
+
+    /*!
+     * @brief Checks if last request to address book failed because it was moved or removed (404 or 301 response).
+     * In such case @ref discover needs to be called again.
+     * @return true if address book was moved.
+     */
+    bool isAddressbookMoved() const
+    {
+      return addressbookMoved;
+    }
+
     /*!
      * @brief Query address book metadata (current revision and sync token).
      * After calling this function sync token can be obtained by using @ref getSyncToken().
@@ -95,6 +132,18 @@ class CardDAVHelper
     bool downloadVCards(std::vector<std::string>& uris,
                         std::vector<std::string>& vcards);
 
+    /*!
+     * @brief Download vCards of given contacts together with their current etags.
+     * @param [in] uris list of contact ids to be downloaded.
+     * @param [out] vcards downloaded vCards, each placed at index of uri it was returned for,
+     * empty if server did not return vCard for given uri.
+     * @param [out] etags etags returned together with vCards, empty if server did not return etag for given uri.
+     * @return true if contacts were downloaded successfully.
+     */
+    bool downloadVCards(const std::vector<std::string>& uris,
+                        std::vector<std::string>& vcards,
+                        std::vector<std::string>& etags);
+
     /*!
      * @brief Uploads contact.
      * @param [in] vcard vcard to be uploaded
@@ -144,6 +193,24 @@ class CardDAVHelper
       return addressbookSyncToken;
     }
 
+    /*!
+     * @brief Returns CTag queried by @ref queryAddressbookMetadata().
+     * @return CTag
+     */
+    std::string getCTag() const
+    {
+      return addressbookCTag;
+    }
+
+    /*!
+     * @brief Returns url of address book found by @ref findAddressbooks().
+     * @return address book url
+     */
+    std::string getAddressbookUrl() const
+    {
+      return principalAddressbookUrl;
+    }
+
     typedef struct
     {
         std::string etag;
@@ -163,6 +230,11 @@ class CardDAVHelper
     }
 
   private:
+    /*!
+     * @brief Converts vCard returned by server to form understood by OpenAB::PIMContactItem.
+     */
+    static std::string fixupVCard(std::string vCard);
+
     /*!
      *  @brief Copy constructor, private unimplemented to prevent misuse.
      */
@@ -173,6 +245,11 @@ class CardDAVHelper
      */
     CardDAVHelper& operator=(CardDAVHelper const &other);
 
+    /*!
+     * @brief Marks address book as moved if server responded with 404 or 301 code.
+     */
+    void checkAddressbookMoved(long code);
+
     std::string       serverUrl;
     std::string       serverHostUrl;
     std::string       principalUrl;
@@ -187,6 +264,7 @@ class CardDAVHelper
     ContactsMetadata contactsMetadata;
     std::string addressbookCTag;
     std::string addressbookSyncToken;
+    bool addressbookMoved;
 };
 
 #endif // CARDDAVHELPER_HPP_
@@ -25,7 +25,9 @@
 
 CardDAVStorage::CardDAVStorage(const std::string& url,
                                const std::string& login,
-                               const OpenAB::SecureString& password)
+                               const OpenAB::SecureString& password,
+                               const std::string& cacheDir,
+                               bool refreshDiscovery)
     : OpenAB_Storage::ContactsStorage(),
       serverUrl (url),
       userLogin(login),
@@ -34,6 +36,8 @@ CardDAVStorage::CardDAVStorage(const std::string& url,
       clientSecret(),
       refreshToken(),
       syncToken(),
+      cacheDir(cacheDir),
+      refreshDiscovery(refreshDiscovery),
       authorizer(NULL),
       cardDAVHelper(NULL),
       sourceIterator(NULL)
@@ -45,7 +49,9 @@ CardDAVStorage::CardDAVStorage(const std::string& url,
 CardDAVStorage::CardDAVStorage(const std::string& url,
                                const std::string& clientId,
                                const OpenAB::SecureString& clientSecret,
-                               const OpenAB::SecureString& refreshToken)
+                               const OpenAB::SecureString& refreshToken,
+                               const std::string& cacheDir,
+                               bool refreshDiscovery)
     : OpenAB_Storage::ContactsStorage(),
       serverUrl (url),
       userLogin(),
@@ -54,6 +60,8 @@ CardDAVStorage::CardDAVStorage(const std::string& url,
       clientSecret(clientSecret),
       refreshToken(refreshToken),
       syncToken(),
+      cacheDir(cacheDir),
+      refreshDiscovery(refreshDiscovery),
       authorizer(NULL),
       cardDAVHelper(NULL),
       sourceIterator(NULL)
@@ -82,6 +90,8 @@ CardDAVStorage::~CardDAVStorage()
 void CardDAVStorage::cleanup()
 {
   std::cout << "**** in cleanup ****" << std::endl;
+  cache = OpenAB::SmartPtr<DAVCache>();
+
   if (cardDAVHelper)
   {
     delete cardDAVHelper;
@@ -124,25 +134,85 @@ enum OpenAB_Storage::Storage::eInit CardDAVStorage::init()
 
   cardDAVHelper = new CardDAVHelper(serverUrl, &curlSession, authorizer);
 
-  if (!cardDAVHelper->findPrincipalUrl())
+  //try to reuse results of previous service discovery, they will be revalidated
+  //by first request to address book
+  DAVCache::State state;
+  if (!cacheDir.empty() && !refreshDiscovery &&
+      DAVCache::loadState(cacheDir, discoveryKey(), state) &&
+      cardDAVHelper->restoreDiscoveryInfo(state))
+  {
+    LOG_DEBUG()<<"Using cached service discovery results"<<std::endl;
+    setupCache();
+  }
+  else if (!discover())
   {
     LOG_ERROR() << "Cannot connect to CardDAV server"<<std::endl;
     return eInitFail;
   }
+  refreshDiscovery = false;
+
+  return eInitOk;
+}
 
-  if (!cardDAVHelper->findAddressbookSet())
+bool CardDAVStorage::discover()
+{
+  if (!cardDAVHelper->discover())
   {
-    LOG_ERROR() << "Cannot connect to CardDAV server"<<std::endl;
-    return eInitFail;
+    if (!cacheDir.empty())
+    {
+      DAVCache::removeState(cacheDir, discoveryKey());
+    }
+    return false;
   }
 
-  if (!cardDAVHelper->findAddressbooks())
+  saveDiscoveryInfo();
+  setupCache();
+  return true;
+}
+
+bool CardDAVStorage::rediscoverIfMoved()
+{
+  if (!cardDAVHelper->isAddressbookMoved())
   {
-    LOG_ERROR() << "Cannot connect to CardDAV server"<<std::endl;
-    return eInitFail;
+    return false;
   }
 
-  return eInitOk;
+  LOG_DEBUG()<<"Address book was moved, repeating service discovery"<<std::endl;
+  return discover();
+}
+
+void CardDAVStorage::saveDiscoveryInfo()
+{
+  if (!cacheDir.empty())
+  {
+    DAVCache::saveState(cacheDir, discoveryKey(), cardDAVHelper->getDiscoveryInfo());
+  }
+}
+
+std::string CardDAVStorage::discoveryKey() const
+{
+  return serverUrl + " " + (userLogin.empty() ? clientId : userLogin);
+}
+
+void CardDAVStorage::setupCache()
+{
+  //iterators that are still running keep their own reference to previous cache,
+  //it is freed when last of them is destroyed
+  cache = OpenAB::SmartPtr<DAVCache>();
+
+  if (!cacheDir.empty())
+  {
+    DAVCache* newCache = new DAVCache(cacheDir, cardDAVHelper->getAddressbookUrl());
+    if (!newCache->init())
+    {
+      LOG_ERROR() << "Cannot initialize vCards cache, continuing without it"<<std::endl;
+      delete newCache;
+    }
+    else
+    {
+      cache = newCache;
+    }
+  }
 }
 
 enum OpenAB_Storage::Storage::eAddItem CardDAVStorage::addContact(const std::string& vCard,
@@ -212,6 +282,10 @@ enum OpenAB_Storage::Storage::eRemoveItem CardDAVStorage::removeContact( const O
   {
     return eRemoveItemFail;
   }
+  if (cache.getPointer())
+  {
+    cache->remove(id);
+  }
   return eRemoveItemOk;
 }
 
@@ -308,7 +382,8 @@ enum OpenAB_Storage::Storage::eGetItem CardDAVStorage::getContacts (const OpenAB
 
 enum OpenAB_Storage::Storage::eGetRevisions CardDAVStorage::getRevisions(std::map<std::string, std::string>& revisions)
 {
-  if (!cardDAVHelper->queryContactsMetadata())
+  if (!cardDAVHelper->queryContactsMetadata() &&
+      (!rediscoverIfMoved() || !cardDAVHelper->queryContactsMetadata()))
   {
     LOG_FUNC()<<" Cannot query metadata"<<std::endl;
     return eGetRevisionsFail;
@@ -332,7 +407,8 @@ enum OpenAB_Storage::Storage::eGetRevisions CardDAVStorage::getChangedRevisions(
     return eGetRevisionsFail;
   }
 
-  if (!cardDAVHelper->queryChangedContactsMetadata(token, removed))
+  if (!cardDAVHelper->queryChangedContactsMetadata(token, removed) &&
+      (!rediscoverIfMoved() || !cardDAVHelper->queryChangedContactsMetadata(token, removed)))
   {
     LOG_FUNC()<<" Cannot query metadata"<<std::endl;
     return eGetRevisionsFail;
@@ -350,12 +426,14 @@ enum OpenAB_Storage::Storage::eGetRevisions CardDAVStorage::getChangedRevisions(
 
 enum OpenAB_Storage::Storage::eGetSyncToken CardDAVStorage::getLatestSyncToken(std::string& token)
 {
-  if (!cardDAVHelper->queryAddressbookMetadata())
+  if (!cardDAVHelper->queryAddressbookMetadata() &&
+      (!rediscoverIfMoved() || !cardDAVHelper->queryAddressbookMetadata()))
   {
     return eGetSyncTokenFail;
   }
 
   token = cardDAVHelper->getSyncToken();
+  saveDiscoveryInfo();
 
   return eGetSyncTokenOk;
 }
@@ -368,7 +446,8 @@ OpenAB_Storage::StorageItemIterator* CardDAVStorage::newStorageItemIterator()
     LOG_ERROR() << "Error Cannot create the CardDAV IndexElemIterator"<<std::endl;
     return NULL;
   }
-  if (ie->eCursorInitOK != ie->cursorInit(cardDAVHelper))
+  if (ie->eCursorInitOK != ie->cursorInit(cardDAVHelper, cache) &&
+      (!rediscoverIfMoved() || ie->eCursorInitOK != ie->cursorInit(cardDAVHelper, cache)))
   {
     LOG_ERROR() << "Error Cannot Init the CardDAV IndexElemIterator"<<std::endl;
     delete ie;
@@ -439,29 +518,36 @@ CardDAVStorageItemIterator::CardDAVStorageItemIterator() :
     total(0),
     offset(0),
     offsetOfCachedVCards(0),
+    cachedContacts(QUERY_SIZE),
     paused(false),
     cancelled(false),
     threadCreated(false),
     transferStatus(OpenAB_Source::Source::eGetItemRetOk)
 {
-  pthread_mutex_init(&mutex, NULL);
-  pthread_cond_init(&bufferReadyCond, NULL);
 }
 
 CardDAVStorageItemIterator::~CardDAVStorageItemIterator()
 {
   cancelled = true;
-  pthread_mutex_destroy(&mutex);
-  pthread_cond_destroy(&bufferReadyCond);
+  //wake up download thread if it is waiting for free space in queue
+  cachedContacts.close();
   if (threadCreated)
   {
     pthread_join(downloadThread, NULL);
   }
+
+  OpenAB::PIMContactItem* item;
+  while (cachedContacts.pop(item))
+  {
+    delete item;
+  }
 }
 
-enum CardDAVStorageItemIterator::eCursorInit CardDAVStorageItemIterator::cursorInit(CardDAVHelper* helper)
+enum CardDAVStorageItemIterator::eCursorInit CardDAVStorageItemIterator::cursorInit(CardDAVHelper* helper,
+                                                                                    const OpenAB::SmartPtr<DAVCache>& davCache)
 {
   cardDavHelper = helper;
+  cache = davCache;
 
   if (!cardDavHelper->queryContactsMetadata())
   {
@@ -470,10 +556,20 @@ enum CardDAVStorageItemIterator::eCursorInit CardDAVStorageItemIterator::cursorI
   contactsMetadata = cardDavHelper->getContactsMetadata();
   total = contactsMetadata.size();
 
+  if (cache.getPointer())
+  {
+    //drop cached vCards of contacts that were removed from server
+    std::vector<std::string> uris;
+    for (unsigned int i = 0; i < contactsMetadata.size(); ++i)
+    {
+      uris.push_back(contactsMetadata[i].uri);
+    }
+    cache->prune(uris);
+  }
 
   offsetOfCachedVCards = 0;
   offset = 0;
-  cachedContacts.clear();
+  cachedContacts.reset();
 
   cancelled = false;
   transferStatus = OpenAB_Source::Source::eGetItemRetOk;
@@ -497,9 +593,7 @@ void* CardDAVStorageItemIterator::downloadThreadFunc(void* ptr)
 
     if (iterator.cancelled)
     {
-      pthread_mutex_lock(&iterator.mutex);
-      pthread_cond_signal(&iterator.bufferReadyCond);
-      pthread_mutex_unlock(&iterator.mutex);
+      iterator.cachedContacts.close();
       return NULL;
     }
 
@@ -507,18 +601,14 @@ void* CardDAVStorageItemIterator::downloadThreadFunc(void* ptr)
     {
       LOG_DEBUG()<<"DownloadThread download error"<<std::endl;
       iterator.transferStatus = OpenAB_Source::Source::eGetItemRetError;
-      pthread_mutex_lock(&iterator.mutex);
-      pthread_cond_signal(&iterator.bufferReadyCond);
-      pthread_mutex_unlock(&iterator.mutex);
+      iterator.cachedContacts.close();
       return NULL;
     }
     offset += QUERY_SIZE;
   }
 
-  pthread_mutex_lock(&iterator.mutex);
   iterator.transferStatus = OpenAB_Source::Source::eGetItemRetEnd;
-  pthread_cond_signal(&iterator.bufferReadyCond);
-  pthread_mutex_unlock(&iterator.mutex);
+  iterator.cachedContacts.close();
   return NULL;
 }
 
@@ -526,7 +616,7 @@ bool CardDAVStorageItemIterator::downloadVCards(unsigned int offset, unsigned in
 {
   LOG_FUNC();
   std::vector<std::string> ids;
-  std::vector<std::string> vcards;
+  std::vector<unsigned int> missing;
 
   unsigned int len = offset + size;
   if (len > contactsMetadata.size())
@@ -534,66 +624,87 @@ bool CardDAVStorageItemIterator::downloadVCards(unsigned int offset, unsigned in
     len = contactsMetadata.size();
   }
 
+  std::vector<std::string> vcards(len - offset);
+
+  //replay from cache all vCards which etag didn't change, download only remaining ones
   for (unsigned int i = offset; i < len; ++i)
   {
+    if (cache.getPointer() && cache->lookup(contactsMetadata[i].uri, contactsMetadata[i].etag, vcards[i - offset]))
+    {
+      continue;
+    }
     ids.push_back(contactsMetadata[i].uri);
+    missing.push_back(i - offset);
   }
-  if (!cardDavHelper->downloadVCards(ids, vcards))
+  LOG_DEBUG()<<"Found "<<(vcards.size() - ids.size())<<" of "<<vcards.size()<<" vCards in cache"<<std::endl;
+
+  if (!ids.empty())
   {
-    return false;
+    std::vector<std::string> downloaded;
+    std::vector<std::string> etags;
+    if (!cardDavHelper->downloadVCards(ids, downloaded, etags))
+    {
+      return false;
+    }
+
+    //downloaded vCards are placed under uri they were returned for,
+    //cache only those returned with etag that was listed in metadata
+    for (unsigned int i = 0; i < missing.size(); ++i)
+    {
+      unsigned int index = missing[i];
+      vcards[index].swap(downloaded[i]);
+      if (cache.getPointer() && !vcards[index].empty() &&
+          etags[i] == contactsMetadata[offset + index].etag)
+      {
+        cache->store(contactsMetadata[offset + index].uri,
+                     contactsMetadata[offset + index].etag,
+                     vcards[index]);
+      }
+    }
   }
 
-  pthread_mutex_lock(&mutex);
+  //parse without holding any lock, queue blocks when consumer is not keeping up
   for (unsigned int i = 0; i < vcards.size(); ++i)
   {
+    if (vcards[i].empty())
+    {
+      continue;
+    }
     OpenAB::PIMContactItem* newItem = new OpenAB::PIMContactItem();
     newItem->parse(vcards.at(i));
     newItem->setId(contactsMetadata[offset + i].uri);
     newItem->setRevision(contactsMetadata[offset + i].etag);
-    cachedContacts.push_back(newItem);
+    std::string().swap(vcards[i]);
+
+    if (!cachedContacts.push(newItem))
+    {
+      //iterator was destroyed
+      delete newItem;
+      return true;
+    }
   }
-  pthread_cond_signal(&bufferReadyCond);
-  pthread_mutex_unlock(&mutex);
 
   return true;
 }
 
 OpenAB_Storage::StorageItem* CardDAVStorageItemIterator::next()
 {
-  pthread_mutex_lock(&mutex);
-
-  if (cachedContacts.empty())
-  {
-    if (OpenAB_Source::Source::eGetItemRetEnd == transferStatus)
-    {
-      //Cache empty, download finished
-      pthread_mutex_unlock(&mutex);
-      return NULL;
-    }
-    //Cache empty, waiting for new batch
-    pthread_cond_wait(&bufferReadyCond, &mutex);
-  }
-
-  if (OpenAB_Source::Source::eGetItemRetEnd == transferStatus && cachedContacts.empty())
+  if (OpenAB_Source::Source::eGetItemRetError == transferStatus)
   {
-    //Download end
-    pthread_mutex_unlock(&mutex);
+    //Download error
     return NULL;
   }
 
-  if (OpenAB_Source::Source::eGetItemRetError == transferStatus)
+  OpenAB::PIMContactItem* item = NULL;
+  if (!cachedContacts.pop(item))
   {
-    //Download error
-    pthread_mutex_unlock(&mutex);
+    //Download finished (or failed) and all contacts were already returned
     return NULL;
   }
 
-  OpenAB::SmartPtr<OpenAB::PIMContactItem> nextItem = cachedContacts.front();
-  cachedContacts.pop_front();
-  pthread_mutex_unlock(&mutex);
-
-  elem.item = new OpenAB::PIMContactItem(*nextItem.getPointer());
-  elem.id = nextItem->getId();
+  //ownership of item is passed from download thread to elem, no need to copy it
+  elem.id = item->getId();
+  elem.item = item;
   return &elem;
 }
 
@@ -626,6 +737,8 @@ OpenAB_Storage::Storage* createInstance (const OpenAB_Storage::Parameters& param
   OpenAB::SecureString refreshToken;
   std::string ignoreFields = "";
   std::string serverUrl = "";
+  std::string cacheDir = "";
+  bool refreshDiscovery = false;
   CardDAVStorage* src = NULL;
   OpenAB::Variant param;
 
@@ -683,13 +796,25 @@ OpenAB_Storage::Storage* createInstance (const OpenAB_Storage::Parameters& param
     ignoreFields = param.getString();
   }
 
+  param = params.getValue("cache_dir");
+  if (!param.invalid() && OpenAB::Variant::STRING == param.getType())
+  {
+    cacheDir = param.getString();
+  }
+
+  param = params.getValue("refresh_discovery");
+  if (!param.invalid() && OpenAB::Variant::BOOL == param.getType())
+  {
+    refreshDiscovery = param.getBool();
+  }
+
   if (useOAuth2)
   {
-    src = new CardDAVStorage(serverUrl, clientId, clientSecret, refreshToken);
+    src = new CardDAVStorage(serverUrl, clientId, clientSecret, refreshToken, cacheDir, refreshDiscovery);
   }
   else
   {
-    src = new CardDAVStorage(serverUrl, login, password);
+    src = new CardDAVStorage(serverUrl, login, password, cacheDir, refreshDiscovery);
   }
   if (NULL == src)
   {
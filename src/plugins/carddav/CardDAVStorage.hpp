@@ -13,7 +13,9 @@
 #include <plugin/storage/ContactsStorage.hpp>
 #include <list>
 #include "helpers/Http.hpp"
+#include "helpers/BoundedQueue.hpp"
 #include "CardDAVHelper.hpp"
+#include "DAVCache.hpp"
 
 class CardDAVStorageItemIterator;
 
@@ -34,12 +36,20 @@ class CardDAVStorageItemIterator;
  * | String | "client_id"     | Id of client application (registered in Google)     | Yes       |
  * | String | "client_secret" | Secret of client application (registered in Google) | Yes       |
  * | String | "refresh_token" | OAuth2 user refresh token                           | Yes       |
+ * | String | "cache_dir"     | Directory where downloaded vCards will be cached    | No        |
+ * | Bool | "refresh_discovery" | When set to true cached service discovery results are ignored | No |
  *
  *@note "login" and "password" pair or
  *  triple "client_id", "client_secret" and "refresh_token"
  *  are mandatory to provide, depending on authorization method used by CardDAV server.
  *  When using OAuth2 refresh token it has to have required scope (for Google contacts this is https://www.googleapis.com/auth/carddav).
  *
+ *@note When "cache_dir" is provided, vCards are cached on disk together with their etags,
+ *  and only vCards whose etag has changed since last sync are downloaded from server.
+ *  Results of service discovery (principal, address book set and address book urls) are persisted
+ *  in the same directory and reused on next initialization, discovery is repeated only when
+ *  address book was moved/removed (server responded with 404 or 301) or "refresh_discovery" was requested.
+ *
  */
 class CardDAVStorage : public OpenAB_Storage::ContactsStorage
 {
@@ -49,12 +59,16 @@ class CardDAVStorage : public OpenAB_Storage::ContactsStorage
      */
     CardDAVStorage(const std::string& url,
                   const std::string& login,
-                  const OpenAB::SecureString& password);
+                  const OpenAB::SecureString& password,
+                  const std::string& cacheDir = "",
+                  bool refreshDiscovery = false);
 
     CardDAVStorage(const std::string& url,
                   const std::string& clientId,
                   const OpenAB::SecureString& clientSecret,
-                  const OpenAB::SecureString& refreshToken);
+                  const OpenAB::SecureString& refreshToken,
+                  const std::string& cacheDir = "",
+                  bool refreshDiscovery = false);
 
     virtual ~CardDAVStorage();
 
@@ -123,6 +137,32 @@ class CardDAVStorage : public OpenAB_Storage::ContactsStorage
 
     bool downloadVCards(unsigned int offset, unsigned int size);
 
+    /*!
+     * @brief Runs service discovery and persists its results if cache directory was provided.
+     */
+    bool discover();
+
+    /*!
+     * @brief Runs service discovery again if last request failed because address book was moved.
+     * @return true if address book was moved and discovered again successfully.
+     */
+    bool rediscoverIfMoved();
+
+    /*!
+     * @brief Persists results of service discovery and address book CTag/sync token.
+     */
+    void saveDiscoveryInfo();
+
+    /*!
+     * @brief Key under which discovery results are persisted (server url and user).
+     */
+    std::string discoveryKey() const;
+
+    /*!
+     * @brief (Re)creates vCards cache for currently used address book.
+     */
+    void setupCache();
+
     std::string       serverUrl;
 
     std::string       userLogin;
@@ -133,10 +173,13 @@ class CardDAVStorage : public OpenAB_Storage::ContactsStorage
     OpenAB::SecureString refreshToken;
 
     std::string syncToken;
+    std::string cacheDir;
+    bool refreshDiscovery;
 
     OpenAB::HttpSession curlSession;
     OpenAB::HttpAuthorizer* authorizer;
     CardDAVHelper* cardDAVHelper;
+    OpenAB::SmartPtr<DAVCache> cache;
     CardDAVStorageItemIterator* sourceIterator;
 };
 
@@ -157,7 +200,13 @@ class CardDAVStorageItemIterator : public OpenAB_Storage::StorageItemIterator
       eCursorInitOK,
       eCursorInitFail
     };
-    enum eCursorInit cursorInit(CardDAVHelper* cardDavHelper);
+    /*!
+     * @brief Initializes iterator.
+     * @param [in] cardDavHelper helper used to download contacts.
+     * @param [in] cache optional cache of vCards, if provided only vCards with changed etag will be downloaded.
+     */
+    enum eCursorInit cursorInit(CardDAVHelper* cardDavHelper,
+                                const OpenAB::SmartPtr<DAVCache>& cache = OpenAB::SmartPtr<DAVCache>());
 
     OpenAB_Storage::StorageItem* next();
 
@@ -192,17 +241,17 @@ class CardDAVStorageItemIterator : public OpenAB_Storage::StorageItemIterator
     bool downloadVCards(unsigned int offset, unsigned int size);
     OpenAB_Storage::StorageItem    elem;
     CardDAVHelper*              cardDavHelper;
+    OpenAB::SmartPtr<DAVCache>  cache;
     unsigned                    total;
     unsigned int                offset;
     unsigned int                offsetOfCachedVCards;
-    std::list<OpenAB::SmartPtr<OpenAB::PIMContactItem> >  cachedContacts;
+    //contacts parsed by download thread waiting to be returned by next(), ownership is passed through the queue
+    OpenAB::BoundedQueue<OpenAB::PIMContactItem*> cachedContacts;
     std::vector<CardDAVHelper::ContactMetadata> contactsMetadata;
     bool                 paused;
     bool                 cancelled;
     pthread_t            downloadThread;
     bool                 threadCreated;
-    pthread_mutex_t      mutex;
-    pthread_cond_t       bufferReadyCond;
     OpenAB_Source::Source::eGetItemRet transferStatus;
 };
 
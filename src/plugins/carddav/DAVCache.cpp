@@ -0,0 +1,225 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file DAVCache.cpp
+ */
+
+#include "DAVCache.hpp"
+#include <helpers/Log.hpp>
+#include <helpers/FileHelper.hpp>
+#include <fstream>
+#include <sstream>
+#include <set>
+#include <stdio.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define DAV_CACHE_MAGIC "OpenAB-DAVCache 1"
+#define DAV_STATE_MAGIC "OpenAB-DAVState 1"
+
+DAVCache::DAVCache(const std::string& cacheDir,
+                   const std::string& collectionUrl) :
+    collectionDir(cacheDir + "/" + OpenAB::hashFileName(collectionUrl)),
+    initialized(false)
+{
+}
+
+DAVCache::~DAVCache()
+{
+}
+
+bool DAVCache::init()
+{
+  if (!OpenAB::makeDirs(collectionDir))
+  {
+    LOG_ERROR()<<"Cannot create cache directory "<<collectionDir<<std::endl;
+    return false;
+  }
+  initialized = true;
+  return true;
+}
+
+std::string DAVCache::entryPath(const std::string& href) const
+{
+  return collectionDir + "/" + OpenAB::hashFileName(href);
+}
+
+bool DAVCache::lookup(const std::string& href,
+                      const std::string& etag,
+                      std::string& data) const
+{
+  if (!initialized || etag.empty())
+  {
+    return false;
+  }
+
+  std::ifstream file(entryPath(href).c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  std::string magic, cachedHref, cachedEtag;
+  if (!std::getline(file, magic) || magic != DAV_CACHE_MAGIC ||
+      !std::getline(file, cachedHref) || cachedHref != href ||
+      !std::getline(file, cachedEtag) || cachedEtag != etag)
+  {
+    return false;
+  }
+
+  std::ostringstream content;
+  content<<file.rdbuf();
+  data = content.str();
+  return true;
+}
+
+bool DAVCache::store(const std::string& href,
+                     const std::string& etag,
+                     const std::string& data)
+{
+  if (!initialized || etag.empty() ||
+      std::string::npos != href.find('\n') || std::string::npos != etag.find('\n'))
+  {
+    return false;
+  }
+
+  //partially written entries will never be picked up
+  std::string path = entryPath(href);
+  OpenAB::AtomicFileWriter file(path);
+  if (!file.isOpen())
+  {
+    LOG_DEBUG()<<"Cannot open cache entry "<<path<<std::endl;
+    return false;
+  }
+
+  file.stream()<<DAV_CACHE_MAGIC<<"\n"<<href<<"\n"<<etag<<"\n"<<data;
+  if (!file.commit())
+  {
+    LOG_DEBUG()<<"Cannot write cache entry "<<path<<std::endl;
+    return false;
+  }
+  return true;
+}
+
+void DAVCache::remove(const std::string& href)
+{
+  if (!initialized)
+  {
+    return;
+  }
+  unlink(entryPath(href).c_str());
+}
+
+void DAVCache::prune(const std::vector<std::string>& hrefs)
+{
+  if (!initialized)
+  {
+    return;
+  }
+
+  std::set<std::string> valid;
+  std::vector<std::string>::const_iterator it;
+  for (it = hrefs.begin(); it != hrefs.end(); ++it)
+  {
+    valid.insert(OpenAB::hashFileName(*it));
+  }
+
+  DIR* dir = opendir(collectionDir.c_str());
+  if (NULL == dir)
+  {
+    return;
+  }
+
+  struct dirent* entry;
+  while (NULL != (entry = readdir(dir)))
+  {
+    std::string name = entry->d_name;
+    if (name == "." || name == "..")
+    {
+      continue;
+    }
+    if (valid.find(name) == valid.end())
+    {
+      unlink((collectionDir + "/" + name).c_str());
+    }
+  }
+  closedir(dir);
+}
+
+bool DAVCache::loadState(const std::string& cacheDir,
+                         const std::string& key,
+                         State& state)
+{
+  std::string path = cacheDir + "/" + OpenAB::hashFileName(key) + ".state";
+  std::ifstream file(path.c_str(), std::ios_base::in);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  std::string line;
+  if (!std::getline(file, line) || line != DAV_STATE_MAGIC ||
+      !std::getline(file, line) || line != key)
+  {
+    return false;
+  }
+
+  state.clear();
+  while (std::getline(file, line))
+  {
+    std::string::size_type pos = line.find('=');
+    if (pos == std::string::npos)
+    {
+      continue;
+    }
+    state[line.substr(0, pos)] = line.substr(pos + 1);
+  }
+  return true;
+}
+
+bool DAVCache::saveState(const std::string& cacheDir,
+                         const std::string& key,
+                         const State& state)
+{
+  if (std::string::npos != key.find('\n') || !OpenAB::makeDirs(cacheDir))
+  {
+    return false;
+  }
+
+  std::string path = cacheDir + "/" + OpenAB::hashFileName(key) + ".state";
+  OpenAB::AtomicFileWriter file(path, false);
+  if (!file.isOpen())
+  {
+    LOG_DEBUG()<<"Cannot open state file "<<path<<std::endl;
+    return false;
+  }
+
+  file.stream()<<DAV_STATE_MAGIC<<"\n"<<key<<"\n";
+  State::const_iterator it;
+  for (it = state.begin(); it != state.end(); ++it)
+  {
+    if (std::string::npos != (*it).first.find_first_of("=\n") ||
+        std::string::npos != (*it).second.find('\n'))
+    {
+      continue;
+    }
+    file.stream()<<(*it).first<<"="<<(*it).second<<"\n";
+  }
+  if (!file.commit())
+  {
+    LOG_DEBUG()<<"Cannot write state file "<<path<<std::endl;
+    return false;
+  }
+  return true;
+}
+
+void DAVCache::removeState(const std::string& cacheDir,
+                           const std::string& key)
+{
+  std::string path = cacheDir + "/" + OpenAB::hashFileName(key) + ".state";
+  unlink(path.c_str());
+}
@@ -0,0 +1,144 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file DAVCache.hpp
+ */
+
+#ifndef DAVCACHE_HPP_
+#define DAVCACHE_HPP_
+
+#include <string>
+#include <vector>
+#include <map>
+
+/*!
+ * @brief On-disk cache of DAV resources content (vCards/iCalendars).
+ *
+ * Entries are addressed by (collection URL, href, etag), each collection gets its own
+ * subdirectory of cache directory and each resource is stored in separate file
+ * containing its href, etag and raw data as returned by server.
+ * Entry is considered valid only if its etag matches the one reported by server,
+ * this way DAV iterators can download only resources that were modified since last sync
+ * and replay all other ones from cache.
+ */
+class DAVCache
+{
+  public:
+    /*!
+     *  @brief Constructor.
+     *  @param [in] cacheDir root directory of cache.
+     *  @param [in] collectionUrl url of address book/calendar which resources will be cached.
+     */
+    DAVCache(const std::string& cacheDir,
+             const std::string& collectionUrl);
+
+    /*!
+     *  @brief Destructor, virtual by default.
+     */
+    virtual ~DAVCache();
+
+    /*!
+     * @brief Creates cache directory of collection if it does not exist yet.
+     * @return true if cache directory is available, false otherwise.
+     */
+    bool init();
+
+    /*!
+     * @brief Looks up resource in cache.
+     * @param [in] href href of resource.
+     * @param [in] etag current etag of resource as reported by server.
+     * @param [out] data cached content of resource.
+     * @return true if resource was found in cache and its etag matches, false otherwise.
+     */
+    bool lookup(const std::string& href,
+                const std::string& etag,
+                std::string& data) const;
+
+    /*!
+     * @brief Stores resource in cache, replacing any previously cached version.
+     * @param [in] href href of resource.
+     * @param [in] etag etag of resource.
+     * @param [in] data content of resource.
+     * @return true if resource was stored successfully, false otherwise.
+     */
+    bool store(const std::string& href,
+               const std::string& etag,
+               const std::string& data);
+
+    /*!
+     * @brief Removes resource from cache.
+     * @param [in] href href of resource.
+     */
+    void remove(const std::string& href);
+
+    /*!
+     * @brief Removes from cache all resources which are not on the provided list.
+     * @param [in] hrefs list of hrefs of all resources that are present in collection.
+     */
+    void prune(const std::vector<std::string>& hrefs);
+
+    /*!
+     * @brief Type used to persist state of DAV plugins (e.g. results of service discovery) as key/value pairs.
+     */
+    typedef std::map<std::string, std::string> State;
+
+    /*!
+     * @brief Loads persisted state.
+     * @param [in] cacheDir root directory of cache.
+     * @param [in] key key identifying state (e.g. server url and user name).
+     * @param [out] state loaded state.
+     * @return true if state was found and loaded successfully, false otherwise.
+     */
+    static bool loadState(const std::string& cacheDir,
+                          const std::string& key,
+                          State& state);
+
+    /*!
+     * @brief Persists state, replacing any previously stored state with the same key.
+     * @param [in] cacheDir root directory of cache.
+     * @param [in] key key identifying state (e.g. server url and user name).
+     * @param [in] state state to be stored.
+     * @return true if state was stored successfully, false otherwise.
+     */
+    static bool saveState(const std::string& cacheDir,
+                          const std::string& key,
+                          const State& state);
+
+    /*!
+     * @brief Removes persisted state.
+     * @param [in] cacheDir root directory of cache.
+     * @param [in] key key identifying state.
+     */
+    static void removeState(const std::string& cacheDir,
+                            const std::string& key);
+
+    /*!
+     * @brief Returns directory where resources of collection are stored.
+     */
+    std::string getCollectionDir() const
+    {
+      return collectionDir;
+    }
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    DAVCache(DAVCache const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    DAVCache& operator=(DAVCache const &other);
+
+
+    std::string entryPath(const std::string& href) const;
+
+    std::string collectionDir;
+    bool        initialized;
+};
+
+#endif // DAVCACHE_HPP_
@@ -13,17 +13,43 @@
 #include <helpers/StringHelper.hpp>
 #include <string.h>
 #include <sstream>
+#include <algorithm>
 
-std::set<std::string> EDSCalendarStorage::currentEventTimeZones;
+/*Default number of objects queried at once by getEvents and getTasks*/
+#define DEFAULT_GET_BATCH_SIZE 100
+
+namespace
+{
+  /*
+   * Quotes string so it can be used as literal in EDS s-expression query.
+   */
+  std::string quoteSexpString(const std::string& str)
+  {
+    std::string quoted = "\"";
+    for (std::string::size_type i = 0; i < str.size(); ++i)
+    {
+      if ('"' == str[i] || '\\' == str[i])
+      {
+        quoted += '\\';
+      }
+      quoted += str[i];
+    }
+    quoted += "\"";
+    return quoted;
+  }
+}
 
 EDSCalendarStorage::EDSCalendarStorage(const std::string & db,
-                                       OpenAB::PIMItemType type)
+                                       OpenAB::PIMItemType type,
+                                       unsigned int batchSize)
     : OpenAB_Storage::CalendarStorage(type),
       database(db),
+      getBatchSize(batchSize ? batchSize : 1),
       registry(NULL),
       source(NULL),
       client(NULL),
-      sourceIterator(NULL)
+      sourceIterator(NULL),
+      changeTracker((OpenAB::eEvent == type) ? "events" : "tasks", db)
 {
   LOG_FUNC();
 }
@@ -166,25 +192,12 @@ int EDSCalendarStorage::getTotalCount() const
   return 0;
 }
 
-void EDSCalendarStorage::findTimeZonesCb(icalparameter* param, void* data)
-{
-  if (NULL == data)
-  {
-    return;
-  }
-
-  //get time zone id and insert it in set of timezones found in current component
-  const char* value = icalparameter_get_tzid(param);
-  currentEventTimeZones.insert(value);
-}
-
 GSList* EDSCalendarStorage::toICalComponentsList(const std::vector<std::string> & iCals,
                                                  const OpenAB::PIMItem::IDs& ids,
-                                                 std::vector<icaltimezone*>& timezones)
+                                                 std::set<std::string>& tzids)
 {
   GSList * events = NULL;
 
-  currentEventTimeZones.clear();
   for(unsigned int i = 0; i < iCals.size(); ++i)
   {
     std::stringstream ss(iCals[i]);
@@ -207,7 +220,7 @@ GSList* EDSCalendarStorage::toICalComponentsList(const std::vector<std::string>
         return NULL;
       }
 
-      icalcomponent_foreach_tzid(newEvent, EDSCalendarStorage::findTimeZonesCb, newEvent);
+      EDSTimeZoneCache::findTimeZones(newEvent, tzids);
       icalcomponent_strip_errors(newEvent);
       if (ids.size() > i)
         icalcomponent_set_uid(newEvent, ids[i].c_str());
@@ -216,17 +229,41 @@ GSList* EDSCalendarStorage::toICalComponentsList(const std::vector<std::string>
     }
   }
 
-  std::set<std::string>::iterator it;
-  for(it = currentEventTimeZones.begin(); it != currentEventTimeZones.end(); ++it)
+  return events;
+}
+
+void EDSCalendarStorage::addTimeZones(const std::set<std::string>& tzids)
+{
+  //the same builtin timezone can be referenced by different TZIDs
+  std::set<icaltimezone*> added;
+
+  std::set<std::string>::const_iterator it;
+  for (it = tzids.begin(); it != tzids.end(); ++it)
   {
-    icaltimezone* tz = icaltimezone_get_builtin_timezone((*it).c_str());
-    if (tz)
+    if (addedTimeZones.find((*it)) != addedTimeZones.end())
     {
-      timezones.push_back(tz);
+      continue;
     }
-  }
 
-  return events;
+    icaltimezone* tz = timeZones.getTimeZone((*it));
+    if (NULL == tz)
+    {
+      continue;
+    }
+
+    if (added.find(tz) == added.end())
+    {
+      GError *gerror = NULL;
+      if (!e_cal_client_add_timezone_sync (client, tz, NULL, &gerror))
+      {
+        LOG_DEBUG() << "Error e_cal_client_add_timezone_sync results: " << GERROR_MESSAGE(gerror)<<std::endl;
+        GERROR_FREE(gerror);
+        continue;
+      }
+      added.insert(tz);
+    }
+    addedTimeZones.insert((*it));
+  }
 }
 
 enum OpenAB_Storage::Storage::eAddItem EDSCalendarStorage::addObject(const std::string & iCal,
@@ -264,8 +301,8 @@ enum OpenAB_Storage::Storage::eAddItem EDSCalendarStorage::addObjects(const std:
   GSList * new_uids;
 
   OpenAB::PIMItem::IDs emptyIds;
-  std::vector<icaltimezone*> timezones;
-  events = toICalComponentsList(iCals, emptyIds, timezones);
+  std::set<std::string> tzids;
+  events = toICalComponentsList(iCals, emptyIds, tzids);
 
   if (NULL == events)
   {
@@ -273,12 +310,7 @@ enum OpenAB_Storage::Storage::eAddItem EDSCalendarStorage::addObjects(const std:
     return eAddItemFail;
   }
 
-  std::vector<icaltimezone*>::iterator it;
-  for (it = timezones.begin(); it != timezones.end(); ++it)
-  {
-    e_cal_client_add_timezone_sync (client, (*it), NULL, &gerror);
-    GERROR_FREE(gerror);
-  }
+  addTimeZones(tzids);
 
   if (!e_cal_client_create_objects_sync (client, events, &new_uids, NULL, &gerror))
   {
@@ -346,8 +378,8 @@ enum OpenAB_Storage::Storage::eModifyItem EDSCalendarStorage::modifyObjects(cons
   GError *gerror = NULL;
   GSList * events = NULL;
 
-  std::vector<icaltimezone*> timezones;
-  events = toICalComponentsList(iCals, ids, timezones);
+  std::set<std::string> tzids;
+  events = toICalComponentsList(iCals, ids, tzids);
 
   if (NULL == events)
   {
@@ -355,12 +387,7 @@ enum OpenAB_Storage::Storage::eModifyItem EDSCalendarStorage::modifyObjects(cons
     return eModifyItemFail;
   }
 
-  std::vector<icaltimezone*>::iterator it;
-  for (it = timezones.begin(); it != timezones.end(); ++it)
-  {
-    e_cal_client_add_timezone_sync (client, (*it), NULL, &gerror);
-    GERROR_FREE(gerror);
-  }
+  addTimeZones(tzids);
 
   if (!e_cal_client_modify_objects_sync (client, events, E_CAL_OBJ_MOD_THIS, NULL, &gerror))
   {
@@ -442,26 +469,118 @@ enum OpenAB_Storage::Storage::eGetItem EDSCalendarStorage::getEvent(const OpenAB
     current = current->next;
   }
 
-  item = (OpenAB::PIMCalendarEventItem*)EDSCalendarStorageCommon::processObject(iCalComponents);
+  item = (OpenAB::PIMCalendarEventItem*)EDSCalendarStorageCommon::processObject(iCalComponents, timeZones);
 
   e_cal_client_free_ecalcomp_slist(events);
   return eGetItemOk;
 }
 
-enum OpenAB_Storage::Storage::eGetItem EDSCalendarStorage::getEvents(const OpenAB::PIMItem::IDs & ids,
-                                                                  std::vector<OpenAB::SmartPtr<OpenAB::PIMCalendarEventItem> > & items)
+bool EDSCalendarStorage::getObjects(const OpenAB::PIMItem::IDs & ids,
+                                    std::vector<OpenAB::PIMCalendarItem*> & items)
 {
-  for (unsigned int i = 0; i < ids.size(); ++i)
+  bool allFound = true;
+
+  //objects are queried in batches using single (or (uid? "id") ...) query for each of them
+  for (unsigned int batchStart = 0; batchStart < ids.size(); batchStart += getBatchSize)
   {
-    OpenAB::SmartPtr<OpenAB::PIMCalendarEventItem> item;
-    if (eGetItemOk != getEvent(ids[i], item))
+    unsigned int batchEnd = std::min<unsigned int>(batchStart + getBatchSize, ids.size());
+
+    std::string sexp = "(or";
+    for (unsigned int i = batchStart; i < batchEnd; ++i)
+    {
+      sexp += " (uid? " + quoteSexpString(ids[i]) + ")";
+    }
+    sexp += ")";
+
+    GError* gerror = NULL;
+    GSList* objects = NULL;
+    if (!e_cal_client_get_object_list_sync(client, sexp.c_str(), &objects, NULL, &gerror))
+    {
+      LOG_ERROR() << "Error e_cal_client_get_object_list_sync result: " << GERROR_MESSAGE(gerror) << std::endl;
+      GERROR_FREE(gerror);
+      return false;
+    }
+
+    //group all instances of recurring objects, ownership of components is taken from the list
+    std::map<std::string, std::vector<icalcomponent*> > found;
+    for (GSList* l = objects; l; l = g_slist_next(l))
     {
-      return eGetItemFail;
+      icalcomponent* component = static_cast<icalcomponent*>(l->data);
+      const char* uid = icalcomponent_get_uid(component);
+      if (uid)
+      {
+        found[uid].push_back(component);
+      }
+      else
+      {
+        icalcomponent_free(component);
+      }
+    }
+    g_slist_free(objects);
+
+    //id can be requested more than once, count requests so that components are consumed only by the last one
+    std::map<std::string, unsigned int> requests;
+    for (unsigned int i = batchStart; i < batchEnd; ++i)
+    {
+      ++requests[ids[i]];
+    }
+
+    //return objects in requested order
+    for (unsigned int i = batchStart; i < batchEnd; ++i)
+    {
+      std::map<std::string, std::vector<icalcomponent*> >::iterator it = found.find(ids[i]);
+      if (it == found.end())
+      {
+        LOG_ERROR() << "Object not found: " << ids[i] << std::endl;
+        allFound = false;
+        continue;
+      }
+
+      if (0 != --requests[ids[i]])
+      {
+        //processObject takes ownership of components, it gets copies unless this is the last request of id
+        std::vector<icalcomponent*> copies;
+        for (unsigned int j = 0; j < (*it).second.size(); ++j)
+        {
+          copies.push_back(icalcomponent_new_clone((*it).second[j]));
+        }
+        items.push_back(EDSCalendarStorageCommon::processObject(copies, timeZones));
+        continue;
+      }
+      items.push_back(EDSCalendarStorageCommon::processObject((*it).second, timeZones));
+      found.erase(it);
+    }
+
+    //free components not consumed by processObject (objects returned by query but not requested)
+    std::map<std::string, std::vector<icalcomponent*> >::iterator it;
+    for (it = found.begin(); it != found.end(); ++it)
+    {
+      for (unsigned int j = 0; j < (*it).second.size(); ++j)
+      {
+        icalcomponent_free((*it).second[j]);
+      }
     }
-    items.push_back(item);
   }
 
-  return eGetItemOk;
+  return allFound;
+}
+
+enum OpenAB_Storage::Storage::eGetItem EDSCalendarStorage::getEvents(const OpenAB::PIMItem::IDs & ids,
+                                                                  std::vector<OpenAB::SmartPtr<OpenAB::PIMCalendarEventItem> > & items)
+{
+  if (getItemType() != OpenAB::eEvent)
+  {
+    return eGetItemFail;
+  }
+
+  std::vector<OpenAB::PIMCalendarItem*> objects;
+  bool allFound = getObjects(ids, objects);
+  for (unsigned int i = 0; i < objects.size(); ++i)
+  {
+    items.push_back((OpenAB::PIMCalendarEventItem*)objects[i]);
+  }
+
+  return allFound ? eGetItemOk : eGetItemFail;
 }
 
 enum OpenAB_Storage::Storage::eGetItem EDSCalendarStorage::getTask(const OpenAB::PIMItem::ID & id,
@@ -484,7 +603,7 @@ enum OpenAB_Storage::Storage::eGetItem EDSCalendarStorage::getTask(const OpenAB:
 
   events.push_back(event);
 
-  item = (OpenAB::PIMCalendarTaskItem*)EDSCalendarStorageCommon::processObject(events);
+  item = (OpenAB::PIMCalendarTaskItem*)EDSCalendarStorageCommon::processObject(events, timeZones);
 
   return eGetItemOk;
 }
@@ -492,17 +611,19 @@ enum OpenAB_Storage::Storage::eGetItem EDSCalendarStorage::getTask(const OpenAB:
 enum OpenAB_Storage::Storage::eGetItem EDSCalendarStorage::getTasks(const OpenAB::PIMItem::IDs & ids,
                                                                   std::vector<OpenAB::SmartPtr<OpenAB::PIMCalendarTaskItem> > & items)
 {
-  for (unsigned int i = 0; i < ids.size(); ++i)
+  if (getItemType() != OpenAB::eTask)
   {
-    OpenAB::SmartPtr<OpenAB::PIMCalendarTaskItem> item;
-    if (eGetItemOk != getTask(ids[i], item))
-    {
-      return eGetItemFail;
-    }
-    items.push_back(item);
+    return eGetItemFail;
   }
 
-  return eGetItemOk;
+  std::vector<OpenAB::PIMCalendarItem*> objects;
+  bool allFound = getObjects(ids, objects);
+  for (unsigned int i = 0; i < objects.size(); ++i)
+  {
+    items.push_back((OpenAB::PIMCalendarTaskItem*)objects[i]);
+  }
+
+  return allFound ? eGetItemOk : eGetItemFail;
 }
 
 OpenAB::PIMItem::Revision EDSCalendarStorage::getRevision(const OpenAB::PIMItem::ID& id)
@@ -520,15 +641,13 @@ OpenAB::PIMItem::Revision EDSCalendarStorage::getRevision(const OpenAB::PIMItem:
   }
 
   GSList* current = events;
-  //in case of recurring event, create revision as concatnation of single revision of all event instances,
-  //so even if only on instance will be modified then we will be able to detect that whole event needs to be updated.
   while(current)
   {
     ECalComponent* component = (ECalComponent*)current->data;
-    icalcomponent* iCalComponent =  e_cal_component_get_icalcomponent(component);
-    revision += icaltime_as_ical_string(icalcomponent_get_dtstamp(iCalComponent));
+    iCalComponents.push_back(e_cal_component_get_icalcomponent(component));
     current = current->next;
   }
+  revision = EDSCalendarStorageCommon::getRevision(iCalComponents);
 
   e_cal_client_free_ecalcomp_slist(events);
 
@@ -549,74 +668,63 @@ OpenAB::PIMItem::Revisions EDSCalendarStorage::getRevisions(const OpenAB::PIMIte
 
 enum OpenAB_Storage::Storage::eGetRevisions EDSCalendarStorage::getRevisions(std::map<std::string, std::string>& revisions)
 {
-  /*
-   * In compare to getRevisions(const OpenAB::PIMItem::IDs& ids)
-   * this has to return ids and revisions of all items in db, as
-   * EDS does not implement query that returns all objects from db
-   * scan db file and get ids list of all object
-   * then use getRevisions(const OpenAB::PIMItem::IDs& ids) to query revisions.
-   */
-  std::ifstream db(databaseFileName.c_str(), std::ios_base::in);
-  if (!db.is_open())
+  GError* gerror = NULL;
+  GSList* objects = NULL;
+
+  //query all objects at once, client returns only objects of its type (events or tasks)
+  if (!e_cal_client_get_object_list_sync(client, "#t", &objects, NULL, &gerror))
   {
+    LOG_ERROR() << "Error e_cal_client_get_object_list_sync result: " << GERROR_MESSAGE(gerror) << std::endl;
+    GERROR_FREE(gerror);
     return eGetRevisionsFail;
   }
 
-  std::string line;
-  bool inEvent = false;
-  std::string uid;
-  std::vector<std::string> uids;
-
-  while (std::getline(db, line))
+  //group all instances of recurring objects, so revision is computed the same way as by getRevision
+  std::map<std::string, std::vector<icalcomponent*> > instances;
+  for (GSList* l = objects; l; l = g_slist_next(l))
   {
-    OpenAB::trimWhitespaces(line);
-
-    if (line == "BEGIN:VEVENT" || line =="BEGIN:VTODO")
+    icalcomponent* component = static_cast<icalcomponent*>(l->data);
+    const char* uid = icalcomponent_get_uid(component);
+    if (uid)
     {
-      inEvent = true;
-      uid = "";
-    }
-    if (inEvent)
-    {
-      if (OpenAB::beginsWith(line, "UID:"))
-      {
-        uid = line.substr(strlen("UID:"));
-        OpenAB::trimWhitespaces(uid);
-      }
-
-      if (line == "END:VEVENT" || line == "END:VTODO")
-      {
-        LOG_DEBUG()<<"Found event end"<<std::endl;
-        if (!uid.empty())
-        {
-          uids.push_back(uid);
-        }
-        inEvent = false;
-      }
+      instances[uid].push_back(component);
     }
   }
-  OpenAB::PIMItem::Revisions revs = getRevisions(uids);
-  for (unsigned int i = 0; i < uids.size(); ++i)
+
+  std::map<std::string, std::vector<icalcomponent*> >::const_iterator it;
+  for (it = instances.begin(); it != instances.end(); ++it)
   {
-    revisions[uids[i]] = revs[i];
+    revisions.insert(revisions.end(), std::make_pair((*it).first, EDSCalendarStorageCommon::getRevision((*it).second)));
   }
 
-  db.close();
+  e_cal_client_free_icalcomp_slist(objects);
 
   return eGetRevisionsOk;
 }
 
-enum OpenAB_Storage::Storage::eGetRevisions EDSCalendarStorage::getChangedRevisions(const std::string&,
-                                                                    std::map<std::string, std::string>& ,
-                                                                    std::vector<OpenAB::PIMItem::ID>&)
+enum OpenAB_Storage::Storage::eGetRevisions EDSCalendarStorage::getChangedRevisions(const std::string& token,
+                                                                                    std::map<std::string, std::string>& revisions,
+                                                                                    std::vector<OpenAB::PIMItem::ID>& removed)
 {
-  //Implement support for delta notification extension, which can provide such information
-  return eGetRevisionsFail;
+  if (!changeTracker.getChangedRevisions(E_CLIENT(client), *this, token, revisions, removed))
+  {
+    return eGetRevisionsFail;
+  }
+  return eGetRevisionsOk;
 }
 
-enum OpenAB_Storage::Storage::eGetSyncToken EDSCalendarStorage::getLatestSyncToken(std::string&)
+enum OpenAB_Storage::Storage::eGetSyncToken EDSCalendarStorage::getLatestSyncToken(std::string& token)
 {
-  return eGetSyncTokenFail;
+  if (!changeTracker.getLatestSyncToken(E_CLIENT(client), *this, token))
+  {
+    return eGetSyncTokenFail;
+  }
+  return eGetSyncTokenOk;
+}
+
+bool EDSCalendarStorage::readRevisions(EDSChangeTracker::Revisions& revisions)
+{
+  return eGetRevisionsOk == getRevisions(revisions);
 }
 
 OpenAB_Storage::StorageItemIterator* EDSCalendarStorage::newStorageItemIterator()
@@ -672,7 +780,14 @@ namespace EDSCalendarFactory {
         return NULL;
     }
 
-    EDSCalendarStorage * cal = new EDSCalendarStorage(db, type);
+    unsigned int batchSize = DEFAULT_GET_BATCH_SIZE;
+    param = params.getValue("get_batch_size");
+    if (!param.invalid() && param.getType() == OpenAB::Variant::INTEGER && param.getInt() > 0)
+    {
+      batchSize = param.getInt();
+    }
+
+    EDSCalendarStorage * cal = new EDSCalendarStorage(db, type, batchSize);
     if (NULL == cal)
     {
       LOG_ERROR() << "Cannot Initialize EDSCalendarStorage"<<std::endl;
@@ -9,6 +9,8 @@
 
 #include <plugin/storage/CalendarStorage.hpp>
 #include "EDSCalendarStorageItemIterator.hpp"
+#include "EDSChangeTracker.hpp"
+#include "EDSTimeZoneCache.hpp"
 #include <string>
 #include <fstream>
 #include <set>
@@ -30,19 +32,23 @@
  * |:-----|:     ----|:----------------------------|:          |
  * |String | "db"      | EDS source name             | Yes       |
  * |Integer | "item_type"| Type of items - OpenAB::eEvent or OpenAB::eTask (set to integer equal to OpenAB::PIMItemType enum values) | Yes |
+ * |Integer | "get_batch_size"| Maximal number of objects queried at once when multiple objects are requested, 100 by default | No |
  *
  */
 
-class EDSCalendarStorage : public OpenAB_Storage::CalendarStorage
+class EDSCalendarStorage : public OpenAB_Storage::CalendarStorage,
+                           private EDSChangeTracker::RevisionsReader
 {
   public:
     /*!
      * @brief Constructor
      * @param [in] sourceName name of EDS's source to use
      * @param [in] type type of items to use (either OpenAB::eEvent or OpenAB::eTask)
+     * @param [in] batchSize maximal number of objects queried at once by getEvents and getTasks
      */
     EDSCalendarStorage(const std::string& sourceName,
-                       OpenAB::PIMItemType type);
+                       OpenAB::PIMItemType type,
+                       unsigned int batchSize = 100);
 
     ~EDSCalendarStorage();
 
@@ -115,28 +121,51 @@ class EDSCalendarStorage : public OpenAB_Storage::CalendarStorage
      */
     OpenAB::PIMItem::Revisions getRevisions(const OpenAB::PIMItem::IDs& ids);
 
+    /*!
+     * @brief Gets objects with given ids, querying them in batches.
+     * @param [in] ids ids of objects
+     * @param [out] items objects that were found, in order of ids, ownership is passed to caller.
+     * @return true if all objects were found, false otherwise.
+     */
+    bool getObjects(const OpenAB::PIMItem::IDs & ids,
+                    std::vector<OpenAB::PIMCalendarItem*> & items);
+
     /*!
      * @brief Converts provided list of iCals object into list of icalcomponent objects.
      * For recurring events it creates multiple icalcomponents for each instance
      *  (each of them has the same UID but different RECURRENCE-ID)
      * @param [in] iCals list of iCalendar strings
      * @param [in] ids optional list of ids, in case where UID in provided iCals will not match UID from ids it will be substituted.
+     * @param [out] tzids TZIDs of all timezones referenced by objects.
      * @return list of icalcomponents objects
      */
     GSList* toICalComponentsList(const std::vector<std::string> & iCals,
                                  const OpenAB::PIMItem::IDs& ids,
-                                 std::vector<icaltimezone*>& timezones);
+                                 std::set<std::string>& tzids);
+
+    /*!
+     * @brief Adds timezones to calendar, skipping ones that were already added by this storage.
+     * Each distinct timezone is added only once, even if it is referenced by many objects.
+     * @param [in] tzids TZIDs of timezones referenced by objects.
+     */
+    void addTimeZones(const std::set<std::string>& tzids);
 
     std::string       database;
+    unsigned int      getBatchSize;
     ESourceRegistry * registry;
     ESource         * source;
     ECalClient      * client;
     EDSCalendarStorageItemIterator* sourceIterator;
     std::string       databaseFileName;
     std::ifstream     databaseFile;
+    EDSChangeTracker  changeTracker;
+    EDSTimeZoneCache  timeZones;
+    /*TZIDs of timezones already added to calendar*/
+    std::set<std::string> addedTimeZones;
 
-    static void findTimeZonesCb(icalparameter* param, void* data);
-
-    static std::set<std::string>       currentEventTimeZones;
+    /*!
+     * @brief Provides current revisions of all items to change tracker.
+     */
+    bool readRevisions(EDSChangeTracker::Revisions& revisions);
 };
 #endif /* OpenAB_PLUGIN_EDS_CALENDAR_HPP_ */
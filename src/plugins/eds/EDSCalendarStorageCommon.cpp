@@ -9,8 +9,7 @@
 
 #include <helpers/StringHelper.hpp>
 #include "EDSCalendarStorageCommon.hpp"
-
-std::set<std::string> EDSCalendarStorageCommon::currentEventTimeZones;
+#include <algorithm>
 
 EDSCalendarStorageCommon::EDSCalendarStorageCommon()
 {
@@ -60,19 +59,33 @@ std::string EDSCalendarStorageCommon::cutVObject(std::istream& stream)
   return event;
 }
 
-void EDSCalendarStorageCommon::findTimeZonesCb(icalparameter* param, void* data)
+std::string EDSCalendarStorageCommon::getRevision(const std::vector<icalcomponent*>& instances)
 {
-  if (NULL == data)
+  //master object has no RECURRENCE-ID, so it will be first
+  std::vector<std::pair<std::string, std::string> > stamps;
+  std::vector<icalcomponent*>::const_iterator it;
+  for (it = instances.begin(); it != instances.end(); ++it)
   {
-    return;
+    struct icaltimetype recurrenceId = icalcomponent_get_recurrenceid((*it));
+    std::string rid;
+    if (!icaltime_is_null_time(recurrenceId))
+    {
+      rid = icaltime_as_ical_string(recurrenceId);
+    }
+    stamps.push_back(std::make_pair(rid, std::string(icaltime_as_ical_string(icalcomponent_get_dtstamp((*it))))));
   }
+  std::sort(stamps.begin(), stamps.end());
 
-  //get time zone id and insert it in set of timezones found in current component
-  const char* value = icalparameter_get_tzid(param);
-  currentEventTimeZones.insert(value);
+  std::string revision;
+  for (unsigned int i = 0; i < stamps.size(); ++i)
+  {
+    revision += stamps[i].second;
+  }
+  return revision;
 }
 
-OpenAB::PIMCalendarItem* EDSCalendarStorageCommon::processObject(const std::vector<std::string>& iCals)
+OpenAB::PIMCalendarItem* EDSCalendarStorageCommon::processObject(const std::vector<std::string>& iCals,
+                                                                 EDSTimeZoneCache& timeZones)
 {
   //Create icalcomponent from provided iCalendar strings
   std::vector<icalcomponent*> iCalComponents;
@@ -96,20 +109,21 @@ OpenAB::PIMCalendarItem* EDSCalendarStorageCommon::processObject(const std::vect
   }
 
   //process icalcomponent object
-  return processObject(iCalComponents);
+  return processObject(iCalComponents, timeZones);
 }
 
-OpenAB::PIMCalendarItem* EDSCalendarStorageCommon::processObject(const std::vector<icalcomponent*>& newEvents)
+OpenAB::PIMCalendarItem* EDSCalendarStorageCommon::processObject(const std::vector<icalcomponent*>& newEvents,
+                                                                 EDSTimeZoneCache& timeZones)
 {
   LOG_FUNC();
   OpenAB::PIMItemType type = OpenAB::eEvent;
-  currentEventTimeZones.clear();
+  std::set<std::string> tzids;
 
   icalcomponent* calendarComponent = icalcomponent_new_vcalendar();
   icalcomponent_add_property(calendarComponent, icalproperty_new_version("2.0"));
 
   std::string uid;
-  std::string revision;
+  std::string revision = getRevision(newEvents);
 
   std::vector<icalcomponent*>::const_iterator it;
   for (it = newEvents.begin(); it != newEvents.end(); ++it)
@@ -122,10 +136,9 @@ OpenAB::PIMCalendarItem* EDSCalendarStorageCommon::processObject(const std::vect
     {
       uid = icalcomponent_get_uid((*it));
     }
-    revision += icaltime_as_ical_string(icalcomponent_get_dtstamp((*it)));
 
     //find all references to timezones
-    icalcomponent_foreach_tzid((*it), EDSCalendarStorageCommon::findTimeZonesCb, (*it));
+    EDSTimeZoneCache::findTimeZones((*it), tzids);
 
     icalcomponent_add_component(calendarComponent, (*it));
 
@@ -140,25 +153,29 @@ OpenAB::PIMCalendarItem* EDSCalendarStorageCommon::processObject(const std::vect
     }
   }
 
-  //create VTIMEZONE component with definitions of all
+  //add VTIMEZONE components with definitions of all
   //timezones that are referenced in processed component
+  std::vector<icalcomponent*> vtimezones;
   std::set<std::string>::iterator it2;
-  for(it2 = currentEventTimeZones.begin(); it2 != currentEventTimeZones.end(); ++it2)
+  for(it2 = tzids.begin(); it2 != tzids.end(); ++it2)
   {
-    icaltimezone* tz = icaltimezone_get_builtin_timezone((*it2).c_str());
-
-    if (tz)
+    icalcomponent* vtimezone = timeZones.getComponent((*it2));
+    if (vtimezone)
     {
-      icalcomponent* vtimezone = icaltimezone_get_component(tz);
-      icalproperty* tzprop = icalcomponent_get_first_property(vtimezone, ICAL_TZID_PROPERTY);
-      icalproperty_set_value_from_string(tzprop, (*it2).c_str(), "NO");
       icalcomponent_add_component(calendarComponent, vtimezone);
-      icaltimezone_free_builtin_timezones();
+      vtimezones.push_back(vtimezone);
     }
   }
 
   //convert icalcomponent back to iCalendar string
   std::string iCal = icalcomponent_as_ical_string(calendarComponent);
+
+  //VTIMEZONE components are owned by cache, detach them before calendar is freed
+  std::vector<icalcomponent*>::iterator it3;
+  for (it3 = vtimezones.begin(); it3 != vtimezones.end(); ++it3)
+  {
+    icalcomponent_remove_component(calendarComponent, (*it3));
+  }
   OpenAB::PIMCalendarItem* newItem;
 
   //create new PIMCalendarItem based on new iCalendar string
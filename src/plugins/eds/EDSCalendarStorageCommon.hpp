@@ -13,6 +13,7 @@
 #include <PIMItem/Calendar/PIMCalendarItem.hpp>
 #include <string>
 #include <libical/ical.h>
+#include "EDSTimeZoneCache.hpp"
 /*!
  * @brief Documentation for class EDSCalendarStorageCommon
  */
@@ -31,18 +32,31 @@ class EDSCalendarStorageCommon
      * Adds VTIMEZONE component and creates new VCALENDAR object
      * In case of recurring events all instances are merged to one VCALENDAR object
      * @param [in] newEvents icalcomponent with instances of given event.
+     * @param [in] timeZones cache of timezones used to create VTIMEZONE components.
      * @return OpenAB::PIMCalendarItem or NULL if components couldn't be processed.
      */
-    static OpenAB::PIMCalendarItem* processObject(const std::vector<icalcomponent*>& newEvents);
+    static OpenAB::PIMCalendarItem* processObject(const std::vector<icalcomponent*>& newEvents,
+                                                  EDSTimeZoneCache& timeZones);
 
     /*!
      * @brief Processes VEVENT or VTODO components obtained from EDS
      * Adds VTIMEZONE component and creates new VCALENDAR object
      * In case of recurring events all instances are merged to one VCALENDAR object
      * @param [in] iCals iCalendar objects with instances of given event
+     * @param [in] timeZones cache of timezones used to create VTIMEZONE components.
      * @return OpenAB::PIMCalendarItem or NULL if component couldn't be processed.
      */
-    static OpenAB::PIMCalendarItem* processObject(const std::vector<std::string>& iCals);
+    static OpenAB::PIMCalendarItem* processObject(const std::vector<std::string>& iCals,
+                                                  EDSTimeZoneCache& timeZones);
+
+    /*!
+     * @brief Computes revision of object from all its instances.
+     * In case of recurring objects revision is concatenation of DTSTAMPs of all instances ordered by their RECURRENCE-IDs,
+     * so modification of any instance changes revision of whole object, regardless of order in which EDS returned instances.
+     * @param [in] instances components with all instances of given object.
+     * @return revision of object.
+     */
+    static std::string getRevision(const std::vector<icalcomponent*>& instances);
 
   private:
     /*!
@@ -64,14 +78,6 @@ class EDSCalendarStorageCommon
      *  @brief Assignment operator, private unimplemented to prevent misuse.
      */
     EDSCalendarStorageCommon& operator=(EDSCalendarStorageCommon const &other);
-
-    /*!
-     * @brief Callback function for libecal that will be called
-     * for each timezone found in VEVENT or VTODO component
-     */
-    static void findTimeZonesCb(icalparameter* param, void* data);
-
-    static std::set<std::string>       currentEventTimeZones;
 };
 
 #endif // EDSCALENDARSTORAGECOMMON_HPP_
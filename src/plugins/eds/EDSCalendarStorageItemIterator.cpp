@@ -57,11 +57,13 @@ OpenAB_Storage::StorageItem* EDSCalendarStorageItemIterator::next()
     }
   }
 
-  //get next object
-  std::string iCal = events.front();
+  //get next object, objects are moved out of events list instead of being copied
+  std::vector<std::string> iCals;
+  iCals.push_back(std::string());
+  iCals.back().swap(events.front());
   events.pop_front();
 
-  if (iCal.empty())
+  if (iCals.back().empty())
   {
     LOG_DEBUG()<<"empty file"<<std::endl;
     return NULL;
@@ -69,12 +71,9 @@ OpenAB_Storage::StorageItem* EDSCalendarStorageItemIterator::next()
 
   //get UID of object
   std::string::size_type pos = 0;
-  std::string uid = OpenAB::cut(iCal, "UID:", "\n", pos);
+  std::string uid = OpenAB::cut(iCals.back(), "UID:", "\n", pos);
   OpenAB::trimSpaces(uid);
 
-  std::vector<std::string> iCals;
-  iCals.push_back(iCal);
-
   /*
    * check if following events contains the same UID, if so
    * process them at the same time.
@@ -96,14 +95,15 @@ OpenAB_Storage::StorageItem* EDSCalendarStorageItemIterator::next()
       OpenAB::trimSpaces(uid2);
       if (uid == uid2)
       {
-        iCals.push_back(events.front());
+        iCals.push_back(std::string());
+        iCals.back().swap(events.front());
         events.pop_front();
         sameEvent = true;
       }
     }
   }
 
-  OpenAB::PIMCalendarItem* newItem = EDSCalendarStorageCommon::processObject(iCals);
+  OpenAB::PIMCalendarItem* newItem = EDSCalendarStorageCommon::processObject(iCals, timeZones);
   elem.id = newItem->getId();
   elem.item = newItem;
 
@@ -15,6 +15,7 @@
 #include <list>
 #include <set>
 #include "OpenAB_eds_global.h"
+#include "EDSTimeZoneCache.hpp"
 
 /*!
  * @brief Documentation for class EDSCalendarStorageItemIterator
@@ -67,6 +68,7 @@ class EDSCalendarStorageItemIterator : public OpenAB_Storage::StorageItemIterato
     std::ifstream               databaseFile;
     int                         total;
     std::list<std::string>      events;
+    EDSTimeZoneCache            timeZones;
 };
 
 #endif // EDSCALENDARSTORAGEITEMITERATOR_HPP_
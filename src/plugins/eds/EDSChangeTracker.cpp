@@ -0,0 +1,258 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file EDSChangeTracker.cpp
+ */
+
+#include "EDSChangeTracker.hpp"
+#include <helpers/Log.hpp>
+#include <helpers/FileHelper.hpp>
+#include <fstream>
+
+#define EDS_SNAPSHOT_MAGIC "OpenAB-EDSSnapshot 1"
+/*Number of attempts to take consistent snapshot of revisions in getLatestSyncToken*/
+#define SYNC_TOKEN_ATTEMPTS 3
+
+EDSChangeTracker::EDSChangeTracker(const std::string& kind,
+                                   const std::string& database)
+{
+  gchar* dir = g_build_filename(g_get_user_data_dir(), "openab", "eds", NULL);
+  directory = dir;
+  g_free(dir);
+
+  //source names are UIDs generated by EDS, but make sure they will not escape snapshots directory
+  std::string name = kind + "-" + database;
+  std::string::size_type pos = 0;
+  while (std::string::npos != (pos = name.find('/', pos)))
+  {
+    name[pos] = '_';
+  }
+  fileName = directory + "/" + name;
+}
+
+EDSChangeTracker::~EDSChangeTracker()
+{
+}
+
+bool EDSChangeTracker::load(std::string& token,
+                            Revisions& revisions) const
+{
+  std::ifstream file(fileName.c_str(), std::ios_base::in);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  std::string line;
+  if (!std::getline(file, line) || line != EDS_SNAPSHOT_MAGIC ||
+      !std::getline(file, token) || token.empty())
+  {
+    return false;
+  }
+
+  revisions.clear();
+  while (std::getline(file, line))
+  {
+    std::string::size_type pos = line.find('\t');
+    if (pos == std::string::npos)
+    {
+      continue;
+    }
+    revisions[line.substr(0, pos)] = line.substr(pos + 1);
+  }
+  return true;
+}
+
+bool EDSChangeTracker::loadToken(std::string& token) const
+{
+  std::ifstream file(fileName.c_str(), std::ios_base::in);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  std::string line;
+  return (std::getline(file, line) && line == EDS_SNAPSHOT_MAGIC &&
+          std::getline(file, token) && !token.empty());
+}
+
+bool EDSChangeTracker::save(const std::string& token,
+                            const Revisions& revisions)
+{
+  if (token.empty() || std::string::npos != token.find('\n'))
+  {
+    return false;
+  }
+
+  if (!OpenAB::makeDirs(directory))
+  {
+    LOG_ERROR()<<"Cannot create directory "<<directory<<std::endl;
+    return false;
+  }
+
+  //partially written snapshot will never be loaded
+  OpenAB::AtomicFileWriter file(fileName, false);
+  if (!file.isOpen())
+  {
+    LOG_ERROR()<<"Cannot open snapshot file "<<fileName<<std::endl;
+    return false;
+  }
+
+  file.stream()<<EDS_SNAPSHOT_MAGIC<<"\n"<<token<<"\n";
+  Revisions::const_iterator it;
+  for (it = revisions.begin(); it != revisions.end(); ++it)
+  {
+    //such entries could not be read back, missing entry will be reported as added item
+    if (std::string::npos != (*it).first.find_first_of("\t\n") ||
+        std::string::npos != (*it).second.find('\n'))
+    {
+      continue;
+    }
+    file.stream()<<(*it).first<<"\t"<<(*it).second<<"\n";
+  }
+
+  if (!file.commit())
+  {
+    LOG_ERROR()<<"Cannot write snapshot file "<<fileName<<std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool EDSChangeTracker::getDatabaseRevision(EClient* client,
+                                           std::string& revision)
+{
+  GError *gerror = NULL;
+  gchar* value = NULL;
+  if (!e_client_get_backend_property_sync(client, CLIENT_BACKEND_PROPERTY_REVISION, &value, NULL, &gerror))
+  {
+    LOG_ERROR() << "Error e_client_get_backend_property_sync results: " << GERROR_MESSAGE(gerror)<<std::endl;
+    GERROR_FREE(gerror);
+    return false;
+  }
+  revision = value ? value : "";
+  g_free(value);
+  return !revision.empty();
+}
+
+bool EDSChangeTracker::getChangedRevisions(EClient* client,
+                                           RevisionsReader& reader,
+                                           const std::string& token,
+                                           Revisions& changed,
+                                           std::vector<OpenAB::PIMItem::ID>& removed)
+{
+  if (token.empty())
+  {
+    return false;
+  }
+
+  std::string snapshotToken;
+  Revisions snapshot;
+  if (!load(snapshotToken, snapshot) || snapshotToken != token)
+  {
+    LOG_DEBUG() << "No snapshot for sync token "<<token<<std::endl;
+    return false;
+  }
+
+  std::string currentToken;
+  if (!getDatabaseRevision(client, currentToken))
+  {
+    return false;
+  }
+
+  //database revision changes with every modification, so nothing needs to be checked if it is the same
+  if (currentToken == token)
+  {
+    return true;
+  }
+
+  Revisions current;
+  if (!reader.readRevisions(current))
+  {
+    return false;
+  }
+
+  diff(snapshot, current, changed, removed);
+  return true;
+}
+
+bool EDSChangeTracker::getLatestSyncToken(EClient* client,
+                                          RevisionsReader& reader,
+                                          std::string& token)
+{
+  std::string before;
+  if (!getDatabaseRevision(client, before))
+  {
+    return false;
+  }
+
+  //stored snapshot is still up to date, no need to read revisions of all items again
+  std::string snapshotToken;
+  if (loadToken(snapshotToken) && snapshotToken == before)
+  {
+    token = before;
+    return true;
+  }
+
+  //snapshot is valid only if database was not modified while revisions of items were collected
+  for (int i = 0; i < SYNC_TOKEN_ATTEMPTS; ++i)
+  {
+    std::string after;
+    Revisions current;
+    if (!reader.readRevisions(current) ||
+        !getDatabaseRevision(client, after))
+    {
+      return false;
+    }
+
+    if (before == after)
+    {
+      if (!save(before, current))
+      {
+        return false;
+      }
+      token = before;
+      return true;
+    }
+    before = after;
+  }
+
+  LOG_ERROR() << "Database is modified constantly, cannot take snapshot"<<std::endl;
+  return false;
+}
+
+void EDSChangeTracker::diff(const Revisions& previous,
+                            const Revisions& current,
+                            Revisions& changed,
+                            std::vector<OpenAB::PIMItem::ID>& removed)
+{
+  //both maps are sorted by id, so they can be merged in single pass
+  Revisions::const_iterator prevIt = previous.begin();
+  Revisions::const_iterator currIt = current.begin();
+  while (prevIt != previous.end() || currIt != current.end())
+  {
+    if (currIt == current.end() ||
+        (prevIt != previous.end() && (*prevIt).first < (*currIt).first))
+    {
+      removed.push_back((*prevIt).first);
+      ++prevIt;
+    }
+    else if (prevIt == previous.end() || (*currIt).first < (*prevIt).first)
+    {
+      changed.insert(changed.end(), (*currIt));
+      ++currIt;
+    }
+    else
+    {
+      if ((*currIt).second != (*prevIt).second)
+      {
+        changed.insert(changed.end(), (*currIt));
+      }
+      ++prevIt;
+      ++currIt;
+    }
+  }
+}
@@ -0,0 +1,154 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file EDSChangeTracker.hpp
+ */
+
+#ifndef EDSCHANGETRACKER_HPP_
+#define EDSCHANGETRACKER_HPP_
+
+#include <PIMItem/PIMItem.hpp>
+#include "OpenAB_eds_global.h"
+#include <string>
+#include <map>
+#include <vector>
+
+/*!
+ * @brief Tracks changes of EDS storage between synchronizations.
+ *
+ * EDS backends report revision of whole database, which changes with every modification,
+ * but they do not provide list of changes since given revision.
+ * Tracker keeps snapshot of revisions of all items taken together with database revision (sync token),
+ * so changes since that token can be computed by comparing snapshot with current revisions of items.
+ * When database revision did not change since token, no items need to be checked at all.
+ * Tracker is shared by EDS storages of all item types, which provide current revisions of their items
+ * through @ref EDSChangeTracker::RevisionsReader.
+ */
+class EDSChangeTracker
+{
+  public:
+    /*!
+     * @brief Revisions of items mapped by their ids.
+     */
+    typedef std::map<std::string, std::string> Revisions;
+
+    /*!
+     * @brief Provides current revisions of all tracked items.
+     */
+    class RevisionsReader
+    {
+      public:
+        virtual ~RevisionsReader() {}
+
+        /*!
+         * @brief Reads current revisions of all items.
+         * @param [out] revisions revisions of items mapped by their ids.
+         * @return true if revisions were read, false otherwise.
+         */
+        virtual bool readRevisions(Revisions& revisions) = 0;
+    };
+
+    /*!
+     *  @brief Constructor.
+     *  @param [in] kind kind of tracked items (e.g. "contacts").
+     *  @param [in] database name of EDS source.
+     */
+    EDSChangeTracker(const std::string& kind,
+                     const std::string& database);
+
+    /*!
+     *  @brief Destructor, virtual by default.
+     */
+    virtual ~EDSChangeTracker();
+
+    /*!
+     * @brief Loads snapshot stored by last call of @ref save.
+     * @param [out] token sync token of snapshot.
+     * @param [out] revisions revisions of all items at time of snapshot.
+     * @return true if snapshot was loaded, false if it does not exist or is invalid.
+     */
+    bool load(std::string& token,
+              Revisions& revisions) const;
+
+    /*!
+     * @brief Stores snapshot, replacing previous one.
+     * @param [in] token sync token identifying snapshot.
+     * @param [in] revisions revisions of all items.
+     * @return true if snapshot was stored, false otherwise.
+     */
+    bool save(const std::string& token,
+              const Revisions& revisions);
+
+    /*!
+     * @brief Gets revision of whole database, which changes with every modification of it.
+     * @param [in] client client connected to database.
+     * @param [out] revision database revision.
+     * @return true if revision was retrieved, false otherwise.
+     */
+    static bool getDatabaseRevision(EClient* client,
+                                    std::string& revision);
+
+    /*!
+     * @brief Computes changes since sync token returned by @ref getLatestSyncToken.
+     * Revisions of items are read only if database revision changed since token.
+     * @param [in] client client connected to database.
+     * @param [in] reader provider of current revisions of items.
+     * @param [in] token sync token.
+     * @param [out] changed current revisions of added and modified items.
+     * @param [out] removed ids of removed items.
+     * @return true if changes were computed, false if token is not known or revisions cannot be read.
+     */
+    bool getChangedRevisions(EClient* client,
+                             RevisionsReader& reader,
+                             const std::string& token,
+                             Revisions& changed,
+                             std::vector<OpenAB::PIMItem::ID>& removed);
+
+    /*!
+     * @brief Gets sync token of current state of database, taking new snapshot of revisions if needed.
+     * When database revision equals token of stored snapshot, that token is returned without reading revisions of items.
+     * @param [in] client client connected to database.
+     * @param [in] reader provider of current revisions of items.
+     * @param [out] token sync token.
+     * @return true if token was retrieved, false otherwise.
+     */
+    bool getLatestSyncToken(EClient* client,
+                            RevisionsReader& reader,
+                            std::string& token);
+
+    /*!
+     * @brief Computes changes between two snapshots.
+     * @param [in] previous revisions of items in previous snapshot.
+     * @param [in] current current revisions of items.
+     * @param [out] changed current revisions of added and modified items.
+     * @param [out] removed ids of removed items.
+     */
+    static void diff(const Revisions& previous,
+                     const Revisions& current,
+                     Revisions& changed,
+                     std::vector<OpenAB::PIMItem::ID>& removed);
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    EDSChangeTracker(EDSChangeTracker const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    EDSChangeTracker& operator=(EDSChangeTracker const &other);
+
+    /*!
+     * @brief Loads only sync token of stored snapshot.
+     */
+    bool loadToken(std::string& token) const;
+
+    std::string directory;
+    std::string fileName;
+};
+
+#endif // EDSCHANGETRACKER_HPP_
@@ -0,0 +1,130 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file EDSContactsBatchConverter.cpp
+ */
+
+#include "EDSContactsBatchConverter.hpp"
+#include <algorithm>
+
+EDSContactsBatchConverter::EDSContactsBatchConverter(const std::vector<std::string>& v,
+                                                     const OpenAB::PIMItem::IDs* i,
+                                                     unsigned int size) :
+    vCards(v),
+    ids(i),
+    batchSize(size ? size : 1),
+    failed(false),
+    batches(1),
+    threadStarted(false)
+{
+}
+
+EDSContactsBatchConverter::~EDSContactsBatchConverter()
+{
+  batches.close();
+  if (threadStarted)
+  {
+    pthread_join(thread, NULL);
+  }
+
+  GSList* contacts = NULL;
+  while (batches.pop(contacts))
+  {
+    g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
+  }
+}
+
+bool EDSContactsBatchConverter::start()
+{
+  if (0 != pthread_create(&thread, NULL, converterThreadFuncWrapper, this))
+  {
+    LOG_ERROR() << "Cannot create converter thread"<<std::endl;
+    return false;
+  }
+  threadStarted = true;
+  return true;
+}
+
+bool EDSContactsBatchConverter::pop(GSList*& contacts)
+{
+  return batches.pop(contacts);
+}
+
+bool EDSContactsBatchConverter::hasFailed() const
+{
+  return failed;
+}
+
+void* EDSContactsBatchConverter::converterThreadFuncWrapper(void* ptr)
+{
+  EDSContactsBatchConverter* converter = static_cast<EDSContactsBatchConverter*>(ptr);
+  converter->converterThreadFunc();
+  return NULL;
+}
+
+void EDSContactsBatchConverter::converterThreadFunc()
+{
+  for (unsigned int batchStart = 0; batchStart < vCards.size(); batchStart += batchSize)
+  {
+    unsigned int batchEnd = std::min<unsigned int>(batchStart + batchSize, vCards.size());
+
+    //prepend and reverse once, so building list is linear in batch size
+    GSList* contacts = NULL;
+    for (unsigned int i = batchStart; i < batchEnd; ++i)
+    {
+      EContact* contact = convert(i);
+      if (NULL == contact)
+      {
+        g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
+        //queue synchronizes access to flag, it is read by consumer only after pop returned false
+        failed = true;
+        batches.close();
+        return;
+      }
+      contacts = g_slist_prepend(contacts, contact);
+    }
+    contacts = g_slist_reverse(contacts);
+
+    if (!batches.push(contacts))
+    {
+      //converter is being destroyed
+      g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
+      return;
+    }
+  }
+  batches.close();
+}
+
+EContact* EDSContactsBatchConverter::convert(unsigned int index) const
+{
+  EContact* contact = NULL;
+  if (NULL != ids)
+  {
+    contact = e_contact_new_from_vcard_with_uid(vCards[index].c_str(), (*ids)[index].c_str());
+    if (NULL == contact)
+    {
+      LOG_ERROR() << "Error e_contact_new_from_vcard_with_uid uid: " << (*ids)[index]<<std::endl;
+    }
+    return contact;
+  }
+
+  std::string vcard = vCards[index];
+
+  //remove UID and let EDS generate new one
+  std::string::size_type uidStart = vcard.find("UID:");
+  if (uidStart != std::string::npos)
+  {
+    std::string::size_type uidEnd = vcard.find("\n", uidStart);
+    vcard = vcard.erase(uidStart, uidEnd-uidStart);
+  }
+
+  contact = e_contact_new_from_vcard(vcard.c_str());
+  if (NULL == contact)
+  {
+    LOG_ERROR() << "Error e_contact_new_from_vcard"<<std::endl;
+  }
+  return contact;
+}
@@ -0,0 +1,95 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file EDSContactsBatchConverter.hpp
+ */
+
+#ifndef EDSCONTACTSBATCHCONVERTER_HPP_
+#define EDSCONTACTSBATCHCONVERTER_HPP_
+
+#include <PIMItem/PIMItem.hpp>
+#include <helpers/BoundedQueue.hpp>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "OpenAB_eds_global.h"
+
+/*!
+ * @brief Converts vCards to lists of EContacts in background thread, batch by batch.
+ *
+ * Allows to write batch of contacts to EDS while next batch is being converted.
+ * At most one converted batch is waiting for consumer, so memory used by converter stays bounded.
+ */
+class EDSContactsBatchConverter
+{
+  public:
+    /*!
+     *  @brief Constructor.
+     *  @param [in] vCards vCards to be converted, have to stay valid until converter is destroyed.
+     *  @param [in] ids ids of contacts to be set in converted contacts (in the same order as vCards),
+     *  if NULL UIDs are removed from vCards, so EDS will generate new ones.
+     *  @param [in] batchSize maximal number of contacts in single batch.
+     */
+    EDSContactsBatchConverter(const std::vector<std::string>& vCards,
+                              const OpenAB::PIMItem::IDs* ids,
+                              unsigned int batchSize);
+
+    /*!
+     *  @brief Destructor, stops converter thread and frees batches that were not popped.
+     */
+    ~EDSContactsBatchConverter();
+
+    /*!
+     * @brief Starts converter thread.
+     * @return true if thread was started, false otherwise.
+     */
+    bool start();
+
+    /*!
+     * @brief Returns next converted batch, blocks until it is ready.
+     * @param [out] contacts list of EContacts, ownership is passed to caller.
+     * @return true if batch was returned, false if there are no more batches
+     * (either all were returned or conversion failed, see @ref hasFailed).
+     */
+    bool pop(GSList*& contacts);
+
+    /*!
+     * @brief Returns true if any of vCards could not be converted.
+     * @note valid only after @ref pop returned false.
+     */
+    bool hasFailed() const;
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    EDSContactsBatchConverter(EDSContactsBatchConverter const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    EDSContactsBatchConverter& operator=(EDSContactsBatchConverter const &other);
+
+    static void* converterThreadFuncWrapper(void* ptr);
+    void converterThreadFunc();
+
+    /*!
+     * @brief Converts single vCard to EContact.
+     * @param [in] index index of vCard.
+     * @return new EContact, or NULL if vCard could not be converted.
+     */
+    EContact* convert(unsigned int index) const;
+
+    const std::vector<std::string>& vCards;
+    const OpenAB::PIMItem::IDs*     ids;
+    unsigned int                    batchSize;
+    bool                            failed;
+    OpenAB::BoundedQueue<GSList*>   batches;
+    pthread_t                       thread;
+    bool                            threadStarted;
+};
+
+#endif // EDSCONTACTSBATCHCONVERTER_HPP_
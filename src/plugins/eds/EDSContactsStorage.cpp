@@ -9,15 +9,85 @@
 
 #include "OpenAB_eds_global.h"
 #include "EDSContactsStorage.hpp"
+#include <algorithm>
 
+/*Default number of contacts queried at once by getContacts*/
+#define DEFAULT_GET_BATCH_SIZE 100
 
-EDSContactsStorage::EDSContactsStorage(const std::string & db)
+/*Default number of contacts written at once by addContacts and modifyContacts*/
+#define DEFAULT_WRITE_BATCH_SIZE 100
+
+namespace
+{
+  /*
+   * State of revisions query, shared with signal handlers of book view.
+   */
+  struct RevisionsQuery
+  {
+    std::map<std::string, std::string>* revisions;
+    GMainLoop* loop;
+    bool failed;
+  };
+
+  void onRevisionsAdded(EBookClientView*, const GSList* contacts, gpointer data)
+  {
+    RevisionsQuery* query = static_cast<RevisionsQuery*>(data);
+    for (const GSList* l = contacts; l; l = g_slist_next(l))
+    {
+      EContact* contact = static_cast<EContact*>(l->data);
+      const char* uid = (const char*)e_contact_get_const(contact, E_CONTACT_UID);
+      const char* rev = (const char*)e_contact_get_const(contact, E_CONTACT_REV);
+      if (uid)
+      {
+        (*query->revisions)[uid] = rev ? rev : "";
+      }
+    }
+  }
+
+  /*
+   * State of asynchronous call, result is stored by completion callback.
+   */
+  struct AsyncCall
+  {
+    GMainLoop* loop;
+    GAsyncResult* result;
+  };
+
+  void onAsyncCallReady(GObject*, GAsyncResult* result, gpointer data)
+  {
+    AsyncCall* call = static_cast<AsyncCall*>(data);
+    call->result = G_ASYNC_RESULT(g_object_ref(result));
+    g_main_loop_quit(call->loop);
+  }
+
+  void onRevisionsComplete(EBookClientView*, const GError* error, gpointer data)
+  {
+    RevisionsQuery* query = static_cast<RevisionsQuery*>(data);
+    if (NULL != error)
+    {
+      LOG_ERROR() << "Error book view results: " << GERROR_MESSAGE(error)<<std::endl;
+      query->failed = true;
+    }
+    g_main_loop_quit(query->loop);
+  }
+}
+
+
+EDSContactsStorage::EDSContactsStorage(const std::string & db,
+                                       unsigned int batchSize,
+                                       bool direct,
+                                       unsigned int writeSize)
     : OpenAB_Storage::ContactsStorage(),
       database(db),
+      getBatchSize(batchSize ? batchSize : 1),
+      writeBatchSize(writeSize ? writeSize : 1),
       registry(NULL),
       source(NULL),
+      directRead(direct),
       client(NULL),
-      contactsIterator(NULL)
+      readClient(NULL),
+      contactsIterator(NULL),
+      changeTracker("contacts", db)
 {
   LOG_FUNC();
 }
@@ -30,6 +100,8 @@ EDSContactsStorage::~EDSContactsStorage()
     delete contactsIterator;
   }
 
+  if (NULL != readClient)
+    g_object_unref(readClient);
   if (NULL != client)
     g_object_unref(client);
   if (NULL != source)
@@ -80,6 +152,24 @@ enum OpenAB_Storage::Storage::eInit EDSContactsStorage::init()
   }
   LOG_VERBOSE() << "e_book_client_connect_sync\n"<<std::endl;
 
+  if (directRead)
+  {
+    //direct read client reads contacts from backend database in our process,
+    //instead of receiving them over D-Bus, so it is used only for bulk reads
+    readClient = (EBookClient *) e_book_client_connect_direct_sync(registry, source, NULL, &gerror);
+    if (gerror)
+    {
+      LOG_ERROR() << "Error e_book_client_connect_direct_sync results: " << GERROR_MESSAGE(gerror)<<std::endl;
+      LOG_ERROR() << "Falling back to reading over D-Bus"<<std::endl;
+      GERROR_FREE(gerror);
+      readClient = NULL;
+    }
+  }
+  if (NULL == readClient)
+  {
+    readClient = (EBookClient *) g_object_ref(client);
+  }
+
   return eInitOk;
 }
 
@@ -88,7 +178,7 @@ enum OpenAB_Source::Source::eGetItemRet EDSContactsStorage::getItem(OpenAB::Smar
   if (NULL == contactsIterator)
   {
     contactsIterator = new EDSContactsStorageItemIterator();
-    if (EDSContactsStorageItemIterator::eCursorInitOK != contactsIterator->cursorInit(client))
+    if (EDSContactsStorageItemIterator::eCursorInitOK != contactsIterator->cursorInit(readClient))
       {
         LOG_ERROR() << "Error Cannot Init the EDS IndexElemIterator"<<std::endl;
         return eGetItemRetEnd;
@@ -151,16 +241,45 @@ OpenAB::PIMItem::Revision EDSContactsStorage::getRevision(const OpenAB::PIMItem:
 
 OpenAB::PIMItem::Revisions EDSContactsStorage::getRevisions(const OpenAB::PIMItem::IDs& ids)
 {
+  std::map<std::string, std::string> found;
+  for (unsigned int batchStart = 0; batchStart < ids.size(); batchStart += getBatchSize)
+  {
+    unsigned int batchEnd = std::min<unsigned int>(batchStart + getBatchSize, ids.size());
+    if (!queryRevisions(idsQuery(ids, batchStart, batchEnd), found))
+    {
+      LOG_ERROR() << "Cannot get revisions of "<<(batchEnd - batchStart)<<" contacts"<<std::endl;
+    }
+  }
+
   OpenAB::PIMItem::Revisions revisions;
   OpenAB::PIMItem::IDs::const_iterator it;
   for (it = ids.begin(); it != ids.end(); ++it)
   {
-    revisions.push_back(getRevision((*it)));
+    std::map<std::string, std::string>::const_iterator rev = found.find((*it));
+    revisions.push_back(rev != found.end() ? (*rev).second : "");
   }
 
   return revisions;
 }
 
+std::string EDSContactsStorage::idsQuery(const OpenAB::PIMItem::IDs& ids,
+                                         unsigned int start,
+                                         unsigned int end)
+{
+  std::vector<EBookQuery*> queries;
+  for (unsigned int i = start; i < end; ++i)
+  {
+    queries.push_back(e_book_query_field_test(E_CONTACT_UID, E_BOOK_QUERY_IS, ids[i].c_str()));
+  }
+  EBookQuery* query = e_book_query_or(queries.size(), &queries[0], TRUE);
+  gchar* sexp = e_book_query_to_string(query);
+  e_book_query_unref(query);
+
+  std::string res = sexp;
+  g_free(sexp);
+  return res;
+}
+
 enum OpenAB_Storage::Storage::eAddItem EDSContactsStorage::addContact(const std::string & vCard,
                                                                    OpenAB::PIMItem::ID & newId,
                                                                    OpenAB::PIMItem::Revision & revision)
@@ -203,54 +322,21 @@ enum OpenAB_Storage::Storage::eAddItem EDSContactsStorage::addContacts(const std
                                                                     OpenAB::PIMItem::IDs & newIds,
                                                                     OpenAB::PIMItem::Revisions & revisions)
 {
-  GError *gerror = NULL;
-  GSList * contacts = NULL;
-  GSList * new_uids;
+  EDSContactsBatchConverter converter(vCards, NULL, writeBatchSize);
 
-  for(unsigned int i = 0; i < vCards.size(); ++i)
+  newIds.clear();
+  if (!writeContacts(converter, &newIds))
   {
-    std::string vcard = vCards[i];
-
-    //remove UID and let EDS generate new one
-    std::string::size_type uidStart = vcard.find("UID:");
-    if (uidStart != std::string::npos)
+    //batches are committed separately, remove contacts added by ones written before failure,
+    //so failed call does not leave contacts whose ids were never returned to caller
+    if (!newIds.empty() && eRemoveItemOk != removeContacts(newIds))
     {
-      std::string::size_type uidEnd = vcard.find("\n", uidStart);
-      vcard = vcard.erase(uidStart, uidEnd-uidStart);
+      LOG_ERROR() << "Cannot remove "<<newIds.size()<<" partially added contacts"<<std::endl;
     }
-
-
-    EContact * contact_new = e_contact_new_from_vcard(vcard.c_str());
-    if (NULL == contact_new)
-    {
-      LOG_ERROR() << "Error e_contact_new_from_vcard"<<std::endl;
-      g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
-      return eAddItemFail;
-    }
-    contacts = g_slist_append(contacts, contact_new);
-  }
-
-
-  if (!e_book_client_add_contacts_sync(client, contacts, &new_uids, NULL, &gerror))
-  {
-    LOG_ERROR() << "Error e_book_client_add_contact_sync results: " << GERROR_MESSAGE(gerror)<<std::endl;
-    GERROR_FREE(gerror);
-    g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
+    newIds.clear();
     return eAddItemFail;
   }
 
-  GSList *l = new_uids;
-  newIds.clear();
-  while(l)
-  {
-    std::string id = (const gchar*)l->data;
-    newIds.push_back(id);
-    l = g_slist_next(l);
-  }
-
-  g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
-  e_client_util_free_string_slist(new_uids);
-
   revisions = getRevisions(newIds);
   return eAddItemOk;
 }
@@ -284,37 +370,84 @@ enum OpenAB_Storage::Storage::eModifyItem EDSContactsStorage::modifyContacts(con
                                                                           const OpenAB::PIMItem::IDs & ids,
                                                                           OpenAB::PIMItem::Revisions & revisions)
 {
-  GError *gerror = NULL;
-  GSList * contacts = NULL;
-
   if (vCards.size() != ids.size())
   {
     return eModifyItemFail;
   }
 
-  for(unsigned int i = 0; i < vCards.size(); ++i)
+  EDSContactsBatchConverter converter(vCards, &ids, writeBatchSize);
+
+  if (!writeContacts(converter, NULL))
   {
-    EContact * contact_new = e_contact_new_from_vcard_with_uid(vCards[i].c_str(), ids[i].c_str());
-    if (NULL == contact_new)
-    {
-      LOG_ERROR() << "Error e_contact_new_from_vcard_with_uid"<<std::endl;
-      g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
-      return eModifyItemFail;
-    }
-    contacts = g_slist_append(contacts, contact_new);
+    return eModifyItemFail;
   }
 
-  if (!e_book_client_modify_contacts_sync(client, contacts, NULL, &gerror))
+  revisions = getRevisions(ids);
+  return eModifyItemOk;
+}
+
+bool EDSContactsStorage::writeContacts(EDSContactsBatchConverter& converter,
+                                       OpenAB::PIMItem::IDs* newIds)
+{
+  if (!converter.start())
   {
-    LOG_ERROR() << "Error e_book_client_modify_contacts_sync results: " << GERROR_MESSAGE(gerror)<<std::endl;
-    GERROR_FREE(gerror);
+    return false;
+  }
+
+  //completion callbacks are invoked in main context that is thread default when call is made,
+  //use private one so batches can be written without interfering with application main loop
+  GMainContext* context = g_main_context_new();
+  g_main_context_push_thread_default(context);
+  GMainLoop* loop = g_main_loop_new(context, FALSE);
+
+  bool res = true;
+  GSList* contacts = NULL;
+  //while backend commits batch, converter thread already prepares next one
+  while (res && converter.pop(contacts))
+  {
+    AsyncCall call;
+    call.loop = loop;
+    call.result = NULL;
+
+    GError* gerror = NULL;
+    if (newIds)
+    {
+      GSList* uids = NULL;
+      e_book_client_add_contacts(client, contacts, NULL, onAsyncCallReady, &call);
+      g_main_loop_run(loop);
+      if (!e_book_client_add_contacts_finish(client, call.result, &uids, &gerror))
+      {
+        LOG_ERROR() << "Error e_book_client_add_contacts results: " << GERROR_MESSAGE(gerror)<<std::endl;
+        GERROR_FREE(gerror);
+        res = false;
+      }
+      for (GSList* l = uids; l; l = g_slist_next(l))
+      {
+        newIds->push_back((const gchar*)l->data);
+      }
+      e_client_util_free_string_slist(uids);
+    }
+    else
+    {
+      e_book_client_modify_contacts(client, contacts, NULL, onAsyncCallReady, &call);
+      g_main_loop_run(loop);
+      if (!e_book_client_modify_contacts_finish(client, call.result, &gerror))
+      {
+        LOG_ERROR() << "Error e_book_client_modify_contacts results: " << GERROR_MESSAGE(gerror)<<std::endl;
+        GERROR_FREE(gerror);
+        res = false;
+      }
+    }
+
+    g_object_unref(call.result);
     g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
-    return eModifyItemFail;
   }
-  revisions = getRevisions(ids);
-  g_slist_free_full(contacts, (GDestroyNotify) g_object_unref);
 
-  return eModifyItemOk;
+  g_main_loop_unref(loop);
+  g_main_context_pop_thread_default(context);
+  g_main_context_unref(context);
+
+  return res && !converter.hasFailed();
 }
 
 enum OpenAB_Storage::Storage::eRemoveItem EDSContactsStorage::removeContact(const OpenAB::PIMItem::ID & id)
@@ -353,29 +486,35 @@ enum OpenAB_Storage::Storage::eRemoveItem EDSContactsStorage::removeContacts(con
   return eRemoveItemOk;
 }
 
+OpenAB::PIMContactItem* EDSContactsStorage::toContactItem(EContact* contact,
+                                                          const OpenAB::PIMItem::ID& id)
+{
+  //e_contact_inline_local_photos(contact, &gerror);
+  gchar * gvc =  e_vcard_to_string(E_VCARD(contact), EVC_FORMAT_VCARD_30);
+  const char * rev  = (const char *)e_contact_get_const(contact, E_CONTACT_REV);
+
+  OpenAB::PIMContactItem* newItem = new OpenAB::PIMContactItem();
+  newItem->parse(gvc);
+  newItem->setId(id);
+  newItem->setRevision(rev ? rev : "");
+
+  g_free (gvc);
+  return newItem;
+}
+
 enum OpenAB_Storage::Storage::eGetItem EDSContactsStorage::getContact(const OpenAB::PIMItem::ID & id, OpenAB::SmartPtr<OpenAB::PIMContactItem> & item)
 {
   GError *gerror = NULL;
   EContact * contact;
-  std::string vCard;
   if (!e_book_client_get_contact_sync(client, id.c_str(), &contact, NULL, &gerror))
   {
     LOG_ERROR() << "Error e_book_client_get_contact_sync results: " << GERROR_MESSAGE(gerror)<<std::endl;
     GERROR_FREE(gerror);
     return eGetItemFail;
   }
-  //e_contact_inline_local_photos(contact, &gerror);
-  gchar * gvc =  e_vcard_to_string(E_VCARD(contact), EVC_FORMAT_VCARD_30);
-  vCard = gvc;
-  const char * rev  = (const char *)e_contact_get_const(contact, E_CONTACT_REV);
 
-  OpenAB::PIMContactItem* newItem = new OpenAB::PIMContactItem();
-  newItem->parse(vCard);
-  newItem->setId(id);
-  newItem->setRevision(rev);
-  item = newItem;
+  item = toContactItem(contact, id);
 
-  g_free (gvc);
   g_object_unref(contact);
   GERROR_FREE(gerror);
   return eGetItemOk;
@@ -384,59 +523,156 @@ enum OpenAB_Storage::Storage::eGetItem EDSContactsStorage::getContact(const Open
 enum OpenAB_Storage::Storage::eGetItem EDSContactsStorage::getContacts(const OpenAB::PIMItem::IDs & ids,
                                                                     std::vector<OpenAB::SmartPtr<OpenAB::PIMContactItem> > & items)
 {
-  for (unsigned int i = 0; i < ids.size(); ++i)
+  bool allFound = true;
+
+  //contacts are queried in batches using single (or (is "id" ...)) query for each of them
+  for (unsigned int batchStart = 0; batchStart < ids.size(); batchStart += getBatchSize)
   {
-    OpenAB::SmartPtr<OpenAB::PIMContactItem> contact;
-    if (eGetItemFail == getContact(ids[i], contact))
+    unsigned int batchEnd = std::min<unsigned int>(batchStart + getBatchSize, ids.size());
+
+    GError *gerror = NULL;
+    GSList* contacts = NULL;
+    gboolean res = e_book_client_get_contacts_sync(readClient, idsQuery(ids, batchStart, batchEnd).c_str(), &contacts, NULL, &gerror);
+    if (!res)
     {
+      LOG_ERROR() << "Error e_book_client_get_contacts_sync results: " << GERROR_MESSAGE(gerror)<<std::endl;
+      GERROR_FREE(gerror);
       return eGetItemFail;
     }
-    items.push_back(contact);
+
+    std::map<std::string, EContact*> found;
+    for (GSList* l = contacts; l; l = g_slist_next(l))
+    {
+      EContact* contact = static_cast<EContact*>(l->data);
+      const char* uid = (const char*)e_contact_get_const(contact, E_CONTACT_UID);
+      if (uid)
+      {
+        found[uid] = contact;
+      }
+    }
+
+    //return contacts in requested order
+    for (unsigned int i = batchStart; i < batchEnd; ++i)
+    {
+      std::map<std::string, EContact*>::iterator it = found.find(ids[i]);
+      if (it == found.end())
+      {
+        LOG_ERROR() << "Contact not found: " << ids[i]<<std::endl;
+        allFound = false;
+        continue;
+      }
+      items.push_back(toContactItem((*it).second, ids[i]));
+    }
+
+    FREE_CONTACTS(contacts);
   }
 
-  return eGetItemOk;
+  return allFound ? eGetItemOk : eGetItemFail;
 }
 
-enum OpenAB_Storage::Storage::eGetRevisions EDSContactsStorage::getRevisions(std::map<std::string, std::string>& revisions)
+bool EDSContactsStorage::queryRevisions(const std::string& query,
+                                        std::map<std::string, std::string>& revisions)
 {
   GError *gerror = NULL;
-  GSList* uids;
-  if (!e_book_client_get_contacts_uids_sync (client, "", &uids, NULL, &gerror))
+  EBookClientView* view = NULL;
+
+  //signals of view are emitted in main context that is thread default when view is created,
+  //use private one so query can be run synchronously without interfering with application main loop
+  GMainContext* context = g_main_context_new();
+  g_main_context_push_thread_default(context);
+
+  if (!e_book_client_get_view_sync(readClient, query.c_str(), &view, NULL, &gerror))
   {
-    LOG_ERROR() << "Error e_book_client_get_contacts_uids_sync results: " << GERROR_MESSAGE(gerror)<<std::endl;
+    LOG_ERROR() << "Error e_book_client_get_view_sync results: " << GERROR_MESSAGE(gerror)<<std::endl;
     GERROR_FREE(gerror);
-    return eGetRevisionsFail;
+    g_main_context_pop_thread_default(context);
+    g_main_context_unref(context);
+    return false;
   }
 
-  OpenAB::PIMItem::IDs ids;
-  GSList *l = uids;
-  while(l)
+  //only UID and REV are transferred, instead of whole contacts with photos
+  GSList* fields = NULL;
+  fields = g_slist_prepend(fields, (gpointer)e_contact_field_name(E_CONTACT_REV));
+  fields = g_slist_prepend(fields, (gpointer)e_contact_field_name(E_CONTACT_UID));
+  e_book_client_view_set_fields_of_interest(view, fields, &gerror);
+  g_slist_free(fields);
+  if (NULL == gerror)
   {
-    ids.push_back(std::string((const gchar*)l->data));
-    l = g_slist_next(l);
+    e_book_client_view_set_flags(view, E_BOOK_CLIENT_VIEW_FLAGS_NOTIFY_INITIAL, &gerror);
   }
-  e_client_util_free_string_slist(uids);
-  uids = NULL;
 
-  OpenAB::PIMItem::Revisions revs = getRevisions(ids);
-  for (unsigned int i = 0; i < ids.size(); ++i)
+  RevisionsQuery revisionsQuery;
+  revisionsQuery.revisions = &revisions;
+  revisionsQuery.loop = g_main_loop_new(context, FALSE);
+  revisionsQuery.failed = false;
+
+  if (NULL == gerror)
   {
-    revisions[ids[i]] = revs[i];
+    g_signal_connect(view, "objects-added", G_CALLBACK(onRevisionsAdded), &revisionsQuery);
+    g_signal_connect(view, "complete", G_CALLBACK(onRevisionsComplete), &revisionsQuery);
+    e_book_client_view_start(view, &gerror);
+  }
+
+  if (NULL == gerror)
+  {
+    g_main_loop_run(revisionsQuery.loop);
+    e_book_client_view_stop(view, NULL);
+  }
+  else
+  {
+    LOG_ERROR() << "Error starting book view: " << GERROR_MESSAGE(gerror)<<std::endl;
+    GERROR_FREE(gerror);
+    revisionsQuery.failed = true;
   }
 
+  g_object_unref(view);
+  g_main_loop_unref(revisionsQuery.loop);
+  g_main_context_pop_thread_default(context);
+  g_main_context_unref(context);
+
+  return !revisionsQuery.failed;
+}
+
+enum OpenAB_Storage::Storage::eGetRevisions EDSContactsStorage::getRevisions(std::map<std::string, std::string>& revisions)
+{
+  EBookQuery* query = e_book_query_any_field_contains("");
+  gchar* sexp = e_book_query_to_string(query);
+  e_book_query_unref(query);
+
+  std::string querySexp = sexp;
+  g_free(sexp);
+
+  if (!queryRevisions(querySexp, revisions))
+  {
+    return eGetRevisionsFail;
+  }
+
+  return eGetRevisionsOk;
+}
+
+enum OpenAB_Storage::Storage::eGetRevisions EDSContactsStorage::getChangedRevisions(const std::string& token,
+                                                                                    std::map<std::string, std::string>& revisions,
+                                                                                    std::vector<OpenAB::PIMItem::ID>& removed)
+{
+  if (!changeTracker.getChangedRevisions(E_CLIENT(client), *this, token, revisions, removed))
+  {
+    return eGetRevisionsFail;
+  }
   return eGetRevisionsOk;
 }
 
-enum OpenAB_Storage::Storage::eGetRevisions EDSContactsStorage::getChangedRevisions(const std::string&,
-                                                                                 std::map<std::string, std::string>& ,
-                                                                                 std::vector<OpenAB::PIMItem::ID>&)
+enum OpenAB_Storage::Storage::eGetSyncToken EDSContactsStorage::getLatestSyncToken(std::string& token)
 {
-  return eGetRevisionsFail;
+  if (!changeTracker.getLatestSyncToken(E_CLIENT(client), *this, token))
+  {
+    return eGetSyncTokenFail;
+  }
+  return eGetSyncTokenOk;
 }
 
-enum OpenAB_Storage::Storage::eGetSyncToken EDSContactsStorage::getLatestSyncToken(std::string&)
+bool EDSContactsStorage::readRevisions(EDSChangeTracker::Revisions& revisions)
 {
-  return eGetSyncTokenFail;
+  return eGetRevisionsOk == getRevisions(revisions);
 }
 
 OpenAB_Storage::StorageItemIterator* EDSContactsStorage::newStorageItemIterator()
@@ -447,7 +683,7 @@ OpenAB_Storage::StorageItemIterator* EDSContactsStorage::newStorageItemIterator(
     LOG_ERROR() << "Error Cannot create the EDS IndexElemIterator"<<std::endl;
     return NULL;
   }
-  if (ie->eCursorInitOK != ie->cursorInit(client))
+  if (ie->eCursorInitOK != ie->cursorInit(readClient))
   {
     LOG_ERROR() << "Error Cannot Init the EDS IndexElemIterator"<<std::endl;
     delete ie;
@@ -467,7 +703,30 @@ namespace EDSContactsFactory
       LOG_ERROR() << "Parameter 'db' not found"<<std::endl;
       return NULL;
     }
-    EDSContactsStorage * ab = new EDSContactsStorage(param.getString());
+    std::string db = param.getString();
+
+    unsigned int batchSize = DEFAULT_GET_BATCH_SIZE;
+    param = params.getValue("get_batch_size");
+    if (!param.invalid() && param.getType() == OpenAB::Variant::INTEGER && param.getInt() > 0)
+    {
+      batchSize = param.getInt();
+    }
+
+    bool directRead = false;
+    param = params.getValue("direct_read");
+    if (!param.invalid() && param.getType() == OpenAB::Variant::BOOL)
+    {
+      directRead = param.getBool();
+    }
+
+    unsigned int writeBatchSize = DEFAULT_WRITE_BATCH_SIZE;
+    param = params.getValue("write_batch_size");
+    if (!param.invalid() && param.getType() == OpenAB::Variant::INTEGER && param.getInt() > 0)
+    {
+      writeBatchSize = param.getInt();
+    }
+
+    EDSContactsStorage * ab = new EDSContactsStorage(db, batchSize, directRead, writeBatchSize);
     if (NULL == ab)
     {
       LOG_ERROR() << "Cannot Initialize EDSAddressbook"<<std::endl;
@@ -9,7 +9,10 @@
 
 #include <plugin/storage/ContactsStorage.hpp>
 #include "EDSContactsStorageItemIterator.hpp"
+#include "EDSChangeTracker.hpp"
+#include "EDSContactsBatchConverter.hpp"
 #include <string>
+#include <map>
 
 #ifndef OPENAB_PLUGIN_EDS_CONTACTS_HPP_
 #define OPENAB_PLUGIN_EDS_CONTACTS_HPP_
@@ -27,13 +30,27 @@
  * | Type   | Name  | Description                 | Mandatory |
  * |:-------|:    --|:----------------------------|:          |
  * | String |  "db" | EDS source name             | Yes       |
+ * | Integer | "get_batch_size" | Maximal number of contacts queried at once when multiple contacts are requested, 100 by default | No |
+ * | Integer | "write_batch_size" | Maximal number of contacts written at once when multiple contacts are added or modified, 100 by default | No |
+ * | Boolean | "direct_read" | Read contacts directly from backend database instead of over D-Bus when iterating over storage and getting contacts or their revisions, modifications are always done over D-Bus, false by default | No |
  *
  */
 
-class EDSContactsStorage : public OpenAB_Storage::ContactsStorage
+class EDSContactsStorage : public OpenAB_Storage::ContactsStorage,
+                           private EDSChangeTracker::RevisionsReader
 {
   public:
-    EDSContactsStorage(const std::string&);
+    /*!
+     * @brief Constructor
+     * @param [in] db name of EDS's source to use
+     * @param [in] batchSize maximal number of contacts queried at once by getContacts
+     * @param [in] directRead if true, contacts are read directly from backend database
+     * @param [in] writeBatchSize maximal number of contacts written at once by addContacts and modifyContacts
+     */
+    EDSContactsStorage(const std::string& db,
+                       unsigned int batchSize = 100,
+                       bool directRead = false,
+                       unsigned int writeBatchSize = 100);
 
     ~EDSContactsStorage();
 
@@ -88,12 +105,64 @@ class EDSContactsStorage : public OpenAB_Storage::ContactsStorage
 
   private:
     OpenAB::PIMItem::Revision getRevision(const OpenAB::PIMItem::ID& id);
+    /*!
+     * @brief Converts contact received from EDS to OpenAB::PIMContactItem.
+     * @param [in] contact contact to be converted.
+     * @param [in] id id of contact.
+     * @return new item, ownership is passed to caller.
+     */
+    OpenAB::PIMContactItem* toContactItem(EContact* contact,
+                                          const OpenAB::PIMItem::ID& id);
+    /*!
+     * @brief Gets revisions of contacts using batched queries limited to UID and REV fields.
+     * @param [in] ids ids of contacts.
+     * @return revisions in the same order as ids (empty for contacts that were not found).
+     */
     OpenAB::PIMItem::Revisions getRevisions(const OpenAB::PIMItem::IDs& ids);
+    /*!
+     * @brief Builds query matching contacts with given ids.
+     * @param [in] ids ids of contacts.
+     * @param [in] start index of first id to be matched.
+     * @param [in] end index after last id to be matched.
+     * @return query in EDS s-expression format.
+     */
+    static std::string idsQuery(const OpenAB::PIMItem::IDs& ids,
+                                unsigned int start,
+                                unsigned int end);
+    /*!
+     * @brief Gets revisions of all contacts matching query using book view limited to UID and REV fields.
+     * @param [in] query query in EDS s-expression format.
+     * @param [out] revisions revisions of matching contacts mapped by their ids.
+     * @return true if query was completed successfully, false otherwise.
+     */
+    bool queryRevisions(const std::string& query,
+                        std::map<std::string, std::string>& revisions);
+    /*!
+     * @brief Provides current revisions of all items to change tracker.
+     */
+    bool readRevisions(EDSChangeTracker::Revisions& revisions);
+    /*!
+     * @brief Writes contacts batch by batch using asynchronous calls,
+     * next batch is converted by converter while previous one is written.
+     * @param [in] converter converter of contacts to be written.
+     * @param [out] newIds if not NULL contacts are added and ids of new contacts are appended to it,
+     * otherwise contacts are modified.
+     * @return true if all contacts were written, false otherwise
+     * (batches written before failure are not reverted, ids of contacts added by them are still appended to newIds).
+     */
+    bool writeContacts(EDSContactsBatchConverter& converter,
+                       OpenAB::PIMItem::IDs* newIds);
     std::string       database;
+    unsigned int      getBatchSize;
+    unsigned int      writeBatchSize;
     ESourceRegistry * registry;
     ESource         * source;
+    bool              directRead;
     EBookClient     * client;
+    /*client used for bulk reads, direct read client or the same as client*/
+    EBookClient     * readClient;
     EDSContactsStorageItemIterator* contactsIterator;
+    EDSChangeTracker  changeTracker;
 };
 
 #endif /* OpenAB_PLUGIN_EDS_CONTACTS_HPP_ */
@@ -7,14 +7,24 @@
  * @file EDSContactsStorageItemIterator.cpp
  */
 
-#include <PIMItem/Contact/PIMContactItem.hpp>
 #include "EDSContactsStorageItemIterator.hpp"
+#include <string.h>
+
+/*limits of number of contacts fetched at once*/
+#define PAGE_SIZE_MIN     50
+#define PAGE_SIZE_MAX     1000
+#define PAGE_SIZE_INITIAL 200
+/*approximate amount of vCard data fetched at once, used to adjust page size*/
+#define PAGE_DATA_SIZE    (512 * 1024)
 
 EDSContactsStorageItemIterator::EDSContactsStorageItemIterator()
 :StorageItemIterator()
 ,cursor(NULL)
-,contacts(NULL)
 ,total(0)
+,pageSize(PAGE_SIZE_INITIAL)
+,pages(1)
+,currentPage(NULL)
+,prefetchThreadStarted(false)
 {
   LOG_FUNC();
   elem.item = NULL;
@@ -23,7 +33,20 @@ EDSContactsStorageItemIterator::EDSContactsStorageItemIterator()
 EDSContactsStorageItemIterator::~EDSContactsStorageItemIterator()
 {
   LOG_FUNC();
-  FREE_CONTACTS(contacts);
+  //wake up prefetch thread blocked on full queue, it will stop before touching cursor again
+  pages.close();
+  if (prefetchThreadStarted)
+  {
+    pthread_join(prefetchThread, NULL);
+  }
+
+  Page* page = NULL;
+  while (pages.pop(page))
+  {
+    freePage(page);
+  }
+  freePage(currentPage);
+
   if (NULL != cursor)
     g_object_unref(cursor);
 }
@@ -51,88 +74,135 @@ enum EDSContactsStorageItemIterator::eCursorInit EDSContactsStorageItemIterator:
 
   GERROR_FREE(gerror);
 
+  //from now on cursor is used only by prefetch thread
+  if (0 != pthread_create(&prefetchThread, NULL, prefetchThreadFuncWrapper, this))
+  {
+    LOG_ERROR() << "Cannot create prefetch thread"<<std::endl;
+    return eCursorInitFail;
+  }
+  prefetchThreadStarted = true;
+
   return eCursorInitOK;
 }
 
 OpenAB_Storage::StorageItem* EDSContactsStorageItemIterator::next()
 {
-  GError * gerror   = NULL;
-
-  static GSList * cont = NULL;
-  if (NULL == cont)
+  while (NULL == currentPage || currentPage->position >= currentPage->items.size())
   {
-    if (eFetchContactsOK != fetchContacts(1000))
+    freePage(currentPage);
+    currentPage = NULL;
+    if (!pages.pop(currentPage))
     {
       return NULL;
     }
-    cont = contacts;
   }
 
-  EContact *data = static_cast<EContact *>(cont->data);
-  char * vcard = e_vcard_to_string (E_VCARD (data), EVC_FORMAT_VCARD_30);
-  const char * id   = (const char *)e_contact_get_const(data,E_CONTACT_UID);
-  const char * rev  = (const char *)e_contact_get_const(data,E_CONTACT_REV);
-
-  elem.id = id;
-  OpenAB::PIMContactItem* newItem = new OpenAB::PIMContactItem();
-  newItem->parse(vcard);
-  newItem->setId(id);
-  newItem->setRevision(rev);
+  OpenAB::PIMContactItem* newItem = currentPage->items[currentPage->position++];
+  elem.id = newItem->getId();
   elem.item = newItem;
 
-  g_free(vcard);
-
-  cont = cont->next;
-
-  GERROR_FREE(gerror);
   return &elem;
 }
 
-enum EDSContactsStorageItemIterator::eFetchContacts EDSContactsStorageItemIterator::fetchContacts(int fetchsize)
+void* EDSContactsStorageItemIterator::prefetchThreadFuncWrapper(void* ptr)
 {
-  GError * gerror   = NULL;
-
-  FREE_CONTACTS(contacts);
-
-  LOG_VERBOSE() << "Cursor Position: " << e_book_client_cursor_get_position(cursor)<<std::endl;
+  EDSContactsStorageItemIterator* iterator = static_cast<EDSContactsStorageItemIterator*>(ptr);
+  iterator->prefetchThreadFunc();
+  return NULL;
+}
 
-  if (e_book_client_cursor_get_position(cursor) > total){
-    FREE_CONTACTS(contacts);
-    return eFetchContactsEND;
+void EDSContactsStorageItemIterator::prefetchThreadFunc()
+{
+  Page* page = NULL;
+  while (eFetchContactsOK == fetchContacts(page))
+  {
+    if (!pages.push(page))
+    {
+      //iterator is being destroyed
+      freePage(page);
+      return;
+    }
   }
+  pages.close();
+}
+
+enum EDSContactsStorageItemIterator::eFetchContacts EDSContactsStorageItemIterator::fetchContacts(Page*& page)
+{
+  GError * gerror   = NULL;
+  GSList * contacts = NULL;
 
+  //fetch contacts and move cursor behind them in single step
   int num = e_book_client_cursor_step_sync(cursor,
-                                           E_BOOK_CURSOR_STEP_FETCH ,
+                                           (EBookCursorStepFlags)(E_BOOK_CURSOR_STEP_MOVE | E_BOOK_CURSOR_STEP_FETCH),
                                            E_BOOK_CURSOR_ORIGIN_CURRENT,
-                                           fetchsize, &contacts, NULL, &gerror);
+                                           pageSize, &contacts, NULL, &gerror);
   if (-1 == num){
     LOG_ERROR() << "Error e_book_client_cursor_step_sync results: " << GERROR_MESSAGE(gerror)<<std::endl ;
     GERROR_FREE(gerror);
     FREE_CONTACTS(contacts);
     return eFetchContactsFail;
   }
-  if (0 == num){
-    GERROR_FREE(gerror);
+  GERROR_FREE(gerror);
+  if (0 == num || NULL == contacts){
     FREE_CONTACTS(contacts);
     return eFetchContactsEND;
   }
 
-  GERROR_FREE(gerror);
-  e_book_client_cursor_step_sync(cursor,
-                                 E_BOOK_CURSOR_STEP_MOVE,
-                                 E_BOOK_CURSOR_ORIGIN_CURRENT,
-                                 fetchsize, NULL, NULL,
-                                 &gerror);
-  if (NULL != gerror){
-    LOG_ERROR() << "Error e_book_client_cursor_step_sync results: " << GERROR_MESSAGE(gerror) <<std::endl;
-    GERROR_FREE(gerror);
-    FREE_CONTACTS(contacts);
-    return eFetchContactsFail;
+  page = new Page();
+  page->position = 0;
+  size_t dataSize = 0;
+
+  for (GSList* it = contacts; it != NULL; it = it->next)
+  {
+    EContact *data = static_cast<EContact *>(it->data);
+    char * vcard = e_vcard_to_string (E_VCARD (data), EVC_FORMAT_VCARD_30);
+    const char * id   = (const char *)e_contact_get_const(data,E_CONTACT_UID);
+    const char * rev  = (const char *)e_contact_get_const(data,E_CONTACT_REV);
+
+    OpenAB::PIMContactItem* newItem = new OpenAB::PIMContactItem();
+    newItem->parse(vcard);
+    newItem->setId(id ? id : "");
+    newItem->setRevision(rev ? rev : "");
+    page->items.push_back(newItem);
+
+    dataSize += strlen(vcard);
+    g_free(vcard);
   }
-  GERROR_FREE(gerror);
+  FREE_CONTACTS(contacts);
+
+  //adjust size of next page, so it will hold about PAGE_DATA_SIZE of data
+  size_t averageSize = dataSize / page->items.size();
+  if (averageSize == 0)
+  {
+    averageSize = 1;
+  }
+  pageSize = PAGE_DATA_SIZE / averageSize;
+  if (pageSize < PAGE_SIZE_MIN)
+  {
+    pageSize = PAGE_SIZE_MIN;
+  }
+  else if (pageSize > PAGE_SIZE_MAX)
+  {
+    pageSize = PAGE_SIZE_MAX;
+  }
+  LOG_VERBOSE() << "Fetched "<<num<<" contacts, next page size: " << pageSize<<std::endl;
+
   return eFetchContactsOK;
 }
 
+void EDSContactsStorageItemIterator::freePage(Page* page)
+{
+  if (NULL == page)
+  {
+    return;
+  }
+  for (size_t i = page->position; i < page->items.size(); ++i)
+  {
+    delete page->items[i];
+  }
+  delete page;
+}
+
 
 OpenAB_Storage::StorageItem EDSContactsStorageItemIterator::operator*()
 {
@@ -11,9 +11,17 @@
 #define EDSCONTACTSSTORAGEITEMITERATOR_HPP_
 
 #include <plugin/storage/StorageItem.hpp>
+#include <PIMItem/Contact/PIMContactItem.hpp>
+#include <helpers/BoundedQueue.hpp>
+#include <pthread.h>
+#include <vector>
 #include "OpenAB_eds_global.h"
 /*!
- * @brief Documentation for class EDSStorageItemIterator
+ * @brief Iterates over all contacts of EDS address book using cursor.
+ *
+ * Pages of contacts are fetched and converted to PIMContactItem by background thread,
+ * so next page is already prepared while current one is consumed.
+ * Size of page is adjusted to size of contacts, so every page holds about the same amount of data.
  */
 class EDSContactsStorageItemIterator : public OpenAB_Storage::StorageItemIterator
 {
@@ -52,17 +60,46 @@ class EDSContactsStorageItemIterator : public OpenAB_Storage::StorageItemIterato
      */
     EDSContactsStorageItemIterator& operator=(EDSContactsStorageItemIterator const &other);
 
+    /*!
+     * @brief Page of contacts converted to items, with ids and revisions already set.
+     */
+    struct Page
+    {
+      std::vector<OpenAB::PIMContactItem*> items;
+      /*index of next item to be returned*/
+      size_t position;
+    };
+
+    static void* prefetchThreadFuncWrapper(void* ptr);
+    void prefetchThreadFunc();
+
     enum eFetchContacts {
       eFetchContactsOK,
       eFetchContactsEND,
       eFetchContactsFail
     };
-    enum eFetchContacts fetchContacts(int fetchsize);
+    /*!
+     * @brief Fetches next page of contacts and moves cursor behind it.
+     * @param [out] page fetched page, ownership is passed to caller.
+     * @return eFetchContactsOK if page was fetched, eFetchContactsEND if there are no more contacts.
+     */
+    enum eFetchContacts fetchContacts(Page*& page);
+
+    /*!
+     * @brief Frees page together with items that were not returned yet.
+     */
+    static void freePage(Page* page);
 
     OpenAB_Storage::StorageItem    elem;
     EBookClientCursor *         cursor;
-    GSList *                    contacts;
     int                         total;
+    /*number of contacts requested by next fetch, used only by prefetch thread*/
+    int                         pageSize;
+    /*pages prepared by prefetch thread*/
+    OpenAB::BoundedQueue<Page*> pages;
+    Page *                      currentPage;
+    pthread_t                   prefetchThread;
+    bool                        prefetchThreadStarted;
 };
 
 #endif // EDSCONTACTSSTORAGEITEMITERATOR_HPP_
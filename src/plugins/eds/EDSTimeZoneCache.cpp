@@ -0,0 +1,78 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file EDSTimeZoneCache.cpp
+ */
+
+#include "EDSTimeZoneCache.hpp"
+
+EDSTimeZoneCache::EDSTimeZoneCache()
+{
+}
+
+EDSTimeZoneCache::~EDSTimeZoneCache()
+{
+  std::map<std::string, icalcomponent*>::iterator it;
+  for (it = components.begin(); it != components.end(); ++it)
+  {
+    if ((*it).second)
+    {
+      icalcomponent_free((*it).second);
+    }
+  }
+}
+
+icaltimezone* EDSTimeZoneCache::getTimeZone(const std::string& tzid)
+{
+  std::map<std::string, icaltimezone*>::iterator it = timeZones.find(tzid);
+  if (it == timeZones.end())
+  {
+    it = timeZones.insert(std::make_pair(tzid, icaltimezone_get_builtin_timezone(tzid.c_str()))).first;
+  }
+  return (*it).second;
+}
+
+icalcomponent* EDSTimeZoneCache::getComponent(const std::string& tzid)
+{
+  std::map<std::string, icalcomponent*>::iterator it = components.find(tzid);
+  if (it != components.end())
+  {
+    return (*it).second;
+  }
+
+  icalcomponent* vtimezone = NULL;
+  icaltimezone* tz = getTimeZone(tzid);
+  if (tz && icaltimezone_get_component(tz))
+  {
+    //use own copy, so builtin timezone stays untouched
+    vtimezone = icalcomponent_new_clone(icaltimezone_get_component(tz));
+    //builtin timezone can use different TZID than one referenced by objects
+    icalproperty* tzprop = icalcomponent_get_first_property(vtimezone, ICAL_TZID_PROPERTY);
+    if (tzprop)
+    {
+      icalproperty_set_value_from_string(tzprop, tzid.c_str(), "NO");
+    }
+  }
+  components[tzid] = vtimezone;
+  return vtimezone;
+}
+
+void EDSTimeZoneCache::findTimeZones(icalcomponent* component,
+                                     std::set<std::string>& tzids)
+{
+  icalcomponent_foreach_tzid(component, EDSTimeZoneCache::findTimeZonesCb, &tzids);
+}
+
+void EDSTimeZoneCache::findTimeZonesCb(icalparameter* param, void* data)
+{
+  const char* value = icalparameter_get_tzid(param);
+  if (NULL == data || NULL == value)
+  {
+    return;
+  }
+
+  static_cast<std::set<std::string>*>(data)->insert(value);
+}
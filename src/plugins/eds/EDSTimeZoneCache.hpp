@@ -0,0 +1,83 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file EDSTimeZoneCache.hpp
+ */
+
+#ifndef EDSTIMEZONECACHE_HPP_
+#define EDSTIMEZONECACHE_HPP_
+
+#include <string>
+#include <map>
+#include <set>
+#include <libical/ical.h>
+
+/*!
+ * @brief Caches timezones referenced by calendar objects.
+ *
+ * Objects of one calendar usually reference only a few timezones,
+ * so each TZID is resolved to builtin timezone and its VTIMEZONE component is prepared only once,
+ * instead of doing that for every processed object.
+ */
+class EDSTimeZoneCache
+{
+  public:
+    /*!
+     *  @brief Constructor.
+     */
+    EDSTimeZoneCache();
+
+    /*!
+     *  @brief Destructor, virtual by default.
+     */
+    virtual ~EDSTimeZoneCache();
+
+    /*!
+     * @brief Returns builtin timezone matching given TZID.
+     * @param [in] tzid TZID of timezone.
+     * @return builtin timezone, owned by libical, or NULL if TZID is unknown.
+     */
+    icaltimezone* getTimeZone(const std::string& tzid);
+
+    /*!
+     * @brief Returns VTIMEZONE component of timezone, with TZID property set to given TZID.
+     * @param [in] tzid TZID of timezone.
+     * @return VTIMEZONE component owned by cache, or NULL if TZID is unknown.
+     * @note component can be temporarily added to other component, but it has to be removed from it before parent is freed.
+     */
+    icalcomponent* getComponent(const std::string& tzid);
+
+    /*!
+     * @brief Finds TZIDs of all timezones referenced by component.
+     * @param [in] component component to be checked.
+     * @param [in,out] tzids set to which found TZIDs are added.
+     */
+    static void findTimeZones(icalcomponent* component,
+                              std::set<std::string>& tzids);
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    EDSTimeZoneCache(EDSTimeZoneCache const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    EDSTimeZoneCache& operator=(EDSTimeZoneCache const &other);
+
+    /*!
+     * @brief Callback function for libical that will be called
+     * for each timezone parameter found in component
+     */
+    static void findTimeZonesCb(icalparameter* param, void* data);
+
+    /*unknown TZIDs are cached as well, with NULL values*/
+    std::map<std::string, icaltimezone*>  timeZones;
+    std::map<std::string, icalcomponent*> components;
+};
+
+#endif // EDSTIMEZONECACHE_HPP_
@@ -9,33 +9,172 @@
 
 #include "plugins/file/File.hpp"
 #include <PIMItem/Contact/PIMContactItem.hpp>
+#include <plugin/source/VCardParseStage.hpp>
+#include <helpers/StringHelper.hpp>
 
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <dirent.h>
 #include <errno.h>
 #include <string.h>
+#include <algorithm>
 
-FileSource::FileSource(const std::string& f)
+/*Maximal number of vCards read ahead of getItem in parallel mode*/
+#define READ_AHEAD_VCARDS 64
+
+/*Maximal size of single file and of all files whose content is kept in memory by init in parallel mode*/
+#define MAX_KEPT_FILE_SIZE (64 * 1024)
+#define MAX_KEPT_CONTENT_SIZE (16 * 1024 * 1024)
+
+FileSource::FileSource(const std::string& f,
+                       unsigned int workers)
     : OpenAB_Source::Source(OpenAB::eContact),
       path(f),
-      totalNumberOfVCards(0)
+      workersCount(workers),
+      parseStage(NULL),
+      totalNumberOfVCards(0),
+      currentFile(0),
+      currentVCard(0),
+      currentData(NULL),
+      mappedData(NULL),
+      mappedSize(0),
+      nextScannedFile(0),
+      keptContentSize(0),
+      keepContent(false)
 {
   LOG_FUNC();
+  pthread_mutex_init(&scanMutex, NULL);
 }
 
 FileSource::~FileSource()
 {
   LOG_FUNC();
-  if (infile.is_open())
+  cleanup();
+  pthread_mutex_destroy(&scanMutex);
+}
+
+void FileSource::cleanup()
+{
+  if (NULL != parseStage)
+  {
+    //unblock reader thread, items that were not returned are freed by stage
+    parseStage->close();
+    pthread_join(readerThread, NULL);
+    delete parseStage;
+    parseStage = NULL;
+  }
+  unmapFile(mappedData, mappedSize);
+  currentData = NULL;
+  files.clear();
+  totalNumberOfVCards = 0;
+  currentFile = 0;
+  currentVCard = 0;
+}
+
+bool FileSource::mapFile(const std::string& filename,
+                         const char*& data,
+                         size_t& size)
+{
+  data = NULL;
+  size = 0;
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    LOG_ERROR() << "Cannot open file "<< filename <<": "<<strerror(errno)<<std::endl;
+    return false;
+  }
+
+  struct stat fileStat;
+  if (0 != fstat(fd, &fileStat))
+  {
+    LOG_ERROR() << "Cannot stat file "<< filename <<": "<<strerror(errno)<<std::endl;
+    close(fd);
+    return false;
+  }
+
+  //empty file cannot be mapped, but it is not an error
+  if (0 == fileStat.st_size)
+  {
+    close(fd);
+    return true;
+  }
+
+  void* mapped = mmap(NULL, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  //mapping stays valid after descriptor is closed
+  close(fd);
+  if (MAP_FAILED == mapped)
+  {
+    LOG_ERROR() << "Cannot map file "<< filename <<": "<<strerror(errno)<<std::endl;
+    return false;
+  }
+  madvise(mapped, fileStat.st_size, MADV_SEQUENTIAL);
+
+  data = static_cast<const char*>(mapped);
+  size = fileStat.st_size;
+  return true;
+}
+
+void FileSource::unmapFile(const char*& data,
+                           size_t& size)
+{
+  if (NULL != data)
+  {
+    munmap(const_cast<char*>(data), size);
+    data = NULL;
+    size = 0;
+  }
+}
+
+void FileSource::findVCards(const char* mappedData,
+                            size_t mappedSize,
+                            std::vector<VCardSpan>& vCards)
+{
+  //each line starting with END:VCARD ends vCard, which begins at last BEGIN:VCARD line
+  //after end of previous vCard (or just after previous vCard if there is no such line)
+  const char* dataEnd = mappedData + mappedSize;
+  const char* pos = mappedData;
+  while (pos < dataEnd)
   {
-    infile.close();
+    const char* vCardEnd = OpenAB::findAtLineStart(mappedData, dataEnd, pos, "END:VCARD", 9);
+    if (NULL == vCardEnd)
+    {
+      break;
+    }
+
+    const char* vCardBegin = pos;
+    const char* begin = pos;
+    while (NULL != (begin = OpenAB::findAtLineStart(mappedData, vCardEnd, begin, "BEGIN:VCARD", 11)))
+    {
+      vCardBegin = begin;
+      ++begin;
+    }
+
+    const char* lineEnd = static_cast<const char*>(memchr(vCardEnd, '\n', dataEnd - vCardEnd));
+    pos = (NULL == lineEnd) ? dataEnd : lineEnd + 1;
+    vCards.push_back(VCardSpan(vCardBegin - mappedData, pos - mappedData));
+  }
+}
+
+std::string FileSource::getVCard(const char* mappedData,
+                                 const VCardSpan& span)
+{
+  std::string vCard(mappedData + span.first, mappedData + span.second);
+  if ('\n' != vCard[vCard.size() - 1])
+  {
+    vCard += "\n";
   }
+  return vCard;
 }
 
 enum OpenAB_Source::Source::eInit FileSource::init()
 {
+  //source can be initialized again, e.g. by each phase of synchronization
+  cleanup();
+
   LOG_FUNC() << "Checking whether "<< path <<" is file or directory"<<std::endl;
   struct stat fileStat;
   if (0 != stat(path.c_str(), &fileStat))
@@ -44,7 +183,9 @@ enum OpenAB_Source::Source::eInit FileSource::init()
     return eInitFail;
   }
 
-  if (S_ISDIR(fileStat.st_mode))
+  std::vector<std::string> filenames;
+  bool isDirectory = S_ISDIR(fileStat.st_mode);
+  if (isDirectory)
   {
     LOG_DEBUG() << path <<" is a directory"<<std::endl;
     DIR* dir;
@@ -59,9 +200,12 @@ enum OpenAB_Source::Source::eInit FileSource::init()
     while ((dirEntry = readdir(dir)) != NULL)
     {
       std::string entryFullPath = path + "/" + dirEntry->d_name;
-      lstat(entryFullPath.c_str(), &fileStat);
-
-      if (S_ISDIR(fileStat.st_mode))
+      //type of entry is usually known without calling lstat
+      if (DT_DIR == dirEntry->d_type)
+        continue;
+      if (DT_UNKNOWN == dirEntry->d_type &&
+          0 == lstat(entryFullPath.c_str(), &fileStat) &&
+          S_ISDIR(fileStat.st_mode))
         continue;
 
       LOG_DEBUG() << "directory entry: " <<entryFullPath<<std::endl;
@@ -69,6 +213,7 @@ enum OpenAB_Source::Source::eInit FileSource::init()
       filenames.push_back(entryFullPath);
     }
     closedir(dir);
+    std::sort(filenames.begin(), filenames.end());
   }
   else
   {
@@ -77,110 +222,244 @@ enum OpenAB_Source::Source::eInit FileSource::init()
   }
 
   LOG_DEBUG() << "In total "<< (int)filenames.size() <<" files will be processed"<<std::endl;
-  LOG_DEBUG() << "Checking number of vCards in files"<<std::endl;
 
-  std::vector<std::string>::iterator it;
-  for(it = filenames.begin(); it != filenames.end();)
+  LOG_DEBUG() << "Looking for vCards in files"<<std::endl;
+
+  //positions of vCards are found in single pass over mapped files, so getItem does not need to scan them again.
+  //In parallel mode files are scanned by workers and content of small files is kept,
+  //so reader thread does not need to open them again
+  bool parallel = isDirectory && workersCount > 0;
+  files.resize(filenames.size());
+  for (size_t i = 0; i < filenames.size(); ++i)
   {
-    LOG_DEBUG() << "Checking "<< (*it) <<std::endl;
-    std::string line;
-    bool anyVCard = false;
+    files[i].name = filenames[i];
+  }
+  nextScannedFile = 0;
+  keptContentSize = 0;
+  keepContent = parallel;
 
-    infile.open((*it).c_str(), std::ifstream::in);
-    if(!infile.is_open())
-    {
-      LOG_ERROR() << "Cannot open file "<< (*it) <<std::endl;
-      it = filenames.erase(it);
-      continue;
-    }
-    //go through all files and count number of lines containing END:VCARD
-    //it may be not 100% correct but will be quicker
-    while (std::getline(infile, line))
+  std::vector<pthread_t> scanThreads;
+  size_t scanThreadsCount = parallel ? std::min((size_t)workersCount, files.size()) : 1;
+  //calling thread scans files too
+  for (size_t i = 1; i < scanThreadsCount; ++i)
+  {
+    pthread_t thread;
+    if (0 != pthread_create(&thread, NULL, scanFuncWrapper, this))
     {
-      if (0 == line.compare(0, 9, "END:VCARD"))
-      {
-        totalNumberOfVCards++;
-        anyVCard = true;
-      }
+      LOG_ERROR()<<"Cannot create scanning thread"<<std::endl;
+      break;
     }
+    scanThreads.push_back(thread);
+  }
+  scanFunc();
+  for (size_t i = 0; i < scanThreads.size(); ++i)
+  {
+    pthread_join(scanThreads[i], NULL);
+  }
 
-    infile.close();
-
-    //if file does not contain any vCard exclude it from list
-    if(!anyVCard)
+  //files without any vCard (or which could not be read) are excluded from list
+  size_t filesWithVCards = 0;
+  for (size_t i = 0; i < files.size(); ++i)
+  {
+    if (files[i].vCards.empty())
     {
-      it = filenames.erase(it);
+      continue;
     }
-    else
+    totalNumberOfVCards += files[i].vCards.size();
+    if (i != filesWithVCards)
     {
-      ++it;
+      files[filesWithVCards].name.swap(files[i].name);
+      files[filesWithVCards].vCards.swap(files[i].vCards);
+      files[filesWithVCards].content.swap(files[i].content);
     }
+    ++filesWithVCards;
   }
-  if (filenames.empty())
+  files.resize(filesWithVCards);
+
+  currentFile = 0;
+  currentVCard = 0;
+  if (files.empty())
   {
     LOG_ERROR()<<"No vcards were found"<<std::endl;
-    currentFile = filenames.end();
     return eInitFail;
   }
-  else
+
+  if (parallel)
   {
-    currentFile = filenames.begin();
-    infile.open((*currentFile).c_str(), std::ifstream::in);
+    //vCards are read by reader thread and parsed by workers of parse stage,
+    //which returns them in the same order as they would be returned in sequential mode
+    LOG_DEBUG() << "Parsing vCards using "<<workersCount<<" workers"<<std::endl;
+    parseStage = new OpenAB_Source::VCardParseStage(workersCount, READ_AHEAD_VCARDS);
+    if (0 != pthread_create(&readerThread, NULL, readerFuncWrapper, this))
+    {
+      LOG_ERROR()<<"Cannot create reader thread"<<std::endl;
+      delete parseStage;
+      parseStage = NULL;
+      return eInitFail;
+    }
   }
 
   return eInitOk;
 }
 
-enum OpenAB_Source::Source::eGetItemRet FileSource::getItem(OpenAB::SmartPtr<OpenAB::PIMItem> & item)
+bool FileSource::readNextVCard(std::string*& vCard)
 {
-  LOG_FUNC();
-  std::string line;
-  std::string vCard;
-  std::vector<std::string>::iterator it;
+  vCard = NULL;
+  while (currentFile < files.size() &&
+         currentVCard >= files[currentFile].vCards.size())
+  {
+    unmapFile(mappedData, mappedSize);
+    currentData = NULL;
+    currentVCard = 0;
+    ++currentFile;
+  }
 
-  if (currentFile == filenames.end())
-      return eGetItemRetEnd;
+  if (currentFile >= files.size())
+  {
+    return false;
+  }
+
+  if (NULL == currentData && !openCurrentFile())
+  {
+    //file was removed or truncated since init, all its vCards are skipped
+    LOG_DEBUG()<<"Cannot read file "<<files[currentFile].name<<std::endl;
+    currentVCard = files[currentFile].vCards.size();
+    return true;
+  }
+
+  const VCardSpan& span = files[currentFile].vCards[currentVCard];
+  ++currentVCard;
+  vCard = new std::string(getVCard(currentData, span));
+  return true;
+}
+
+bool FileSource::openCurrentFile()
+{
+  const VCardFile& file = files[currentFile];
+  if (!file.content.empty())
+  {
+    currentData = file.content.data();
+    return true;
+  }
+
+  if (!mapFile(file.name, mappedData, mappedSize) ||
+      mappedSize < file.vCards.back().second)
+  {
+    unmapFile(mappedData, mappedSize);
+    return false;
+  }
+  currentData = mappedData;
+  return true;
+}
+
+void* FileSource::scanFuncWrapper(void* ptr)
+{
+  FileSource* source = static_cast<FileSource*>(ptr);
+  source->scanFunc();
+  return NULL;
+}
 
-  while (std::getline(infile, line))
+void FileSource::scanFunc()
+{
+  while (true)
   {
-    // LOG_DEBUG() << line;
-    vCard+=line + "\n";
-    if (0 == line.compare(0, 11, "BEGIN:VCARD"))
+    pthread_mutex_lock(&scanMutex);
+    size_t index = nextScannedFile++;
+    pthread_mutex_unlock(&scanMutex);
+    if (index >= files.size())
+    {
+      break;
+    }
+
+    //each thread modifies only its own entries of files, which is not resized until all threads finish
+    VCardFile& file = files[index];
+    LOG_DEBUG() << "Checking "<< file.name <<std::endl;
+    const char* data = NULL;
+    size_t size = 0;
+    if (!mapFile(file.name, data, size))
     {
-      vCard.clear();
-      vCard+=line + "\n";
+      continue;
     }
-    else if (0 == line.compare(0, 9, "END:VCARD")){
-      OpenAB::PIMContactItem * newContactItem = new OpenAB::PIMContactItem();
-      if (newContactItem->parse(vCard))
+    findVCards(data, size, file.vCards);
+
+    if (keepContent && !file.vCards.empty() && size <= MAX_KEPT_FILE_SIZE)
+    {
+      pthread_mutex_lock(&scanMutex);
+      bool keep = (keptContentSize + size <= MAX_KEPT_CONTENT_SIZE);
+      if (keep)
       {
-        item = newContactItem;
-        return eGetItemRetOk;
+        keptContentSize += size;
       }
-      else
+      pthread_mutex_unlock(&scanMutex);
+      if (keep)
       {
-        delete newContactItem;
-        return eGetItemRetError;
+        file.content.assign(data, size);
       }
     }
+    unmapFile(data, size);
   }
-  infile.close();
-  vCard.clear();
-  ++currentFile;
+}
+
+void* FileSource::readerFuncWrapper(void* ptr)
+{
+  FileSource* source = static_cast<FileSource*>(ptr);
+  source->readerFunc();
+  return NULL;
+}
 
-  if (currentFile == filenames.end())
+void FileSource::readerFunc()
+{
+  std::string* vCard = NULL;
+  while (readNextVCard(vCard))
   {
-    return eGetItemRetEnd;
+    //stage is closed when source is destroyed
+    if (!parseStage->push(vCard))
+    {
+      break;
+    }
   }
+  parseStage->close();
+}
+
+enum OpenAB_Source::Source::eGetItemRet FileSource::getItem(OpenAB::SmartPtr<OpenAB::PIMItem> & item)
+{
+  LOG_FUNC();
 
-  infile.open((*currentFile).c_str(), std::ifstream::in);
-  if (!infile.is_open())
+  if (NULL != parseStage)
+  {
+    OpenAB::PIMContactItem * newContactItem = NULL;
+    if (!parseStage->pop(newContactItem))
+    {
+      return eGetItemRetEnd;
+    }
+    if (NULL == newContactItem)
+    {
+      return eGetItemRetError;
+    }
+    item = newContactItem;
+    return eGetItemRetOk;
+  }
+
+  std::string* vCard = NULL;
+  if (!readNextVCard(vCard))
+  {
+    return eGetItemRetEnd;
+  }
+  if (NULL == vCard)
   {
-    LOG_DEBUG()<<"Cannot open file "<<(*currentFile).c_str()<<std::endl;
-    ++currentFile;
     return eGetItemRetError;
   }
-  return getItem(item);
+
+  OpenAB::PIMContactItem * newContactItem = new OpenAB::PIMContactItem();
+  bool parsed = newContactItem->parse(*vCard);
+  delete vCard;
+  if (parsed)
+  {
+    item = newContactItem;
+    return eGetItemRetOk;
+  }
+  delete newContactItem;
+  return eGetItemRetError;
 }
 
 enum OpenAB_Source::Source::eSuspendRet FileSource::suspend()
@@ -229,7 +508,15 @@ class FileFactory : OpenAB_Source::Factory
         return NULL;
       }
 
-      FileSource * fi =new FileSource(param.getString());
+      std::string filename = param.getString();
+      unsigned int workers = 0;
+
+      param = params.getValue("workers");
+      if (!param.invalid() && param.getInt() > 0){
+        workers = param.getInt();
+      }
+
+      FileSource * fi =new FileSource(filename, workers);
       if (NULL == fi)
       {
         LOG_ERROR() << "Cannot Initialize FileInput";
@@ -11,8 +11,13 @@
 #define FILE_HPP_
 
 #include <plugin/source/Source.hpp>
-#include <fstream>
-#include <iostream>
+#include <vector>
+#include <utility>
+#include <pthread.h>
+
+namespace OpenAB_Source {
+class VCardParseStage;
+}
 
 /**
  * @defgroup FileSource File Source Plugin
@@ -28,6 +33,11 @@
  * |:--------------|:     |: ----------------------------|:           |
  * | String | "filename"     | Path to the file or directory containing vCards | Yes |
  * | Bool   | "count_vcards" | Any value, if provided number of vCards will be counted, so OpenAB_Sync::Sync progress will be available, but it make OpenAB_Source::Source initialization process slower| No |
+ * | Integer| "workers"      | Number of threads parsing vCards in parallel when "filename" is a directory, vCards are then read from files by separate thread ahead of getItem. By default vCards are read and parsed one by one in getItem | No |
+ *
+ * Files of directory are always processed in order of their names.
+ * In parallel mode files are also scanned for vCards by "workers" threads during initialization,
+ * contents of small files are kept in memory then, so they are not read again by getItem.
  *
  * @todo implement support for count_vcards parameter
  */
@@ -40,8 +50,11 @@ class FileSource : public OpenAB_Source::Source
   public:
     /*!
      *  @brief Constructor.
+     *  @param [in] f path to file or directory containing vCards.
+     *  @param [in] workers number of threads used to parse vCards of directory, 0 to parse them one by one.
      */
-    FileSource(const std::string& f);
+    FileSource(const std::string& f,
+               unsigned int workers = 0);
 
     /*!
      *  @brief Destructor, virtual by default.
@@ -60,6 +73,46 @@ class FileSource : public OpenAB_Source::Source
 
     int getTotalCount() const;
 
+    /*!
+     * @brief Offsets of beginning and end of single vCard in file.
+     */
+    typedef std::pair<size_t, size_t> VCardSpan;
+
+    /*!
+     * @brief Maps whole file into memory.
+     * @param [in] filename file to be mapped.
+     * @param [out] data mapped content of file, NULL if file is empty.
+     * @param [out] size size of file.
+     * @return true if file was mapped, false otherwise.
+     */
+    static bool mapFile(const std::string& filename,
+                        const char*& data,
+                        size_t& size);
+
+    /*!
+     * @brief Unmaps file mapped with @ref mapFile, data and size are cleared.
+     */
+    static void unmapFile(const char*& data,
+                          size_t& size);
+
+    /*!
+     * @brief Finds positions of all vCards in mapped file.
+     * @param [in] mappedData mapped content of file.
+     * @param [in] mappedSize size of file.
+     * @param [out] vCards found vCards.
+     */
+    static void findVCards(const char* mappedData,
+                           size_t mappedSize,
+                           std::vector<VCardSpan>& vCards);
+
+    /*!
+     * @brief Returns copy of vCard from mapped file, terminated with new line.
+     * @param [in] mappedData mapped content of file.
+     * @param [in] span position of vCard.
+     */
+    static std::string getVCard(const char* mappedData,
+                                const VCardSpan& span);
+
   private:
     /*!
      *  @brief Copy constructor, private unimplemented to prevent misuse.
@@ -71,11 +124,64 @@ class FileSource : public OpenAB_Source::Source
      */
     FileSource& operator=(FileSource const &other);
 
+    /*!
+     * @brief Reads next vCard from files found by init.
+     * @param [out] vCard read vCard, ownership is passed to caller, NULL if file cannot be read anymore.
+     * @return true if vCard was read, false if all vCards were already read.
+     */
+    bool readNextVCard(std::string*& vCard);
+
+    /*!
+     * @brief Makes content of current file available in currentData.
+     * @return false if file was removed or truncated since init.
+     */
+    bool openCurrentFile();
+
+    /*!
+     * @brief Stops reader thread and forgets all files found by previous init.
+     */
+    void cleanup();
+
+    static void* readerFuncWrapper(void* ptr);
+    void readerFunc();
+
+    static void* scanFuncWrapper(void* ptr);
+    /*!
+     * @brief Finds vCards in files not scanned yet by other scanning threads.
+     */
+    void scanFunc();
+
+    /*!
+     * @brief File containing vCards, together with positions of all vCards in it.
+     */
+    struct VCardFile
+    {
+      std::string name;
+      std::vector<VCardSpan> vCards;
+      /*Content of file read during init, empty if file has to be mapped again*/
+      std::string content;
+    };
+
     std::string path;
-    std::ifstream infile;
-    std::vector<std::string> filenames;
+    unsigned int workersCount;
+    /*Parses vCards pushed by reader thread in parallel mode, NULL otherwise*/
+    OpenAB_Source::VCardParseStage* parseStage;
+    pthread_t readerThread;
+    std::vector<VCardFile> files;
     int totalNumberOfVCards;
-    std::vector<std::string>::iterator currentFile;
+    size_t currentFile;
+    size_t currentVCard;
+    /*Content of currently read file, NULL if it was not opened yet*/
+    const char* currentData;
+    /*Currently read file if its content is not kept in memory, mapped until all its vCards are returned*/
+    const char* mappedData;
+    size_t mappedSize;
+
+    /*Protects position of scanning threads and amount of kept content during init*/
+    pthread_mutex_t scanMutex;
+    size_t nextScannedFile;
+    size_t keptContentSize;
+    bool keepContent;
 };
 
 #endif // FILE_HPP_
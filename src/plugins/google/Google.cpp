@@ -37,6 +37,7 @@ GoogleSource::GoogleSource(const std::string& login,
       service(NULL),
       cancellable(NULL),
       totalNumber(0),
+      bufferedVCards(QUERY_SIZE),
       threadCreated(false),
       paused(false),
       cancelled(false)
@@ -60,6 +61,7 @@ GoogleSource::GoogleSource(const std::string& clientId,
       service(NULL),
       cancellable(NULL),
       totalNumber(0),
+      bufferedVCards(QUERY_SIZE),
       threadCreated(false),
       paused(false),
       cancelled(false)
@@ -91,18 +93,18 @@ void GoogleSource::construct(const std::string& ignoreFields)
   }
 
   pthread_mutex_init(&mutex, NULL);
-  pthread_cond_init(&bufferReadyCond, NULL);
 }
 
 GoogleSource::~GoogleSource()
 {
   cancelled = true;
-  pthread_mutex_destroy(&mutex);
-  pthread_cond_destroy(&bufferReadyCond);
+  //wake up download thread if it is waiting for free space in buffer
+  bufferedVCards.close();
   if (threadCreated)
   {
     pthread_join(downloadThread, NULL);
   }
+  pthread_mutex_destroy(&mutex);
   cleanup();
 
   clientSecret.clear();
@@ -205,7 +207,7 @@ enum OpenAB_Source::Source::eInit GoogleSource::init()
 
   cancellable = g_cancellable_new();
 
-  bufferedVCards.clear();
+  bufferedVCards.reset();
   totalNumber = 0;
   paused = false;
   cancelled = false;
@@ -241,38 +243,24 @@ enum OpenAB_Source::Source::eGetItemRet GoogleSource::getItem(OpenAB::SmartPtr<O
 {
   std::string vCard;
 
-  pthread_mutex_lock(&mutex);
+  if (eGetItemRetError == transferStatus)
+  {
+    LOG_DEBUG() << "Download error" << std::endl;
+    return eGetItemRetError;
+  }
 
-  if (bufferedVCards.empty())
+  //wait for new vCards, buffer is closed by download thread when it finishes
+  if (!bufferedVCards.pop(vCard))
   {
-    if (eGetItemRetEnd == transferStatus)
+    if (eGetItemRetError == transferStatus)
     {
-      //if buffer is empty and transfer status is end, process finished
-      pthread_mutex_unlock(&mutex);
-      return eGetItemRetEnd;
+      LOG_DEBUG() << "Download error" << std::endl;
+      return eGetItemRetError;
     }
-    //otherwise wait for new vCards
-    pthread_cond_wait(&bufferReadyCond, &mutex);
-  }
-  //check after being wake up, if there was some new contacts added
-  if (eGetItemRetEnd == transferStatus && bufferedVCards.empty())
-  {
     LOG_DEBUG() << "Download end" << std::endl;
-    pthread_mutex_unlock(&mutex);
     return eGetItemRetEnd;
   }
 
-  if (eGetItemRetError == transferStatus)
-  {
-    LOG_DEBUG() << "Download error" << std::endl;
-    pthread_mutex_unlock(&mutex);
-    return eGetItemRetError;
-  }
-
-  vCard = bufferedVCards.front();
-  bufferedVCards.pop_front();
-  pthread_mutex_unlock(&mutex);
-
   OpenAB::PIMContactItem *newContactItem = new OpenAB::PIMContactItem();
   if (newContactItem->parse(vCard))
   {
@@ -310,6 +298,7 @@ enum OpenAB_Source::Source::eCancelRet GoogleSource::cancel()
   pthread_mutex_lock(&mutex);
   cancelled = true;
   pthread_mutex_unlock(&mutex);
+  bufferedVCards.close();
 
   if (NULL != cancellable)
   {
@@ -356,9 +345,7 @@ void* GoogleSource::downloadThreadFunc(void* ptr)
     if (source.cancelled)
     {
       //if we are cancelled, wake up thread waiting for new vCards
-      pthread_mutex_lock(&source.mutex);
-      pthread_cond_signal(&source.bufferReadyCond);
-      pthread_mutex_unlock(&source.mutex);
+      source.bufferedVCards.close();
       return NULL;
     }
 
@@ -369,9 +356,7 @@ void* GoogleSource::downloadThreadFunc(void* ptr)
     {
       source.transferStatus = eGetItemRetError;
       LOG_ERROR() << "Cannot create query" << std::endl;
-      pthread_mutex_lock(&source.mutex);
-      pthread_cond_signal(&source.bufferReadyCond);
-      pthread_mutex_unlock(&source.mutex);
+      source.bufferedVCards.close();
       return NULL;
     }
 
@@ -395,9 +380,7 @@ void* GoogleSource::downloadThreadFunc(void* ptr)
       LOG_ERROR() << "Cannot query contacts " << GERROR_MESSAGE(gerror) << std::endl;
       source.transferStatus = eGetItemRetError;
       GERROR_FREE(gerror);
-      pthread_mutex_lock(&source.mutex);
-      pthread_cond_signal(&source.bufferReadyCond);
-      pthread_mutex_unlock(&source.mutex);
+      source.bufferedVCards.close();
       return NULL;
     }
 
@@ -414,9 +397,7 @@ void* GoogleSource::downloadThreadFunc(void* ptr)
       if (source.cancelled)
       {
         g_object_unref(feed);
-        pthread_mutex_lock(&source.mutex);
-        pthread_cond_signal(&source.bufferReadyCond);
-        pthread_mutex_unlock(&source.mutex);
+        source.bufferedVCards.close();
         return NULL;
       }
 
@@ -445,9 +426,7 @@ void* GoogleSource::downloadThreadFunc(void* ptr)
             source.transferStatus = eGetItemRetError;
             GERROR_FREE(gerror);
             g_object_unref(feed);
-            pthread_mutex_lock(&source.mutex);
-            pthread_cond_signal(&source.bufferReadyCond);
-            pthread_mutex_unlock(&source.mutex);
+            source.bufferedVCards.close();
             return NULL;
           }
         }
@@ -457,10 +436,12 @@ void* GoogleSource::downloadThreadFunc(void* ptr)
       //convert contact is freeing photoData and unrefing contact
       std::string vCard = source.convertContact(contact, photoData, photoDataLen, photoContentType);
 
-      pthread_mutex_lock(&source.mutex);
-      source.bufferedVCards.push_back(vCard);
-      pthread_cond_signal(&source.bufferReadyCond);
-      pthread_mutex_unlock(&source.mutex);
+      //blocks while buffer is full, fails only when source was cancelled
+      if (!source.bufferedVCards.push(vCard))
+      {
+        g_object_unref(feed);
+        return NULL;
+      }
     }
     g_object_unref(feed);
 
@@ -471,17 +452,15 @@ void* GoogleSource::downloadThreadFunc(void* ptr)
     if (numDownloaded < QUERY_SIZE)
     {
       source.transferStatus = eGetItemRetEnd;
-      pthread_cond_signal(&source.bufferReadyCond);
       numDownloaded = 0;
       pthread_mutex_unlock(&source.mutex);
+      source.bufferedVCards.close();
       return NULL;
     }
     pthread_mutex_unlock(&source.mutex);
   }
 
-  pthread_mutex_lock(&source.mutex);
-  pthread_cond_signal(&source.bufferReadyCond);
-  pthread_mutex_unlock(&source.mutex);
+  source.bufferedVCards.close();
   return NULL;
 }
 
@@ -13,6 +13,7 @@
 #include <plugin/source/Source.hpp>
 #include <gdata/gdata.h>
 #include <glib2/OpenAB_glib2_global.h>
+#include <helpers/BoundedQueue.hpp>
 #include <list>
 
 /**
@@ -127,15 +128,14 @@ class GoogleSource : public OpenAB_Source::Source
 
 
     unsigned int totalNumber;
-    //buffer of already converted vCards
-    std::list<std::string> bufferedVCards;
+    //buffer of already converted vCards, download thread is blocked when it is full
+    OpenAB::BoundedQueue<std::string> bufferedVCards;
 
     pthread_t       downloadThread;
     bool            threadCreated;
     bool            paused;
     bool            cancelled;
     pthread_mutex_t mutex;
-    pthread_cond_t  bufferReadyCond;
 };
 
 #endif // GOOGLE_H_
@@ -0,0 +1,813 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file MemoryStorage.cpp
+ */
+
+#include "MemoryStorage.hpp"
+#include <OpenAB.hpp>
+#include <helpers/FileHelper.hpp>
+#include <PIMItem/Contact/PIMContactItem.hpp>
+#include <PIMItem/Calendar/PIMCalendarItem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MEMORY_SNAPSHOT_MAGIC "OpenAB-MemorySnapshot 1"
+#define MIN_SLOTS 64
+#define DEFAULT_MAX_REMOVALS 10000
+
+MemoryStorage::MemoryStorage(OpenAB::PIMItemType t,
+                             const std::string& file,
+                             unsigned int maxRemovals) :
+    OpenAB_Storage::Storage(t),
+    snapshotFile(file),
+    snapshotLoaded(false),
+    modified(false),
+    slots(MIN_SLOTS, 0),
+    maxRemovals(maxRemovals),
+    sequence(0),
+    nextId(0),
+    readIterator(NULL)
+{
+  LOG_FUNC();
+  generation = newGeneration();
+}
+
+MemoryStorage::~MemoryStorage()
+{
+  LOG_FUNC();
+  delete readIterator;
+  if (modified)
+  {
+    saveSnapshot();
+  }
+}
+
+enum OpenAB_Source::Source::eInit MemoryStorage::init()
+{
+  LOG_FUNC();
+  if (!snapshotLoaded)
+  {
+    //missing snapshot is not an error, storage will be just empty
+    loadSnapshot();
+    snapshotLoaded = true;
+  }
+
+  delete readIterator;
+  readIterator = NULL;
+  return eInitOk;
+}
+
+enum OpenAB_Source::Source::eSuspendRet MemoryStorage::suspend()
+{
+  return eSuspendRetNotSupported;
+}
+
+enum OpenAB_Source::Source::eResumeRet MemoryStorage::resume()
+{
+  return eResumeRetNotSupported;
+}
+
+enum OpenAB_Source::Source::eCancelRet MemoryStorage::cancel()
+{
+  return eCancelRetNotSupported;
+}
+
+enum OpenAB_Source::Source::eGetItemRet MemoryStorage::getItem(OpenAB::SmartPtr<OpenAB::PIMItem> &item)
+{
+  if (NULL == readIterator)
+  {
+    OpenAB::PIMItem::IDs ids;
+    getSortedIds(ids);
+    readIterator = new MemoryStorageItemIterator(this, ids);
+  }
+
+  OpenAB_Storage::StorageItem* elem = readIterator->next();
+  if (NULL == elem)
+  {
+    return eGetItemRetEnd;
+  }
+  item = elem->item;
+  return eGetItemRetOk;
+}
+
+int MemoryStorage::getTotalCount() const
+{
+  return records.size();
+}
+
+enum OpenAB_Storage::Storage::eAddItem MemoryStorage::addItem(const OpenAB::SmartPtr<OpenAB::PIMItem>& item,
+                                                              OpenAB::PIMItem::ID & newId,
+                                                              OpenAB::PIMItem::Revision & revision)
+{
+  std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > items;
+  items.push_back(item);
+  OpenAB::PIMItem::IDs newIds;
+  OpenAB::PIMItem::Revisions revisions;
+
+  enum eAddItem res = addItems(items, newIds, revisions);
+  if (eAddItemOk == res)
+  {
+    newId = newIds.front();
+    revision = revisions.front();
+  }
+  return res;
+}
+
+enum OpenAB_Storage::Storage::eAddItem MemoryStorage::addItems(const std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items,
+                                                               OpenAB::PIMItem::IDs & newIds,
+                                                               OpenAB::PIMItem::Revisions & revisions)
+{
+  newIds.clear();
+  revisions.clear();
+
+  std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> >::const_iterator it;
+  for (it = items.begin(); it != items.end(); ++it)
+  {
+    if (!((*it).getPointer() && (*it)->getType() == getItemType()))
+    {
+      LOG_ERROR()<<"Mismatched item types"<<std::endl;
+      return eAddItemFail;
+    }
+  }
+
+  for (it = items.begin(); it != items.end(); ++it)
+  {
+    std::stringstream ss;
+    ss<<++nextId;
+
+    Record record;
+    record.id = ss.str();
+    record.hash = hashId(record.id);
+    record.changed = ++sequence;
+    record.data = (*it)->getRawData();
+    insertRecord(record);
+
+    newIds.push_back(record.id);
+    revisions.push_back(revisionString(record.changed));
+  }
+
+  modified = true;
+  return eAddItemOk;
+}
+
+enum OpenAB_Storage::Storage::eModifyItem MemoryStorage::modifyItem(const OpenAB::SmartPtr<OpenAB::PIMItem>& item,
+                                                                    const OpenAB::PIMItem::ID & id,
+                                                                    OpenAB::PIMItem::Revision & revision)
+{
+  std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > items;
+  items.push_back(item);
+  OpenAB::PIMItem::IDs ids;
+  ids.push_back(id);
+  OpenAB::PIMItem::Revisions revisions;
+
+  enum eModifyItem res = modifyItems(items, ids, revisions);
+  if (eModifyItemOk == res)
+  {
+    revision = revisions.front();
+  }
+  return res;
+}
+
+enum OpenAB_Storage::Storage::eModifyItem MemoryStorage::modifyItems(const std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items,
+                                                                     const OpenAB::PIMItem::IDs & ids,
+                                                                     OpenAB::PIMItem::Revisions & revisions)
+{
+  revisions.clear();
+  if (items.size() != ids.size())
+  {
+    return eModifyItemFail;
+  }
+
+  //check all items first, so failed batch does not modify anything
+  std::vector<int> indexes;
+  for (unsigned int i = 0; i < items.size(); ++i)
+  {
+    if (!(items[i].getPointer() && items[i]->getType() == getItemType()))
+    {
+      LOG_ERROR()<<"Mismatched item types"<<std::endl;
+      return eModifyItemFail;
+    }
+    int index = findRecord(ids[i]);
+    if (index < 0)
+    {
+      LOG_ERROR()<<"Item "<<ids[i]<<" does not exist"<<std::endl;
+      return eModifyItemFail;
+    }
+    indexes.push_back(index);
+  }
+
+  for (unsigned int i = 0; i < items.size(); ++i)
+  {
+    Record& record = records[indexes[i]];
+    record.changed = ++sequence;
+    record.data = items[i]->getRawData();
+    revisions.push_back(revisionString(record.changed));
+  }
+
+  modified = true;
+  return eModifyItemOk;
+}
+
+enum OpenAB_Storage::Storage::eRemoveItem MemoryStorage::removeItem(const OpenAB::PIMItem::ID & id)
+{
+  OpenAB::PIMItem::IDs ids;
+  ids.push_back(id);
+  return removeItems(ids);
+}
+
+enum OpenAB_Storage::Storage::eRemoveItem MemoryStorage::removeItems(const OpenAB::PIMItem::IDs & ids)
+{
+  for (unsigned int i = 0; i < ids.size(); ++i)
+  {
+    if (findRecord(ids[i]) < 0)
+    {
+      LOG_ERROR()<<"Item "<<ids[i]<<" does not exist"<<std::endl;
+      return eRemoveItemFail;
+    }
+  }
+
+  for (unsigned int i = 0; i < ids.size(); ++i)
+  {
+    int index = findRecord(ids[i]);
+    //the same id can be requested more than once
+    if (index < 0)
+    {
+      continue;
+    }
+    eraseRecord(index);
+
+    Removal removal;
+    removal.changed = ++sequence;
+    removal.id = ids[i];
+    removals.push_back(removal);
+  }
+  trimRemovals();
+
+  modified = true;
+  return eRemoveItemOk;
+}
+
+std::string MemoryStorage::newGeneration() const
+{
+  //sequence makes generations started by the same instance unique
+  std::stringstream ss;
+  ss<<std::hex<<time(NULL)<<"-"<<getpid()<<"-"<<(unsigned long)this<<"-"<<sequence;
+  return ss.str();
+}
+
+void MemoryStorage::trimRemovals()
+{
+  if (removals.size() <= maxRemovals)
+  {
+    return;
+  }
+
+  //removals older than remembered ones could not be reported, so tokens of current generation are not valid anymore
+  LOG_DEBUG()<<"Forgetting "<<removals.size()<<" removals, starting new generation"<<std::endl;
+  std::vector<Removal>().swap(removals);
+  generation = newGeneration();
+}
+
+enum OpenAB_Storage::Storage::eGetItem MemoryStorage::getItem(const OpenAB::PIMItem::ID & id,
+                                                              OpenAB::SmartPtr<OpenAB::PIMItem>& item)
+{
+  int index = findRecord(id);
+  if (index < 0)
+  {
+    return eGetItemFail;
+  }
+
+  OpenAB::PIMItem* newItem = parseItem(records[index]);
+  if (NULL == newItem)
+  {
+    return eGetItemFail;
+  }
+  item = newItem;
+  return eGetItemOk;
+}
+
+enum OpenAB_Storage::Storage::eGetItem MemoryStorage::getItems(const OpenAB::PIMItem::IDs & ids,
+                                                               std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items)
+{
+  items.clear();
+  for (unsigned int i = 0; i < ids.size(); ++i)
+  {
+    OpenAB::SmartPtr<OpenAB::PIMItem> item;
+    if (eGetItemOk != getItem(ids[i], item))
+    {
+      items.clear();
+      return eGetItemFail;
+    }
+    items.push_back(item);
+  }
+  return eGetItemOk;
+}
+
+enum OpenAB_Storage::Storage::eGetSyncToken MemoryStorage::getLatestSyncToken(std::string& token)
+{
+  std::stringstream ss;
+  ss<<generation<<":"<<sequence;
+  token = ss.str();
+  return eGetSyncTokenOk;
+}
+
+enum OpenAB_Storage::Storage::eGetRevisions MemoryStorage::getRevisions(std::map<std::string, std::string>& revisions)
+{
+  std::vector<Record>::const_iterator it;
+  for (it = records.begin(); it != records.end(); ++it)
+  {
+    revisions[(*it).id] = revisionString((*it).changed);
+  }
+  return eGetRevisionsOk;
+}
+
+enum OpenAB_Storage::Storage::eGetRevisions MemoryStorage::getChangedRevisions(const std::string& token,
+                                                                               std::map<std::string, std::string>& revisions,
+                                                                               std::vector<OpenAB::PIMItem::ID>& removed)
+{
+  std::string::size_type pos = token.rfind(':');
+  if (std::string::npos == pos || token.substr(0, pos) != generation)
+  {
+    LOG_DEBUG()<<"Unknown sync token "<<token<<std::endl;
+    return eGetRevisionsFail;
+  }
+
+  char* end = NULL;
+  unsigned long long since = strtoull(token.c_str() + pos + 1, &end, 10);
+  if (end == token.c_str() + pos + 1 || *end != '\0' || since > sequence)
+  {
+    LOG_DEBUG()<<"Invalid sync token "<<token<<std::endl;
+    return eGetRevisionsFail;
+  }
+
+  std::vector<Record>::const_iterator it;
+  for (it = records.begin(); it != records.end(); ++it)
+  {
+    if ((*it).changed > since)
+    {
+      revisions[(*it).id] = revisionString((*it).changed);
+    }
+  }
+
+  //removals are ordered by sequence number, ids are never reused so removed items cannot exist again
+  std::vector<Removal>::const_reverse_iterator rit;
+  for (rit = removals.rbegin(); rit != removals.rend() && (*rit).changed > since; ++rit)
+  {
+    removed.push_back((*rit).id);
+  }
+  return eGetRevisionsOk;
+}
+
+OpenAB_Storage::StorageItemIterator* MemoryStorage::newStorageItemIterator()
+{
+  OpenAB::PIMItem::IDs ids;
+  getSortedIds(ids);
+  return new MemoryStorageItemIterator(this, ids);
+}
+
+bool MemoryStorage::saveSnapshot()
+{
+  if (snapshotFile.empty())
+  {
+    return true;
+  }
+
+  //partially written snapshot will never be loaded
+  OpenAB::AtomicFileWriter file(snapshotFile);
+  if (!file.isOpen())
+  {
+    LOG_ERROR()<<"Cannot open snapshot file "<<snapshotFile<<std::endl;
+    return false;
+  }
+
+  file.stream()<<MEMORY_SNAPSHOT_MAGIC<<"\n"
+               <<generation<<"\n"
+               <<sequence<<" "<<nextId<<"\n"
+               <<records.size()<<"\n";
+  std::vector<Record>::const_iterator it;
+  for (it = records.begin(); it != records.end(); ++it)
+  {
+    file.stream()<<(*it).id<<" "<<(*it).changed<<" "<<(*it).data.size()<<"\n"<<(*it).data;
+  }
+  file.stream()<<removals.size()<<"\n";
+  std::vector<Removal>::const_iterator rit;
+  for (rit = removals.begin(); rit != removals.end(); ++rit)
+  {
+    file.stream()<<(*rit).id<<" "<<(*rit).changed<<"\n";
+  }
+
+  if (!file.commit())
+  {
+    LOG_ERROR()<<"Cannot write snapshot file "<<snapshotFile<<std::endl;
+    return false;
+  }
+
+  modified = false;
+  return true;
+}
+
+bool MemoryStorage::loadSnapshot()
+{
+  if (snapshotFile.empty())
+  {
+    return false;
+  }
+
+  std::ifstream file(snapshotFile.c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  std::string line;
+  std::string snapshotGeneration;
+  unsigned long long snapshotSequence = 0;
+  unsigned long long snapshotNextId = 0;
+  unsigned int count = 0;
+  if (!std::getline(file, line) || line != MEMORY_SNAPSHOT_MAGIC ||
+      !std::getline(file, snapshotGeneration) || snapshotGeneration.empty() ||
+      !(file>>snapshotSequence>>snapshotNextId>>count))
+  {
+    LOG_ERROR()<<"Invalid snapshot file "<<snapshotFile<<std::endl;
+    return false;
+  }
+
+  std::vector<Record> snapshotRecords;
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    Record record;
+    size_t size = 0;
+    if (!(file>>record.id>>record.changed>>size) || file.get() != '\n')
+    {
+      LOG_ERROR()<<"Invalid snapshot file "<<snapshotFile<<std::endl;
+      return false;
+    }
+    record.data.resize(size);
+    if (size > 0 && !file.read(&record.data[0], size))
+    {
+      LOG_ERROR()<<"Invalid snapshot file "<<snapshotFile<<std::endl;
+      return false;
+    }
+    record.hash = hashId(record.id);
+    snapshotRecords.push_back(record);
+  }
+
+  std::vector<Removal> snapshotRemovals;
+  if (!(file>>count))
+  {
+    LOG_ERROR()<<"Invalid snapshot file "<<snapshotFile<<std::endl;
+    return false;
+  }
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    Removal removal;
+    if (!(file>>removal.id>>removal.changed))
+    {
+      LOG_ERROR()<<"Invalid snapshot file "<<snapshotFile<<std::endl;
+      return false;
+    }
+    snapshotRemovals.push_back(removal);
+  }
+
+  generation = snapshotGeneration;
+  sequence = snapshotSequence;
+  nextId = snapshotNextId;
+  records.clear();
+  rehash(MIN_SLOTS);
+  for (unsigned int i = 0; i < snapshotRecords.size(); ++i)
+  {
+    insertRecord(snapshotRecords[i]);
+  }
+  removals.swap(snapshotRemovals);
+  modified = false;
+  //limit could be lowered since snapshot was saved
+  trimRemovals();
+  LOG_DEBUG()<<"Loaded "<<records.size()<<" items from "<<snapshotFile<<std::endl;
+  return true;
+}
+
+OpenAB::PIMItem* MemoryStorage::parseItem(const Record& record) const
+{
+  OpenAB::PIMItem* item = NULL;
+  bool parsed = false;
+  switch (getItemType())
+  {
+    case OpenAB::eContact:
+    {
+      OpenAB::PIMContactItem* contact = new OpenAB::PIMContactItem();
+      parsed = contact->parse(record.data);
+      item = contact;
+      break;
+    }
+    case OpenAB::eEvent:
+    {
+      OpenAB::PIMCalendarEventItem* event = new OpenAB::PIMCalendarEventItem();
+      parsed = event->parse(record.data);
+      item = event;
+      break;
+    }
+    case OpenAB::eTask:
+    {
+      OpenAB::PIMCalendarTaskItem* task = new OpenAB::PIMCalendarTaskItem();
+      parsed = task->parse(record.data);
+      item = task;
+      break;
+    }
+  }
+
+  if (!parsed)
+  {
+    LOG_ERROR()<<"Cannot parse item "<<record.id<<std::endl;
+    delete item;
+    return NULL;
+  }
+
+  item->setId(record.id);
+  item->setRevision(revisionString(record.changed));
+  return item;
+}
+
+void MemoryStorage::getSortedIds(OpenAB::PIMItem::IDs& ids) const
+{
+  ids.clear();
+  ids.reserve(records.size());
+  std::vector<Record>::const_iterator it;
+  for (it = records.begin(); it != records.end(); ++it)
+  {
+    ids.push_back((*it).id);
+  }
+  std::sort(ids.begin(), ids.end());
+}
+
+unsigned int MemoryStorage::hashId(const OpenAB::PIMItem::ID& id)
+{
+  //FNV-1a
+  unsigned int hash = 2166136261u;
+  for (std::string::size_type i = 0; i < id.size(); ++i)
+  {
+    hash ^= (unsigned char)id[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+std::string MemoryStorage::revisionString(unsigned long long changed)
+{
+  std::stringstream ss;
+  ss<<changed;
+  return ss.str();
+}
+
+unsigned int MemoryStorage::findSlot(const OpenAB::PIMItem::ID& id, unsigned int hash) const
+{
+  //number of slots is power of two and table is never full
+  unsigned int mask = slots.size() - 1;
+  unsigned int slot = hash & mask;
+  while (0 != slots[slot])
+  {
+    const Record& record = records[slots[slot] - 1];
+    if (record.hash == hash && record.id == id)
+    {
+      break;
+    }
+    slot = (slot + 1) & mask;
+  }
+  return slot;
+}
+
+int MemoryStorage::findRecord(const OpenAB::PIMItem::ID& id) const
+{
+  unsigned int slot = findSlot(id, hashId(id));
+  return (int)slots[slot] - 1;
+}
+
+void MemoryStorage::insertRecord(const Record& record)
+{
+  //keep load factor below 1/2, so probe sequences stay short
+  if ((records.size() + 1) * 2 > slots.size())
+  {
+    rehash(slots.size() * 2);
+  }
+  records.push_back(record);
+  slots[findSlot(record.id, record.hash)] = records.size();
+}
+
+void MemoryStorage::eraseRecord(unsigned int index)
+{
+  unsigned int mask = slots.size() - 1;
+  unsigned int slot = findSlot(records[index].id, records[index].hash);
+
+  //backward shift deletion, moves following entries of probe sequence into freed slot
+  unsigned int next = slot;
+  while (true)
+  {
+    next = (next + 1) & mask;
+    if (0 == slots[next])
+    {
+      break;
+    }
+    unsigned int home = records[slots[next] - 1].hash & mask;
+    bool canMove = (slot <= next) ? (home <= slot || home > next)
+                                  : (home <= slot && home > next);
+    if (canMove)
+    {
+      slots[slot] = slots[next];
+      slot = next;
+    }
+  }
+  slots[slot] = 0;
+
+  //fill hole with last record, so records stay continuous
+  unsigned int last = records.size() - 1;
+  if (index != last)
+  {
+    slots[findSlot(records[last].id, records[last].hash)] = index + 1;
+    records[index] = records[last];
+  }
+  records.pop_back();
+}
+
+void MemoryStorage::rehash(unsigned int size)
+{
+  slots.assign(size, 0);
+  for (unsigned int i = 0; i < records.size(); ++i)
+  {
+    slots[findSlot(records[i].id, records[i].hash)] = i + 1;
+  }
+}
+
+MemoryStorageItemIterator::MemoryStorageItemIterator(OpenAB_Storage::Storage* s,
+                                                     const OpenAB::PIMItem::IDs& i) :
+    storage(s),
+    ids(i),
+    position(0)
+{
+}
+
+MemoryStorageItemIterator::~MemoryStorageItemIterator()
+{
+}
+
+OpenAB_Storage::StorageItem* MemoryStorageItemIterator::next()
+{
+  while (position < ids.size())
+  {
+    const OpenAB::PIMItem::ID& id = ids[position++];
+    OpenAB::SmartPtr<OpenAB::PIMItem> item;
+    if (OpenAB_Storage::Storage::eGetItemOk == storage->getItem(id, item))
+    {
+      elem.id = id;
+      elem.item = item;
+      return &elem;
+    }
+  }
+  return NULL;
+}
+
+OpenAB_Storage::StorageItem MemoryStorageItemIterator::operator*()
+{
+  return elem;
+}
+
+OpenAB_Storage::StorageItem* MemoryStorageItemIterator::operator->()
+{
+  return &elem;
+}
+
+unsigned int MemoryStorageItemIterator::getSize() const
+{
+  return ids.size();
+}
+
+namespace MemoryFactory
+{
+  OpenAB_Storage::Storage* createInstance(const OpenAB_Storage::Parameters& params)
+  {
+    LOG_FUNC();
+    OpenAB::PIMItemType type = OpenAB::eContact;
+    std::string snapshotFile;
+
+    OpenAB::Variant param = params.getValue("item_type");
+    if (!param.invalid())
+    {
+      if (OpenAB::Variant::STRING != param.getType())
+      {
+        LOG_ERROR() << "Parameter 'item_type' has to be of STRING type"<<std::endl;
+        return NULL;
+      }
+      if (param.getString() == "contact")
+      {
+        type = OpenAB::eContact;
+      }
+      else if (param.getString() == "event")
+      {
+        type = OpenAB::eEvent;
+      }
+      else if (param.getString() == "task")
+      {
+        type = OpenAB::eTask;
+      }
+      else
+      {
+        LOG_ERROR() << "Unknown item type "<<param.getString()<<std::endl;
+        return NULL;
+      }
+    }
+
+    param = params.getValue("snapshot_file");
+    if (!param.invalid())
+    {
+      if (OpenAB::Variant::STRING != param.getType())
+      {
+        LOG_ERROR() << "Parameter 'snapshot_file' has to be of STRING type"<<std::endl;
+        return NULL;
+      }
+      snapshotFile = param.getString();
+    }
+
+    unsigned int maxRemovals = DEFAULT_MAX_REMOVALS;
+    param = params.getValue("max_removals");
+    if (!param.invalid())
+    {
+      if (OpenAB::Variant::INTEGER != param.getType() || param.getInt() < 0)
+      {
+        LOG_ERROR() << "Parameter 'max_removals' has to be of non negative INTEGER type"<<std::endl;
+        return NULL;
+      }
+      maxRemovals = param.getInt();
+    }
+
+    MemoryStorage* storage = new MemoryStorage(type, snapshotFile, maxRemovals);
+    if (NULL == storage)
+    {
+      LOG_ERROR() << "Cannot Initialize MemoryStorage"<<std::endl;
+      return NULL;
+    }
+    return storage;
+  }
+
+  class MemoryStorageFactory : OpenAB_Storage::Factory
+  {
+    public:
+      /*!
+       *  @brief Constructor.
+       */
+      MemoryStorageFactory():
+        Factory::Factory("Memory"){};
+
+      /*!
+       *  @brief Destructor, virtual by default.
+       */
+      virtual ~MemoryStorageFactory(){};
+
+      OpenAB_Storage::Storage * newIstance(const OpenAB_Storage::Parameters & params)
+      {
+        return createInstance(params);
+      };
+  };
+
+  class MemorySourceFactory : OpenAB_Source::Factory
+  {
+    public:
+      /*!
+       *  @brief Constructor.
+       */
+      MemorySourceFactory()
+          : Factory::Factory("Memory")
+      {
+      }
+      ;
+
+      /*!
+       *  @brief Destructor, virtual by default.
+       */
+      virtual ~MemorySourceFactory()
+      {
+      }
+      ;
+
+      OpenAB_Source::Source * newIstance(const OpenAB_Source::Parameters & params)
+      {
+        return createInstance(params);
+      }
+  };
+}
+
+namespace MemoryStorageFactory
+{
+  REGISTER_PLUGIN_FACTORY(MemoryFactory::MemoryStorageFactory);
+}
+
+namespace MemorySourceFactory
+{
+  REGISTER_PLUGIN_FACTORY(MemoryFactory::MemorySourceFactory);
+}
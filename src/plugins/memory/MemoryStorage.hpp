@@ -0,0 +1,223 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file MemoryStorage.hpp
+ */
+
+#ifndef MEMORYSTORAGE_HPP_
+#define MEMORYSTORAGE_HPP_
+
+#include <plugin/storage/Storage.hpp>
+#include <string>
+#include <vector>
+
+class MemoryStorageItemIterator;
+
+/**
+ * @defgroup MemoryStorage Memory Storage Plugin
+ * @ingroup StoragePlugin
+ *
+ * @brief Keeps items of any OpenAB::PIMItemType in process memory.
+ *
+ * Plugin Name: "Memory"
+ *
+ * Parameters:
+ * | Type       | Name  |  Description                                         | Mandatory |
+ * |:-----------|:      |:-----------------------------------------------------| :         |
+ * | String | "item_type"     | type of stored items: "contact" (default), "event" or "task" | No |
+ * | String | "snapshot_file" | file from which contents are loaded on first initialization and to which they are saved on destruction | No |
+ * | Integer| "max_removals"  | maximal number of remembered removals (10000 by default), see below | No |
+ *
+ * Items are kept as raw data (vCard or iCalendar) in single array, indexed by open addressing hash table of ids,
+ * and are parsed only when requested. Revisions are sequence numbers of last change of each item,
+ * so changes since any sync token returned by @ref MemoryStorage::getLatestSyncToken can be reported without
+ * comparing contents of items.
+ * Ids of removed items are remembered to be reported by @ref MemoryStorage::getChangedRevisions. When their number
+ * exceeds "max_removals" they are forgotten and new generation of contents history is started,
+ * so all sync tokens returned before are rejected and clients fall back to full comparison of revisions.
+ *
+ * Storage has no I/O costs, so it can be used as baseline when measuring performance of Sync plugins,
+ * or as fast local storage in front of slower ones.
+ */
+class MemoryStorage : public OpenAB_Storage::Storage
+{
+  public:
+    /*!
+     *  @brief Constructor.
+     *  @param [in] type type of stored items.
+     *  @param [in] snapshotFile file used to persist contents, empty if contents should not be persisted.
+     *  @param [in] maxRemovals maximal number of remembered removals.
+     */
+    MemoryStorage(OpenAB::PIMItemType type,
+                  const std::string& snapshotFile,
+                  unsigned int maxRemovals);
+
+    /*!
+     *  @brief Destructor, saves snapshot if contents changed.
+     */
+    virtual ~MemoryStorage();
+
+    enum eInit init();
+    enum eSuspendRet suspend();
+    enum eResumeRet resume();
+    enum eCancelRet cancel();
+    enum eGetItemRet getItem(OpenAB::SmartPtr<OpenAB::PIMItem> &item);
+    int getTotalCount() const;
+
+    enum eAddItem addItem(const OpenAB::SmartPtr<OpenAB::PIMItem>& item,
+                          OpenAB::PIMItem::ID & newId,
+                          OpenAB::PIMItem::Revision & revision);
+    enum eAddItem addItems(const std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items,
+                           OpenAB::PIMItem::IDs & newIds,
+                           OpenAB::PIMItem::Revisions & revisions);
+    enum eModifyItem modifyItem(const OpenAB::SmartPtr<OpenAB::PIMItem>& item,
+                                const OpenAB::PIMItem::ID & id,
+                                OpenAB::PIMItem::Revision & revision);
+    enum eModifyItem modifyItems(const std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items,
+                                 const OpenAB::PIMItem::IDs & ids,
+                                 OpenAB::PIMItem::Revisions & revisions);
+    enum eRemoveItem removeItem(const OpenAB::PIMItem::ID & id);
+    enum eRemoveItem removeItems(const OpenAB::PIMItem::IDs & ids);
+    enum eGetItem getItem(const OpenAB::PIMItem::ID & id,
+                          OpenAB::SmartPtr<OpenAB::PIMItem>& item);
+    enum eGetItem getItems(const OpenAB::PIMItem::IDs & ids,
+                           std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & items);
+    enum eGetSyncToken getLatestSyncToken(std::string& token);
+    enum eGetRevisions getRevisions(std::map<std::string, std::string>& revisions);
+    enum eGetRevisions getChangedRevisions(const std::string& token,
+                                           std::map<std::string, std::string>& revisions,
+                                           std::vector<OpenAB::PIMItem::ID>& removed);
+    OpenAB_Storage::StorageItemIterator* newStorageItemIterator();
+
+    /*!
+     * @brief Saves contents to snapshot file.
+     * @return true if snapshot was saved or no snapshot file was configured, false otherwise.
+     */
+    bool saveSnapshot();
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    MemoryStorage(MemoryStorage const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    MemoryStorage& operator=(MemoryStorage const &other);
+
+    struct Record
+    {
+      OpenAB::PIMItem::ID id;
+      unsigned int        hash;
+      unsigned long long  changed; /**< sequence number of last change, used as revision */
+      std::string         data;
+    };
+
+    struct Removal
+    {
+      unsigned long long  changed;
+      OpenAB::PIMItem::ID id;
+    };
+
+    bool loadSnapshot();
+
+    /*!
+     * @brief Creates item of stored type from raw data.
+     */
+    OpenAB::PIMItem* parseItem(const Record& record) const;
+
+    /*!
+     * @brief Returns ids of all items sorted.
+     */
+    void getSortedIds(OpenAB::PIMItem::IDs& ids) const;
+
+    static unsigned int hashId(const OpenAB::PIMItem::ID& id);
+    static std::string revisionString(unsigned long long changed);
+
+    /*!
+     * @brief Returns slot of hash table which points to item with given id, or empty slot where it should be inserted.
+     */
+    unsigned int findSlot(const OpenAB::PIMItem::ID& id, unsigned int hash) const;
+    /*!
+     * @brief Returns index of item in records or -1 if it does not exist.
+     */
+    int findRecord(const OpenAB::PIMItem::ID& id) const;
+    void insertRecord(const Record& record);
+    void eraseRecord(unsigned int index);
+    void rehash(unsigned int size);
+
+    /*!
+     * @brief Returns new unique identifier of contents history.
+     */
+    std::string newGeneration() const;
+    /*!
+     * @brief Forgets all removals and starts new generation if there are more than maxRemovals of them.
+     */
+    void trimRemovals();
+
+    std::string                 snapshotFile;
+    bool                        snapshotLoaded;
+    bool                        modified;
+
+    /*items stored continuously, removed item is replaced by last one*/
+    std::vector<Record>         records;
+    /*open addressing hash table, each slot holds index of record + 1, or 0 if it is empty*/
+    std::vector<unsigned int>   slots;
+    std::vector<Removal>        removals;
+    unsigned int                maxRemovals;
+
+    /*identifies contents history, sync tokens of other instances (or of cleared snapshots) are not accepted*/
+    std::string                 generation;
+    unsigned long long          sequence;
+    unsigned long long          nextId;
+
+    MemoryStorageItemIterator*  readIterator;
+};
+
+/*!
+ * @brief Iterates over items of MemoryStorage sorted by id.
+ * Items are parsed while iterating, items removed after iterator was created are skipped.
+ */
+class MemoryStorageItemIterator : public OpenAB_Storage::StorageItemIterator
+{
+  public:
+    /*!
+     *  @brief Constructor.
+     *  @param [in] storage storage to iterate over, it has to outlive iterator.
+     *  @param [in] ids sorted ids of items.
+     */
+    MemoryStorageItemIterator(OpenAB_Storage::Storage* storage,
+                              const OpenAB::PIMItem::IDs& ids);
+
+    /*!
+     *  @brief Destructor, virtual by default.
+     */
+    virtual ~MemoryStorageItemIterator();
+
+    OpenAB_Storage::StorageItem* next();
+    OpenAB_Storage::StorageItem operator*();
+    OpenAB_Storage::StorageItem* operator->();
+    unsigned int getSize() const;
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    MemoryStorageItemIterator(MemoryStorageItemIterator const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    MemoryStorageItemIterator& operator=(MemoryStorageItemIterator const &other);
+
+    OpenAB_Storage::Storage*    storage;
+    OpenAB::PIMItem::IDs        ids;
+    unsigned int                position;
+    OpenAB_Storage::StorageItem elem;
+};
+
+#endif // MEMORYSTORAGE_HPP_
@@ -43,6 +43,8 @@ OneWaySync::OneWaySync(OpenAB_Sync_params & p)
       params(p),
       source(NULL),
       storage(NULL),
+      writeBuffer(NULL),
+      writer(NULL),
       dbError(false),
       inputError(false),
       threadCreated(false),
@@ -74,6 +76,13 @@ OneWaySync::~OneWaySync()
     OpenAB::PluginManager::getInstance().freePluginInstance(source);
     source = NULL;
   }
+  if (NULL != writeBuffer)
+  {
+    //flushes pending operations, so it has to be deleted before wrapped storage
+    delete writeBuffer;
+    writeBuffer = NULL;
+  }
+  writer = NULL;
   if (NULL != storage)
   {
     LOG_FUNC() << "Delete Storage"<<std::endl;;
@@ -126,6 +135,16 @@ enum OpenAB_Sync::Sync::eInit OneWaySync::init()
     return OpenAB_Sync::Sync::eInitFail;
   }
 
+  writer = storage;
+  if (0 != params.write_buffer_size)
+  {
+    writeBuffer = new OpenAB_Storage::WriteBufferedStorage(storage,
+                                                           params.write_buffer_size,
+                                                           params.write_buffer_bytes,
+                                                           params.write_buffer_time);
+    writer = writeBuffer;
+  }
+
   return OpenAB_Sync::Sync::eInitOk;
 }
 
@@ -351,9 +370,18 @@ enum OpenAB_Sync::Sync::eSync OneWaySync::doSynchronize()
 
     //========================================================
     /* Phase 3 remove vCards marked as NOT_FOUND */
-    LOG_VERBOSE() << "cleanAddressbook() ..."<<std::endl;
-    cleanStorage();
-    LOG_VERBOSE() << "cleanAddressbook() DONE"<<std::endl;
+    if (source->isDelta())
+    {
+      //items that were not provided by delta source were not removed
+      LOG_VERBOSE() << "Source provides only new items, nothing will be removed"<<std::endl;
+    }
+    else
+    {
+      LOG_VERBOSE() << "cleanAddressbook() ..."<<std::endl;
+      cleanStorage();
+      LOG_VERBOSE() << "cleanAddressbook() DONE"<<std::endl;
+    }
+    flushWriteBuffer();
     CHECK_DB_ERROR();
     CHECK_CANCEL();
 
@@ -369,6 +397,13 @@ enum OpenAB_Sync::Sync::eSync OneWaySync::doSynchronize()
   OpenAB::PIMContactItemIndex::enableAllChecks();
   indexDB.clear();
 
+  //each phase initializes source again, so delta source provides the same items in all phases
+  //and can forget them only when all phases are finished
+  if (!phases.empty() && source->isDelta())
+  {
+    source->commitDelta();
+  }
+
   if(globalStats.added != 0 ||
      globalStats.modified != 0 ||
      globalStats.removed != 0)
@@ -394,10 +429,13 @@ void OneWaySync::updateIndexDB()
     if(cancelSync)
       return;
 
-    OpenAB_Storage::StorageItem *aa = new OpenAB_Storage::StorageItem(*e);
-    LOG_DEBUG() << "id:" << e->id << " Name:" << e->item->getIndex()->toString()<<std::endl;
+    //take over item from iterator, it will be replaced by next call anyway
+    OpenAB_Storage::StorageItem *aa = new OpenAB_Storage::StorageItem();
+    aa->swap(*e);
+    OpenAB::SmartPtr<OpenAB::PIMItemIndex> index = aa->item->getIndex();
+    LOG_DEBUG() << "id:" << aa->id << " Name:" << index->toString()<<std::endl;
     LOG_DEBUG()<<"STORAGE ITEM "<<aa<<std::endl;
-    indexDB[e->item->getIndex()].push_back(aa);
+    indexDB[index].push_back(aa);
     LOG_DEBUG() <<" IDB:" << (int)indexDB.size()<<std::endl;
   }
   delete it;
@@ -409,15 +447,31 @@ void OneWaySync::processItems(unsigned int phaseNum)
 
   OpenAB::SmartPtr<OpenAB::PIMItem> item;
 
-  unsigned int numOfProcessedContacts = phaseNum*source->getTotalCount();
-  unsigned int totalNumOfContacts = source->getTotalCount()*phases.size();
+  //when number of items is not known in advance, progress is based only on number of finished phases
+  int totalCount = source->getTotalCount();
+  unsigned int numOfProcessedContacts = 0;
+  unsigned int totalNumOfContacts = 0;
+  float phasesProgress = 0.0f;
+  if (totalCount >= 0)
+  {
+    numOfProcessedContacts = phaseNum*totalCount;
+    totalNumOfContacts = totalCount*phases.size();
+  }
+  else
+  {
+    phasesProgress = float(phaseNum)/float(phases.size());
+  }
   float progress = 0.0f;
   OpenAB::TimeStamp currentTime(true);
   OpenAB::TimeStamp lastSyncProgressEventTime(true);
   OpenAB::TimeStamp progressEventTime(params.sync_progress_time, 0);
 
 
-  progress = float(numOfProcessedContacts)/float(totalNumOfContacts);
+  progress = phasesProgress;
+  if (totalNumOfContacts != 0)
+  {
+    progress = float(numOfProcessedContacts)/float(totalNumOfContacts);
+  }
 
   if(params.cb)
     params.cb->syncProgress(phases.at(phaseNum).name, progress, numOfProcessedContacts);
@@ -437,7 +491,7 @@ void OneWaySync::processItems(unsigned int phaseNum)
       lastSyncProgressEventTime = currentTime;
       if(params.cb)
       {
-        progress = 0.0;
+        progress = phasesProgress;
         if (totalNumOfContacts != 0)
         {
           progress = float(numOfProcessedContacts)/float(totalNumOfContacts);
@@ -558,7 +612,7 @@ void OneWaySync::cleanStorage()
   }
   if(!idsToBeRemoved.empty())
   {
-    if (storage->eRemoveItemFail == storage->removeItems(idsToBeRemoved))
+    if (writer->eRemoveItemFail == writer->removeItems(idsToBeRemoved))
     {
       dbError = true;
     }
@@ -597,7 +651,7 @@ bool OneWaySync::flushInsertions()
     items.push_back(itemsToBeAdded[i].item);
   }
 
-  if (storage->eAddItemOk != storage->addItems(items, newIds, revisions))
+  if (writer->eAddItemOk != writer->addItems(items, newIds, revisions))
   {
     dbError = true;
     return false;
@@ -621,7 +675,7 @@ bool OneWaySync::flushModifications()
     items.push_back(itemsToBeModified[i].item);
   }
 
-  if (storage->eModifyItemOk != storage->modifyItems(items, ids, revisions))
+  if (writer->eModifyItemOk != writer->modifyItems(items, ids, revisions))
   {
     dbError = true;
     return false;
@@ -631,6 +685,23 @@ bool OneWaySync::flushModifications()
   return true;
 }
 
+bool OneWaySync::flushWriteBuffer()
+{
+  if (NULL == writeBuffer)
+    return true;
+
+  if (!writeBuffer->flush())
+  {
+    dbError = true;
+    return false;
+  }
+
+  const OpenAB_Storage::WriteBufferedStorage::Stats& stats = writeBuffer->getStats();
+  LOG_DEBUG()<<"Write buffer: "<<stats.requestedCalls<<" requested write calls merged into "<<stats.commits<<" commits, "
+             <<"written "<<stats.writtenOperations<<" operations ("<<stats.writtenBytes<<" bytes)"<<std::endl;
+  return true;
+}
+
 namespace {
 
 class OneWaySyncFactory : OpenAB_Sync::Factory
@@ -701,6 +772,26 @@ class OneWaySyncFactory : OpenAB_Sync::Factory
       }
       LOG_INFO()<<"Batch size "<<p.batch_size<<std::endl;
 
+      p.write_buffer_size = 0;
+      p.write_buffer_bytes = 0;
+      p.write_buffer_time = 0;
+      const char* writeBufferParams[] = {"write_buffer_size", "write_buffer_bytes", "write_buffer_time"};
+      unsigned int* writeBufferValues[] = {&p.write_buffer_size, &p.write_buffer_bytes, &p.write_buffer_time};
+      for (unsigned int i = 0; i < sizeof(writeBufferParams) / sizeof(writeBufferParams[0]); ++i)
+      {
+        param = params.getValue(writeBufferParams[i]);
+        if (!param.invalid()){
+          if (param.getType() != OpenAB::Variant::INTEGER || param.getInt() < 0)
+          {
+            LOG_ERROR() << "Parameter '"<<writeBufferParams[i]<<"' has to be of non negative INTEGER type"<<std::endl;
+            return NULL;
+          }
+          *writeBufferValues[i] = param.getInt();
+        }
+      }
+      LOG_INFO()<<"Write buffer size "<<p.write_buffer_size<<", bytes "<<p.write_buffer_bytes
+                <<", time "<<p.write_buffer_time<<std::endl;
+
 
       OneWaySync * fi =new OneWaySync(p);
       if (NULL == fi)
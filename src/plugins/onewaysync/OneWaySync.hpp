@@ -13,6 +13,7 @@
 
 #include <pthread.h>
 #include "plugin/sync/Sync.hpp"
+#include "plugin/storage/WriteBufferedStorage.hpp"
 
 /**
  * @defgroup  OneWaySync OneWay Sync Plugin
@@ -79,6 +80,11 @@
  *
  * - @b Step3: Delete all the unmarked items from the Storage (OpenAB_Storage::Storage::deleteItems)
  *
+ * When Source provides only items that are new since previous synchronization (OpenAB_Source::Source::isDelta),
+ * Step3 is skipped, as items that were not provided were not removed. Such Source is informed that all its items
+ * were stored (OpenAB_Source::Source::commitDelta) only after all phases finished successfully,
+ * so each phase gets the same items and failed or cancelled synchronization is repeated next time.
+ *
  * Each phase can define PIMItem fields that should be ignored both during getting items from OpenAB_Source::Source and during comparison of them with contents of OpenAB_Storage::Storage.
  *
  * ## Parameters ##
@@ -92,6 +98,15 @@
  * |Pointer   |"callback"      | pointer to OpenAB_Sync::Sync::SyncCallback   | No       |
  * |Float     |"sync_progress_frequency" | interval of OpenAB_Sync::Sync::SyncCallback::syncProgress() emission in seconds | No |
  * |Integer   | "batch_size" | size of batches to be used on Storage operations | No |
+ * |Integer   | "write_buffer_size" | maximal number of Storage write operations buffered before they are written (0 disables buffering, default) | No |
+ * |Integer   | "write_buffer_bytes" | maximal size in bytes of buffered Storage write operations (0 for no limit, default) | No |
+ * |Integer   | "write_buffer_time" | maximal time in milliseconds Storage write operations stay buffered (0 for no limit, default) | No |
+ *
+ * When write buffering is enabled, Storage write operations are passed through OpenAB_Storage::WriteBufferedStorage,
+ * which is flushed at least at the end of each phase, so results of each phase are visible in Storage when it finishes.
+ * Buffering does not coalesce operations, it only merges batches of "batch_size" items into fewer Storage commits
+ * (e.g. with "batch_size" 100 and "write_buffer_size" 1000 adding 1000 items takes single commit instead of 10).
+ * Requested write calls, written operations with their size and number of commits are logged on debug level after each phase.
  *
  * @todo Input: define signal for sync statistics
  * @todo Add possibility to sleep after processing each item to lower CPU consumption during sync
@@ -115,6 +130,9 @@ struct OpenAB_Sync_params
     }                               sync_type;
     float                           sync_progress_time;
     unsigned int                    batch_size;
+    unsigned int                    write_buffer_size;
+    unsigned int                    write_buffer_bytes;
+    unsigned int                    write_buffer_time;
 };
 
 /**
@@ -162,6 +180,7 @@ class OneWaySync : public OpenAB_Sync::Sync
     void modifyItem(const std::string& id, const OpenAB::SmartPtr<OpenAB::PIMItem> & item);
     bool flushInsertions();
     bool flushModifications();
+    bool flushWriteBuffer();
 
     enum eSync doSynchronize();
     static void* threadSync(void*);
@@ -186,6 +205,9 @@ class OneWaySync : public OpenAB_Sync::Sync
 
     OpenAB_Source::Source*   source;
     OpenAB_Storage::Storage* storage;
+    OpenAB_Storage::WriteBufferedStorage* writeBuffer;
+    /*Storage used for write operations, either storage or writeBuffer wrapping it*/
+    OpenAB_Storage::Storage* writer;
 
     typedef std::vector< OpenAB::SmartPtr<OpenAB_Storage::StorageItem> > vectorElem;
     typedef std::map< OpenAB::SmartPtr<OpenAB::PIMItemIndex> , vectorElem > dbIndexElem;
@@ -8,32 +8,112 @@
  */
 
 #include "PBAP.hpp"
+#include "PBAPChunkController.hpp"
 #include <PIMItem/Contact/PIMContactItem.hpp>
 #include <OpenAB.hpp>
 #include <algorithm>
 #include <locale>
 #include <fcntl.h>
+#include <poll.h>
+
+/*Maximal number of downloaded vCards waiting to be parsed and returned by getItem*/
+#define VCARDS_QUEUE_SIZE 100
+
+/*Size of single read from FIFO*/
+#define FIFO_READ_SIZE 65536
+
+/*Time (in ms) to wait for BlueZ closing FIFO after transfer was reported as completed*/
+#define FIFO_CLOSE_TIMEOUT 1000
+
+/*Minimal and maximal size of batch when batch download is enabled*/
+#define BATCH_MIN_SIZE 10
+#define BATCH_MAX_SIZE 65535
+
+/*Number of call history entries downloaded in first batch, each next batch is twice as big*/
+#define CALL_HISTORY_FIRST_BATCH 5
+
+/*Maximal number of consecutive synchronizations that download only vCards with changed listing entries*/
+#define MAX_PARTIAL_SYNCS 5
+
+namespace
+{
+  /*
+   * Removes trailing empty components from structured name, so names reported
+   * in vCard listing and N property of vCard can be compared.
+   */
+  std::string trimName(const std::string& name)
+  {
+    std::string::size_type end = name.find_last_not_of("; \r\n");
+    if (std::string::npos == end)
+    {
+      return "";
+    }
+    return name.substr(0, end + 1);
+  }
+
+  /*
+   * Returns value of N property of vCard.
+   */
+  std::string getVCardName(const std::string& vCard)
+  {
+    std::string::size_type pos = 0;
+    while (std::string::npos != pos)
+    {
+      if (0 == vCard.compare(pos, 2, "N:") || 0 == vCard.compare(pos, 2, "N;"))
+      {
+        std::string::size_type valueStart = vCard.find(':', pos);
+        std::string::size_type lineEnd = vCard.find('\n', pos);
+        if (std::string::npos == valueStart || valueStart > lineEnd)
+        {
+          return "";
+        }
+        return trimName(vCard.substr(valueStart + 1, lineEnd - valueStart - 1));
+      }
+      pos = vCard.find('\n', pos);
+      if (std::string::npos != pos)
+      {
+        ++pos;
+      }
+    }
+    return "";
+  }
+}
 
 PBAPSource::PBAPSource(const std::string& mac,
                        const std::string& pb,
                        const std::string& ignoreFields,
-                       unsigned int batchDownloadTime)
+                       unsigned int batchDownloadTime,
+                       const std::string& cacheDir,
+                       const std::string& phonebook,
+                       const std::string& cursorFile)
     : OpenAB_Source::Source(OpenAB::eContact),
       macAddress(mac),
       pbLocation(pb),
+      pbName(phonebook),
       batchDownloadDesiredTime(batchDownloadTime),
-      tempFIFO("NA"),
-      fifoBuffer(),
+      tempFIFO(),
+      vCards(0, VCARDS_QUEUE_SIZE),
       threadCreated(false),
+      session(NULL),
       connection(NULL),
-      proxyClient1(NULL),
       proxyPhonebookAccess1(NULL),
       proxyTransfer1(NULL),
       transferStatus(eGetItemRetOk),
       sessionPath(),
-      phonebookSize(0)
+      phonebookSize(0),
+      cacheDir(cacheDir),
+      cache(NULL),
+      incrementalSync(false),
+      partialSync(false),
+      cacheComplete(true),
+      listingPosition(0),
+      cursorFile(cursorFile),
+      callHistoryDelta(false),
+      cursorFound(false)
 {
   LOG_FUNC();
+  wakeupPipe[0] = -1;
+  wakeupPipe[1] = -1;
   if (!ignoreFields.empty())
   {
     std::string field;
@@ -64,35 +144,45 @@ void PBAPSource::cleanup()
 {
   LOG_FUNC();
 
+  //wake up download thread if it is waiting for free space in queue
+  vCards.close();
   if(threadCreated)
   {
     pthread_join(threadFIFO, NULL);
+    threadCreated = false;
   }
 
-  if(transfer.isInitialized())
-  {
-    transfer.cancel();
-  }
+  vCards.reset();
+  removeFIFO();
 
-  if (NULL != proxyTransfer1)
-  {
-    g_object_unref(proxyTransfer1);
-  }
+  //filters are queried again on every init, they are also part of cache key
+  supportedFilters.clear();
+  filters.clear();
 
-  if (NULL != proxyPhonebookAccess1)
+  delete cache;
+  cache = NULL;
+
+  for (int i = 0; i < 2; ++i)
   {
-    g_object_unref(proxyPhonebookAccess1);
+    if (-1 != wakeupPipe[i])
+    {
+      close(wakeupPipe[i]);
+      wakeupPipe[i] = -1;
+    }
   }
 
-  if (NULL != proxyClient1)
+  if(transfer.isInitialized())
   {
-    g_object_unref(proxyClient1);
+    transfer.cancel();
   }
 
-  if (NULL != connection)
+  if (NULL != proxyTransfer1)
   {
-    g_object_unref(connection);
+    g_object_unref(proxyTransfer1);
+    proxyTransfer1 = NULL;
   }
+
+  disconnectSession();
 }
 
 enum OpenAB_Source::Source::eInit PBAPSource::init()
@@ -100,38 +190,23 @@ enum OpenAB_Source::Source::eInit PBAPSource::init()
   LOG_FUNC() << "Open PBAP: " << macAddress<<std::endl;
   cleanup();
 
-  GError * gerror = NULL;
-
 #if GLIB_VERSION_MIN_REQUIRED < G_ENCODE_VERSION(2,36)
   /* g_type_init has been deprecated since 2.36 */
   g_type_init();
 #endif
 
-  connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &gerror);
-
-  if (NULL == connection){
-    LOG_ERROR() << "Cannot open connection to bus: " << GERROR_MESSAGE(gerror)<<std::endl;
-    GERROR_FREE(gerror);
-    return eInitFail;
-  }
-
   if (!createSession())
   {
     return eInitFail;
   }
 
-  if (!selectPhonebook())
-  {
-    return eInitFail;
-  }
-
-  if (!getPhonebookSize())
-  {
-    return eInitFail;
-  }
-
-  if (!getSupportedFilters())
+  //other sources cannot select their phonebooks until this one is fully initialized
+  session->lock();
+  if (!selectPhonebook() ||
+      !getPhonebookSize() ||
+      !getSupportedFilters())
   {
+    session->unlock();
     return eInitFail;
   }
 
@@ -170,157 +245,73 @@ enum OpenAB_Source::Source::eInit PBAPSource::init()
     LOG_DEBUG()<<(*it)<<std::endl;
   }
 
-  threadCreated = true;
-  pthread_create(&threadFIFO,NULL,threadFuncFIFOWrapper,this);
-
-  return eInitOk;
-}
-
-bool PBAPSource::createSession()
-{
-  GError* gerror = NULL;
-  GVariantBuilder *builder;
-  GVariant* response = NULL;
-  GVariant* sessionPathVariant = NULL;
-  bool res = true;
-
-  proxyClient1 = g_dbus_proxy_new_sync(connection,
-                                       G_DBUS_PROXY_FLAGS_NONE,
-                                       NULL,
-                                       "org.bluez.obex",
-                                       "/org/bluez/obex",
-                                       "org.bluez.obex.Client1",
-                                       NULL, &gerror);
-
-  if (NULL != gerror)
-  {
-    LOG_ERROR() << "Cannot create org.bluez.obex.Client1 proxy : " << GERROR_MESSAGE(gerror)<<std::endl;
-    GERROR_FREE(gerror);
-    return false;
-  }
-
-  builder = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
-  g_variant_builder_add(builder, "{sv}", "Target", g_variant_new_string("PBAP"));
-
-  response = g_dbus_proxy_call_sync(proxyClient1,
-                                    "CreateSession",
-                                    g_variant_new("(sa{sv})",
-                                                  macAddress.c_str(),
-                                                  builder),
-                                    G_DBUS_CALL_FLAGS_NONE, -1,
-                                    NULL, &gerror);
-  g_variant_builder_unref (builder);
-  if (NULL == response)
+  callHistoryDelta = false;
+  if (!cursorFile.empty())
   {
-    LOG_ERROR() << "Cannot call CreateSession : " << GERROR_MESSAGE(gerror)<<std::endl;
-    if (NULL != gerror && gerror->domain == G_DBUS_ERROR)
+    if ("pb" == pbName)
     {
-      char* err = g_dbus_error_get_remote_error(gerror);
-      LOG_ERROR() << "Exception: " << err<<std::endl;
-      g_free(err);
-      GERROR_FREE(gerror);
+      LOG_ERROR() << "Cursor can be used only with call history phonebooks, ignoring it"<<std::endl;
+    }
+    else
+    {
+      callHistoryDelta = true;
+      loadCursor();
     }
-    res = false;
   }
 
-  if (res)
+  if (!callHistoryDelta)
   {
-    sessionPathVariant = g_variant_get_child_value(response, 0);
-    sessionPath = g_variant_get_string(sessionPathVariant, NULL);
-    g_variant_unref(sessionPathVariant);
-
-    proxyPhonebookAccess1 = g_dbus_proxy_new_sync(connection,
-                                                  G_DBUS_PROXY_FLAGS_NONE,
-                                                  NULL,
-                                                  "org.bluez.obex",
-                                                  sessionPath.c_str(),
-                                                  "org.bluez.obex.PhonebookAccess1",
-                                                  NULL, &gerror);
-
-    if (NULL != gerror)
-    {
-      LOG_ERROR() << "Cannot create org.bluez.obex.PhonebookAccess1 proxy : " << GERROR_MESSAGE(gerror)<<std::endl;
-      GERROR_FREE(gerror);
-      res = false;
-    }
+    prepareIncrementalSync();
   }
+  session->unlock();
 
-  if (NULL != response)
+  if (0 != pipe(wakeupPipe))
   {
-    g_variant_unref(response);
+    LOG_ERROR() << "Cannot create pipe: " << strerror(errno)<<std::endl;
+    return eInitFail;
   }
-  return res;
+  fcntl(wakeupPipe[0], F_SETFL, O_NONBLOCK);
+  fcntl(wakeupPipe[1], F_SETFL, O_NONBLOCK);
+
+  threadCreated = true;
+  pthread_create(&threadFIFO,NULL,threadFuncFIFOWrapper,this);
+
+  return eInitOk;
 }
 
-bool PBAPSource::disconnectSession()
+bool PBAPSource::createSession()
 {
-  if(sessionPath.empty())
+  session = PBAPSession::acquire(macAddress);
+  if (NULL == session)
   {
     return false;
   }
 
-  GError* gerror = NULL;
-  GVariant* response = NULL;
-  bool res = true;
-
-  LOG_DEBUG()<<"Disconnectin session "<<sessionPath<<std::endl;
-  response = g_dbus_proxy_call_sync(proxyClient1,
-                                    "RemoveSession",
-                                    g_variant_new("(o)", sessionPath.c_str()),
-                                    G_DBUS_CALL_FLAGS_NONE, -1,
-                                    NULL, &gerror);
-  if (NULL == response)
-  {
-    LOG_ERROR() << "Cannot call RemoveSession : " << GERROR_MESSAGE(gerror)<<std::endl;
-    if (NULL != gerror && gerror->domain == G_DBUS_ERROR)
-    {
-      char* err = g_dbus_error_get_remote_error(gerror);
-      LOG_ERROR() << "Exception: " << err<<std::endl;
-      g_free(err);
-      GERROR_FREE(gerror);
-    }
-    res = false;
-  }
+  connection = session->getConnection();
+  proxyPhonebookAccess1 = session->getPhonebookAccess();
+  sessionPath = session->getPath();
+  return true;
+}
 
-  if (res)
+bool PBAPSource::disconnectSession()
+{
+  if(NULL == session)
   {
-    sessionPath.clear();
-    transfer.clean();
-    g_variant_unref(response);
+    return false;
   }
 
-  return res;
+  transfer.clean();
+  PBAPSession::release(session);
+  session = NULL;
+  connection = NULL;
+  proxyPhonebookAccess1 = NULL;
+  sessionPath.clear();
+  return true;
 }
 
 bool PBAPSource::selectPhonebook()
 {
-  GError* gerror = NULL;
-  GVariant* response;
-  bool res = true;
-
-  response = g_dbus_proxy_call_sync(proxyPhonebookAccess1,
-                                    "Select",
-                                    g_variant_new("(ss)", pbLocation.c_str(), "pb"),
-                                    G_DBUS_CALL_FLAGS_NONE, -1,
-                                    NULL, &gerror);
-  if (!response)
-  {
-    LOG_ERROR() << "Cannot call Select : " << GERROR_MESSAGE(gerror)<<std::endl;
-    if (NULL != gerror && gerror->domain == G_DBUS_ERROR)
-    {
-      char* err = g_dbus_error_get_remote_error(gerror);
-      LOG_ERROR() << "Exception: " << err<<std::endl;
-      g_free(err);
-      GERROR_FREE(gerror);
-    }
-    res = false;
-  }
-
-  if (res)
-  {
-    g_variant_unref(response);
-  }
-  return res;
+  return session->select(pbLocation, pbName);
 }
 
 bool PBAPSource::getPhonebookSize()
@@ -408,15 +399,10 @@ bool PBAPSource::pullPhonebook(unsigned int offset, unsigned int count)
   GVariant* response;
   GVariant* transferPathVariant;
   bool res = true;
-  const gchar** fields = new const gchar*[filters.size()];
-  for(unsigned int i = 0; i < filters.size(); ++i)
-  {
-    fields[i] = filters[i].c_str();
-  }
 
   builder = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
   g_variant_builder_add(builder, "{sv}", "Format", g_variant_new_string("vcard30"));
-  g_variant_builder_add(builder, "{sv}", "Fields", g_variant_new_strv(fields, filters.size()));
+  g_variant_builder_add(builder, "{sv}", "Fields", newFieldsFilter());
   g_variant_builder_add(builder, "{sv}", "Offset", g_variant_new_uint16(offset));
   g_variant_builder_add(builder, "{sv}", "MaxCount", g_variant_new_uint16(count));
 
@@ -453,95 +439,269 @@ bool PBAPSource::pullPhonebook(unsigned int offset, unsigned int count)
     g_variant_unref(response);
   }
 
-  delete[] fields;
   return res;
 }
 
-enum OpenAB_Source::Source::eGetItemRet PBAPSource::getItem(OpenAB::SmartPtr<OpenAB::PIMItem> & item)
+bool PBAPSource::pullVCard(const std::string& handle)
 {
-  static int counter = 0;
-  std::string line;
-  std::string vCard;
-  while (fifoBuffer.tryPop(line))
+  GError* gerror = NULL;
+  GVariantBuilder *builder;
+  GVariant* response;
+  GVariant* transferPathVariant;
+  bool res = true;
+
+  builder = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
+  g_variant_builder_add(builder, "{sv}", "Format", g_variant_new_string("vcard30"));
+  g_variant_builder_add(builder, "{sv}", "Fields", newFieldsFilter());
+
+  response = g_dbus_proxy_call_sync(proxyPhonebookAccess1,
+                                    "Pull",
+                                    g_variant_new("(ssa{sv})",
+                                                  handle.c_str(),
+                                                  tempFIFO.c_str(),
+                                                  builder),
+                                    G_DBUS_CALL_FLAGS_NONE, -1,
+                                    NULL, &gerror);
+  g_variant_builder_unref (builder);
+  if(!response)
   {
-    //LOG_DEBUG() << line;
-    vCard += line + "\n";
-    if (0 == line.compare(0, 11, "BEGIN:VCARD"))
-    {
-      vCard.clear();
-      vCard += line + "\n";
-      counter++;
-    }
-    else if (0 == line.compare(0, 9, "END:VCARD"))
+    LOG_ERROR() << "Cannot call Pull : " << GERROR_MESSAGE(gerror)<<std::endl;
+    if (NULL != gerror && gerror->domain == G_DBUS_ERROR)
     {
-      OpenAB::PIMContactItem *newContactItem = new OpenAB::PIMContactItem();
-      if (newContactItem->parse(vCard))
-      {
-        item = newContactItem;
-        return eGetItemRetOk;
-      }
-      else
-      {
-        delete newContactItem;
-        return eGetItemRetError;
-      }
+      char* err = g_dbus_error_get_remote_error(gerror);
+      LOG_ERROR() << "Exception: " << err<<std::endl;
+      g_free(err);
+      GERROR_FREE(gerror);
     }
-  }
-  vCard.clear();
-  return transferStatus;
-}
 
-enum OpenAB_Source::Source::eSuspendRet PBAPSource::suspend()
-{
-  unsigned int numRetries = 5;
-  while(!transfer.isInitialized() && numRetries--)
-  {
-    LOG_DEBUG()<<"Waiting for transfer to suspend"<<std::endl;
-    usleep(1000);
+    res = false;
   }
-
-  if(transfer.isInitialized())
+  if (res)
   {
-    if (transfer.suspend())
-      return eSuspendRetOk;
+    transferPathVariant = g_variant_get_child_value(response, 0);
+    const gchar *transferPath = g_variant_get_string(transferPathVariant, NULL);
+    transfer.init(connection, transferPath);
+    transferStatus = eGetItemRetOk;
+    g_variant_unref(transferPathVariant);
+    g_variant_unref(response);
   }
-  LOG_DEBUG()<<"Suspend failed"<<std::endl;
-  return eSuspendRetFail;
+
+  return res;
 }
 
-enum OpenAB_Source::Source::eResumeRet PBAPSource::resume()
+GVariant* PBAPSource::newFieldsFilter()
 {
-  if(transfer.isInitialized())
+  const gchar** fields = new const gchar*[filters.size()];
+  for(unsigned int i = 0; i < filters.size(); ++i)
   {
-    if (transfer.resume())
-      return eResumeRetOk;
+    fields[i] = filters[i].c_str();
   }
-
-  return eResumeRetFail;
+  GVariant* res = g_variant_new_strv(fields, filters.size());
+  delete[] fields;
+  return res;
 }
 
-enum OpenAB_Source::Source::eCancelRet PBAPSource::cancel()
+bool PBAPSource::listPhonebook(Listing& result)
 {
-  unsigned int numRetries = 5;
-  while(!transfer.isInitialized() && numRetries--)
+  GError* gerror = NULL;
+  GVariantBuilder *builder;
+  GVariant* response;
+  bool res = true;
+
+  result.clear();
+  builder = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
+  g_variant_builder_add(builder, "{sv}", "Order", g_variant_new_string("indexed"));
+
+  response = g_dbus_proxy_call_sync(proxyPhonebookAccess1,
+                                    "List",
+                                    g_variant_new("(a{sv})", builder),
+                                    G_DBUS_CALL_FLAGS_NONE, -1,
+                                    NULL, &gerror);
+  g_variant_builder_unref (builder);
+  if(!response)
   {
-    usleep(1000);
+    LOG_ERROR() << "Cannot call List : " << GERROR_MESSAGE(gerror)<<std::endl;
+    if (NULL != gerror && gerror->domain == G_DBUS_ERROR)
+    {
+      char* err = g_dbus_error_get_remote_error(gerror);
+      LOG_ERROR() << "Exception: " << err<<std::endl;
+      g_free(err);
+      GERROR_FREE(gerror);
+    }
+    res = false;
   }
 
-  if(transfer.isInitialized())
+  if (res)
   {
-    if (transfer.cancel())
-      return eCancelRetOk;
+    GVariant* entries = g_variant_get_child_value(response, 0);
+    GVariantIter iter;
+    const gchar* handle = NULL;
+    const gchar* name = NULL;
+    g_variant_iter_init(&iter, entries);
+    while (g_variant_iter_next(&iter, "(&s&s)", &handle, &name))
+    {
+      result.push_back(std::make_pair(std::string(handle), std::string(name)));
+    }
+    g_variant_unref(entries);
+    g_variant_unref(response);
   }
 
-  return eCancelRetFail;
+  return res;
+}
+
+bool PBAPSource::getPhonebookVersion(std::string& version)
+{
+  GError* gerror = NULL;
+  GVariant* response;
+
+  version.clear();
+
+  //refresh version counters, not supported by older versions of BlueZ
+  response = g_dbus_proxy_call_sync(proxyPhonebookAccess1,
+                                    "UpdateVersion",
+                                    NULL,
+                                    G_DBUS_CALL_FLAGS_NONE, -1,
+                                    NULL, &gerror);
+  if (NULL == response)
+  {
+    LOG_DEBUG() << "Cannot call UpdateVersion : " << GERROR_MESSAGE(gerror)<<std::endl;
+    GERROR_FREE(gerror);
+  }
+  else
+  {
+    g_variant_unref(response);
+  }
+
+  response = g_dbus_connection_call_sync(connection,
+                                         "org.bluez.obex",
+                                         sessionPath.c_str(),
+                                         "org.freedesktop.DBus.Properties",
+                                         "GetAll",
+                                         g_variant_new("(s)", "org.bluez.obex.PhonebookAccess1"),
+                                         G_VARIANT_TYPE("(a{sv})"),
+                                         G_DBUS_CALL_FLAGS_NONE, -1,
+                                         NULL, &gerror);
+  if (NULL == response)
+  {
+    LOG_DEBUG() << "Cannot get PhonebookAccess1 properties : " << GERROR_MESSAGE(gerror)<<std::endl;
+    GERROR_FREE(gerror);
+    return false;
+  }
+
+  GVariant* properties = g_variant_get_child_value(response, 0);
+  const gchar* databaseIdentifier = NULL;
+  const gchar* primaryCounter = NULL;
+  const gchar* secondaryCounter = NULL;
+  if (g_variant_lookup(properties, "DatabaseIdentifier", "&s", &databaseIdentifier) &&
+      g_variant_lookup(properties, "PrimaryCounter", "&s", &primaryCounter) &&
+      g_variant_lookup(properties, "SecondaryCounter", "&s", &secondaryCounter))
+  {
+    version = std::string(databaseIdentifier) + "|" + primaryCounter + "|" + secondaryCounter;
+    LOG_DEBUG() << "Phonebook version " << version<<std::endl;
+  }
+  g_variant_unref(properties);
+  g_variant_unref(response);
+
+  return !version.empty();
+}
+
+enum OpenAB_Source::Source::eGetItemRet PBAPSource::getItem(OpenAB::SmartPtr<OpenAB::PIMItem> & item)
+{
+  OpenAB::PIMContactItem *newContactItem = NULL;
+  if (!vCards.pop(newContactItem))
+  {
+    //download thread closes queue after setting final status of transfer,
+    //if it is still not set download was cancelled
+    if (eGetItemRetOk == transferStatus)
+    {
+      return eGetItemRetError;
+    }
+    return transferStatus;
+  }
+
+  //vCards are parsed by workers of parse stage
+  if (NULL != newContactItem)
+  {
+    item = newContactItem;
+    return eGetItemRetOk;
+  }
+  return eGetItemRetError;
+}
+
+enum OpenAB_Source::Source::eSuspendRet PBAPSource::suspend()
+{
+  unsigned int numRetries = 5;
+  while(!transfer.isInitialized() && numRetries--)
+  {
+    LOG_DEBUG()<<"Waiting for transfer to suspend"<<std::endl;
+    usleep(1000);
+  }
+
+  if(transfer.isInitialized())
+  {
+    if (transfer.suspend())
+      return eSuspendRetOk;
+  }
+  LOG_DEBUG()<<"Suspend failed"<<std::endl;
+  return eSuspendRetFail;
+}
+
+enum OpenAB_Source::Source::eResumeRet PBAPSource::resume()
+{
+  if(transfer.isInitialized())
+  {
+    if (transfer.resume())
+      return eResumeRetOk;
+  }
+
+  return eResumeRetFail;
+}
+
+enum OpenAB_Source::Source::eCancelRet PBAPSource::cancel()
+{
+  unsigned int numRetries = 5;
+  while(!transfer.isInitialized() && numRetries--)
+  {
+    usleep(1000);
+  }
+
+  if(transfer.isInitialized())
+  {
+    if (transfer.cancel())
+    {
+      //unblock both download thread and getItem
+      vCards.close();
+      wakeup();
+      return eCancelRetOk;
+    }
+  }
+
+  return eCancelRetFail;
 }
 
 int PBAPSource::getTotalCount() const
 {
+  if (callHistoryDelta)
+  {
+    return -1;
+  }
   return phonebookSize;
 }
 
+bool PBAPSource::isDelta() const
+{
+  return callHistoryDelta;
+}
+
+void PBAPSource::commitDelta()
+{
+  //cursor can be moved only when all new entries were returned
+  if (callHistoryDelta && eGetItemRetEnd == transferStatus)
+  {
+    saveCursor();
+  }
+}
+
 void * PBAPSource::threadFuncFIFOWrapper(void* ptr)
 {
   LOG_FUNC();
@@ -551,21 +711,39 @@ void * PBAPSource::threadFuncFIFOWrapper(void* ptr)
     return NULL;
   }
   input->threadFuncFIFO();
+  input->removeFIFO();
   return NULL;
 }
 
 void PBAPSource::threadFuncFIFO()
 {
+  if (callHistoryDelta)
+  {
+    threadFuncCallHistory();
+    return;
+  }
+
+  if (incrementalSync)
+  {
+    threadFuncIncremental();
+    return;
+  }
+
   unsigned int startOffset = 0;
   unsigned int chunkStart = 0;
   unsigned int chunkSize = phonebookSize;
   unsigned int chunksEnd = phonebookSize;
   unsigned int toDownload = phonebookSize;
-  OpenAB::TimeStamp lastChunkDownloadStartTime;
-  OpenAB::TimeStamp lastChunkDownloadStopTime;
-  unsigned int lastChunkDownloadTime;
+  OpenAB::TimeStamp chunkDownloadStartTime;
+  PBAPChunkController chunkController(batchDownloadDesiredTime, BATCH_MIN_SIZE, BATCH_MAX_SIZE);
+
+  //buffers reused by all chunks
+  std::string buffer;
+  std::vector<char> readBuffer(FIFO_READ_SIZE);
+  bool queueClosed = false;
 
-  if (batchDownloadDesiredTime > 0)
+  //empty phonebook has nothing to download, offset of first chunk cannot be chosen
+  if (batchDownloadDesiredTime > 0 && phonebookSize > 0)
   {
     startOffset = rand()%phonebookSize;
     chunkStart = startOffset;
@@ -575,17 +753,7 @@ void PBAPSource::threadFuncFIFO()
   {
     if (batchDownloadDesiredTime > 0)
     {
-      lastChunkDownloadTime = (lastChunkDownloadStopTime - lastChunkDownloadStartTime).toMs();
-      if (lastChunkDownloadTime != 0)
-      {
-        LOG_DEBUG()<<"Chunk download time "<<lastChunkDownloadTime<<" ms"<<std::endl;
-        chunkSize = (batchDownloadDesiredTime * chunkSize) / lastChunkDownloadTime;
-        LOG_DEBUG()<<"Updating chunk size to "<<chunkSize<<std::endl;
-      }
-      else
-      {
-        chunkSize = 10;
-      }
+      chunkSize = chunkController.getChunkSize();
 
       if (chunkStart + chunkSize > chunksEnd)
       {
@@ -593,155 +761,642 @@ void PBAPSource::threadFuncFIFO()
       }
     }
 
-    /**
-     * create a FIFO (tempFIFO)
-     */
-    tempFIFO = tmpnam(NULL);
-    LOG_DEBUG() << "Temporary FIFO: " << tempFIFO<<std::endl;
-
-    if (0 != mkfifo( tempFIFO.c_str() , 0600 )){
-      LOG_ERROR() << "Cannot create the FIFO: " << tempFIFO << " err:" << strerror(errno)<<std::endl;
-      transferStatus = eGetItemRetError;
-      fifoBuffer.close();
+    chunkDownloadStartTime.setNow();
+    if (!downloadToFIFO("", chunkStart, chunkSize, buffer, readBuffer, queueClosed))
+    {
+      vCards.close();
       disconnectSession();
       return;
     }
 
-    //open FIFO temprary in non-blocking mode so that BlueZ can start writing to FIFO
-    int fd = open(tempFIFO.c_str(), O_RDONLY | O_NONBLOCK);
+    if (queueClosed)
+    {
+      LOG_DEBUG()<<"Download cancelled"<<std::endl;
+      break;
+    }
 
-    if (!pullPhonebook(chunkStart, chunkSize))
+    if (batchDownloadDesiredTime > 0)
     {
-      LOG_ERROR()<<"Cannot pull phonebook"<<std::endl;
-      transferStatus = eGetItemRetError;
-      fifoBuffer.close();
-      disconnectSession();
-      return;
+      unsigned int chunkDownloadTime = (OpenAB::TimeStamp(true) - chunkDownloadStartTime).toMs();
+      chunkController.chunkDownloaded(chunkSize, chunkDownloadTime);
+      const PBAPChunkController::ChunkStats& stats = chunkController.getStats().back();
+      LOG_DEBUG()<<"Chunk "<<chunkController.getStats().size()<<": "<<stats.size<<" items in "<<stats.timeMs<<" ms ("
+                 <<stats.itemsPerSecond<<" items/s), estimated overhead "<<chunkController.getOverheadTime()
+                 <<" ms, time per item "<<chunkController.getItemTime()<<" ms, next chunk size "
+                 <<chunkController.getChunkSize()<<std::endl;
     }
-    lastChunkDownloadStartTime.setNow();
 
-    //open FIFO using ifstream (ifstream is not supporting non-blocking mode)
-    std::ifstream fifoStream(tempFIFO.c_str());
+    toDownload -= chunkSize;
+    chunkStart += chunkSize;
+    if (chunkStart >= chunksEnd)
+    {
+      chunkStart = 0;
+      chunksEnd = startOffset;
+    }
+  }
+
+  if (!queueClosed && eGetItemRetError != transferStatus)
+  {
+    //status of last transfer is not set if nothing was downloaded (empty phonebook)
+    transferStatus = eGetItemRetEnd;
+    finishIncrementalSync();
+  }
+  vCards.close();
+  disconnectSession();
+}
+
+bool PBAPSource::downloadToFIFO(const std::string& handle,
+                                unsigned int offset, unsigned int count,
+                                std::string& buffer, std::vector<char>& readBuffer,
+                                bool& queueClosed)
+{
+  queueClosed = false;
+
+  if (!createFIFO())
+  {
+    transferStatus = eGetItemRetError;
+    return false;
+  }
+
+  //FIFO is reopened for each transfer, as after BlueZ closed it poll would keep reporting end of file
+  //open FIFO in non-blocking mode so that BlueZ can start writing to FIFO,
+  //and download thread can wait for both data and transfer status changes
+  int fd = open(tempFIFO.c_str(), O_RDONLY | O_NONBLOCK);
+  if (-1 == fd)
+  {
+    LOG_ERROR() << "Cannot open the FIFO: " << tempFIFO << " err:" << strerror(errno)<<std::endl;
+    transferStatus = eGetItemRetError;
+    return false;
+  }
+
+  //status of previous transfer is not valid anymore
+  transferStatus = eGetItemRetOk;
+  currentHandle = handle;
+  listingPosition = offset;
+  //phonebook selected by this source could be changed by other source sharing the session
+  session->lock();
+  bool pulled = selectPhonebook() &&
+                (handle.empty() ? pullPhonebook(offset, count) : pullVCard(handle));
+  session->unlock();
+  if (!pulled)
+  {
+    LOG_ERROR()<<"Cannot pull phonebook"<<std::endl;
     close(fd);
+    currentHandle.clear();
+    transferStatus = eGetItemRetError;
+    return false;
+  }
+
+  transfer.setCallback(transferStatusChanged, this);
+  if (transfer.getStatus() == BluezOBEXTransfer::eStatusComplete)
+  {
+   transferStatus = eGetItemRetEnd;
+   transfer.clean();
+  }
+  else if(transfer.getStatus() == BluezOBEXTransfer::eStatusError)
+  {
+    transferStatus = eGetItemRetError;
+    transfer.clean();
+  }
+
+  queueClosed = !readFIFO(fd, buffer, readBuffer);
+
+  close(fd);
+  currentHandle.clear();
+  return true;
+}
+
+bool PBAPSource::createFIFO()
+{
+  if (!tempFIFO.empty())
+  {
+    return true;
+  }
+
+  //FIFO is created in private directory, so its name cannot be taken over by other process
+  char dirTemplate[] = "/tmp/oab_pbap_XXXXXX";
+  if (NULL == mkdtemp(dirTemplate))
+  {
+    LOG_ERROR() << "Cannot create directory for the FIFO, err:" << strerror(errno)<<std::endl;
+    return false;
+  }
+
+  std::string fifo = std::string(dirTemplate) + "/phonebook.vcf";
+  LOG_DEBUG() << "Temporary FIFO: " << fifo<<std::endl;
+  if (0 != mkfifo(fifo.c_str(), 0600))
+  {
+    LOG_ERROR() << "Cannot create the FIFO: " << fifo << " err:" << strerror(errno)<<std::endl;
+    rmdir(dirTemplate);
+    return false;
+  }
+
+  tempFIFO = fifo;
+  return true;
+}
+
+void PBAPSource::removeFIFO()
+{
+  if (tempFIFO.empty())
+  {
+    return;
+  }
+
+  if (0 != unlink(tempFIFO.c_str()))
+  {
+    LOG_ERROR() << "Cannot remove the FIFO: " << tempFIFO << "err: " << strerror(errno)<<std::endl;
+  }
+  rmdir(tempFIFO.substr(0, tempFIFO.rfind('/')).c_str());
+  tempFIFO.clear();
+}
+
+void PBAPSource::prepareIncrementalSync()
+{
+  incrementalSync = false;
+  partialSync = false;
+  cacheComplete = true;
+  listing.clear();
+  replayHandles.clear();
+  pullHandles.clear();
+  oldHandles.clear();
+  newState = PBAPCache::State();
+  currentHandle.clear();
+  currentDigest.clear();
+  listingPosition = 0;
+
+  if (cacheDir.empty())
+  {
+    return;
+  }
+
+  //downloaded vCards depend on used filters, so they are part of cache key
+  std::string key = macAddress + " " + pbLocation + " " + pbName;
+  std::vector<std::string>::iterator it;
+  for(it = filters.begin(); it != filters.end(); ++it)
+  {
+    key += " " + (*it);
+  }
+
+  cache = new PBAPCache(cacheDir, key);
+  if (!cache->init())
+  {
+    delete cache;
+    cache = NULL;
+    return;
+  }
+
+  PBAPCache::State oldState;
+  bool stateLoaded = cache->loadState(oldState);
+  oldHandles = oldState.handles;
+  getPhonebookVersion(newState.version);
+
+  if (stateLoaded && !newState.version.empty() && newState.version == oldState.version)
+  {
+    LOG_DEBUG()<<"Phonebook not changed since last synchronization, providing vCards from cache"<<std::endl;
+    replayHandles = oldState.handles;
+    incrementalSync = true;
+    return;
+  }
 
+  if (!listPhonebook(listing))
+  {
+    //vCards will be downloaded, but cannot be cached without knowing their handles
+    listing.clear();
+    return;
+  }
+
+  if (!stateLoaded)
+  {
+    return;
+  }
 
-    transfer.setCallback(transferStatusChanged, this);
-    if (transfer.getStatus() == BluezOBEXTransfer::eStatusComplete)
+  Listing::iterator entry;
+  for (entry = listing.begin(); entry != listing.end(); ++entry)
+  {
+    std::string entryDigest = PBAPCache::digest(trimName((*entry).second));
+    PBAPCache::Handles::iterator cached = oldState.handles.find((*entry).first);
+    if (cached != oldState.handles.end() && (*cached).second == entryDigest)
     {
-     transferStatus = eGetItemRetEnd;
-     transfer.clean();
+      replayHandles[(*entry).first] = entryDigest;
     }
-    else if(transfer.getStatus() == BluezOBEXTransfer::eStatusError)
+    else
     {
-      transferStatus = eGetItemRetError;
-      transfer.clean();
+      pullHandles[(*entry).first] = entryDigest;
     }
+  }
 
-    std::string line;
-    while(transferStatus != eGetItemRetEnd &&
-          transferStatus != eGetItemRetError)
-    {
-      while(std::getline(fifoStream,line)){
-        fifoBuffer.tryPush(line);
-      }
-    }
+  //when listing did not change, but version did (or is unknown) there is no way to find modified vCards,
+  //when most of vCards changed downloading them one by one is slower than single PullAll
+  if (pullHandles.empty() || pullHandles.size() > listing.size() / 2)
+  {
+    LOG_DEBUG()<<"Downloading whole phonebook, "<<pullHandles.size()<<" of "<<listing.size()<<" vCards changed"<<std::endl;
+    replayHandles.clear();
+    pullHandles.clear();
+    return;
+  }
+
+  //vCards with unchanged listing entries may still have other fields modified,
+  //bound how long they can be replayed from cache without full download
+  if (oldState.partialSyncs >= MAX_PARTIAL_SYNCS)
+  {
+    LOG_DEBUG()<<"Downloading whole phonebook after "<<oldState.partialSyncs<<" partial synchronizations"<<std::endl;
+    replayHandles.clear();
+    pullHandles.clear();
+    return;
+  }
 
-    while(std::getline(fifoStream,line)){
-      fifoBuffer.tryPush(line);
+  LOG_DEBUG()<<"Downloading "<<pullHandles.size()<<" of "<<listing.size()<<" vCards"<<std::endl;
+  newState.partialSyncs = oldState.partialSyncs + 1;
+  partialSync = true;
+  incrementalSync = true;
+}
+
+void PBAPSource::threadFuncIncremental()
+{
+  std::string buffer;
+  std::vector<char> readBuffer(FIFO_READ_SIZE);
+  bool queueClosed = false;
+
+  PBAPCache::Handles::iterator it;
+  for (it = replayHandles.begin(); it != replayHandles.end() && !queueClosed; ++it)
+  {
+    std::string* vCard = new std::string();
+    if (!cache->lookup((*it).first, *vCard))
+    {
+      LOG_DEBUG()<<"vCard "<<(*it).first<<" not found in cache"<<std::endl;
+      delete vCard;
+      pullHandles[(*it).first] = (*it).second;
+      continue;
     }
-    toDownload -= chunkSize;
-    chunkStart += chunkSize;
-    if (chunkStart >= chunksEnd)
+    newState.handles[(*it).first] = (*it).second;
+    if (!vCards.push(vCard))
     {
-      chunkStart = 0;
-      chunksEnd = startOffset;
+      queueClosed = true;
     }
+  }
 
-    fifoStream.close();
-    if (-1 != access(tempFIFO.c_str(), F_OK))
+  for (it = pullHandles.begin(); it != pullHandles.end() && !queueClosed; ++it)
+  {
+    currentDigest = (*it).second;
+    if (!downloadToFIFO((*it).first, 0, 1, buffer, readBuffer, queueClosed) ||
+        eGetItemRetError == transferStatus)
     {
-      if (0 != unlink(tempFIFO.c_str()))
-      {
-        LOG_ERROR() << "Cannot remove the FIFO: " << tempFIFO << "err: " << strerror(errno)<<std::endl;
-      }
+      break;
     }
-    lastChunkDownloadStopTime.setNow();
   }
-  fifoBuffer.close();
+  currentDigest.clear();
+
+  if (queueClosed)
+  {
+    LOG_DEBUG()<<"Download cancelled"<<std::endl;
+  }
+  else if (eGetItemRetError != transferStatus)
+  {
+    transferStatus = eGetItemRetEnd;
+    finishIncrementalSync();
+  }
+  vCards.close();
   disconnectSession();
 }
 
-void PBAPSource::transferStatusChanged(BluezOBEXTransfer::Status status, void*userData)
+void PBAPSource::threadFuncCallHistory()
 {
-  PBAPSource* input = static_cast<PBAPSource*>(userData);
-  switch(status)
+  std::string buffer;
+  std::vector<char> readBuffer(FIFO_READ_SIZE);
+  bool queueClosed = false;
+  unsigned int offset = 0;
+  unsigned int count = CALL_HISTORY_FIRST_BATCH;
+
+  newCursor.clear();
+  cursorFound = false;
+
+  //call history is sorted from the newest entry, so download it from the beginning
+  //until entry that was the newest one during previous synchronization is found
+  while (!cursorFound && offset < phonebookSize)
   {
-    case BluezOBEXTransfer::eStatusComplete:
-      input->transferStatus = eGetItemRetEnd;
-      input->transfer.clean();
-      break;
-    case BluezOBEXTransfer::eStatusError:
-      input->transferStatus = eGetItemRetError;
-      input->transfer.clean();
+    if (offset + count > phonebookSize)
+    {
+      count = phonebookSize - offset;
+    }
+
+    if (!downloadToFIFO("", offset, count, buffer, readBuffer, queueClosed))
+    {
+      vCards.close();
+      disconnectSession();
+      return;
+    }
+
+    if (queueClosed)
+    {
+      LOG_DEBUG()<<"Download cancelled"<<std::endl;
       break;
-    case BluezOBEXTransfer::eStatusQueued:
-    case BluezOBEXTransfer::eStatusActive:
-    case BluezOBEXTransfer::eStatusSuspended:
+    }
+    if (eGetItemRetError == transferStatus)
+    {
       break;
+    }
+
+    offset += count;
+    count *= 2;
+  }
+
+  if (!queueClosed && eGetItemRetError != transferStatus)
+  {
+    LOG_DEBUG()<<"Call history downloaded up to entry "<<offset<<" of "<<phonebookSize<<std::endl;
+    transferStatus = eGetItemRetEnd;
   }
+  vCards.close();
+  disconnectSession();
 }
 
-FIFOBuffer::FIFOBuffer() :
-    size(0),
-    active(true)
+void PBAPSource::loadCursor()
 {
-  pthread_mutex_init(&mutex, NULL);
+  cursor.clear();
+  std::ifstream file(cursorFile.c_str(), std::ios_base::in);
+  if (file.is_open())
+  {
+    std::getline(file, cursor);
+  }
+  LOG_DEBUG()<<"Call history cursor: "<<cursor<<std::endl;
 }
 
-FIFOBuffer::~FIFOBuffer()
+void PBAPSource::saveCursor()
 {
-  pthread_mutex_destroy(&mutex);
+  //no new entries since previous synchronization
+  if (newCursor.empty() || newCursor == cursor)
+  {
+    return;
+  }
+
+  std::ofstream file(cursorFile.c_str(), std::ios_base::out | std::ios_base::trunc);
+  file<<newCursor<<std::endl;
+  file.close();
+  if (file.fail())
+  {
+    LOG_ERROR()<<"Cannot store call history cursor in "<<cursorFile<<std::endl;
+    return;
+  }
+  cursor = newCursor;
 }
 
-void FIFOBuffer::tryPush(const std::string& s)
+void PBAPSource::finishIncrementalSync()
 {
- /* if (!active)
+  if (NULL == cache)
   {
     return;
-  }*/
+  }
+
+  PBAPCache::Handles::iterator it;
+  for (it = oldHandles.begin(); it != oldHandles.end(); ++it)
+  {
+    if (newState.handles.find((*it).first) == newState.handles.end())
+    {
+      cache->remove((*it).first);
+    }
+  }
+
+  //do not allow skipping synchronization if not all vCards are available in cache,
+  //or if some of them were replayed from cache only because their listing entries did not change
+  if (!cacheComplete || partialSync)
+  {
+    newState.version.clear();
+  }
+
+  if (!cache->saveState(newState))
+  {
+    LOG_ERROR()<<"Cannot store PBAP synchronization state"<<std::endl;
+  }
+}
+
+bool PBAPSource::readFIFO(int fd, std::string& buffer, std::vector<char>& readBuffer)
+{
+  bool eof = false;
+  buffer.clear();
+
+  while (transferStatus != eGetItemRetError &&
+         !(eof && transferStatus == eGetItemRetEnd))
+  {
+    struct pollfd fds[2];
+    nfds_t nfds = 1;
+    fds[0].fd = wakeupPipe[0];
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    //after end of file was reached only wait for transfer status change
+    if (!eof)
+    {
+      fds[1].fd = fd;
+      fds[1].events = POLLIN;
+      fds[1].revents = 0;
+      nfds = 2;
+    }
+
+    int timeout = (eGetItemRetEnd == transferStatus) ? FIFO_CLOSE_TIMEOUT : -1;
+    int ret = poll(fds, nfds, timeout);
+    if (ret < 0)
+    {
+      if (EINTR == errno)
+      {
+        continue;
+      }
+      LOG_ERROR() << "Cannot poll the FIFO: " << strerror(errno)<<std::endl;
+      transferStatus = eGetItemRetError;
+      return true;
+    }
+    if (0 == ret)
+    {
+      //transfer was completed, but FIFO was not closed by BlueZ
+      eof = true;
+      continue;
+    }
+
+    if (fds[0].revents & POLLIN)
+    {
+      char c;
+      while (read(wakeupPipe[0], &c, 1) > 0);
+      if (vCards.isClosed())
+      {
+        return false;
+      }
+    }
+
+    if (!eof && (fds[1].revents & (POLLIN | POLLHUP | POLLERR)))
+    {
+      ssize_t n = read(fd, &readBuffer[0], readBuffer.size());
+      if (n > 0)
+      {
+        buffer.append(&readBuffer[0], n);
+        if (!processFIFOData(buffer, false))
+        {
+          return false;
+        }
+      }
+      else if (0 == n)
+      {
+        eof = true;
+      }
+      else if (EAGAIN != errno && EINTR != errno)
+      {
+        LOG_ERROR() << "Cannot read the FIFO: " << strerror(errno)<<std::endl;
+        transferStatus = eGetItemRetError;
+        return true;
+      }
+    }
+  }
 
-  while (size > fifoBufferSize)
+  if (eof)
   {
-    usleep(100000);
+    return processFIFOData(buffer, true);
   }
-  pthread_mutex_lock(&mutex);
-  fifoBuffer.push(s);
-  ++size;
-  pthread_mutex_unlock(&mutex);
+  return true;
 }
 
-bool FIFOBuffer::tryPop(std::string& s)
+bool PBAPSource::processFIFOData(std::string& buffer, bool eof)
 {
-  while (size <= 0)
+  static const char beginMarker[] = "BEGIN:VCARD";
+  static const char endMarker[] = "END:VCARD";
+
+  const char* data = buffer.data();
+  const char* dataEnd = data + buffer.size();
+  const char* pos = data;
+
+  while (pos < dataEnd)
   {
-    if (!active)
+    const char* begin = OpenAB::findAtLineStart(data, dataEnd, pos, beginMarker, sizeof(beginMarker) - 1);
+    if (NULL == begin)
+    {
+      //data outside of vCards is ignored, keep only last incomplete line
+      //as it may contain beginning of next vCard
+      const char* lastLine = dataEnd;
+      while (lastLine > pos && '\n' != *(lastLine - 1))
+      {
+        --lastLine;
+      }
+      pos = lastLine;
+      break;
+    }
+
+    const char* end = OpenAB::findAtLineStart(data, dataEnd, begin, endMarker, sizeof(endMarker) - 1);
+    const char* lineEnd = NULL;
+    if (NULL != end)
+    {
+      lineEnd = static_cast<const char*>(memchr(end, '\n', dataEnd - end));
+      if (NULL != lineEnd)
+      {
+        ++lineEnd;
+      }
+      else if (eof)
+      {
+        lineEnd = dataEnd;
+      }
+    }
+
+    if (NULL == lineEnd)
+    {
+      //vCard is not complete yet
+      pos = begin;
+      break;
+    }
+
+    std::string* vCard = new std::string(begin, lineEnd);
+    if (lineEnd == dataEnd && '\n' != *(lineEnd - 1))
+    {
+      vCard->append("\n");
+    }
+    if (!deliverVCard(vCard))
     {
       return false;
     }
-    usleep(100000);
+    pos = lineEnd;
   }
-  pthread_mutex_lock(&mutex);
-  --size;
-  s = fifoBuffer.front();
-  fifoBuffer.pop();
-  pthread_mutex_unlock(&mutex);
+
+  buffer.erase(0, pos - data);
   return true;
 }
 
-void FIFOBuffer::close()
+bool PBAPSource::deliverVCard(std::string* vCard)
 {
-  active = false;
-};
+  if (callHistoryDelta)
+  {
+    //entries older than cursor were already provided
+    if (cursorFound)
+    {
+      delete vCard;
+      return true;
+    }
+    std::string entryDigest = PBAPCache::digest(*vCard);
+    if (entryDigest == cursor)
+    {
+      cursorFound = true;
+      delete vCard;
+      return true;
+    }
+    if (newCursor.empty())
+    {
+      newCursor = entryDigest;
+    }
+  }
+
+  if (NULL != cache)
+  {
+    bool stored = false;
+    if (!currentHandle.empty())
+    {
+      if (cache->store(currentHandle, *vCard))
+      {
+        newState.handles[currentHandle] = currentDigest;
+        stored = true;
+      }
+    }
+    else if (listingPosition < listing.size())
+    {
+      //vCards downloaded by PullAll are matched with listing by position,
+      //name is compared to make sure that phonebook was not modified in the meantime
+      const std::pair<std::string, std::string>& entry = listing[listingPosition];
+      std::string name = trimName(entry.second);
+      if (!name.empty() && name == getVCardName(*vCard) &&
+          cache->store(entry.first, *vCard))
+      {
+        newState.handles[entry.first] = PBAPCache::digest(name);
+        stored = true;
+      }
+    }
+    ++listingPosition;
+    cacheComplete = cacheComplete && stored;
+  }
+
+  return vCards.push(vCard);
+}
+
+void PBAPSource::wakeup()
+{
+  if (-1 != wakeupPipe[1])
+  {
+    char c = 0;
+    ssize_t ret = write(wakeupPipe[1], &c, 1);
+    (void)ret;
+  }
+}
+
+void PBAPSource::transferStatusChanged(BluezOBEXTransfer::Status status, void*userData)
+{
+  PBAPSource* input = static_cast<PBAPSource*>(userData);
+  switch(status)
+  {
+    case BluezOBEXTransfer::eStatusComplete:
+      input->transferStatus = eGetItemRetEnd;
+      input->transfer.clean();
+      input->wakeup();
+      break;
+    case BluezOBEXTransfer::eStatusError:
+      input->transferStatus = eGetItemRetError;
+      input->transfer.clean();
+      input->wakeup();
+      break;
+    case BluezOBEXTransfer::eStatusQueued:
+    case BluezOBEXTransfer::eStatusActive:
+    case BluezOBEXTransfer::eStatusSuspended:
+      break;
+  }
+}
 
 namespace {
   class PBAPFactory : OpenAB_Source::Factory
@@ -767,6 +1422,9 @@ namespace {
         std::string mac;
         std::string pbLoc = "int";
         std::string ignoreFields = "";
+        std::string cacheDir = "";
+        std::string phonebook = "pb";
+        std::string cursorFile = "";
         unsigned int batchDownloadTime = 0;
         PBAPSource * src = NULL;
         OpenAB::Variant param;
@@ -803,7 +1461,22 @@ namespace {
         }
         LOG_DEBUG()<<"BatchDownloadTime "<<batchDownloadTime;
 
-        src = new PBAPSource(mac, pbLoc, ignoreFields, batchDownloadTime);
+        param = params.getValue("cache_dir");
+        if (!param.invalid()){
+          cacheDir = param.getString();
+        }
+
+        param = params.getValue("phonebook");
+        if (!param.invalid()){
+          phonebook = param.getString();
+        }
+
+        param = params.getValue("cursor_file");
+        if (!param.invalid()){
+          cursorFile = param.getString();
+        }
+
+        src = new PBAPSource(mac, pbLoc, ignoreFields, batchDownloadTime, cacheDir, phonebook, cursorFile);
         if (NULL == src)
         {
           LOG_ERROR() << "Cannot Initialize PBAPInput"<<std::endl;
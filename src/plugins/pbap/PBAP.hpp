@@ -17,8 +17,9 @@
 
 #include <iostream>
 #include <fstream>
+#include <vector>
 
-#include <queue>
+#include <plugin/source/VCardParseStage.hpp>
 
 #include <cstdio>
 #include <cerrno>
@@ -29,24 +30,8 @@
 
 #include <pthread.h>
 #include "BluezOBEXTransfer.hpp"
-
-class FIFOBuffer
-{
-  public:
-    FIFOBuffer();
-    ~FIFOBuffer();
-
-    void tryPush(const std::string& s);
-    bool tryPop(std::string& s);
-    void close();
-
-  private:
-    static const unsigned int fifoBufferSize = 5000000;
-    unsigned int size;
-    bool active;
-    std::queue<std::string> fifoBuffer;
-    pthread_mutex_t mutex;
-};
+#include "PBAPCache.hpp"
+#include "PBAPSession.hpp"
 
 /**
  * @defgroup PBAPSource PBAP Source Plugin
@@ -61,8 +46,39 @@ class FIFOBuffer
  * |:-----------|:---------------------------------------------------------| :         |
  * | "MAC"      | Bluetooth MAC Address of the device                      | Yes       |
  * | "loc"      | Location of the addressbook (default = "int")            | No        |
+ * | "phonebook" | Phonebook to be downloaded (default = "pb")             | No        |
+ * | "cursor_file" | File storing newest downloaded call history entry, enables incremental download of call history | No |
  * | "ignore_fields" | Comma separated list of vCard fields to be not downloaded    | No |
- * | "batch_download_time" | Desired time of single PBAP batch download (when set to 0 - default - all contacts are downloaded in single PBAP transfer)| No |
+ * | "batch_download_time" | Desired time of single PBAP batch download in ms (when set to 0 - default - all contacts are downloaded in single PBAP transfer)| No |
+ * | "cache_dir" | Directory where downloaded vCards will be cached, enables incremental download | No |
+ *
+ * Size of batches is adjusted after each batch, so that batch download takes "batch_download_time"
+ * while batches are as big as possible (see PBAPChunkController), statistics of each batch are logged on debug level.
+ *
+ * When "cache_dir" is provided, downloaded vCards are cached per PBAP handle, together with
+ * phonebook version (database identifier and primary/secondary version counters of PBAP 1.2 devices).
+ * On next synchronization, when phonebook version did not change all vCards are provided from cache
+ * without any transfer. Otherwise vCard listing is downloaded and compared with cached one,
+ * only vCards with new handles or changed listing entries are downloaded using Pull.
+ * Full PullAll is done on first synchronization, when more than half of vCards changed, when
+ * phonebook version changed (or is not supported by device) but listing did not, and after
+ * MAX_PARTIAL_SYNCS consecutive synchronizations that downloaded only changed listing entries.
+ * @note listing reveals only new and renamed contacts, other modifications are detected only by version counters.
+ * That is why phonebook version is not stored after synchronization which replayed vCards with unchanged listing
+ * entries from cache, so next synchronization compares listing again and falls back to full PullAll
+ * when listing did not change.
+ *
+ * When "cursor_file" is provided for call history phonebook, only entries newer than newest entry
+ * provided during previous synchronization are returned. Call history is sorted from the newest entry,
+ * so it is downloaded in growing batches from its beginning until previously newest entry is found.
+ * Source reports itself as delta source (isDelta) in this mode and cursor is updated only when commitDelta is called
+ * after all entries were returned (getItem returned eGetItemRetEnd), so source initialized again before that
+ * (e.g. by next phase of synchronization) provides the same entries.
+ * getTotalCount returns -1 in this mode, as number of new entries is not known in advance.
+ *
+ * Several PBAP sources created for the same device (e.g. for contacts and call history phonebooks)
+ * share single OBEX session, so device is connected only once and requests of one source are queued
+ * while transfer of another one is ongoing. Each source provides items of its own phonebook only.
  *
  * @todo expose some more parameters for batch download like default size of batches with/without photos
  *
@@ -73,6 +89,15 @@ class FIFOBuffer
  * | "sim"    | (sim1)                            |
  * | "sim2"   | (sim2)                            |
  * |  ...     |                                   |
+ *
+ * **Phonebook** possible values:
+ * | Type     | Description                       |
+ * |:---------|:----------------------------------|
+ * | "pb"     | contacts (default if unspecified) |
+ * | "ich"    | incoming calls history            |
+ * | "och"    | outgoing calls history            |
+ * | "mch"    | missed calls history              |
+ * | "cch"    | combined calls history            |
  */
 class PBAPSource : public OpenAB_Source::Source
 {
@@ -81,7 +106,10 @@ class PBAPSource : public OpenAB_Source::Source
      *  @brief Constructor.
      */
     PBAPSource(const std::string& mac, const std::string& pb,
-               const std::string& filter, unsigned int batchDownloadTime);
+               const std::string& filter, unsigned int batchDownloadTime,
+               const std::string& cacheDir = "",
+               const std::string& phonebook = "pb",
+               const std::string& cursorFile = "");
 
     virtual ~PBAPSource();
 
@@ -97,6 +125,10 @@ class PBAPSource : public OpenAB_Source::Source
 
     int getTotalCount() const;
 
+    bool isDelta() const;
+
+    void commitDelta();
+
   private:
     /*!
      *  @brief Copy constructor, private unimplemented to prevent misuse.
@@ -112,6 +144,96 @@ class PBAPSource : public OpenAB_Source::Source
 
     static void* threadFuncFIFOWrapper(void* ptr);
     void threadFuncFIFO();
+
+    /*!
+     * @brief Reads FIFO until BlueZ closes it and transfer is completed or transfer fails.
+     * Waits for data and transfer status changes using poll, so no CPU time is used while BlueZ is not writing.
+     * @param [in] fd FIFO file descriptor opened in non-blocking mode.
+     * @param [in,out] buffer buffer for data not yet split into vCards.
+     * @param [in,out] readBuffer buffer used for single read.
+     * @return false if vCards queue was closed (download was cancelled), true otherwise.
+     */
+    bool readFIFO(int fd, std::string& buffer, std::vector<char>& readBuffer);
+
+    /*!
+     * @brief Splits complete vCards from buffer and passes them to consumer through vCards queue,
+     * incomplete data stays in buffer.
+     * @param [in,out] buffer data read from FIFO.
+     * @param [in] eof true if no more data will be read, so last vCard does not need to end with new line.
+     * @return false if vCards queue was closed (download was cancelled), true otherwise.
+     */
+    bool processFIFOData(std::string& buffer, bool eof);
+
+    /*!
+     * @brief Passes downloaded vCard to consumer and stores it in cache if enabled.
+     * @param [in] vCard downloaded vCard, ownership is passed to this function.
+     * @return false if vCards queue was closed (download was cancelled), true otherwise.
+     */
+    bool deliverVCard(std::string* vCard);
+
+    /*!
+     * @brief Downloads vCards using single PBAP transfer through FIFO.
+     * @param [in] handle handle of vCard to be downloaded using Pull, if empty PullAll is used.
+     * @param [in] offset offset of first vCard to be downloaded using PullAll.
+     * @param [in] count number of vCards to be downloaded using PullAll.
+     * @param [in,out] buffer buffer for data not yet split into vCards.
+     * @param [in,out] readBuffer buffer used for single read.
+     * @param [out] queueClosed set to true if download was cancelled.
+     * @return true if transfer was successful, false otherwise (transferStatus is set to error).
+     */
+    bool downloadToFIFO(const std::string& handle,
+                        unsigned int offset, unsigned int count,
+                        std::string& buffer, std::vector<char>& readBuffer,
+                        bool& queueClosed);
+
+    /*!
+     * @brief Creates FIFO used by all transfers of this source, if it was not created yet.
+     * @return true if FIFO is available, false otherwise.
+     */
+    bool createFIFO();
+
+    /*!
+     * @brief Removes FIFO created by @ref createFIFO.
+     */
+    void removeFIFO();
+
+    /*!
+     * @brief Provides vCards from cache and downloads only changed ones, used when @ref prepareIncrementalSync found
+     * that incremental download is possible.
+     */
+    void threadFuncIncremental();
+
+    /*!
+     * @brief Compares phonebook version and vCard listing with state of last synchronization
+     * and selects vCards to be provided from cache and vCards to be downloaded.
+     */
+    void prepareIncrementalSync();
+
+    /*!
+     * @brief Stores state of successful synchronization in cache and removes vCards that are no longer present.
+     */
+    void finishIncrementalSync();
+
+    /*!
+     * @brief Downloads call history entries newer than cursor, used when "cursor_file" was provided.
+     */
+    void threadFuncCallHistory();
+
+    /*!
+     * @brief Loads cursor of call history from cursor file.
+     */
+    void loadCursor();
+
+    /*!
+     * @brief Stores cursor of call history in cursor file.
+     */
+    void saveCursor();
+
+    /*!
+     * @brief Wakes up download thread waiting for data from FIFO.
+     */
+    void wakeup();
+
     static void transferStatusChanged(BluezOBEXTransfer::Status status, void*userData);
 
     bool createSession();
@@ -119,11 +241,34 @@ class PBAPSource : public OpenAB_Source::Source
     bool getPhonebookSize();
     bool getSupportedFilters();
     bool pullPhonebook(unsigned int offset, unsigned int count);
+    bool pullVCard(const std::string& handle);
     bool disconnectSession();
 
+    /*!
+     * @brief Reads phonebook version (database identifier and primary/secondary counters).
+     * @return false if version is not supported by device or BlueZ.
+     */
+    bool getPhonebookVersion(std::string& version);
+
+    /*!
+     * @brief vCard listing entries (handle and name).
+     */
+    typedef std::vector<std::pair<std::string, std::string> > Listing;
+
+    /*!
+     * @brief Downloads vCard listing (in the same order as vCards are downloaded using PullAll).
+     */
+    bool listPhonebook(Listing& listing);
+
+    /*!
+     * @brief Builds list of vCard fields to be downloaded.
+     */
+    GVariant* newFieldsFilter();
+
 
     std::string macAddress;
     std::string pbLocation;
+    std::string pbName;
     unsigned int batchDownloadDesiredTime;
 
 
@@ -132,12 +277,16 @@ class PBAPSource : public OpenAB_Source::Source
     std::vector<std::string> supportedFilters;
 
     std::string tempFIFO;
-    FIFOBuffer  fifoBuffer;
+    /*Complete vCards passed from download thread to getItem, parsed on the way by worker threads*/
+    OpenAB_Source::VCardParseStage vCards;
     pthread_t   threadFIFO;
     bool        threadCreated;
+    /*Pipe used to wake up download thread on transfer status change or cancel*/
+    int         wakeupPipe[2];
 
+    /*Session shared with other sources of the same device, connection and proxy are owned by session*/
+    PBAPSession*        session;
     GDBusConnection*    connection;
-    GDBusProxy*         proxyClient1;
     GDBusProxy*         proxyPhonebookAccess1;
     GDBusProxy*         proxyTransfer1;
     BluezOBEXTransfer   transfer;
@@ -145,6 +294,38 @@ class PBAPSource : public OpenAB_Source::Source
 
     std::string         sessionPath;
     unsigned int        phonebookSize;
+
+    std::string         cacheDir;
+    PBAPCache*          cache;
+    /*true if vCards should be provided from cache and only changed ones downloaded*/
+    bool                incrementalSync;
+    /*true if only vCards with changed listing entries are downloaded, replayed ones may be stale*/
+    bool                partialSync;
+    Listing             listing;
+    /*handles of vCards to be provided from cache*/
+    PBAPCache::Handles  replayHandles;
+    /*handles of vCards to be downloaded using Pull*/
+    PBAPCache::Handles  pullHandles;
+    /*handles present in cache before synchronization*/
+    PBAPCache::Handles  oldHandles;
+    /*state of current synchronization*/
+    PBAPCache::State    newState;
+    /*handle and listing digest of vCard currently downloaded using Pull*/
+    std::string         currentHandle;
+    std::string         currentDigest;
+    /*false if any of provided vCards could not be stored in cache*/
+    bool                cacheComplete;
+    /*position in listing of next vCard downloaded using PullAll*/
+    unsigned int        listingPosition;
+
+    std::string         cursorFile;
+    /*true if only call history entries newer than cursor should be provided*/
+    bool                callHistoryDelta;
+    /*digest of newest entry provided during previous synchronization*/
+    std::string         cursor;
+    /*digest of newest entry provided during current synchronization*/
+    std::string         newCursor;
+    bool                cursorFound;
 };
 
 #endif // PBAP_H_
@@ -0,0 +1,153 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file PBAPCache.cpp
+ */
+
+#include "PBAPCache.hpp"
+#include <helpers/Log.hpp>
+#include <helpers/FileHelper.hpp>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define PBAP_STATE_MAGIC "OpenAB-PBAPState 2"
+
+PBAPCache::PBAPCache(const std::string& cacheDir,
+                     const std::string& key) :
+    phonebookDir(cacheDir + "/" + digest(key)),
+    initialized(false)
+{
+}
+
+PBAPCache::~PBAPCache()
+{
+}
+
+bool PBAPCache::init()
+{
+  if (!OpenAB::makeDirs(phonebookDir))
+  {
+    LOG_ERROR()<<"Cannot create cache directory "<<phonebookDir<<std::endl;
+    return false;
+  }
+  initialized = true;
+  return true;
+}
+
+std::string PBAPCache::digest(const std::string& str)
+{
+  return OpenAB::hashFileName(str);
+}
+
+bool PBAPCache::loadState(State& state) const
+{
+  if (!initialized)
+  {
+    return false;
+  }
+
+  std::ifstream file((phonebookDir + "/state").c_str(), std::ios_base::in);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  std::string line;
+  if (!std::getline(file, line) || line != PBAP_STATE_MAGIC ||
+      !std::getline(file, state.version) ||
+      !std::getline(file, line))
+  {
+    return false;
+  }
+  state.partialSyncs = strtoul(line.c_str(), NULL, 10);
+
+  state.handles.clear();
+  while (std::getline(file, line))
+  {
+    std::string::size_type pos = line.find('\t');
+    if (pos == std::string::npos)
+    {
+      continue;
+    }
+    state.handles[line.substr(0, pos)] = line.substr(pos + 1);
+  }
+  return true;
+}
+
+bool PBAPCache::saveState(const State& state)
+{
+  if (!initialized || std::string::npos != state.version.find('\n'))
+  {
+    return false;
+  }
+
+  std::stringstream data;
+  data<<PBAP_STATE_MAGIC<<"\n"<<state.version<<"\n"<<state.partialSyncs<<"\n";
+  Handles::const_iterator it;
+  for (it = state.handles.begin(); it != state.handles.end(); ++it)
+  {
+    if (std::string::npos != (*it).first.find_first_of("\t\n"))
+    {
+      continue;
+    }
+    data<<(*it).first<<"\t"<<(*it).second<<"\n";
+  }
+
+  if (!OpenAB::writeFileAtomically(phonebookDir + "/state", data.str()))
+  {
+    LOG_DEBUG()<<"Cannot write cache file "<<phonebookDir<<"/state"<<std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool PBAPCache::lookup(const std::string& handle,
+                       std::string& vCard) const
+{
+  if (!initialized)
+  {
+    return false;
+  }
+
+  std::ifstream file((phonebookDir + "/" + digest(handle)).c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  std::ostringstream content;
+  content<<file.rdbuf();
+  vCard = content.str();
+  return !vCard.empty();
+}
+
+bool PBAPCache::store(const std::string& handle,
+                      const std::string& vCard)
+{
+  if (!initialized)
+  {
+    return false;
+  }
+  std::string path = phonebookDir + "/" + digest(handle);
+  if (!OpenAB::writeFileAtomically(path, vCard))
+  {
+    LOG_DEBUG()<<"Cannot write cache file "<<path<<std::endl;
+    return false;
+  }
+  return true;
+}
+
+void PBAPCache::remove(const std::string& handle)
+{
+  if (!initialized)
+  {
+    return;
+  }
+  unlink((phonebookDir + "/" + digest(handle)).c_str());
+}
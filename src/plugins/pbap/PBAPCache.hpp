@@ -0,0 +1,124 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file PBAPCache.hpp
+ */
+
+#ifndef PBAPCACHE_HPP_
+#define PBAPCACHE_HPP_
+
+#include <string>
+#include <map>
+
+/*!
+ * @brief On-disk cache of vCards downloaded from phonebook of single device.
+ *
+ * Together with vCards (stored per PBAP handle) cache keeps state of last synchronization:
+ * phonebook version (database identifier and version counters reported by PBAP 1.2 devices)
+ * and digests of vCard listing entries of all cached handles.
+ * This allows PBAP source to download only vCards that were added or modified since last synchronization.
+ */
+class PBAPCache
+{
+  public:
+    /*!
+     * @brief Handles of cached vCards mapped to digests of their vCard listing entries.
+     */
+    typedef std::map<std::string, std::string> Handles;
+
+    /*!
+     * @brief State of last synchronization.
+     */
+    struct State
+    {
+      State() : partialSyncs(0) {}
+
+      /*Phonebook version (database identifier, version counters and used filters), empty if unknown*/
+      std::string version;
+      /*Number of consecutive synchronizations that downloaded only vCards with changed listing entries*/
+      unsigned int partialSyncs;
+      /*Handles of all cached vCards*/
+      Handles handles;
+    };
+
+    /*!
+     *  @brief Constructor.
+     *  @param [in] cacheDir root directory of cache.
+     *  @param [in] key key identifying phonebook (e.g. device address, location and phonebook name).
+     */
+    PBAPCache(const std::string& cacheDir,
+              const std::string& key);
+
+    /*!
+     *  @brief Destructor, virtual by default.
+     */
+    virtual ~PBAPCache();
+
+    /*!
+     * @brief Creates cache directory of phonebook if it does not exist yet.
+     * @return true if cache directory is available, false otherwise.
+     */
+    bool init();
+
+    /*!
+     * @brief Loads state of last synchronization.
+     * @param [out] state loaded state.
+     * @return true if state was loaded, false if it does not exist or is invalid.
+     */
+    bool loadState(State& state) const;
+
+    /*!
+     * @brief Stores state of synchronization, replacing previous one.
+     * @param [in] state state to be stored.
+     * @return true if state was stored successfully, false otherwise.
+     */
+    bool saveState(const State& state);
+
+    /*!
+     * @brief Looks up cached vCard.
+     * @param [in] handle PBAP handle of vCard.
+     * @param [out] vCard cached vCard.
+     * @return true if vCard was found in cache, false otherwise.
+     */
+    bool lookup(const std::string& handle,
+                std::string& vCard) const;
+
+    /*!
+     * @brief Stores vCard in cache, replacing any previously cached version.
+     * @param [in] handle PBAP handle of vCard.
+     * @param [in] vCard vCard to be stored.
+     * @return true if vCard was stored successfully, false otherwise.
+     */
+    bool store(const std::string& handle,
+               const std::string& vCard);
+
+    /*!
+     * @brief Removes vCard from cache.
+     * @param [in] handle PBAP handle of vCard.
+     */
+    void remove(const std::string& handle);
+
+    /*!
+     * @brief Returns digest of given string (hex encoded FNV-1a hash).
+     */
+    static std::string digest(const std::string& str);
+
+  private:
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    PBAPCache(PBAPCache const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    PBAPCache& operator=(PBAPCache const &other);
+
+    std::string phonebookDir;
+    bool        initialized;
+};
+
+#endif // PBAPCACHE_HPP_
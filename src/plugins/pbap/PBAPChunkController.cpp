@@ -0,0 +1,124 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file PBAPChunkController.cpp
+ */
+
+#include "PBAPChunkController.hpp"
+
+/*Weight of previous batches when new batch is added*/
+#define HISTORY_DECAY 0.6
+
+/*Maximal growth of batch size between two batches*/
+#define MAX_GROWTH 2
+
+/*Minimal relative spread of batch sizes needed to estimate overhead separately from time per item*/
+#define MIN_SIZE_SPREAD 0.1
+
+PBAPChunkController::PBAPChunkController(unsigned int targetTime,
+                                         unsigned int minSize,
+                                         unsigned int maxSize) :
+    targetTime(targetTime),
+    minSize(minSize ? minSize : 1),
+    maxSize(maxSize < minSize ? minSize : maxSize),
+    chunkSize(this->minSize),
+    sumW(0),
+    sumX(0),
+    sumY(0),
+    sumXX(0),
+    sumXY(0),
+    itemTime(0),
+    overheadTime(0)
+{
+}
+
+PBAPChunkController::~PBAPChunkController()
+{
+}
+
+unsigned int PBAPChunkController::getChunkSize() const
+{
+  return chunkSize;
+}
+
+const std::vector<PBAPChunkController::ChunkStats>& PBAPChunkController::getStats() const
+{
+  return stats;
+}
+
+double PBAPChunkController::getItemTime() const
+{
+  return itemTime;
+}
+
+double PBAPChunkController::getOverheadTime() const
+{
+  return overheadTime;
+}
+
+void PBAPChunkController::chunkDownloaded(unsigned int size, unsigned int timeMs)
+{
+  if (0 == size)
+  {
+    return;
+  }
+  //time below timer resolution
+  if (0 == timeMs)
+  {
+    timeMs = 1;
+  }
+
+  ChunkStats chunk;
+  chunk.size = size;
+  chunk.timeMs = timeMs;
+  chunk.itemsPerSecond = (size * 1000.0) / timeMs;
+  stats.push_back(chunk);
+
+  double x = size;
+  double y = timeMs;
+  sumW = sumW * HISTORY_DECAY + 1;
+  sumX = sumX * HISTORY_DECAY + x;
+  sumY = sumY * HISTORY_DECAY + y;
+  sumXX = sumXX * HISTORY_DECAY + x * x;
+  sumXY = sumXY * HISTORY_DECAY + x * y;
+
+  double meanX = sumX / sumW;
+  double meanY = sumY / sumW;
+  double varX = sumXX / sumW - meanX * meanX;
+
+  itemTime = 0;
+  overheadTime = 0;
+  if (varX > (meanX * MIN_SIZE_SPREAD) * (meanX * MIN_SIZE_SPREAD))
+  {
+    itemTime = (sumXY / sumW - meanX * meanY) / varX;
+    overheadTime = meanY - itemTime * meanX;
+  }
+  //not enough different batch sizes to separate overhead, or estimation is not meaningful (e.g. noisy times)
+  if (itemTime <= 0 || overheadTime < 0)
+  {
+    itemTime = meanY / meanX;
+    overheadTime = 0;
+  }
+
+  double budget = targetTime - overheadTime;
+  double next = (budget > 0) ? budget / itemTime : minSize;
+
+  //last batches can be smaller than requested, growth is limited relative to requested size
+  double growthBase = (size > chunkSize) ? size : chunkSize;
+  if (next > growthBase * MAX_GROWTH)
+  {
+    next = growthBase * MAX_GROWTH;
+  }
+  if (next > maxSize)
+  {
+    next = maxSize;
+  }
+  if (next < minSize)
+  {
+    next = minSize;
+  }
+  chunkSize = (unsigned int)next;
+}
@@ -0,0 +1,102 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file PBAPChunkController.hpp
+ */
+
+#ifndef PBAPCHUNKCONTROLLER_HPP_
+#define PBAPCHUNKCONTROLLER_HPP_
+
+#include <vector>
+
+/*!
+ * @brief Selects size of PBAP batch downloads, so that single batch takes desired time.
+ *
+ * Time of batch download is modeled as fixed per transfer overhead plus time per downloaded item.
+ * Both are estimated using linear regression over downloaded batches, where older batches have
+ * exponentially decreasing weights, so estimation follows changing conditions (e.g. contacts with photos)
+ * without reacting to noise of single batch. Next batch size is the biggest one that should fit into desired
+ * time, as bigger batches amortize transfer overhead and give better throughput.
+ * Batch size is allowed to at most double between batches and is always kept between minimal and maximal size.
+ */
+class PBAPChunkController
+{
+  public:
+    /*!
+     * @brief Statistics of single downloaded batch.
+     */
+    struct ChunkStats
+    {
+      /*Number of downloaded items*/
+      unsigned int size;
+      /*Download time in ms*/
+      unsigned int timeMs;
+      /*Download throughput*/
+      double itemsPerSecond;
+    };
+
+    /*!
+     *  @brief Constructor.
+     *  @param [in] targetTime desired time of single batch download in ms.
+     *  @param [in] minSize minimal batch size, also used as size of first batch.
+     *  @param [in] maxSize maximal batch size.
+     */
+    PBAPChunkController(unsigned int targetTime,
+                        unsigned int minSize,
+                        unsigned int maxSize);
+
+    /*!
+     *  @brief Destructor, virtual by default.
+     */
+    virtual ~PBAPChunkController();
+
+    /*!
+     * @brief Returns size of next batch.
+     */
+    unsigned int getChunkSize() const;
+
+    /*!
+     * @brief Updates estimations with results of downloaded batch and calculates size of next batch.
+     * @param [in] size number of downloaded items.
+     * @param [in] timeMs download time in ms.
+     */
+    void chunkDownloaded(unsigned int size, unsigned int timeMs);
+
+    /*!
+     * @brief Returns statistics of all downloaded batches.
+     */
+    const std::vector<ChunkStats>& getStats() const;
+
+    /*!
+     * @brief Returns estimated download time of single item in ms.
+     */
+    double getItemTime() const;
+
+    /*!
+     * @brief Returns estimated fixed overhead of single batch download in ms.
+     */
+    double getOverheadTime() const;
+
+  private:
+    unsigned int targetTime;
+    unsigned int minSize;
+    unsigned int maxSize;
+    unsigned int chunkSize;
+
+    /*exponentially weighted sums of batch sizes (x) and download times (y)*/
+    double sumW;
+    double sumX;
+    double sumY;
+    double sumXX;
+    double sumXY;
+
+    double itemTime;
+    double overheadTime;
+
+    std::vector<ChunkStats> stats;
+};
+
+#endif // PBAPCHUNKCONTROLLER_HPP_
@@ -0,0 +1,272 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file PBAPSession.cpp
+ */
+
+#include "PBAPSession.hpp"
+#include <helpers/Log.hpp>
+
+PBAPSession::Sessions PBAPSession::sessions;
+pthread_mutex_t PBAPSession::sessionsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+PBAPSession::PBAPSession(const std::string& mac) :
+    macAddress(mac),
+    connection(NULL),
+    proxyClient1(NULL),
+    proxyPhonebookAccess1(NULL),
+    sessionPath(),
+    refCount(1)
+{
+  pthread_mutex_init(&mutex, NULL);
+}
+
+PBAPSession::~PBAPSession()
+{
+  disconnect();
+  pthread_mutex_destroy(&mutex);
+}
+
+PBAPSession* PBAPSession::acquire(const std::string& mac)
+{
+  PBAPSession* session = NULL;
+
+  pthread_mutex_lock(&sessionsMutex);
+  Sessions::iterator it = sessions.find(mac);
+  if (it != sessions.end())
+  {
+    session = (*it).second;
+    session->refCount++;
+    LOG_DEBUG()<<"Reusing session "<<session->sessionPath<<std::endl;
+  }
+  else
+  {
+    session = new PBAPSession(mac);
+    if (session->connect())
+    {
+      sessions[mac] = session;
+    }
+    else
+    {
+      delete session;
+      session = NULL;
+    }
+  }
+  pthread_mutex_unlock(&sessionsMutex);
+
+  return session;
+}
+
+void PBAPSession::release(PBAPSession* session)
+{
+  if (NULL == session)
+  {
+    return;
+  }
+
+  pthread_mutex_lock(&sessionsMutex);
+  if (0 == --session->refCount)
+  {
+    sessions.erase(session->macAddress);
+    delete session;
+  }
+  pthread_mutex_unlock(&sessionsMutex);
+}
+
+void PBAPSession::lock()
+{
+  pthread_mutex_lock(&mutex);
+}
+
+void PBAPSession::unlock()
+{
+  pthread_mutex_unlock(&mutex);
+}
+
+GDBusConnection* PBAPSession::getConnection() const
+{
+  return connection;
+}
+
+GDBusProxy* PBAPSession::getPhonebookAccess() const
+{
+  return proxyPhonebookAccess1;
+}
+
+const std::string& PBAPSession::getPath() const
+{
+  return sessionPath;
+}
+
+bool PBAPSession::connect()
+{
+  GError* gerror = NULL;
+  GVariantBuilder *builder;
+  GVariant* response = NULL;
+  GVariant* sessionPathVariant = NULL;
+  bool res = true;
+
+  connection = g_bus_get_sync (G_BUS_TYPE_SESSION, NULL, &gerror);
+
+  if (NULL == connection){
+    LOG_ERROR() << "Cannot open connection to bus: " << GERROR_MESSAGE(gerror)<<std::endl;
+    GERROR_FREE(gerror);
+    return false;
+  }
+
+  proxyClient1 = g_dbus_proxy_new_sync(connection,
+                                       G_DBUS_PROXY_FLAGS_NONE,
+                                       NULL,
+                                       "org.bluez.obex",
+                                       "/org/bluez/obex",
+                                       "org.bluez.obex.Client1",
+                                       NULL, &gerror);
+
+  if (NULL != gerror)
+  {
+    LOG_ERROR() << "Cannot create org.bluez.obex.Client1 proxy : " << GERROR_MESSAGE(gerror)<<std::endl;
+    GERROR_FREE(gerror);
+    return false;
+  }
+
+  builder = g_variant_builder_new(G_VARIANT_TYPE_ARRAY);
+  g_variant_builder_add(builder, "{sv}", "Target", g_variant_new_string("PBAP"));
+
+  response = g_dbus_proxy_call_sync(proxyClient1,
+                                    "CreateSession",
+                                    g_variant_new("(sa{sv})",
+                                                  macAddress.c_str(),
+                                                  builder),
+                                    G_DBUS_CALL_FLAGS_NONE, -1,
+                                    NULL, &gerror);
+  g_variant_builder_unref (builder);
+  if (NULL == response)
+  {
+    LOG_ERROR() << "Cannot call CreateSession : " << GERROR_MESSAGE(gerror)<<std::endl;
+    if (NULL != gerror && gerror->domain == G_DBUS_ERROR)
+    {
+      char* err = g_dbus_error_get_remote_error(gerror);
+      LOG_ERROR() << "Exception: " << err<<std::endl;
+      g_free(err);
+      GERROR_FREE(gerror);
+    }
+    res = false;
+  }
+
+  if (res)
+  {
+    sessionPathVariant = g_variant_get_child_value(response, 0);
+    sessionPath = g_variant_get_string(sessionPathVariant, NULL);
+    g_variant_unref(sessionPathVariant);
+
+    proxyPhonebookAccess1 = g_dbus_proxy_new_sync(connection,
+                                                  G_DBUS_PROXY_FLAGS_NONE,
+                                                  NULL,
+                                                  "org.bluez.obex",
+                                                  sessionPath.c_str(),
+                                                  "org.bluez.obex.PhonebookAccess1",
+                                                  NULL, &gerror);
+
+    if (NULL != gerror)
+    {
+      LOG_ERROR() << "Cannot create org.bluez.obex.PhonebookAccess1 proxy : " << GERROR_MESSAGE(gerror)<<std::endl;
+      GERROR_FREE(gerror);
+      res = false;
+    }
+  }
+
+  if (NULL != response)
+  {
+    g_variant_unref(response);
+  }
+  return res;
+}
+
+void PBAPSession::disconnect()
+{
+  if(!sessionPath.empty())
+  {
+    GError* gerror = NULL;
+    GVariant* response = NULL;
+
+    LOG_DEBUG()<<"Disconnectin session "<<sessionPath<<std::endl;
+    response = g_dbus_proxy_call_sync(proxyClient1,
+                                      "RemoveSession",
+                                      g_variant_new("(o)", sessionPath.c_str()),
+                                      G_DBUS_CALL_FLAGS_NONE, -1,
+                                      NULL, &gerror);
+    if (NULL == response)
+    {
+      LOG_ERROR() << "Cannot call RemoveSession : " << GERROR_MESSAGE(gerror)<<std::endl;
+      if (NULL != gerror && gerror->domain == G_DBUS_ERROR)
+      {
+        char* err = g_dbus_error_get_remote_error(gerror);
+        LOG_ERROR() << "Exception: " << err<<std::endl;
+        g_free(err);
+        GERROR_FREE(gerror);
+      }
+    }
+    else
+    {
+      g_variant_unref(response);
+    }
+    sessionPath.clear();
+  }
+
+  if (NULL != proxyPhonebookAccess1)
+  {
+    g_object_unref(proxyPhonebookAccess1);
+    proxyPhonebookAccess1 = NULL;
+  }
+
+  if (NULL != proxyClient1)
+  {
+    g_object_unref(proxyClient1);
+    proxyClient1 = NULL;
+  }
+
+  if (NULL != connection)
+  {
+    g_object_unref(connection);
+    connection = NULL;
+  }
+}
+
+bool PBAPSession::select(const std::string& location, const std::string& phonebook)
+{
+  if (location == selectedLocation && phonebook == selectedPhonebook)
+  {
+    return true;
+  }
+
+  GError* gerror = NULL;
+  GVariant* response;
+
+  response = g_dbus_proxy_call_sync(proxyPhonebookAccess1,
+                                    "Select",
+                                    g_variant_new("(ss)", location.c_str(), phonebook.c_str()),
+                                    G_DBUS_CALL_FLAGS_NONE, -1,
+                                    NULL, &gerror);
+  if (!response)
+  {
+    LOG_ERROR() << "Cannot call Select : " << GERROR_MESSAGE(gerror)<<std::endl;
+    if (NULL != gerror && gerror->domain == G_DBUS_ERROR)
+    {
+      char* err = g_dbus_error_get_remote_error(gerror);
+      LOG_ERROR() << "Exception: " << err<<std::endl;
+      g_free(err);
+      GERROR_FREE(gerror);
+    }
+    selectedLocation.clear();
+    selectedPhonebook.clear();
+    return false;
+  }
+
+  g_variant_unref(response);
+  selectedLocation = location;
+  selectedPhonebook = phonebook;
+  return true;
+}
@@ -0,0 +1,108 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file PBAPSession.hpp
+ */
+
+#ifndef PBAPSESSION_HPP_
+#define PBAPSESSION_HPP_
+
+#include <glib2/OpenAB_glib2_global.h>
+#include <gio/gio.h>
+#include <pthread.h>
+#include <string>
+#include <map>
+
+/*!
+ * @brief BlueZ OBEX PBAP session shared by all PBAP sources of the same device.
+ *
+ * Creating OBEX session means connecting to device, so when several phonebooks (e.g. contacts
+ * and call history) are downloaded from the same device, single session is created by first source
+ * and reused by others until last of them releases it.
+ *
+ * PhonebookAccess1 operations always refer to currently selected phonebook, so sources have to
+ * keep session locked between selecting phonebook (@ref select) and issuing their requests.
+ * Transfers are queued by BlueZ, so lock does not need to be kept while data is transferred,
+ * which allows request of one source to be queued while transfer of another one is ongoing.
+ */
+class PBAPSession
+{
+  public:
+    /*!
+     * @brief Returns session connected to given device, creating it if needed.
+     * @param [in] mac Bluetooth MAC address of device.
+     * @return session or NULL if it cannot be created, session has to be released using @ref release.
+     */
+    static PBAPSession* acquire(const std::string& mac);
+
+    /*!
+     * @brief Releases session returned by @ref acquire, session is removed when it is not used anymore.
+     */
+    static void release(PBAPSession* session);
+
+    /*!
+     * @brief Locks session, so no other source can change selected phonebook.
+     */
+    void lock();
+
+    /*!
+     * @brief Unlocks session locked with @ref lock.
+     */
+    void unlock();
+
+    /*!
+     * @brief Selects phonebook, session has to be locked.
+     * @param [in] location phonebook location ("int", "sim1", ...).
+     * @param [in] phonebook phonebook name ("pb", "ich", "och", "mch", "cch").
+     * @return true if phonebook was selected, false otherwise.
+     */
+    bool select(const std::string& location, const std::string& phonebook);
+
+    GDBusConnection* getConnection() const;
+    GDBusProxy* getPhonebookAccess() const;
+    const std::string& getPath() const;
+
+  private:
+    /*!
+     *  @brief Constructor.
+     */
+    PBAPSession(const std::string& mac);
+
+    /*!
+     *  @brief Destructor.
+     */
+    ~PBAPSession();
+
+    /*!
+     *  @brief Copy constructor, private unimplemented to prevent misuse.
+     */
+    PBAPSession(PBAPSession const &other);
+
+    /*!
+     *  @brief Assignment operator, private unimplemented to prevent misuse.
+     */
+    PBAPSession& operator=(PBAPSession const &other);
+
+    bool connect();
+    void disconnect();
+
+    std::string         macAddress;
+    GDBusConnection*    connection;
+    GDBusProxy*         proxyClient1;
+    GDBusProxy*         proxyPhonebookAccess1;
+    std::string         sessionPath;
+    /*currently selected phonebook, empty if unknown*/
+    std::string         selectedLocation;
+    std::string         selectedPhonebook;
+    unsigned int        refCount;
+    pthread_mutex_t     mutex;
+
+    typedef std::map<std::string, PBAPSession*> Sessions;
+    static Sessions         sessions;
+    static pthread_mutex_t  sessionsMutex;
+};
+
+#endif // PBAPSESSION_HPP_
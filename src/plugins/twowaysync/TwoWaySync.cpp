@@ -377,9 +377,12 @@ void TwoWaySync::buildLocalIndexDB()
     if(cancelSync)
       return;
 
-    OpenAB_Storage::StorageItem *aa = new OpenAB_Storage::StorageItem(*e);
-    LOG_DEBUG()<<"Building local index "<<e->item->getIndex()->toStringFull()<<std::endl;
-    indexDB[e->item->getIndex()].push_back(aa);
+    //take over item from iterator, it will be replaced by next call anyway
+    OpenAB_Storage::StorageItem *aa = new OpenAB_Storage::StorageItem();
+    aa->swap(*e);
+    OpenAB::SmartPtr<OpenAB::PIMItemIndex> index = aa->item->getIndex();
+    LOG_DEBUG()<<"Building local index "<<index->toStringFull()<<std::endl;
+    indexDB[index].push_back(aa);
   }
   delete it;
 }
@@ -0,0 +1,128 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file bounded_queue_tests.cpp
+ */
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include "helpers/BoundedQueue.hpp"
+
+class BoundedQueueTests: public ::testing::Test
+{
+public:
+    BoundedQueueTests() : ::testing::Test()
+    {
+    }
+
+    ~BoundedQueueTests()
+    {
+    }
+
+protected:
+    // Sets up the test fixture.
+    virtual void SetUp()
+    {
+    }
+
+    // Tears down the test fixture.
+    virtual void TearDown()
+    {
+
+    }
+
+};
+
+namespace
+{
+  struct ProducerParams
+  {
+    OpenAB::BoundedQueue<int>* queue;
+    int count;
+    unsigned int maxSize;
+  };
+
+  void* producer(void* p)
+  {
+    ProducerParams* params = static_cast<ProducerParams*>(p);
+    for (int i = 0; i < params->count; ++i)
+    {
+      if (!params->queue->push(i))
+      {
+        break;
+      }
+      unsigned int s = params->queue->size();
+      if (s > params->maxSize)
+      {
+        params->maxSize = s;
+      }
+    }
+    params->queue->close();
+    return NULL;
+  }
+}
+
+TEST_F(BoundedQueueTests, testPushPop)
+{
+  OpenAB::BoundedQueue<int> queue(3);
+  ASSERT_EQ(3u, queue.getCapacity());
+  ASSERT_EQ(0u, queue.size());
+
+  ASSERT_TRUE(queue.push(1));
+  ASSERT_TRUE(queue.push(2));
+  ASSERT_EQ(2u, queue.size());
+
+  int item = 0;
+  ASSERT_TRUE(queue.pop(item));
+  ASSERT_EQ(1, item);
+  ASSERT_TRUE(queue.pop(item));
+  ASSERT_EQ(2, item);
+  ASSERT_EQ(0u, queue.size());
+}
+
+TEST_F(BoundedQueueTests, testClose)
+{
+  OpenAB::BoundedQueue<int> queue(3);
+  ASSERT_TRUE(queue.push(1));
+  ASSERT_FALSE(queue.isClosed());
+  queue.close();
+  ASSERT_TRUE(queue.isClosed());
+
+  //no more items can be added, but stored ones still can be removed
+  ASSERT_FALSE(queue.push(2));
+  int item = 0;
+  ASSERT_TRUE(queue.pop(item));
+  ASSERT_EQ(1, item);
+  ASSERT_FALSE(queue.pop(item));
+
+  queue.reset();
+  ASSERT_TRUE(queue.push(3));
+  ASSERT_TRUE(queue.pop(item));
+  ASSERT_EQ(3, item);
+}
+
+TEST_F(BoundedQueueTests, testProducerConsumer)
+{
+  OpenAB::BoundedQueue<int> queue(4);
+  ProducerParams params;
+  params.queue = &queue;
+  params.count = 1000;
+  params.maxSize = 0;
+
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, producer, &params));
+
+  int item = 0;
+  int expected = 0;
+  while (queue.pop(item))
+  {
+    ASSERT_EQ(expected, item);
+    ++expected;
+  }
+  pthread_join(thread, NULL);
+
+  ASSERT_EQ(1000, expected);
+  ASSERT_LE(params.maxSize, 4u);
+}
@@ -0,0 +1,111 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file file_helper_tests.cpp
+ */
+#include <gtest/gtest.h>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "helpers/FileHelper.hpp"
+
+class FileHelperTests: public ::testing::Test
+{
+public:
+    FileHelperTests() : ::testing::Test()
+    {
+    }
+
+    ~FileHelperTests()
+    {
+    }
+
+protected:
+    // Sets up the test fixture.
+    virtual void SetUp()
+    {
+      char dirName[] = "/tmp/oab_file_helperXXXXXX";
+      ASSERT_TRUE(NULL != mkdtemp(dirName));
+      dir = dirName;
+    }
+
+    // Tears down the test fixture.
+    virtual void TearDown()
+    {
+      unlink((dir + "/a/b/file").c_str());
+      rmdir((dir + "/a/b").c_str());
+      rmdir((dir + "/a").c_str());
+      rmdir(dir.c_str());
+    }
+
+    static std::string readFile(const std::string& path)
+    {
+      std::ifstream file(path.c_str(), std::ios_base::in | std::ios_base::binary);
+      std::ostringstream content;
+      content<<file.rdbuf();
+      return content.str();
+    }
+
+    std::string dir;
+};
+
+TEST_F(FileHelperTests, testMakeDirs)
+{
+  ASSERT_TRUE(OpenAB::makeDirs(dir + "/a/b"));
+  //already existing directory
+  ASSERT_TRUE(OpenAB::makeDirs(dir + "/a/b"));
+
+  struct stat st;
+  ASSERT_EQ(0, stat((dir + "/a/b").c_str(), &st));
+  ASSERT_TRUE(S_ISDIR(st.st_mode));
+
+  //path of existing file
+  ASSERT_TRUE(OpenAB::writeFileAtomically(dir + "/a/b/file", "data"));
+  ASSERT_FALSE(OpenAB::makeDirs(dir + "/a/b/file"));
+}
+
+TEST_F(FileHelperTests, testHashFileName)
+{
+  ASSERT_EQ("cbf29ce484222325", OpenAB::hashFileName(""));
+  ASSERT_EQ("af63dc4c8601ec8c", OpenAB::hashFileName("a"));
+  ASSERT_NE(OpenAB::hashFileName("a"), OpenAB::hashFileName("b"));
+}
+
+TEST_F(FileHelperTests, testAtomicFileWriter)
+{
+  ASSERT_TRUE(OpenAB::makeDirs(dir + "/a/b"));
+  std::string path = dir + "/a/b/file";
+
+  ASSERT_TRUE(OpenAB::writeFileAtomically(path, "first"));
+  ASSERT_EQ("first", readFile(path));
+
+  //not committed writer does not modify file and leaves no temporary file behind
+  {
+    OpenAB::AtomicFileWriter writer(path);
+    ASSERT_TRUE(writer.isOpen());
+    writer.stream()<<"second";
+  }
+  ASSERT_EQ("first", readFile(path));
+  ASSERT_NE(0, access((path + ".tmp").c_str(), F_OK));
+
+  {
+    OpenAB::AtomicFileWriter writer(path);
+    ASSERT_TRUE(writer.isOpen());
+    writer.stream()<<"third";
+    ASSERT_TRUE(writer.commit());
+    ASSERT_FALSE(writer.commit());
+  }
+  ASSERT_EQ("third", readFile(path));
+  ASSERT_NE(0, access((path + ".tmp").c_str(), F_OK));
+
+  //directory does not exist
+  OpenAB::AtomicFileWriter writer(dir + "/missing/file");
+  ASSERT_FALSE(writer.isOpen());
+  ASSERT_FALSE(writer.commit());
+}
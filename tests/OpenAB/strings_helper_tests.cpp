@@ -259,3 +259,16 @@ TEST_F(StringHelperTests, testParseUrlHostPart)
 	ASSERT_EQ("http://www.google.com", OpenAB::parseURLHostPart(urlWithHost));
 	ASSERT_EQ("www.google.com", OpenAB::parseURLHostPart(urlWithoutHost));
 }
+
+TEST_F(StringHelperTests, testFindAtLineStart)
+{
+  std::string data = "END:VCARD\nX-NOTE:END:VCARD\nEND:VCARD\n";
+  const char* begin = data.c_str();
+  const char* end = begin + data.size();
+  //beginning of buffer is beginning of line
+  ASSERT_EQ(begin, OpenAB::findAtLineStart(begin, end, begin, "END:VCARD", 9));
+  //marker in the middle of line is skipped
+  ASSERT_EQ(begin + 27, OpenAB::findAtLineStart(begin, end, begin + 1, "END:VCARD", 9));
+  ASSERT_EQ(NULL, OpenAB::findAtLineStart(begin, end, begin + 28, "END:VCARD", 9));
+  ASSERT_EQ(NULL, OpenAB::findAtLineStart(begin, end, begin, "BEGIN:VCARD", 11));
+}
@@ -0,0 +1,149 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file vcard_parse_stage_tests.cpp
+ */
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <sstream>
+#include "plugin/source/VCardParseStage.hpp"
+
+class VCardParseStageTests: public ::testing::Test
+{
+public:
+    VCardParseStageTests() : ::testing::Test()
+    {
+    }
+
+    ~VCardParseStageTests()
+    {
+    }
+
+protected:
+    // Sets up the test fixture.
+    virtual void SetUp()
+    {
+      OpenAB::Logger::OutLevel() = OpenAB::Logger::Fatal;
+    }
+
+    // Tears down the test fixture.
+    virtual void TearDown()
+    {
+
+    }
+
+};
+
+namespace
+{
+  std::string vCard(int i)
+  {
+    std::stringstream ss;
+    ss<<"BEGIN:VCARD\r\nVERSION:3.0\r\nN:Surname"<<i<<";Name\r\nFN:Name Surname"<<i<<"\r\nEND:VCARD\r\n";
+    return ss.str();
+  }
+
+  struct ProducerParams
+  {
+    OpenAB_Source::VCardParseStage* stage;
+    int count;
+  };
+
+  void* producer(void* p)
+  {
+    ProducerParams* params = static_cast<ProducerParams*>(p);
+    for (int i = 0; i < params->count; ++i)
+    {
+      if (!params->stage->push(new std::string(vCard(i))))
+      {
+        break;
+      }
+    }
+    params->stage->close();
+    return NULL;
+  }
+}
+
+TEST_F(VCardParseStageTests, testOrderIsPreserved)
+{
+  OpenAB_Source::VCardParseStage stage(4, 8);
+  ASSERT_EQ(4u, stage.getWorkersCount());
+
+  ProducerParams params;
+  params.stage = &stage;
+  params.count = 1000;
+
+  pthread_t thread;
+  ASSERT_EQ(0, pthread_create(&thread, NULL, producer, &params));
+
+  OpenAB::PIMContactItem* item = NULL;
+  int expected = 0;
+  while (stage.pop(item))
+  {
+    ASSERT_TRUE(item);
+    ASSERT_EQ(vCard(expected), item->getRawData());
+    delete item;
+    ++expected;
+  }
+  pthread_join(thread, NULL);
+
+  ASSERT_EQ(1000, expected);
+}
+
+TEST_F(VCardParseStageTests, testParseError)
+{
+  OpenAB_Source::VCardParseStage stage(2, 4);
+  ASSERT_TRUE(stage.push(new std::string(vCard(1))));
+  ASSERT_TRUE(stage.push(new std::string("BEGIN:VCARD\r\nVERSION:3.0\r\nPHOTO:http://www.example.com/photo.gif\r\nEND:VCARD\r\n")));
+  ASSERT_TRUE(stage.push(new std::string(vCard(3))));
+  //vCard that could not be read
+  ASSERT_TRUE(stage.push(NULL));
+  stage.close();
+
+  OpenAB::PIMContactItem* item = NULL;
+  ASSERT_TRUE(stage.pop(item));
+  ASSERT_TRUE(item);
+  delete item;
+  ASSERT_TRUE(stage.pop(item));
+  ASSERT_FALSE(item);
+  ASSERT_TRUE(stage.pop(item));
+  ASSERT_TRUE(item);
+  ASSERT_EQ(vCard(3), item->getRawData());
+  delete item;
+  ASSERT_TRUE(stage.pop(item));
+  ASSERT_FALSE(item);
+  ASSERT_FALSE(stage.pop(item));
+}
+
+TEST_F(VCardParseStageTests, testCloseAndReset)
+{
+  OpenAB_Source::VCardParseStage stage(1, 2);
+  ASSERT_TRUE(stage.push(new std::string(vCard(1))));
+  ASSERT_FALSE(stage.isClosed());
+  stage.close();
+  ASSERT_TRUE(stage.isClosed());
+  ASSERT_FALSE(stage.push(new std::string(vCard(2))));
+
+  //not popped items are freed
+  stage.reset();
+  ASSERT_FALSE(stage.isClosed());
+  ASSERT_TRUE(stage.push(new std::string(vCard(3))));
+  OpenAB::PIMContactItem* item = NULL;
+  ASSERT_TRUE(stage.pop(item));
+  ASSERT_EQ(vCard(3), item->getRawData());
+  delete item;
+}
+
+TEST_F(VCardParseStageTests, testNotPoppedItemsAreFreed)
+{
+  //window is full, destructor has to release blocked producer and free items
+  OpenAB_Source::VCardParseStage* stage = new OpenAB_Source::VCardParseStage(2, 4);
+  for (int i = 0; i < 4; ++i)
+  {
+    ASSERT_TRUE(stage->push(new std::string(vCard(i))));
+  }
+  delete stage;
+}
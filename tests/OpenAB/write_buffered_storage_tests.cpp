@@ -0,0 +1,319 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file write_buffered_storage_tests.cpp
+ */
+#include <gtest/gtest.h>
+#include <sstream>
+#include "plugin/storage/WriteBufferedStorage.hpp"
+#include "PIMItem/Contact/PIMContactItem.hpp"
+
+namespace
+{
+  /*Storage keeping items in memory and counting batch calls*/
+  class CountingStorage : public OpenAB_Storage::Storage
+  {
+    public:
+      CountingStorage() : OpenAB_Storage::Storage(OpenAB::eContact),
+                          addCalls(0), modifyCalls(0), removeCalls(0),
+                          nextId(0), failWrites(false)
+      {
+      }
+
+      enum eInit init() { return eInitOk; }
+      enum eSuspendRet suspend() { return eSuspendRetNotSupported; }
+      enum eResumeRet resume() { return eResumeRetNotSupported; }
+      enum eCancelRet cancel() { return eCancelRetNotSupported; }
+      enum eGetItemRet getItem(OpenAB::SmartPtr<OpenAB::PIMItem> &) { return eGetItemRetEnd; }
+      int getTotalCount() const { return items.size(); }
+
+      enum eAddItem addItem(const OpenAB::SmartPtr<OpenAB::PIMItem>& item,
+                            OpenAB::PIMItem::ID & newId,
+                            OpenAB::PIMItem::Revision & revision)
+      {
+        std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > v(1, item);
+        OpenAB::PIMItem::IDs ids;
+        OpenAB::PIMItem::Revisions revisions;
+        enum eAddItem res = addItems(v, ids, revisions);
+        if (eAddItemOk == res)
+        {
+          newId = ids.front();
+          revision = revisions.front();
+        }
+        return res;
+      }
+
+      enum eAddItem addItems(const std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & v,
+                             OpenAB::PIMItem::IDs & ids,
+                             OpenAB::PIMItem::Revisions & revisions)
+      {
+        ++addCalls;
+        if (failWrites)
+        {
+          return eAddItemFail;
+        }
+        for (unsigned int i = 0; i < v.size(); ++i)
+        {
+          std::stringstream id;
+          id<<"id"<<nextId++;
+          items[id.str()] = v[i]->getRawData();
+          ids.push_back(id.str());
+          revisions.push_back("1");
+        }
+        return eAddItemOk;
+      }
+
+      enum eModifyItem modifyItem(const OpenAB::SmartPtr<OpenAB::PIMItem>& item,
+                                  const OpenAB::PIMItem::ID & id,
+                                  OpenAB::PIMItem::Revision & /*revision*/)
+      {
+        std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > v(1, item);
+        OpenAB::PIMItem::IDs ids(1, id);
+        OpenAB::PIMItem::Revisions revisions;
+        return modifyItems(v, ids, revisions);
+      }
+
+      enum eModifyItem modifyItems(const std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > & v,
+                                   const OpenAB::PIMItem::IDs & ids,
+                                   OpenAB::PIMItem::Revisions & revisions)
+      {
+        ++modifyCalls;
+        for (unsigned int i = 0; i < v.size(); ++i)
+        {
+          if (items.find(ids[i]) == items.end())
+          {
+            return eModifyItemFail;
+          }
+          items[ids[i]] = v[i]->getRawData();
+          revisions.push_back("2");
+        }
+        return eModifyItemOk;
+      }
+
+      enum eRemoveItem removeItem(const OpenAB::PIMItem::ID & id)
+      {
+        return removeItems(OpenAB::PIMItem::IDs(1, id));
+      }
+
+      enum eRemoveItem removeItems(const OpenAB::PIMItem::IDs & ids)
+      {
+        ++removeCalls;
+        for (unsigned int i = 0; i < ids.size(); ++i)
+        {
+          if (0 == items.erase(ids[i]))
+          {
+            return eRemoveItemFail;
+          }
+        }
+        return eRemoveItemOk;
+      }
+
+      enum eGetItem getItem(const OpenAB::PIMItem::ID & id, OpenAB::SmartPtr<OpenAB::PIMItem>& item)
+      {
+        std::map<std::string, std::string>::iterator it = items.find(id);
+        if (it == items.end())
+        {
+          return eGetItemFail;
+        }
+        OpenAB::PIMContactItem* contact = new OpenAB::PIMContactItem();
+        contact->parse((*it).second);
+        contact->setId(id);
+        item = contact;
+        return eGetItemOk;
+      }
+
+      enum eGetItem getItems(const OpenAB::PIMItem::IDs &, std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > &)
+      {
+        return eGetItemFail;
+      }
+
+      enum eGetSyncToken getLatestSyncToken(std::string&) { return eGetSyncTokenFail; }
+
+      enum eGetRevisions getRevisions(std::map<std::string, std::string>& revisions)
+      {
+        std::map<std::string, std::string>::iterator it;
+        for (it = items.begin(); it != items.end(); ++it)
+        {
+          revisions[(*it).first] = "1";
+        }
+        return eGetRevisionsOk;
+      }
+
+      enum eGetRevisions getChangedRevisions(const std::string&,
+                                             std::map<std::string, std::string>&,
+                                             std::vector<OpenAB::PIMItem::ID>&)
+      {
+        return eGetRevisionsFail;
+      }
+
+      OpenAB_Storage::StorageItemIterator* newStorageItemIterator() { return NULL; }
+
+      std::map<std::string, std::string> items;
+      unsigned int addCalls;
+      unsigned int modifyCalls;
+      unsigned int removeCalls;
+      unsigned int nextId;
+      bool failWrites;
+  };
+
+  OpenAB::SmartPtr<OpenAB::PIMItem> createContact(const std::string& name)
+  {
+    OpenAB::PIMContactItem* contact = new OpenAB::PIMContactItem();
+    contact->parse("BEGIN:VCARD\nVERSION:3.0\nFN:" + name + "\nEND:VCARD\n");
+    return OpenAB::SmartPtr<OpenAB::PIMItem>(contact);
+  }
+}
+
+class WriteBufferedStorageTests: public ::testing::Test
+{
+public:
+    WriteBufferedStorageTests() : ::testing::Test()
+    {
+    }
+
+    ~WriteBufferedStorageTests()
+    {
+    }
+
+protected:
+    // Sets up the test fixture.
+    virtual void SetUp()
+    {
+    }
+
+    // Tears down the test fixture.
+    virtual void TearDown()
+    {
+
+    }
+
+    CountingStorage storage;
+};
+
+TEST_F(WriteBufferedStorageTests, testBatchesWrites)
+{
+  OpenAB_Storage::WriteBufferedStorage buffer(&storage, 0, 0, 0);
+  OpenAB::PIMItem::ID id;
+  OpenAB::PIMItem::Revision revision;
+  for (int i = 0; i < 10; ++i)
+  {
+    ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, buffer.addItem(createContact("Name"), id, revision));
+  }
+  ASSERT_EQ(10u, buffer.getPendingCount());
+  ASSERT_EQ(0u, storage.addCalls);
+
+  ASSERT_TRUE(buffer.flush());
+  ASSERT_EQ(0u, buffer.getPendingCount());
+  ASSERT_EQ(1u, storage.addCalls);
+  ASSERT_EQ(10u, storage.items.size());
+  ASSERT_EQ(10u, buffer.getStats().writtenOperations);
+  ASSERT_EQ(1u, buffer.getStats().commits);
+
+  //nothing pending, flush does not commit anything
+  ASSERT_TRUE(buffer.flush());
+  ASSERT_EQ(1u, buffer.getStats().commits);
+}
+
+TEST_F(WriteBufferedStorageTests, testKeepsOrderOfOperationsOnSameItem)
+{
+  OpenAB_Storage::WriteBufferedStorage buffer(&storage, 0, 0, 0);
+  OpenAB::PIMItem::ID id;
+  OpenAB::PIMItem::Revision revision;
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, storage.addItem(createContact("First"), id, revision));
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, storage.addItem(createContact("Second"), id, revision));
+  storage.addCalls = 0;
+
+  //additions do not report ids nor revisions
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, buffer.addItem(createContact("Third"), id, revision));
+  ASSERT_TRUE(id.empty());
+  ASSERT_TRUE(revision.empty());
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eModifyItemOk, buffer.modifyItem(createContact("Modified"), "id0", revision));
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, buffer.removeItem("id1"));
+  ASSERT_EQ(3u, buffer.getPendingCount());
+  ASSERT_EQ(0u, storage.modifyCalls);
+
+  //operations are not coalesced, modification followed by removal of the same item flushes modification first
+  ASSERT_EQ(OpenAB_Storage::Storage::eModifyItemOk, buffer.modifyItem(createContact("Again"), "id0", revision));
+  ASSERT_EQ(1u, buffer.getPendingCount());
+  ASSERT_EQ(1u, storage.addCalls);
+  ASSERT_EQ(1u, storage.modifyCalls);
+  ASSERT_EQ(1u, storage.removeCalls);
+  ASSERT_NE(std::string::npos, storage.items["id0"].find("Modified"));
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, buffer.removeItem("id0"));
+  ASSERT_EQ(2u, storage.modifyCalls);
+  ASSERT_TRUE(buffer.flush());
+  ASSERT_EQ(2u, storage.removeCalls);
+  ASSERT_EQ(1u, storage.items.size());
+  ASSERT_NE(std::string::npos, storage.items.begin()->second.find("Third"));
+
+  ASSERT_EQ(5u, buffer.getStats().requestedCalls);
+  ASSERT_EQ(5u, buffer.getStats().writtenOperations);
+  ASSERT_EQ(3u, buffer.getStats().commits);
+}
+
+TEST_F(WriteBufferedStorageTests, testMergesBatches)
+{
+  //write pattern of OneWaySync: batches of distinct items, no item is written twice
+  OpenAB_Storage::WriteBufferedStorage buffer(&storage, 1000, 0, 0);
+  for (int batch = 0; batch < 10; ++batch)
+  {
+    std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > items;
+    for (int i = 0; i < 100; ++i)
+    {
+      items.push_back(createContact("Name"));
+    }
+    OpenAB::PIMItem::IDs ids;
+    OpenAB::PIMItem::Revisions revisions;
+    ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, buffer.addItems(items, ids, revisions));
+  }
+  ASSERT_TRUE(buffer.flush());
+
+  //10 batches are written in single commit
+  ASSERT_EQ(10u, buffer.getStats().requestedCalls);
+  ASSERT_EQ(1000u, buffer.getStats().writtenOperations);
+  ASSERT_EQ(1u, buffer.getStats().commits);
+  ASSERT_EQ(1u, storage.addCalls);
+  ASSERT_EQ(1000u, storage.items.size());
+}
+
+TEST_F(WriteBufferedStorageTests, testFlushesWhenBudgetExceeded)
+{
+  OpenAB_Storage::WriteBufferedStorage buffer(&storage, 3, 0, 0);
+  OpenAB::PIMItem::ID id;
+  OpenAB::PIMItem::Revision revision;
+  for (int i = 0; i < 7; ++i)
+  {
+    ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, buffer.addItem(createContact("Name"), id, revision));
+  }
+  ASSERT_EQ(2u, storage.addCalls);
+  ASSERT_EQ(1u, buffer.getPendingCount());
+
+  //reads see all pending writes
+  std::map<std::string, std::string> revisions;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsOk, buffer.getRevisions(revisions));
+  ASSERT_EQ(7u, revisions.size());
+  ASSERT_EQ(0u, buffer.getPendingCount());
+}
+
+TEST_F(WriteBufferedStorageTests, testFailedFlushKeepsOperations)
+{
+  OpenAB_Storage::WriteBufferedStorage buffer(&storage, 0, 0, 0);
+  OpenAB::PIMItem::ID id;
+  OpenAB::PIMItem::Revision revision;
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, buffer.addItem(createContact("Name"), id, revision));
+
+  storage.failWrites = true;
+  ASSERT_FALSE(buffer.flush());
+  ASSERT_EQ(1u, buffer.getPendingCount());
+  ASSERT_EQ(0u, buffer.getStats().writtenOperations);
+
+  storage.failWrites = false;
+  ASSERT_TRUE(buffer.flush());
+  ASSERT_EQ(1u, storage.items.size());
+}
@@ -1,13 +1,29 @@
 #!/usr/bin/python
 
+# Mock of BlueZ obexd PBAP client used by PBAP source tests.
+#
+# Without arguments it serves small hard-coded set of vCards (see special MAC addresses below).
+# With --contacts it works as load generator: phonebook of given number of synthesized contacts
+# is served honouring Offset/MaxCount and Fields filters, and data is streamed into FIFO
+# with configurable bandwidth, latency and error rate (see --help).
+
 import os
+import sys
+import argparse
+import random
 import dbus
 import dbus.service
 import time
 from dbus.mainloop.glib import DBusGMainLoop
-import gobject
+try:
+  import gobject
+except ImportError:
+  from gi.repository import GLib as gobject
 import threading
-import StringIO
+try:
+  from StringIO import StringIO
+except ImportError:
+  from io import StringIO
 
 dbus_bus_name = "org.bluez.obex"
 obex_client1_interface = "org.bluez.obex.Client1"
@@ -57,6 +73,90 @@ END:VCARD\n\r"""
 
 currentMAC = ""
 
+#Load generator settings, set from command line
+loadGenerator = None
+
+
+class LoadGenerator:
+  """Synthesizes phonebook of given size and describes how it should be streamed."""
+
+  #Properties always sent, regardless of Fields filter (mandatory in PBAP)
+  mandatoryFields = ["BEGIN", "END", "VERSION", "N", "FN", "TEL"]
+
+  def __init__(self, args):
+    self.contacts = args.contacts
+    self.bandwidth = args.bandwidth
+    self.latency = args.latency / 1000.0
+    self.errorRate = args.error_rate
+    self.writeSize = args.write_size
+    self.seed = args.seed
+    self.photoSizes = []
+    totalWeight = 0
+    for entry in args.photo_sizes.split(","):
+      size, weight = entry.split(":")
+      totalWeight += int(weight)
+      self.photoSizes.append((int(size), totalWeight))
+    self.totalWeight = totalWeight
+
+  def photoSize(self, rnd):
+    value = rnd.randint(1, self.totalWeight)
+    for size, weight in self.photoSizes:
+      if value <= weight:
+        return size
+    return 0
+
+  def name(self, index):
+    if index == 0:
+      return "Owner;Phone"
+    return "Surname%d;Name%d" % (index, index)
+
+  def vCard(self, index):
+    #every contact is always generated the same way, so repeated downloads return the same data
+    rnd = random.Random(self.seed * 1000003 + index)
+    lines = ["BEGIN:VCARD",
+             "VERSION:3.0",
+             "N:%s;;;" % self.name(index),
+             "FN:Name%d Surname%d" % (index, index),
+             "TEL;TYPE=CELL:+49%09d" % rnd.randint(0, 999999999),
+             "EMAIL;TYPE=INTERNET:name%d.surname%d@example.com" % (index, index),
+             "ORG:Company %d" % rnd.randint(0, 100),
+             "ADR;TYPE=HOME:;;%d Main Street;Town;;%05d;Country" % (rnd.randint(1, 999), rnd.randint(0, 99999))]
+    size = self.photoSize(rnd)
+    if size > 0:
+      #base64 encoded photo, folded at 75 characters
+      chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"
+      data = "".join(chars[rnd.randint(0, 63)] for i in range(64)) * (size // 64 + 1)
+      data = data[:size]
+      photo = "PHOTO;ENCODING=b;TYPE=JPEG:" + data[:48]
+      for pos in range(48, len(data), 74):
+        photo += "\r\n " + data[pos:pos + 74]
+      lines.append(photo)
+    lines.append("END:VCARD")
+    return lines
+
+  def filterLines(self, lines, filters):
+    if not "Fields" in filters:
+      return lines
+    fields = [str(f).upper() for f in filters["Fields"]] + self.mandatoryFields
+    result = []
+    for line in lines:
+      name = line.split(":", 1)[0].split(";", 1)[0].upper()
+      if name in fields:
+        result.append(line)
+    return result
+
+  def data(self, indexes, filters):
+    for index in indexes:
+      yield "\r\n".join(self.filterLines(self.vCard(index), filters)) + "\r\n"
+
+  def pullAll(self, filters):
+    offset = int(filters.get("Offset", 0))
+    count = int(filters.get("MaxCount", 65535))
+    return self.data(range(offset, min(offset + count, self.contacts)), filters)
+
+  def pull(self, handle, filters):
+    return self.data([int(handle.split(".")[0])], filters)
+
 
 class MockOBEXClient1(dbus.service.Object):
   def __init__(self):
@@ -68,7 +168,7 @@ class MockOBEXClient1(dbus.service.Object):
   def CreateSession(self, dest, args):
     session_name = "/org/bluez/obex/session1"
     if(dest == "DE:AD:DE:AD:DE:AD"):
-      raise dbus.exception.DBusException('org.bluez.obex.Error.Failed', 'Create Session with DE:AD:DE:AD:DE:AD test exception')
+      raise dbus.exceptions.DBusException('org.bluez.obex.Error.Failed', 'Create Session with DE:AD:DE:AD:DE:AD test exception')
 
     global currentMAC
     currentMAC = dest
@@ -79,12 +179,13 @@ class MockOBEXClient1(dbus.service.Object):
     pass
 
 class MockOBEXTransfer1(dbus.service.Object, threading.Thread):
-  def __init__(self, path, targetFile, filters):
+  def __init__(self, path, targetFile, filters, data = None):
     bus_name = dbus.service.BusName(dbus_bus_name, bus=dbus.SessionBus())
     dbus.service.Object.__init__(self, bus_name, path)
     threading.Thread.__init__(self)
     self.targetFile = targetFile
     self.filters = filters
+    self.data = data
     self.paused = False
     self.cancelled = False
     self.start()
@@ -95,7 +196,7 @@ class MockOBEXTransfer1(dbus.service.Object, threading.Thread):
     global currentMAC
     print("Cancelling " + currentMAC)
     if(currentMAC == "55:55:55:55:55:55"):
-      raise dbus.exception.DBusException('org.bluez.obex.Error.Failed', 'Cancel Transfer with 55:55:55:55:55:55 test exception')
+      raise dbus.exceptions.DBusException('org.bluez.obex.Error.Failed', 'Cancel Transfer with 55:55:55:55:55:55 test exception')
 
     if not self.cancelled:
       self.cancelled = True
@@ -106,7 +207,7 @@ class MockOBEXTransfer1(dbus.service.Object, threading.Thread):
   def Suspend(self): 
     global currentMAC
     if(currentMAC == "55:55:55:55:55:55"):
-      raise dbus.exception.DBusException('org.bluez.obex.Error.Failed', 'Suspend Transfer with 55:55:55:55:55:55 test exception')
+      raise dbus.exceptions.DBusException('org.bluez.obex.Error.Failed', 'Suspend Transfer with 55:55:55:55:55:55 test exception')
 
     if not self.paused:
       self.paused = True
@@ -118,7 +219,7 @@ class MockOBEXTransfer1(dbus.service.Object, threading.Thread):
   def Resume(self):
     global currentMAC
     if(currentMAC == "55:55:55:55:55:55"):
-      raise dbus.exception.DBusException('org.bluez.obex.Error.Failed', 'Resume Transfer with 55:55:55:55:55:55 test exception')
+      raise dbus.exceptions.DBusException('org.bluez.obex.Error.Failed', 'Resume Transfer with 55:55:55:55:55:55 test exception')
 
     if self.paused:
       self.paused = False
@@ -131,13 +232,17 @@ class MockOBEXTransfer1(dbus.service.Object, threading.Thread):
 
   #Special use case - for MAC 44:44:44:44:44:44 - this will send misformatted vcard
   def run(self):
+    if self.data is not None:
+      self.runLoad()
+      return
+
     global currentMAC
     f = open(self.targetFile, 'w')
     buf = ""
     if (currentMAC == "44:44:44:44:44:44"):
-      buf = StringIO.StringIO(vCardsMisformatted)
+      buf = StringIO(vCardsMisformatted)
     else:
-      buf = StringIO.StringIO(vCardsNormal)
+      buf = StringIO(vCardsNormal)
 
     self.PropertiesChanged(obex_transfer1_interface, dbus.Dictionary({"Status" : "queued"}, signature="sv"), [])
     self.PropertiesChanged(obex_transfer1_interface, dbus.Dictionary({"Status" : "active"}, signature="sv"), [])
@@ -155,10 +260,10 @@ class MockOBEXTransfer1(dbus.service.Object, threading.Thread):
         break
 
       if "Fields" in self.filters:
-	if ((not ("PHOTO" in self.filters["Fields"]) and "PHOTO" in data) or
-           (not ("ADR" in self.filters["Fields"]) and "ADR" in data) or
-           (not ("TEL" in self.filters["Fields"]) and "TEL" in data)):
-	  print("field ignored")
+        if ((not ("PHOTO" in self.filters["Fields"]) and "PHOTO" in data) or
+            (not ("ADR" in self.filters["Fields"]) and "ADR" in data) or
+            (not ("TEL" in self.filters["Fields"]) and "TEL" in data)):
+          print("field ignored")
           continue
 
       f.write(data)
@@ -166,6 +271,50 @@ class MockOBEXTransfer1(dbus.service.Object, threading.Thread):
     f.close()
     self.PropertiesChanged(obex_transfer1_interface, dbus.Dictionary({"Status" : "complete"}, signature="sv"), dbus.Array([], signature="s"))
 
+  #Streams data of load generator with configured latency, bandwidth and error rate
+  def runLoad(self):
+    gen = loadGenerator
+    self.PropertiesChanged(obex_transfer1_interface, dbus.Dictionary({"Status" : "queued"}, signature="sv"), [])
+    time.sleep(gen.latency)
+    f = open(self.targetFile, 'w')
+    self.PropertiesChanged(obex_transfer1_interface, dbus.Dictionary({"Status" : "active"}, signature="sv"), [])
+
+    #transfer selected to fail is aborted after random number of vCards
+    failAfter = -1
+    if gen.errorRate > 0 and random.random() < gen.errorRate:
+      failAfter = random.randint(0, 10)
+
+    status = "complete"
+    pending = ""
+    written = 0
+    count = 0
+    start = time.time()
+    for vCard in self.data:
+      if self.cancelled or count == failAfter:
+        status = "error"
+        break
+      while self.paused and not self.cancelled:
+        time.sleep(0.01)
+      pending += vCard
+      count += 1
+      while len(pending) >= gen.writeSize:
+        written += self.write(f, pending[:gen.writeSize], written, start)
+        pending = pending[gen.writeSize:]
+
+    if status == "complete" and pending:
+      self.write(f, pending, written, start)
+    f.close()
+    self.PropertiesChanged(obex_transfer1_interface, dbus.Dictionary({"Status" : status}, signature="sv"), dbus.Array([], signature="s"))
+
+  def write(self, f, data, written, start):
+    f.write(data)
+    f.flush()
+    if loadGenerator.bandwidth > 0:
+      delay = start + float(written + len(data)) / loadGenerator.bandwidth - time.time()
+      if delay > 0:
+        time.sleep(delay)
+    return len(data)
+
 class MockOBEXPhonebookAccess1(dbus.service.Object):
   def __init__(self):
     bus_name = dbus.service.BusName(dbus_bus_name, bus=dbus.SessionBus())
@@ -176,22 +325,27 @@ class MockOBEXPhonebookAccess1(dbus.service.Object):
   @dbus.service.method(dbus_interface=obex_phonebook_access1_interface, in_signature="ss", out_signature="")
   def Select(self, location, phonebook):
     if(location == "sim3"):
-      raise dbus.exception.DBusException('org.bluez.obex.Error.Failed', 'Select sim3 test exception')
+      raise dbus.exceptions.DBusException('org.bluez.obex.Error.Failed', 'Select sim3 test exception')
 
   #Special use case - for MAC 11:11:11:11:11:11 - this will fail
   @dbus.service.method(dbus_interface=obex_phonebook_access1_interface, in_signature="", out_signature="as")
   def ListFilterFields(self):
     global currentMAC
     if(currentMAC == "11:11:11:11:11:11"):
-      raise dbus.exception.DBusException('org.bluez.obex.Error.Failed', 'ListFilterFields test exception')
+      raise dbus.exceptions.DBusException('org.bluez.obex.Error.Failed', 'ListFilterFields test exception')
     return ['VERSION', 'FN', 'N', 'PHOTO', 'BDAY', 'ADR', 'LABEL', 'TEL', 'EMAIL', 'MAILER', 'TZ', 'GEO', 'TITLE', 'ROLE', 'LOGO', 'AGENT', 'ORG', 'NOTE', 'REV', 'SOUND', 'URL', 'UID', 'KEY', 'NICKNAME', 'CATEGORIES', 'PROID', 'CLASS']
 
   #Special use case - for MAC 22:22:22:22:22:22 - this will fail
+  #Special use case - for MAC 66:66:66:66:66:66 - phonebook is empty
   @dbus.service.method(dbus_interface=obex_phonebook_access1_interface, in_signature="", out_signature="q")
   def GetSize(self): 
     global currentMac
     if(currentMAC == "22:22:22:22:22:22"):
-      raise dbus.exception.DBusException('org.bluez.obex.Error.Failed', 'GetSize test exception')
+      raise dbus.exceptions.DBusException('org.bluez.obex.Error.Failed', 'GetSize test exception')
+    if(currentMAC == "66:66:66:66:66:66"):
+      return 0
+    if loadGenerator is not None:
+      return loadGenerator.contacts
     return 1
 
   #Special use case - for MAC 33:33:33:33:33:33 - this will fail 
@@ -199,17 +353,60 @@ class MockOBEXPhonebookAccess1(dbus.service.Object):
   def PullAll(self, targetFile, filters):
     global currentMac
     if(currentMAC == "33:33:33:33:33:33"):
-      raise dbus.exception.DBusException('org.bluez.obex.Error.Failed', 'PullAll ADR test exception')
+      raise dbus.exceptions.DBusException('org.bluez.obex.Error.Failed', 'PullAll ADR test exception')
 
     transfer = "/org/bluez/obex/session1/transfer" + str(self.transferNum);
     self.transferNum = self.transferNum + 1
     print("Filters: ")
     print(filters)
-    newTransfer = MockOBEXTransfer1(transfer, targetFile, filters)
+    data = None
+    if loadGenerator is not None:
+      data = loadGenerator.pullAll(filters)
+    newTransfer = MockOBEXTransfer1(transfer, targetFile, filters, data)
+    ongoingTransfers.append(transfer)
+    return (dbus.ObjectPath(transfer), dbus.Dictionary({"Filename": targetFile}, signature='sv'))
+
+  @dbus.service.method(dbus_interface=obex_phonebook_access1_interface, in_signature="ssa{sv}", out_signature="oa{sv}")
+  def Pull(self, handle, targetFile, filters):
+    if loadGenerator is None:
+      raise dbus.exceptions.DBusException('org.bluez.obex.Error.NotSupported', 'Pull is supported only by load generator')
+
+    transfer = "/org/bluez/obex/session1/transfer" + str(self.transferNum);
+    self.transferNum = self.transferNum + 1
+    newTransfer = MockOBEXTransfer1(transfer, targetFile, filters, loadGenerator.pull(handle, filters))
     ongoingTransfers.append(transfer)
     return (dbus.ObjectPath(transfer), dbus.Dictionary({"Filename": targetFile}, signature='sv'))
 
-gobject.threads_init()
+  @dbus.service.method(dbus_interface=obex_phonebook_access1_interface, in_signature="a{sv}", out_signature="a(ss)")
+  def List(self, filters):
+    if loadGenerator is None:
+      raise dbus.exceptions.DBusException('org.bluez.obex.Error.NotSupported', 'List is supported only by load generator')
+
+    offset = int(filters.get("Offset", 0))
+    count = int(filters.get("MaxCount", 65535))
+    return dbus.Array([(str(i) + ".vcf", loadGenerator.name(i)) for i in range(offset, min(offset + count, loadGenerator.contacts))], signature="(ss)")
+
+parser = argparse.ArgumentParser(description="BlueZ obexd PBAP mock")
+parser.add_argument("--contacts", type=int, default=0,
+                    help="number of synthesized contacts, hard-coded vCards are served when 0 (default)")
+parser.add_argument("--photo-sizes", default="0:70,4096:20,32768:10",
+                    help="distribution of photo sizes in bytes as size:weight pairs (default: %(default)s)")
+parser.add_argument("--bandwidth", type=int, default=0,
+                    help="transfer bandwidth in bytes per second, 0 - unlimited (default)")
+parser.add_argument("--latency", type=int, default=0,
+                    help="delay before each transfer starts in ms (default: %(default)s)")
+parser.add_argument("--error-rate", type=float, default=0,
+                    help="probability that transfer fails (default: %(default)s)")
+parser.add_argument("--write-size", type=int, default=4096,
+                    help="size of single write into FIFO (default: %(default)s)")
+parser.add_argument("--seed", type=int, default=0,
+                    help="seed used to synthesize contacts (default: %(default)s)")
+args = parser.parse_args()
+if args.contacts > 0:
+  loadGenerator = LoadGenerator(args)
+
+if hasattr(gobject, "threads_init"):
+  gobject.threads_init()
 DBusGMainLoop(set_as_default=True)
 client = MockOBEXClient1()
 phonebook = MockOBEXPhonebookAccess1()
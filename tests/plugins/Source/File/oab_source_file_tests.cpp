@@ -8,6 +8,9 @@
  */
 #include <gtest/gtest.h>
 #include <string>
+#include <sstream>
+#include <stdio.h>
+#include <unistd.h>
 #include "helpers/PluginManager.hpp"
 
 
@@ -127,6 +130,178 @@ TEST_F(FileSourceTest, testDirectoryOfVCards)
   OpenAB::PluginManager::getInstance().freePluginInstance(s);
 }
 
+TEST_F(FileSourceTest, testDirectoryOfVCardsParallel)
+{
+  OpenAB_Source::Parameters p;
+  p.setValue("filename", "./vcards");
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  OpenAB_Source::Source* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("File", p);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(OpenAB_Source::Source::eInitOk, s->init());
+
+  p.setValue("workers", 4);
+  OpenAB_Source::Source* parallel = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("File", p);
+  ASSERT_TRUE(parallel);
+  ASSERT_EQ(OpenAB_Source::Source::eInitOk, parallel->init());
+
+  //items are returned in the same order as when files are read one by one
+  OpenAB::SmartPtr<OpenAB::PIMItem> item;
+  OpenAB::SmartPtr<OpenAB::PIMItem> parallelItem;
+  for (int i = 0; i < 2; ++i)
+  {
+    ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s->getItem(item));
+    ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, parallel->getItem(parallelItem));
+    ASSERT_EQ(item->getRawData(), parallelItem->getRawData());
+  }
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, parallel->getItem(parallelItem));
+  ASSERT_EQ(2, parallel->getTotalCount());
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(parallel);
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
+
+TEST_F(FileSourceTest, testReinit)
+{
+  OpenAB_Source::Parameters p;
+  p.setValue("filename", "./vcards");
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+
+  //source can be initialized again both after all items were returned and in the middle of reading
+  for (int workers = 0; workers <= 4; workers += 4)
+  {
+    p.setValue("workers", workers);
+    OpenAB_Source::Source* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("File", p);
+    ASSERT_TRUE(s);
+    OpenAB::SmartPtr<OpenAB::PIMItem> item;
+    for (int i = 0; i < 3; ++i)
+    {
+      ASSERT_EQ(OpenAB_Source::Source::eInitOk, s->init());
+      ASSERT_EQ(2, s->getTotalCount());
+      ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s->getItem(item));
+      if (1 == i)
+      {
+        continue;
+      }
+      ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s->getItem(item));
+      ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, s->getItem(item));
+    }
+    OpenAB::PluginManager::getInstance().freePluginInstance(s);
+  }
+}
+
+TEST_F(FileSourceTest, testDirectoryWithoutVCards)
+{
+  char dirName[] = "/tmp/oab_file_sourceXXXXXX";
+  ASSERT_TRUE(NULL != mkdtemp(dirName));
+  std::string filename = std::string(dirName) + "/empty.vcf";
+
+  OpenAB_Source::Parameters p;
+  p.setValue("filename", dirName);
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+
+  //both empty directory and directory with files not containing vCards are refused in both modes
+  for (int i = 0; i < 2; ++i)
+  {
+    if (1 == i)
+    {
+      FILE* f = fopen(filename.c_str(), "w");
+      ASSERT_TRUE(f);
+      fputs("no vCards here\n", f);
+      fclose(f);
+    }
+
+    p.setValue("workers", 0);
+    OpenAB_Source::Source* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("File", p);
+    ASSERT_TRUE(s);
+    ASSERT_EQ(OpenAB_Source::Source::eInitFail, s->init());
+    ASSERT_EQ(0, s->getTotalCount());
+    OpenAB::PluginManager::getInstance().freePluginInstance(s);
+
+    p.setValue("workers", 4);
+    s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("File", p);
+    ASSERT_TRUE(s);
+    ASSERT_EQ(OpenAB_Source::Source::eInitFail, s->init());
+    ASSERT_EQ(0, s->getTotalCount());
+    OpenAB::SmartPtr<OpenAB::PIMItem> item;
+    ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, s->getItem(item));
+    OpenAB::PluginManager::getInstance().freePluginInstance(s);
+  }
+
+  unlink(filename.c_str());
+  rmdir(dirName);
+}
+
+TEST_F(FileSourceTest, testFileRemovedAfterInit)
+{
+  char dirName[] = "/tmp/oab_file_sourceXXXXXX";
+  ASSERT_TRUE(NULL != mkdtemp(dirName));
+  std::string filenames[3];
+  for (int i = 0; i < 3; ++i)
+  {
+    std::stringstream ss;
+    ss<<dirName<<"/vcard_"<<i<<".vcf";
+    filenames[i] = ss.str();
+    FILE* f = fopen(filenames[i].c_str(), "w");
+    ASSERT_TRUE(f);
+    fprintf(f, "BEGIN:VCARD\nVERSION:3.0\nN:Surname%d;Name;;;\nEND:VCARD\n", i);
+    fclose(f);
+  }
+
+  OpenAB_Source::Parameters p;
+  p.setValue("filename", dirName);
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  OpenAB_Source::Source* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("File", p);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(OpenAB_Source::Source::eInitOk, s->init());
+  ASSERT_EQ(3, s->getTotalCount());
+
+  OpenAB::SmartPtr<OpenAB::PIMItem> item;
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s->getItem(item));
+  ASSERT_NE(std::string::npos, item->getRawData().find("Surname0"));
+
+  //vCards of removed file are reported as errors, reading continues with next file
+  unlink(filenames[1].c_str());
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetError, s->getItem(item));
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s->getItem(item));
+  ASSERT_NE(std::string::npos, item->getRawData().find("Surname2"));
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, s->getItem(item));
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+
+  unlink(filenames[0].c_str());
+  unlink(filenames[2].c_str());
+  rmdir(dirName);
+}
+
+TEST_F(FileSourceTest, testVCardsWithoutTrailingNewLine)
+{
+  //vCards are returned exactly as stored in file, text between vCards is ignored
+  const char* filename = "./vcard_no_trailing_newline.vcf";
+  FILE* f = fopen(filename, "w");
+  ASSERT_TRUE(f);
+  fputs("BEGIN:VCARD\r\nVERSION:3.0\r\nN:Surname;Name;;;\r\nEND:VCARD\r\n"
+        "some garbage\n"
+        "BEGIN:VCARD\nVERSION:3.0\nN:Surname2;Name2;;;\nEND:VCARD", f);
+  fclose(f);
+
+  OpenAB_Source::Parameters p;
+  p.setValue("filename", filename);
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  OpenAB_Source::Source* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("File", p);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(OpenAB_Source::Source::eInitOk, s->init());
+  ASSERT_EQ(2, s->getTotalCount());
+
+  OpenAB::SmartPtr<OpenAB::PIMItem> item;
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s->getItem(item));
+  ASSERT_EQ("BEGIN:VCARD\r\nVERSION:3.0\r\nN:Surname;Name;;;\r\nEND:VCARD\r\n", item->getRawData());
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s->getItem(item));
+  ASSERT_EQ("BEGIN:VCARD\nVERSION:3.0\nN:Surname2;Name2;;;\nEND:VCARD\n", item->getRawData());
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, s->getItem(item));
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+  unlink(filename);
+}
+
 TEST_F(FileSourceTest, testSuspend)
 {
   OpenAB_Source::Parameters p;
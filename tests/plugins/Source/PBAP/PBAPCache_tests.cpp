@@ -0,0 +1,127 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file PBAPCache_tests.cpp
+ */
+#include <gtest/gtest.h>
+#include <string>
+#include <stdlib.h>
+#include <OpenAB.hpp>
+#include <plugins/pbap/PBAPCache.hpp>
+#include "../../TestHelpers.hpp"
+
+
+namespace OpenAB_Tests {
+
+	class PBAPCacheTests: public ::testing::Test
+	{
+	public:
+		PBAPCacheTests() : ::testing::Test()
+		{
+
+		}
+
+		~PBAPCacheTests()
+		{
+		}
+
+	protected:
+		virtual void SetUp()
+		{
+			OpenAB::Logger::setDefaultLogger(NULL);
+			OpenAB::Logger::OutLevel() = OpenAB::Logger::Error;
+
+			char dirTemplate[] = "/tmp/oab_pbap_cache_XXXXXX";
+			cacheDir = mkdtemp(dirTemplate);
+		}
+
+		virtual void TearDown()
+		{
+			ASSERT_TRUE(OpenAB_TESTS::removeDirectory(cacheDir));
+		}
+
+		std::string cacheDir;
+	};
+
+	TEST_F(PBAPCacheTests, testStoreAndLookup)
+	{
+		PBAPCache cache(cacheDir + "/nested", "00:11:22:33:44:55 int");
+		ASSERT_TRUE(cache.init());
+
+		std::string data;
+		ASSERT_FALSE(cache.lookup("1.vcf", data));
+
+		std::string vcard = "BEGIN:VCARD\r\nVERSION:3.0\r\nN:Doe;John\r\nEND:VCARD\r\n";
+		ASSERT_TRUE(cache.store("1.vcf", vcard));
+		ASSERT_TRUE(cache.lookup("1.vcf", data));
+		ASSERT_EQ(vcard, data);
+
+		cache.remove("1.vcf");
+		ASSERT_FALSE(cache.lookup("1.vcf", data));
+	}
+
+	TEST_F(PBAPCacheTests, testPhonebooksAreSeparated)
+	{
+		PBAPCache cache1(cacheDir, "00:11:22:33:44:55 int");
+		PBAPCache cache2(cacheDir, "00:11:22:33:44:55 sim1");
+		ASSERT_TRUE(cache1.init());
+		ASSERT_TRUE(cache2.init());
+
+		ASSERT_TRUE(cache1.store("1.vcf", "data"));
+
+		std::string data;
+		ASSERT_TRUE(cache1.lookup("1.vcf", data));
+		ASSERT_FALSE(cache2.lookup("1.vcf", data));
+	}
+
+	TEST_F(PBAPCacheTests, testNotInitialized)
+	{
+		PBAPCache cache(cacheDir, "00:11:22:33:44:55 int");
+
+		std::string data;
+		PBAPCache::State state;
+		ASSERT_FALSE(cache.store("1.vcf", "data"));
+		ASSERT_FALSE(cache.lookup("1.vcf", data));
+		ASSERT_FALSE(cache.saveState(state));
+		ASSERT_FALSE(cache.loadState(state));
+	}
+
+	TEST_F(PBAPCacheTests, testState)
+	{
+		PBAPCache cache(cacheDir, "00:11:22:33:44:55 int");
+		ASSERT_TRUE(cache.init());
+
+		PBAPCache::State state;
+		ASSERT_FALSE(cache.loadState(state));
+
+		state.version = "0123456789ABCDEF|1|2";
+		state.handles["0.vcf"] = PBAPCache::digest("Owner");
+		state.handles["1.vcf"] = PBAPCache::digest("Doe;John");
+		ASSERT_TRUE(cache.saveState(state));
+
+		PBAPCache::State loaded;
+		ASSERT_TRUE(cache.loadState(loaded));
+		ASSERT_EQ(state.version, loaded.version);
+		ASSERT_EQ(0u, loaded.partialSyncs);
+		ASSERT_EQ(state.handles, loaded.handles);
+
+		//unknown version is stored as well, together with number of partial synchronizations
+		state.version = "";
+		state.partialSyncs = 3;
+		ASSERT_TRUE(cache.saveState(state));
+		ASSERT_TRUE(cache.loadState(loaded));
+		ASSERT_EQ("", loaded.version);
+		ASSERT_EQ(3u, loaded.partialSyncs);
+		ASSERT_EQ(2u, loaded.handles.size());
+	}
+
+	TEST_F(PBAPCacheTests, testDigest)
+	{
+		ASSERT_EQ(16u, PBAPCache::digest("Doe;John").size());
+		ASSERT_EQ(PBAPCache::digest("Doe;John"), PBAPCache::digest("Doe;John"));
+		ASSERT_NE(PBAPCache::digest("Doe;John"), PBAPCache::digest("Doe;Jane"));
+	}
+}
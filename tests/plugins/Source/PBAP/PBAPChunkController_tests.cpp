@@ -0,0 +1,99 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file PBAPChunkController_tests.cpp
+ */
+#include <gtest/gtest.h>
+#include <plugins/pbap/PBAPChunkController.hpp>
+
+
+namespace OpenAB_Tests {
+
+	class PBAPChunkControllerTests: public ::testing::Test
+	{
+	public:
+		PBAPChunkControllerTests() : ::testing::Test()
+		{
+
+		}
+
+		~PBAPChunkControllerTests()
+		{
+		}
+
+	protected:
+		virtual void SetUp()
+		{
+		}
+
+		virtual void TearDown()
+		{
+		}
+	};
+
+	TEST_F(PBAPChunkControllerTests, testConvergesToTargetTime)
+	{
+		//each transfer takes 200 ms plus 5 ms per item, so 160 items fit into 1 s
+		PBAPChunkController controller(1000, 10, 65535);
+		ASSERT_EQ(10u, controller.getChunkSize());
+
+		for (int i = 0; i < 20; ++i)
+		{
+			unsigned int size = controller.getChunkSize();
+			controller.chunkDownloaded(size, 200 + 5 * size);
+		}
+
+		ASSERT_NEAR(160, controller.getChunkSize(), 2);
+		ASSERT_EQ(20u, controller.getStats().size());
+		const PBAPChunkController::ChunkStats& last = controller.getStats().back();
+		ASSERT_NEAR(1000u, last.timeMs, 10);
+		ASSERT_NEAR(last.size * 1000.0 / last.timeMs, last.itemsPerSecond, 0.001);
+	}
+
+	TEST_F(PBAPChunkControllerTests, testGrowthIsLimited)
+	{
+		PBAPChunkController controller(1000, 10, 65535);
+		controller.chunkDownloaded(10, 1);
+		ASSERT_EQ(20u, controller.getChunkSize());
+		controller.chunkDownloaded(20, 1);
+		ASSERT_EQ(40u, controller.getChunkSize());
+	}
+
+	TEST_F(PBAPChunkControllerTests, testClamps)
+	{
+		PBAPChunkController controller(1000, 10, 30);
+
+		//slow transfer cannot go below minimal size
+		controller.chunkDownloaded(10, 5000);
+		ASSERT_EQ(10u, controller.getChunkSize());
+
+		//fast transfer cannot go above maximal size
+		for (int i = 0; i < 10; ++i)
+		{
+			controller.chunkDownloaded(controller.getChunkSize(), 0);
+		}
+		ASSERT_EQ(30u, controller.getChunkSize());
+	}
+
+	TEST_F(PBAPChunkControllerTests, testAdaptsToSlowerItems)
+	{
+		PBAPChunkController controller(1000, 10, 65535);
+		for (int i = 0; i < 20; ++i)
+		{
+			unsigned int size = controller.getChunkSize();
+			controller.chunkDownloaded(size, 5 * size);
+		}
+		ASSERT_NEAR(200, controller.getChunkSize(), 2);
+
+		//e.g. contacts with photos, items become 4 times slower
+		for (int i = 0; i < 20; ++i)
+		{
+			unsigned int size = controller.getChunkSize();
+			controller.chunkDownloaded(size, 20 * size);
+		}
+		ASSERT_NEAR(50, controller.getChunkSize(), 2);
+	}
+}
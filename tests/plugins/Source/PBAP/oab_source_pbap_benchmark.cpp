@@ -0,0 +1,138 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file oab_source_pbap_benchmark.cpp
+ * @brief Measures throughput of PBAP source end to end, using obex_mock.py as load generator.
+ *
+ * Usage: OpenAB_Source_PBAP_benchmark [--batch-time ms] [obex_mock.py options]
+ * e.g. OpenAB_Source_PBAP_benchmark --batch-time 500 --contacts 5000 --bandwidth 200000 --latency 50
+ */
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include "helpers/PluginManager.hpp"
+#include "helpers/TimeStamp.hpp"
+#include "plugin/source/Source.hpp"
+#include "../../TestHelpers.hpp"
+
+#define BENCHMARK_MAC "12:34:56:78:90:12"
+#define DEFAULT_CONTACTS "2000"
+
+namespace
+{
+  pid_t startMock(const std::vector<std::string>& args)
+  {
+    std::vector<char*> argv;
+    argv.push_back(const_cast<char*>("./obex_mock.py"));
+    for (unsigned int i = 0; i < args.size(); ++i)
+    {
+      argv.push_back(const_cast<char*>(args[i].c_str()));
+    }
+    argv.push_back(NULL);
+
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      prctl(PR_SET_PDEATHSIG, SIGTERM);
+      execv("obex_mock.py", &argv[0]);
+      _exit(1);
+    }
+    return pid;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  int batchTime = 0;
+  bool contactsSet = false;
+  std::vector<std::string> mockArgs;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (0 == strcmp(argv[i], "--batch-time") && i + 1 < argc)
+    {
+      batchTime = atoi(argv[++i]);
+      continue;
+    }
+    if (0 == strcmp(argv[i], "--contacts"))
+    {
+      contactsSet = true;
+    }
+    mockArgs.push_back(argv[i]);
+  }
+  if (!contactsSet)
+  {
+    mockArgs.push_back("--contacts");
+    mockArgs.push_back(DEFAULT_CONTACTS);
+  }
+
+  OpenAB::Logger::OutLevel() = OpenAB::Logger::Error;
+
+  pid_t mockPid = startMock(mockArgs);
+  if (mockPid < 0)
+  {
+    std::cerr<<"Cannot start obex_mock.py"<<std::endl;
+    return 1;
+  }
+  //take some time to setup mock
+  sleep(1);
+  if (0 != kill(mockPid, 0))
+  {
+    std::cerr<<"obex_mock.py is not running"<<std::endl;
+    return 1;
+  }
+
+  OpenAB_Source::Parameters p;
+  p.setValue("MAC", BENCHMARK_MAC);
+  p.setValue("batch_download_time", batchTime);
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  OpenAB_Source::Source* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("PBAP", p);
+  if (NULL == s)
+  {
+    std::cerr<<"Cannot create PBAP source"<<std::endl;
+    kill(mockPid, SIGTERM);
+    return 1;
+  }
+
+  OpenAB::TimeStamp startTime(true);
+  double startCpuTime = OpenAB_TESTS::cpuTimeMs();
+
+  unsigned int items = 0;
+  unsigned long long bytes = 0;
+  OpenAB_Source::Source::eGetItemRet ret = OpenAB_Source::Source::eGetItemRetError;
+  if (OpenAB_Source::Source::eInitOk == s->init())
+  {
+    OpenAB::SmartPtr<OpenAB::PIMItem> item;
+    while (OpenAB_Source::Source::eGetItemRetOk == (ret = s->getItem(item)))
+    {
+      ++items;
+      bytes += item->getRawData().size();
+    }
+  }
+
+  double cpuTime = OpenAB_TESTS::cpuTimeMs() - startCpuTime;
+  double wallTime = (OpenAB::TimeStamp(true) - startTime).toMs();
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+  kill(mockPid, SIGTERM);
+  waitpid(mockPid, NULL, 0);
+
+  std::cout<<"Result:       "<<(OpenAB_Source::Source::eGetItemRetEnd == ret ? "complete" : "error")<<std::endl;
+  std::cout<<"Items:        "<<items<<" ("<<bytes<<" bytes)"<<std::endl;
+  std::cout<<"Wall time:    "<<wallTime<<" ms"<<std::endl;
+  std::cout<<"Throughput:   "<<(wallTime > 0 ? items * 1000.0 / wallTime : 0)<<" items/s, "
+           <<(wallTime > 0 ? bytes / wallTime : 0)<<" kB/s"<<std::endl;
+  std::cout<<"CPU time:     "<<cpuTime<<" ms ("<<(items ? cpuTime * 1000.0 / items : 0)<<" us/item)"<<std::endl;
+  std::cout<<"Peak RSS:     "<<OpenAB_TESTS::peakRSSKb()<<" kB"<<std::endl;
+
+  return (OpenAB_Source::Source::eGetItemRetEnd == ret) ? 0 : 1;
+}
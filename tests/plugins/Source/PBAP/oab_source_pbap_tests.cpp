@@ -10,6 +10,8 @@
 #include <string>
 #include <sys/prctl.h>
 #include "helpers/PluginManager.hpp"
+#include "helpers/TimeStamp.hpp"
+#include "../../TestHelpers.hpp"
 
 
 class PBAPSourceTest: public ::testing::Test
@@ -65,6 +67,7 @@ protected:
 #define PULL_ALL_FAILURE_MAC "33:33:33:33:33:33"
 #define MISFORMATTED_VCARD_FAILURE_MAC "44:44:44:44:44:44"
 #define CANCEL_FAILURE_MAC "55:55:55:55:55:55"
+#define EMPTY_PHONEBOOK_MAC "66:66:66:66:66:66"
 #define NORMAL_VCARD_MAC "12:34:56:78:90:12"
 
 TEST_F(PBAPSourceTest, testEmptyParams)
@@ -164,6 +167,124 @@ TEST_F(PBAPSourceTest, testGetItem)
   OpenAB::PluginManager::getInstance().freePluginInstance(s);
 }
 
+TEST_F(PBAPSourceTest, testEmptyPhonebook)
+{
+  OpenAB_Source::Parameters p;
+  p.setValue("MAC", EMPTY_PHONEBOOK_MAC);
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+
+  //both downloading whole phonebook and downloading it in batches
+  for (int batchDownloadTime = 0; batchDownloadTime <= 1000; batchDownloadTime += 1000)
+  {
+    p.setValue("batch_download_time", batchDownloadTime);
+    OpenAB_Source::Source* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("PBAP", p);
+    ASSERT_TRUE(s);
+    ASSERT_EQ(OpenAB_Source::Source::eInitOk, s->init());
+    ASSERT_EQ(0, s->getTotalCount());
+    OpenAB::SmartPtr<OpenAB::PIMItem> item;
+    ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, s->getItem(item));
+    OpenAB::PluginManager::getInstance().freePluginInstance(s);
+  }
+}
+
+TEST_F(PBAPSourceTest, testMultiplePhonebooks)
+{
+  //contacts and call history sources of the same device share single session
+  OpenAB_Source::Parameters p1;
+  p1.setValue("MAC", NORMAL_VCARD_MAC);
+  OpenAB_Source::Parameters p2;
+  p2.setValue("MAC", NORMAL_VCARD_MAC);
+  p2.setValue("phonebook", "ich");
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  OpenAB_Source::Source* s1 = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("PBAP", p1);
+  OpenAB_Source::Source* s2 = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("PBAP", p2);
+  ASSERT_TRUE(s1);
+  ASSERT_TRUE(s2);
+  ASSERT_EQ(OpenAB_Source::Source::eInitOk, s1->init());
+  ASSERT_EQ(OpenAB_Source::Source::eInitOk, s2->init());
+
+  OpenAB::SmartPtr<OpenAB::PIMItem> item;
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s2->getItem(item));
+  ASSERT_NE("", item->getRawData());
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s1->getItem(item));
+  ASSERT_NE("", item->getRawData());
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, s2->getItem(item));
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, s1->getItem(item));
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s2);
+  OpenAB::PluginManager::getInstance().freePluginInstance(s1);
+}
+
+TEST_F(PBAPSourceTest, testCallHistoryCursor)
+{
+  char cursorTemplate[] = "/tmp/oab_pbap_cursor_XXXXXX";
+  int cursorFd = mkstemp(cursorTemplate);
+  ASSERT_NE(-1, cursorFd);
+  close(cursorFd);
+
+  OpenAB_Source::Parameters p;
+  p.setValue("MAC", NORMAL_VCARD_MAC);
+  p.setValue("phonebook", "cch");
+  p.setValue("cursor_file", cursorTemplate);
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+
+  //first synchronization provides all entries, they are provided again until they are committed
+  OpenAB_Source::Source* s = NULL;
+  OpenAB::SmartPtr<OpenAB::PIMItem> item;
+  for (int i = 0; i < 2; ++i)
+  {
+    s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("PBAP", p);
+    ASSERT_TRUE(s);
+    ASSERT_EQ(OpenAB_Source::Source::eInitOk, s->init());
+    ASSERT_TRUE(s->isDelta());
+    ASSERT_EQ(-1, s->getTotalCount());
+    ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s->getItem(item));
+    ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, s->getItem(item));
+    if (1 == i)
+    {
+      s->commitDelta();
+    }
+    OpenAB::PluginManager::getInstance().freePluginInstance(s);
+  }
+
+  //call history did not change, so there are no new entries
+  s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("PBAP", p);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(OpenAB_Source::Source::eInitOk, s->init());
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, s->getItem(item));
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+
+  unlink(cursorTemplate);
+}
+
+TEST_F(PBAPSourceTest, testGetItemCPUTime)
+{
+  //obex mock writes vCard line by line with delays, download thread should not
+  //use CPU while waiting for data (it was spinning on FIFO before)
+  OpenAB_Source::Parameters p;
+  p.setValue("MAC", NORMAL_VCARD_MAC);
+  OpenAB::Logger::OutLevel() = OpenAB::Logger::Error;
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  OpenAB_Source::Source* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Source::Source>("PBAP", p);
+  ASSERT_TRUE(s);
+
+  OpenAB::TimeStamp startTime(true);
+  double startCpuTime = OpenAB_TESTS::cpuTimeMs();
+
+  ASSERT_EQ(OpenAB_Source::Source::eInitOk, s->init());
+  OpenAB::SmartPtr<OpenAB::PIMItem> item;
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetOk, s->getItem(item));
+  ASSERT_EQ(OpenAB_Source::Source::eGetItemRetEnd, s->getItem(item));
+
+  double cpuTime = OpenAB_TESTS::cpuTimeMs() - startCpuTime;
+  double wallTime = (OpenAB::TimeStamp(true) - startTime).toMs();
+  RecordProperty("TransferWallTimeMs", (int)wallTime);
+  RecordProperty("TransferCPUTimeMs", (int)cpuTime);
+  ASSERT_LT(cpuTime, wallTime / 2);
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
+
 TEST_F(PBAPSourceTest, testGetItemWithIgnoredPhotoField)
 {
   OpenAB_Source::Parameters p;
@@ -0,0 +1,393 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file CalDAVTimeRange_tests.cpp
+ */
+#include <gtest/gtest.h>
+#include <string>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <OpenAB.hpp>
+#include <plugins/carddav/CalDAVHelper.hpp>
+#include <helpers/BasicHttpAuthorizer.hpp>
+
+namespace OpenAB_Tests
+{
+  /*
+   * Minimal HTTP server answering every request with the same multistatus response,
+   * it records method and body of last request so that queries sent by CalDAVHelper can be checked.
+   */
+  class FakeDAVServer
+  {
+    public:
+      FakeDAVServer() : fd(-1), port(0), stopping(false)
+      {
+        pthread_mutex_init(&mutex, NULL);
+      }
+
+      ~FakeDAVServer()
+      {
+        stop();
+        pthread_mutex_destroy(&mutex);
+      }
+
+      bool start(const std::string& multistatus)
+      {
+        response = multistatus;
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0)
+        {
+          return false;
+        }
+
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        socklen_t len = sizeof(addr);
+        if (0 != bind(fd, (struct sockaddr*)&addr, sizeof(addr)) ||
+            0 != listen(fd, 4) ||
+            0 != getsockname(fd, (struct sockaddr*)&addr, &len))
+        {
+          close(fd);
+          fd = -1;
+          return false;
+        }
+        port = ntohs(addr.sin_port);
+        return 0 == pthread_create(&thread, NULL, serveWrapper, this);
+      }
+
+      void stop()
+      {
+        if (fd < 0)
+        {
+          return;
+        }
+        pthread_mutex_lock(&mutex);
+        stopping = true;
+        pthread_mutex_unlock(&mutex);
+        //unblocks accept
+        shutdown(fd, SHUT_RDWR);
+        pthread_join(thread, NULL);
+        close(fd);
+        fd = -1;
+      }
+
+      std::string getUrl() const
+      {
+        std::stringstream url;
+        url<<"http://127.0.0.1:"<<port<<"/calendars/user/calendar/";
+        return url.str();
+      }
+
+      std::string getMethod()
+      {
+        pthread_mutex_lock(&mutex);
+        std::string m = method;
+        pthread_mutex_unlock(&mutex);
+        return m;
+      }
+
+      std::string getBody()
+      {
+        pthread_mutex_lock(&mutex);
+        std::string b = body;
+        pthread_mutex_unlock(&mutex);
+        return b;
+      }
+
+    private:
+      static void* serveWrapper(void* ptr)
+      {
+        static_cast<FakeDAVServer*>(ptr)->serve();
+        return NULL;
+      }
+
+      void serve()
+      {
+        while (true)
+        {
+          int client = accept(fd, NULL, NULL);
+          if (client < 0)
+          {
+            break;
+          }
+          handle(client);
+          close(client);
+
+          pthread_mutex_lock(&mutex);
+          bool s = stopping;
+          pthread_mutex_unlock(&mutex);
+          if (s)
+          {
+            break;
+          }
+        }
+      }
+
+      static bool readMore(int client, std::string& data)
+      {
+        char buf[1024];
+        ssize_t r = read(client, buf, sizeof(buf));
+        if (r <= 0)
+        {
+          return false;
+        }
+        data.append(buf, r);
+        return true;
+      }
+
+      static std::string getHeader(const std::string& headers, const std::string& name)
+      {
+        std::string::size_type pos = 0;
+        while (std::string::npos != (pos = headers.find("\r\n", pos)))
+        {
+          pos += 2;
+          if (0 == strncasecmp(headers.c_str() + pos, (name + ":").c_str(), name.size() + 1))
+          {
+            std::string::size_type begin = headers.find_first_not_of(' ', pos + name.size() + 1);
+            return headers.substr(begin, headers.find("\r\n", begin) - begin);
+          }
+        }
+        return "";
+      }
+
+      void handle(int client)
+      {
+        std::string data;
+        std::string::size_type headersEnd;
+        while (std::string::npos == (headersEnd = data.find("\r\n\r\n")))
+        {
+          if (!readMore(client, data))
+          {
+            return;
+          }
+        }
+        std::string headers = data.substr(0, headersEnd);
+        data.erase(0, headersEnd + 4);
+
+        if (!getHeader(headers, "Expect").empty())
+        {
+          const char* cont = "HTTP/1.1 100 Continue\r\n\r\n";
+          if (write(client, cont, strlen(cont)) < 0)
+          {
+            return;
+          }
+        }
+
+        std::string requestBody;
+        if (getHeader(headers, "Transfer-Encoding") == "chunked")
+        {
+          while (true)
+          {
+            std::string::size_type lineEnd;
+            while (std::string::npos == (lineEnd = data.find("\r\n")))
+            {
+              if (!readMore(client, data))
+              {
+                return;
+              }
+            }
+            size_t chunkSize = strtoul(data.c_str(), NULL, 16);
+            while (data.size() < lineEnd + 2 + chunkSize + 2)
+            {
+              if (!readMore(client, data))
+              {
+                return;
+              }
+            }
+            requestBody += data.substr(lineEnd + 2, chunkSize);
+            data.erase(0, lineEnd + 2 + chunkSize + 2);
+            if (0 == chunkSize)
+            {
+              break;
+            }
+          }
+        }
+        else
+        {
+          size_t length = strtoul(getHeader(headers, "Content-Length").c_str(), NULL, 10);
+          while (data.size() < length)
+          {
+            if (!readMore(client, data))
+            {
+              return;
+            }
+          }
+          requestBody = data.substr(0, length);
+        }
+
+        pthread_mutex_lock(&mutex);
+        method = headers.substr(0, headers.find(' '));
+        body = requestBody;
+        pthread_mutex_unlock(&mutex);
+
+        std::stringstream reply;
+        reply<<"HTTP/1.1 207 Multi-Status\r\n"
+             <<"Content-Type: application/xml; charset=utf-8\r\n"
+             <<"Content-Length: "<<response.size()<<"\r\n"
+             <<"Connection: close\r\n\r\n"
+             <<response;
+        std::string r = reply.str();
+        if (write(client, r.c_str(), r.size()) < 0)
+        {
+          return;
+        }
+      }
+
+      int fd;
+      unsigned short port;
+      bool stopping;
+      pthread_t thread;
+      pthread_mutex_t mutex;
+      std::string response;
+      std::string method;
+      std::string body;
+  };
+
+  //calendar-query response - resources overlapping time range, collection itself has no etag
+  std::string timeRangeResponse = "<?xml version='1.0' encoding='utf-8'?>"
+  "<d:multistatus xmlns:d='DAV:'>"
+  "<d:response><d:href>/calendars/user/calendar/</d:href>"
+  "<d:propstat><d:prop><d:resourcetype><d:collection/></d:resourcetype></d:prop>"
+  "<d:status>HTTP/1.1 200 OK</d:status></d:propstat></d:response>"
+  "<d:response><d:href>/calendars/user/calendar/inside.ics</d:href>"
+  "<d:propstat><d:prop><d:getetag>\"1\"</d:getetag><d:resourcetype/></d:prop>"
+  "<d:status>HTTP/1.1 200 OK</d:status></d:propstat></d:response>"
+  "<d:response><d:href>/calendars/user/calendar/crossing.ics</d:href>"
+  "<d:propstat><d:prop><d:getetag>\"2\"</d:getetag><d:resourcetype/></d:prop>"
+  "<d:status>HTTP/1.1 200 OK</d:status></d:propstat></d:response>"
+  "</d:multistatus>";
+
+  class CalDAVTimeRangeTests: public ::testing::Test
+  {
+    public:
+      CalDAVTimeRangeTests() : ::testing::Test()
+      {
+      }
+
+      ~CalDAVTimeRangeTests()
+      {
+      }
+
+    protected:
+      virtual void SetUp()
+      {
+        OpenAB::Logger::setDefaultLogger(NULL);
+        OpenAB::Logger::OutLevel() = OpenAB::Logger::Error;
+        httpSession.init();
+        authorizer.setCredentials("user", "password");
+        ASSERT_TRUE(server.start(timeRangeResponse));
+      }
+
+      virtual void TearDown()
+      {
+        server.stop();
+        httpSession.cleanup();
+      }
+
+      OpenAB::HttpSession httpSession;
+      OpenAB::BasicHttpAuthorizer authorizer;
+      FakeDAVServer server;
+  };
+
+  TEST_F(CalDAVTimeRangeTests, testGetTimeRange)
+  {
+    //2015-06-15 12:00:00 UTC
+    time_t now = 1434369600;
+    std::string start, end;
+
+    CalDAVHelper::getTimeRange(now, 1, 2, start, end);
+    ASSERT_EQ("20150614T120000Z", start);
+    ASSERT_EQ("20150617T120000Z", end);
+
+    CalDAVHelper::getTimeRange(now, -1, 2, start, end);
+    ASSERT_EQ("", start);
+    ASSERT_EQ("20150617T120000Z", end);
+
+    CalDAVHelper::getTimeRange(now, 1, -1, start, end);
+    ASSERT_EQ("20150614T120000Z", start);
+    ASSERT_EQ("", end);
+
+    //empty range, time range is disabled
+    CalDAVHelper::getTimeRange(now, -1, -1, start, end);
+    ASSERT_EQ("", start);
+    ASSERT_EQ("", end);
+
+    //range of zero length
+    CalDAVHelper::getTimeRange(now, 0, 0, start, end);
+    ASSERT_EQ("20150615T120000Z", start);
+    ASSERT_EQ(start, end);
+  }
+
+  TEST_F(CalDAVTimeRangeTests, testGetTimeRangeCrossingYearBoundary)
+  {
+    //2014-12-31 23:00:00 UTC
+    time_t now = 1420066800;
+    std::string start, end;
+    CalDAVHelper::getTimeRange(now, 365, 1, start, end);
+    ASSERT_EQ("20131231T230000Z", start);
+    ASSERT_EQ("20150101T230000Z", end);
+  }
+
+  TEST_F(CalDAVTimeRangeTests, testEmptyTimeRangeListsWholeCalendar)
+  {
+    CalDAVHelper helper(server.getUrl(), true, &httpSession, &authorizer);
+    helper.setTimeRange("VEVENT", "", "");
+    ASSERT_FALSE(helper.hasTimeRange());
+
+    //without time range whole calendar is listed using PROPFIND
+    ASSERT_TRUE(helper.queryEventsMetadata(server.getUrl()));
+    ASSERT_EQ("PROPFIND", server.getMethod());
+    ASSERT_EQ(std::string::npos, server.getBody().find("time-range"));
+  }
+
+  TEST_F(CalDAVTimeRangeTests, testQueryTimeRangeMetadata)
+  {
+    CalDAVHelper helper(server.getUrl(), true, &httpSession, &authorizer);
+    helper.setTimeRange("VTODO", "20150614T120000Z", "20150617T120000Z");
+    ASSERT_TRUE(helper.hasTimeRange());
+
+    ASSERT_TRUE(helper.queryEventsMetadata(server.getUrl()));
+    ASSERT_EQ("REPORT", server.getMethod());
+    std::string body = server.getBody();
+    ASSERT_NE(std::string::npos, body.find("calendar-query"));
+    ASSERT_NE(std::string::npos, body.find("<C:comp-filter name='VTODO'>"));
+    ASSERT_NE(std::string::npos, body.find("<C:time-range start='20150614T120000Z' end='20150617T120000Z'/>"));
+
+    //collection is skipped, all resources returned by server are reported
+    CalDAVHelper::EventsMetadata metadata = helper.getEventsMetadata();
+    ASSERT_EQ(2u, metadata.size());
+    ASSERT_EQ("/calendars/user/calendar/inside.ics", metadata[0].uri);
+    ASSERT_EQ("\"1\"", metadata[0].etag);
+    ASSERT_EQ("/calendars/user/calendar/crossing.ics", metadata[1].uri);
+    ASSERT_EQ("\"2\"", metadata[1].etag);
+  }
+
+  TEST_F(CalDAVTimeRangeTests, testQueryTimeRangeCrossingWindowBoundary)
+  {
+    //window bounded only on one side, unbounded side is omitted from filter
+    //so that objects crossing the bounded edge are still returned by server
+    CalDAVHelper helper(server.getUrl(), true, &httpSession, &authorizer);
+    helper.setTimeRange("VEVENT", "20150614T120000Z", "");
+    ASSERT_TRUE(helper.queryEventsMetadata(server.getUrl()));
+    ASSERT_NE(std::string::npos, server.getBody().find("<C:time-range start='20150614T120000Z'/>"));
+    ASSERT_EQ(2u, helper.getEventsMetadata().size());
+
+    helper.setTimeRange("VEVENT", "", "20150617T120000Z");
+    ASSERT_TRUE(helper.queryEventsMetadata(server.getUrl()));
+    ASSERT_NE(std::string::npos, server.getBody().find("<C:time-range end='20150617T120000Z'/>"));
+    ASSERT_EQ(2u, helper.getEventsMetadata().size());
+  }
+}
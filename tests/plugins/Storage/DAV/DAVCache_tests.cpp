@@ -0,0 +1,131 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file DAVCache_tests.cpp
+ */
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+#include <OpenAB.hpp>
+#include <plugins/carddav/DAVCache.hpp>
+#include "../../TestHelpers.hpp"
+
+
+namespace OpenAB_Tests {
+
+	class DAVCacheTests: public ::testing::Test
+	{
+	public:
+		DAVCacheTests() : ::testing::Test()
+		{
+
+		}
+
+		~DAVCacheTests()
+		{
+		}
+
+	protected:
+		virtual void SetUp()
+		{
+			OpenAB::Logger::setDefaultLogger(NULL);
+			OpenAB::Logger::OutLevel() = OpenAB::Logger::Error;
+
+			char dirTemplate[] = "/tmp/oab_dav_cache_XXXXXX";
+			cacheDir = mkdtemp(dirTemplate);
+		}
+
+		virtual void TearDown()
+		{
+			ASSERT_TRUE(OpenAB_TESTS::removeDirectory(cacheDir));
+		}
+
+		std::string cacheDir;
+	};
+
+	TEST_F(DAVCacheTests, testStoreAndLookup)
+	{
+		DAVCache cache(cacheDir + "/nested", "https://example.com/addressbook/");
+		ASSERT_TRUE(cache.init());
+
+		std::string data;
+		ASSERT_FALSE(cache.lookup("/addressbook/1.vcf", "\"etag1\"", data));
+
+		std::string vcard = "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Test\r\nEND:VCARD\r\n";
+		ASSERT_TRUE(cache.store("/addressbook/1.vcf", "\"etag1\"", vcard));
+		ASSERT_TRUE(cache.lookup("/addressbook/1.vcf", "\"etag1\"", data));
+		ASSERT_EQ(vcard, data);
+
+		//changed etag has to invalidate entry
+		ASSERT_FALSE(cache.lookup("/addressbook/1.vcf", "\"etag2\"", data));
+	}
+
+	TEST_F(DAVCacheTests, testCollectionsAreSeparated)
+	{
+		DAVCache cache1(cacheDir, "https://example.com/addressbook1/");
+		DAVCache cache2(cacheDir, "https://example.com/addressbook2/");
+		ASSERT_TRUE(cache1.init());
+		ASSERT_TRUE(cache2.init());
+
+		ASSERT_TRUE(cache1.store("/1.vcf", "1", "data"));
+
+		std::string data;
+		ASSERT_TRUE(cache1.lookup("/1.vcf", "1", data));
+		ASSERT_FALSE(cache2.lookup("/1.vcf", "1", data));
+	}
+
+	TEST_F(DAVCacheTests, testRemoveAndPrune)
+	{
+		DAVCache cache(cacheDir, "https://example.com/calendar/");
+		ASSERT_TRUE(cache.init());
+
+		ASSERT_TRUE(cache.store("/1.ics", "1", "data1"));
+		ASSERT_TRUE(cache.store("/2.ics", "1", "data2"));
+		ASSERT_TRUE(cache.store("/3.ics", "1", "data3"));
+
+		std::string data;
+		cache.remove("/1.ics");
+		ASSERT_FALSE(cache.lookup("/1.ics", "1", data));
+
+		std::vector<std::string> hrefs;
+		hrefs.push_back("/2.ics");
+		cache.prune(hrefs);
+		ASSERT_TRUE(cache.lookup("/2.ics", "1", data));
+		ASSERT_EQ("data2", data);
+		ASSERT_FALSE(cache.lookup("/3.ics", "1", data));
+	}
+
+	TEST_F(DAVCacheTests, testNotInitialized)
+	{
+		DAVCache cache(cacheDir, "https://example.com/addressbook/");
+
+		std::string data;
+		ASSERT_FALSE(cache.store("/1.vcf", "1", "data"));
+		ASSERT_FALSE(cache.lookup("/1.vcf", "1", data));
+	}
+
+	TEST_F(DAVCacheTests, testState)
+	{
+		DAVCache::State state;
+		ASSERT_FALSE(DAVCache::loadState(cacheDir, "https://example.com user", state));
+
+		state["addressbook_url"] = "https://example.com/addressbooks/user/default/";
+		state["sync_token"] = "http://example.com/ns/sync/1234";
+		state["ctag"] = "";
+		ASSERT_TRUE(DAVCache::saveState(cacheDir, "https://example.com user", state));
+
+		DAVCache::State loaded;
+		ASSERT_TRUE(DAVCache::loadState(cacheDir, "https://example.com user", loaded));
+		ASSERT_EQ(state, loaded);
+
+		//state is stored per key
+		ASSERT_FALSE(DAVCache::loadState(cacheDir, "https://example.com other_user", loaded));
+
+		DAVCache::removeState(cacheDir, "https://example.com user");
+		ASSERT_FALSE(DAVCache::loadState(cacheDir, "https://example.com user", loaded));
+	}
+}
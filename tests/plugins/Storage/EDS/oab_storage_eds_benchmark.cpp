@@ -0,0 +1,243 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file oab_storage_eds_benchmark.cpp
+ * @brief Compares scan of EDS contacts storage over D-Bus and using direct read access.
+ *
+ * Creates temporary address book filled with generated contacts, then for both access modes
+ * iterates over all contacts, gets revisions of all of them and gets all of them by ids.
+ *
+ * Usage: OpenAB_Storage_EDS_benchmark [--contacts count]
+ */
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include "helpers/PluginManager.hpp"
+#include "helpers/TimeStamp.hpp"
+#include "plugin/storage/ContactsStorage.hpp"
+#include "glib2/OpenAB_glib2_global.h"
+#include <libebook/libebook.h>
+#include "../../TestHelpers.hpp"
+
+#define BENCHMARK_SOURCE "oab_benchmark"
+#define DEFAULT_CONTACTS 10000
+#define ADD_BATCH_SIZE   500
+
+namespace
+{
+  bool createSource(const std::string& name)
+  {
+    GError* gerror = NULL;
+    ESourceRegistry* registry = e_source_registry_new_sync(NULL, &gerror);
+    if (!registry)
+    {
+      std::cerr<<"Cannot create source registry: "<<GERROR_MESSAGE(gerror)<<std::endl;
+      GERROR_FREE(gerror);
+      return false;
+    }
+
+    ESource* source = e_source_new_with_uid(name.c_str(), NULL, &gerror);
+    if (!source)
+    {
+      std::cerr<<"Cannot create source "<<name<<": "<<GERROR_MESSAGE(gerror)<<std::endl;
+      GERROR_FREE(gerror);
+      g_object_unref(registry);
+      return false;
+    }
+    e_source_set_display_name(source, name.c_str());
+
+    g_type_ensure(E_TYPE_SOURCE_ADDRESS_BOOK);
+    ESourceBackend* backend = E_SOURCE_BACKEND(e_source_get_extension(source, E_SOURCE_EXTENSION_ADDRESS_BOOK));
+    if (backend)
+    {
+      e_source_backend_set_backend_name(backend, "local");
+    }
+
+    bool res = e_source_registry_commit_source_sync(registry, source, NULL, &gerror);
+    if (!res)
+    {
+      std::cerr<<"Cannot commit source "<<name<<": "<<GERROR_MESSAGE(gerror)<<std::endl;
+      GERROR_FREE(gerror);
+    }
+    g_object_unref(source);
+    g_object_unref(registry);
+    return res;
+  }
+
+  void removeSource(const std::string& name)
+  {
+    GError* gerror = NULL;
+    ESourceRegistry* registry = e_source_registry_new_sync(NULL, &gerror);
+    if (!registry)
+    {
+      GERROR_FREE(gerror);
+      return;
+    }
+
+    ESource* source = e_source_registry_ref_source(registry, name.c_str());
+    if (source)
+    {
+      e_source_remove_sync(source, NULL, &gerror);
+      GERROR_FREE(gerror);
+      g_object_unref(source);
+    }
+    g_object_unref(registry);
+
+    OpenAB_TESTS::removeDirectory(std::string(g_get_user_data_dir()) + "/evolution/addressbook/" + name);
+  }
+
+  OpenAB_Storage::ContactsStorage* openStorage(bool directRead)
+  {
+    OpenAB_Storage::Parameters p;
+    p.setValue("db", BENCHMARK_SOURCE);
+    p.setValue("direct_read", directRead);
+    OpenAB_Storage::Storage* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Storage::Storage>("EDSContacts", p);
+    if (NULL == s)
+    {
+      return NULL;
+    }
+    if (OpenAB_Storage::Storage::eInitOk != s->init())
+    {
+      OpenAB::PluginManager::getInstance().freePluginInstance(s);
+      return NULL;
+    }
+    return dynamic_cast<OpenAB_Storage::ContactsStorage*>(s);
+  }
+
+  bool fillStorage(unsigned int count)
+  {
+    OpenAB_Storage::ContactsStorage* s = openStorage(false);
+    if (NULL == s)
+    {
+      return false;
+    }
+
+    bool res = true;
+    std::vector<std::string> vCards;
+    for (unsigned int i = 0; i < count && res; ++i)
+    {
+      std::stringstream vCard;
+      vCard<<"BEGIN:VCARD\n"
+           <<"VERSION:3.0\n"
+           <<"N:Surname"<<i<<";Name"<<i<<";;;\n"
+           <<"FN:Name"<<i<<" Surname"<<i<<"\n"
+           <<"TEL;TYPE=CELL:+48"<<(500000000 + i)<<"\n"
+           <<"EMAIL;TYPE=HOME:name"<<i<<"@example.com\n"
+           <<"ADR;TYPE=HOME:;;Street "<<i<<";City;;00-"<<(i % 1000)<<";Country\n"
+           <<"END:VCARD\n";
+      vCards.push_back(vCard.str());
+
+      if (vCards.size() == ADD_BATCH_SIZE || i + 1 == count)
+      {
+        OpenAB::PIMItem::IDs ids;
+        OpenAB::PIMItem::Revisions revisions;
+        res = (OpenAB_Storage::Storage::eAddItemOk == s->addContacts(vCards, ids, revisions));
+        vCards.clear();
+      }
+    }
+
+    OpenAB::PluginManager::getInstance().freePluginInstance(s);
+    return res;
+  }
+
+  void printTime(const std::string& name, const OpenAB::TimeStamp& start, double startCpuTime)
+  {
+    std::cout<<"  "<<name<<(OpenAB::TimeStamp(true) - start).toMs()<<" ms wall, "
+             <<(OpenAB_TESTS::cpuTimeMs() - startCpuTime)<<" ms CPU"<<std::endl;
+  }
+
+  bool scanStorage(bool directRead, unsigned int count)
+  {
+    std::cout<<(directRead ? "Direct read:" : "D-Bus:")<<std::endl;
+
+    OpenAB::TimeStamp start(true);
+    double startCpuTime = OpenAB_TESTS::cpuTimeMs();
+    OpenAB_Storage::ContactsStorage* s = openStorage(directRead);
+    if (NULL == s)
+    {
+      std::cerr<<"Cannot open storage"<<std::endl;
+      return false;
+    }
+    printTime("init:          ", start, startCpuTime);
+
+    start = OpenAB::TimeStamp(true);
+    startCpuTime = OpenAB_TESTS::cpuTimeMs();
+    unsigned int items = 0;
+    OpenAB::PIMItem::IDs ids;
+    OpenAB_Storage::StorageItemIterator* iter = s->newStorageItemIterator();
+    if (iter)
+    {
+      while (iter->next())
+      {
+        ids.push_back((*iter)->id);
+        ++items;
+      }
+      delete iter;
+    }
+    printTime("iterator:      ", start, startCpuTime);
+
+    start = OpenAB::TimeStamp(true);
+    startCpuTime = OpenAB_TESTS::cpuTimeMs();
+    std::map<std::string, std::string> revisions;
+    bool revisionsOk = (OpenAB_Storage::Storage::eGetRevisionsOk == s->getRevisions(revisions));
+    printTime("getRevisions:  ", start, startCpuTime);
+
+    start = OpenAB::TimeStamp(true);
+    startCpuTime = OpenAB_TESTS::cpuTimeMs();
+    std::vector<OpenAB::SmartPtr<OpenAB::PIMContactItem> > contacts;
+    bool contactsOk = (OpenAB_Storage::Storage::eGetItemOk == s->getContacts(ids, contacts));
+    printTime("getContacts:   ", start, startCpuTime);
+
+    OpenAB::PluginManager::getInstance().freePluginInstance(s);
+
+    bool res = (items == count && revisionsOk && revisions.size() == count &&
+                contactsOk && contacts.size() == count);
+    if (!res)
+    {
+      std::cerr<<"Unexpected results, iterated "<<items<<", revisions "<<revisions.size()
+               <<", contacts "<<contacts.size()<<" of "<<count<<std::endl;
+    }
+    return res;
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  unsigned int count = DEFAULT_CONTACTS;
+  for (int i = 1; i < argc; ++i)
+  {
+    if (0 == strcmp(argv[i], "--contacts") && i + 1 < argc)
+    {
+      count = atoi(argv[++i]);
+    }
+  }
+
+  OpenAB::Logger::OutLevel() = OpenAB::Logger::Error;
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+
+  removeSource(BENCHMARK_SOURCE);
+  if (!createSource(BENCHMARK_SOURCE))
+  {
+    return 1;
+  }
+
+  std::cout<<"Adding "<<count<<" contacts"<<std::endl;
+  bool res = fillStorage(count);
+  if (!res)
+  {
+    std::cerr<<"Cannot add contacts"<<std::endl;
+  }
+
+  res = res && scanStorage(false, count);
+  res = res && scanStorage(true, count);
+
+  removeSource(BENCHMARK_SOURCE);
+  return res ? 0 : 1;
+}
@@ -15,7 +15,7 @@
 #include <libebook/libebook.h>
 #include <libedata-book/libedata-book.h>
 
-bool createSource(const std::string& name)
+bool createSource(const std::string& name, const char* extension = E_SOURCE_EXTENSION_ADDRESS_BOOK)
 {
   ESourceRegistry* sourceRegistry;
   ESource* newSource;
@@ -41,8 +41,8 @@ bool createSource(const std::string& name)
   e_source_set_display_name (newSource, name.c_str());
 
   g_type_ensure (E_TYPE_SOURCE_ADDRESS_BOOK);
-  ESourceBackend *backend_setup = E_SOURCE_BACKEND(e_source_get_extension (newSource,
-                                                                           E_SOURCE_EXTENSION_ADDRESS_BOOK));
+  g_type_ensure (E_TYPE_SOURCE_CALENDAR);
+  ESourceBackend *backend_setup = E_SOURCE_BACKEND(e_source_get_extension (newSource, extension));
   if(backend_setup)
   {
     e_source_backend_set_backend_name(backend_setup, "local");
@@ -74,7 +74,7 @@ bool removePeerData(const std::string& path)
   return true;
 }
 
-bool removeSource(const std::string& name)
+bool removeSource(const std::string& name, const std::string& dataKind = "addressbook")
 {
   ESourceRegistry* sourceRegistry;
   ESource* source;
@@ -110,7 +110,7 @@ bool removeSource(const std::string& name)
   g_object_unref (sourceRegistry);
 
   const char* dataDir = g_get_user_data_dir();
-  std::string peerDataDir = std::string(dataDir) + std::string("/evolution/addressbook/") + name;
+  std::string peerDataDir = std::string(dataDir) + std::string("/evolution/") + dataKind + std::string("/") + name;
 
   if(!removePeerData(peerDataDir))
   {
@@ -162,6 +162,12 @@ static const char* vcard1 = \
 "N:Surname2;Name2;Middle2;Perfix2;Suffix2\n"
 "END:VCARD\n";
 
+static const char* vcard2 = \
+"BEGIN:VCARD\n"
+"VERSION:3.0\n"
+"N:Surname3;Name3;Middle3;Perfix3;Suffix3\n"
+"END:VCARD\n";
+
 
 TEST_F(EDSStorageTest, testEmptyParams)
 {
@@ -894,3 +900,347 @@ TEST_F(EDSStorageTest, testAddNullItem)
   OpenAB::PluginManager::getInstance().freePluginInstance(s);
 }
 
+TEST_F(EDSStorageTest, testGetChangedRevisions)
+{
+  OpenAB_Storage::Parameters p;
+  p.setValue("db", "oab");
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  ASSERT_TRUE(OpenAB::PluginManager::getInstance().isPluginAvailable("EDSContacts"));
+  OpenAB_Storage::Storage* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Storage::Storage>("EDSContacts", p);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(OpenAB_Storage::Storage::eInitOk, s->init());
+
+  // add two contacts to db
+  OpenAB::SmartPtr<OpenAB::PIMItem> newItem = new OpenAB::PIMContactItem();
+  ASSERT_TRUE(newItem->parse(vcard0));
+  OpenAB::PIMItem::ID item0Id = "";
+  OpenAB::PIMItem::Revision item0Rev = "";
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(newItem, item0Id, item0Rev));
+
+  newItem = new OpenAB::PIMContactItem();
+  ASSERT_TRUE(newItem->parse(vcard1));
+  OpenAB::PIMItem::ID item1Id = "";
+  OpenAB::PIMItem::Revision item1Rev = "";
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(newItem, item1Id, item1Rev));
+
+  std::string token;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetSyncTokenOk, s->getLatestSyncToken(token));
+  ASSERT_NE("", token);
+
+  //nothing changed since token
+  std::map<std::string, std::string> revisions;
+  std::vector<OpenAB::PIMItem::ID> removed;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsOk, s->getChangedRevisions(token, revisions, removed));
+  ASSERT_TRUE(revisions.empty());
+  ASSERT_TRUE(removed.empty());
+
+  //add, modify and remove one contact
+  newItem = new OpenAB::PIMContactItem();
+  ASSERT_TRUE(newItem->parse(vcard2));
+  OpenAB::PIMItem::ID item2Id = "";
+  OpenAB::PIMItem::Revision item2Rev = "";
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(newItem, item2Id, item2Rev));
+
+  newItem = new OpenAB::PIMContactItem();
+  ASSERT_TRUE(newItem->parse(vcard2));
+  ASSERT_EQ(OpenAB_Storage::Storage::eModifyItemOk, s->modifyItem(newItem, item0Id, item0Rev));
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItem(item1Id));
+
+  //exactly those changes are reported
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsOk, s->getChangedRevisions(token, revisions, removed));
+  ASSERT_EQ(2, revisions.size());
+  ASSERT_EQ(item2Rev, revisions[item2Id]);
+  ASSERT_EQ(item0Rev, revisions[item0Id]);
+  ASSERT_EQ(1, removed.size());
+  ASSERT_EQ(item1Id, removed[0]);
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
+
+TEST_F(EDSStorageTest, testGetChangedRevisionsUnknownToken)
+{
+  OpenAB_Storage::Parameters p;
+  p.setValue("db", "oab");
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  ASSERT_TRUE(OpenAB::PluginManager::getInstance().isPluginAvailable("EDSContacts"));
+  OpenAB_Storage::Storage* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Storage::Storage>("EDSContacts", p);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(OpenAB_Storage::Storage::eInitOk, s->init());
+
+  std::string staleToken;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetSyncTokenOk, s->getLatestSyncToken(staleToken));
+
+  OpenAB::SmartPtr<OpenAB::PIMItem> newItem = new OpenAB::PIMContactItem();
+  ASSERT_TRUE(newItem->parse(vcard0));
+  OpenAB::PIMItem::ID itemId = "";
+  OpenAB::PIMItem::Revision itemRev = "";
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(newItem, itemId, itemRev));
+
+  //new token replaces snapshot of the previous one
+  std::string token;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetSyncTokenOk, s->getLatestSyncToken(token));
+  ASSERT_NE(staleToken, token);
+
+  std::map<std::string, std::string> revisions;
+  std::vector<OpenAB::PIMItem::ID> removed;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsFail, s->getChangedRevisions(staleToken, revisions, removed));
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsFail, s->getChangedRevisions("UnknownToken", revisions, removed));
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsFail, s->getChangedRevisions("", revisions, removed));
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsOk, s->getChangedRevisions(token, revisions, removed));
+  ASSERT_TRUE(revisions.empty());
+  ASSERT_TRUE(removed.empty());
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
+
+TEST_F(EDSStorageTest, testGetContacts)
+{
+  OpenAB_Storage::Parameters p;
+  p.setValue("db", "oab");
+  //ids below span several batches and are repeated both in the same and in different batches
+  p.setValue("get_batch_size", 3);
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  ASSERT_TRUE(OpenAB::PluginManager::getInstance().isPluginAvailable("EDSContacts"));
+  OpenAB_Storage::Storage* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Storage::Storage>("EDSContacts", p);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(OpenAB_Storage::Storage::eInitOk, s->init());
+
+  //add three contacts to db
+  std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > newItems;
+  const char* vcards[] = {vcard0, vcard1, vcard2};
+  for (unsigned int i = 0; i < 3; ++i)
+  {
+    OpenAB::PIMItem* newContact = new OpenAB::PIMContactItem();
+    ASSERT_TRUE(newContact->parse(vcards[i]));
+    newItems.push_back(newContact);
+  }
+  OpenAB::PIMItem::IDs itemIds;
+  OpenAB::PIMItem::Revisions itemRevs;
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItems(newItems, itemIds, itemRevs));
+  ASSERT_EQ(3, itemIds.size());
+
+  //contacts are returned in requested order, also when requested more than once
+  OpenAB::PIMItem::IDs ids;
+  ids.push_back(itemIds[2]);
+  ids.push_back(itemIds[0]);
+  ids.push_back(itemIds[0]);
+  ids.push_back(itemIds[1]);
+  ids.push_back(itemIds[2]);
+  const char* surnames[] = {"Surname3", "Surname1", "Surname1", "Surname2", "Surname3"};
+
+  std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > items;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetItemOk, s->getItems(ids, items));
+  ASSERT_EQ(ids.size(), items.size());
+  for (unsigned int i = 0; i < ids.size(); ++i)
+  {
+    ASSERT_EQ(ids[i], items[i]->getId());
+    ASSERT_EQ(OpenAB::eContact, items[i]->getType());
+    ASSERT_NE(std::string::npos, items[i]->getRawData().find(surnames[i]));
+  }
+
+  //missing contact fails whole call
+  ids.clear();
+  ids.push_back(itemIds[0]);
+  ids.push_back("NonExistingId");
+  ids.push_back(itemIds[1]);
+  items.clear();
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetItemFail, s->getItems(ids, items));
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
+
+class EDSCalendarStorageTest: public ::testing::Test
+{
+public:
+    EDSCalendarStorageTest() : ::testing::Test()
+    {
+    }
+
+    ~EDSCalendarStorageTest()
+    {
+    }
+
+protected:
+    // Sets up the test fixture.
+    virtual void SetUp()
+    {
+      OpenAB::Logger::setDefaultLogger(NULL);
+      OpenAB::Logger::OutLevel() = OpenAB::Logger::Error;
+      removeSource("oab-calendar", "calendar");
+      createSource("oab-calendar", E_SOURCE_EXTENSION_CALENDAR);
+    }
+
+    // Tears down the test fixture.
+    virtual void TearDown()
+    {
+    }
+};
+
+static const char* event0 = \
+"BEGIN:VCALENDAR\n"
+"VERSION:2.0\n"
+"BEGIN:VEVENT\n"
+"UID:oab-eds-test-event0\n"
+"DTSTAMP:20141217T103142Z\n"
+"DTSTART:20141128T150000Z\n"
+"DTEND:20141128T160000Z\n"
+"SUMMARY:Event0\n"
+"END:VEVENT\n"
+"END:VCALENDAR\n";
+
+static const char* event1 = \
+"BEGIN:VCALENDAR\n"
+"VERSION:2.0\n"
+"BEGIN:VEVENT\n"
+"UID:oab-eds-test-event1\n"
+"DTSTAMP:20141217T103142Z\n"
+"DTSTART:20141129T150000Z\n"
+"DTEND:20141129T160000Z\n"
+"SUMMARY:Event1\n"
+"END:VEVENT\n"
+"END:VCALENDAR\n";
+
+static const char* event2 = \
+"BEGIN:VCALENDAR\n"
+"VERSION:2.0\n"
+"BEGIN:VEVENT\n"
+"UID:oab-eds-test-event2\n"
+"DTSTAMP:20141217T103142Z\n"
+"DTSTART:20141130T150000Z\n"
+"DTEND:20141130T160000Z\n"
+"SUMMARY:Event2\n"
+"END:VEVENT\n"
+"END:VCALENDAR\n";
+
+/*event0 modified later, revision of events is based on DTSTAMP*/
+static const char* event0Modified = \
+"BEGIN:VCALENDAR\n"
+"VERSION:2.0\n"
+"BEGIN:VEVENT\n"
+"UID:oab-eds-test-event0\n"
+"DTSTAMP:20141218T103142Z\n"
+"DTSTART:20141128T170000Z\n"
+"DTEND:20141128T180000Z\n"
+"SUMMARY:Event0Modified\n"
+"END:VEVENT\n"
+"END:VCALENDAR\n";
+
+TEST_F(EDSCalendarStorageTest, testGetChangedRevisions)
+{
+  OpenAB_Storage::Parameters p;
+  p.setValue("db", "oab-calendar");
+  p.setValue("item_type", OpenAB::eEvent);
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  ASSERT_TRUE(OpenAB::PluginManager::getInstance().isPluginAvailable("EDSCalendar"));
+  OpenAB_Storage::Storage* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Storage::Storage>("EDSCalendar", p);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(OpenAB_Storage::Storage::eInitOk, s->init());
+
+  // add two events to db
+  OpenAB::SmartPtr<OpenAB::PIMItem> newItem = new OpenAB::PIMCalendarEventItem();
+  ASSERT_TRUE(newItem->parse(event0));
+  OpenAB::PIMItem::ID item0Id = "";
+  OpenAB::PIMItem::Revision item0Rev = "";
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(newItem, item0Id, item0Rev));
+
+  newItem = new OpenAB::PIMCalendarEventItem();
+  ASSERT_TRUE(newItem->parse(event1));
+  OpenAB::PIMItem::ID item1Id = "";
+  OpenAB::PIMItem::Revision item1Rev = "";
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(newItem, item1Id, item1Rev));
+
+  std::string token;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetSyncTokenOk, s->getLatestSyncToken(token));
+  ASSERT_NE("", token);
+
+  //add, modify and remove one event
+  newItem = new OpenAB::PIMCalendarEventItem();
+  ASSERT_TRUE(newItem->parse(event2));
+  OpenAB::PIMItem::ID item2Id = "";
+  OpenAB::PIMItem::Revision item2Rev = "";
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(newItem, item2Id, item2Rev));
+
+  newItem = new OpenAB::PIMCalendarEventItem();
+  ASSERT_TRUE(newItem->parse(event0Modified));
+  ASSERT_EQ(OpenAB_Storage::Storage::eModifyItemOk, s->modifyItem(newItem, item0Id, item0Rev));
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItem(item1Id));
+
+  //exactly those changes are reported
+  std::map<std::string, std::string> revisions;
+  std::vector<OpenAB::PIMItem::ID> removed;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsOk, s->getChangedRevisions(token, revisions, removed));
+  ASSERT_EQ(2, revisions.size());
+  ASSERT_EQ(item2Rev, revisions[item2Id]);
+  ASSERT_EQ(item0Rev, revisions[item0Id]);
+  ASSERT_EQ(1, removed.size());
+  ASSERT_EQ(item1Id, removed[0]);
+
+  //stale and unknown tokens are rejected
+  std::string newToken;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetSyncTokenOk, s->getLatestSyncToken(newToken));
+  ASSERT_NE(token, newToken);
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsFail, s->getChangedRevisions(token, revisions, removed));
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsFail, s->getChangedRevisions("UnknownToken", revisions, removed));
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
+
+TEST_F(EDSCalendarStorageTest, testGetEvents)
+{
+  OpenAB_Storage::Parameters p;
+  p.setValue("db", "oab-calendar");
+  p.setValue("item_type", OpenAB::eEvent);
+  //ids below span several batches and are repeated both in the same and in different batches
+  p.setValue("get_batch_size", 3);
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  ASSERT_TRUE(OpenAB::PluginManager::getInstance().isPluginAvailable("EDSCalendar"));
+  OpenAB_Storage::Storage* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Storage::Storage>("EDSCalendar", p);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(OpenAB_Storage::Storage::eInitOk, s->init());
+
+  //add three events to db
+  std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > newItems;
+  const char* events[] = {event0, event1, event2};
+  for (unsigned int i = 0; i < 3; ++i)
+  {
+    OpenAB::PIMItem* newEvent = new OpenAB::PIMCalendarEventItem();
+    ASSERT_TRUE(newEvent->parse(events[i]));
+    newItems.push_back(newEvent);
+  }
+  OpenAB::PIMItem::IDs itemIds;
+  OpenAB::PIMItem::Revisions itemRevs;
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItems(newItems, itemIds, itemRevs));
+  ASSERT_EQ(3, itemIds.size());
+
+  //events are returned in requested order, also when requested more than once
+  OpenAB::PIMItem::IDs ids;
+  ids.push_back(itemIds[2]);
+  ids.push_back(itemIds[0]);
+  ids.push_back(itemIds[0]);
+  ids.push_back(itemIds[1]);
+  ids.push_back(itemIds[2]);
+  const char* summaries[] = {"Event2", "Event0", "Event0", "Event1", "Event2"};
+
+  std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > items;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetItemOk, s->getItems(ids, items));
+  ASSERT_EQ(ids.size(), items.size());
+  for (unsigned int i = 0; i < ids.size(); ++i)
+  {
+    ASSERT_EQ(ids[i], items[i]->getId());
+    ASSERT_EQ(OpenAB::eEvent, items[i]->getType());
+    ASSERT_NE(std::string::npos, items[i]->getRawData().find(summaries[i]));
+  }
+
+  //missing event fails whole call
+  ids.clear();
+  ids.push_back(itemIds[0]);
+  ids.push_back("NonExistingId");
+  ids.push_back(itemIds[1]);
+  items.clear();
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetItemFail, s->getItems(ids, items));
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
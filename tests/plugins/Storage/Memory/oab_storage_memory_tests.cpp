@@ -0,0 +1,284 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file oab_storage_memory_tests.cpp
+ */
+#include <gtest/gtest.h>
+#include <string>
+#include <sstream>
+#include <stdio.h>
+#include <unistd.h>
+#include "helpers/PluginManager.hpp"
+#include "plugin/storage/Storage.hpp"
+#include "PIMItem/Contact/PIMContactItem.hpp"
+
+class MemoryStorageTest: public ::testing::Test
+{
+public:
+    MemoryStorageTest() : ::testing::Test()
+    {
+    }
+
+    ~MemoryStorageTest()
+    {
+    }
+
+protected:
+    // Sets up the test fixture.
+    virtual void SetUp()
+    {
+      OpenAB::Logger::setDefaultLogger(NULL);
+      OpenAB::Logger::OutLevel() = OpenAB::Logger::Error;
+    }
+
+    // Tears down the test fixture.
+    virtual void TearDown()
+    {
+    }
+
+    OpenAB_Storage::Storage* createStorage(const std::string& snapshotFile = "", int maxRemovals = -1)
+    {
+      OpenAB_Storage::Parameters p;
+      if (!snapshotFile.empty())
+      {
+        p.setValue("snapshot_file", snapshotFile);
+      }
+      if (maxRemovals >= 0)
+      {
+        p.setValue("max_removals", maxRemovals);
+      }
+      OpenAB_Storage::Storage* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Storage::Storage>("Memory", p);
+      if (s && OpenAB_Storage::Storage::eInitOk != s->init())
+      {
+        OpenAB::PluginManager::getInstance().freePluginInstance(s);
+        return NULL;
+      }
+      return s;
+    }
+};
+
+static OpenAB::SmartPtr<OpenAB::PIMItem> createContact(const std::string& name)
+{
+  OpenAB::PIMContactItem* contact = new OpenAB::PIMContactItem();
+  contact->parse("BEGIN:VCARD\nVERSION:3.0\nN:" + name + ";;;;\nEND:VCARD\n");
+  return OpenAB::SmartPtr<OpenAB::PIMItem>(contact);
+}
+
+TEST_F(MemoryStorageTest, testWrongParams)
+{
+  OpenAB_Storage::Parameters p;
+  p.setValue("item_type", "unknown");
+  ASSERT_TRUE(OpenAB::PluginManager::getInstance().isPluginAvailable("Memory"));
+  OpenAB_Storage::Storage* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Storage::Storage>("Memory", p);
+  ASSERT_FALSE(s);
+}
+
+TEST_F(MemoryStorageTest, testAddModifyRemove)
+{
+  OpenAB_Storage::Storage* s = createStorage();
+  ASSERT_TRUE(s);
+
+  OpenAB::PIMItem::ID id;
+  OpenAB::PIMItem::Revision revision;
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(createContact("Surname1"), id, revision));
+  ASSERT_FALSE(id.empty());
+  ASSERT_FALSE(revision.empty());
+  ASSERT_EQ(1, s->getTotalCount());
+
+  OpenAB::SmartPtr<OpenAB::PIMItem> item;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetItemOk, s->getItem(id, item));
+  ASSERT_EQ(id, item->getId());
+  ASSERT_EQ(revision, item->getRevision());
+  ASSERT_NE(std::string::npos, item->getRawData().find("Surname1"));
+
+  OpenAB::PIMItem::Revision newRevision;
+  ASSERT_EQ(OpenAB_Storage::Storage::eModifyItemOk, s->modifyItem(createContact("Surname2"), id, newRevision));
+  ASSERT_NE(revision, newRevision);
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetItemOk, s->getItem(id, item));
+  ASSERT_NE(std::string::npos, item->getRawData().find("Surname2"));
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eModifyItemFail, s->modifyItem(createContact("Surname3"), "nonexisting", newRevision));
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemFail, s->removeItem("nonexisting"));
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItem(id));
+  ASSERT_EQ(0, s->getTotalCount());
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetItemFail, s->getItem(id, item));
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
+
+TEST_F(MemoryStorageTest, testManyItems)
+{
+  OpenAB_Storage::Storage* s = createStorage();
+  ASSERT_TRUE(s);
+
+  std::vector<OpenAB::SmartPtr<OpenAB::PIMItem> > items;
+  for (int i = 0; i < 1000; ++i)
+  {
+    std::stringstream name;
+    name<<"Surname"<<i;
+    items.push_back(createContact(name.str()));
+  }
+  OpenAB::PIMItem::IDs ids;
+  OpenAB::PIMItem::Revisions revisions;
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItems(items, ids, revisions));
+  ASSERT_EQ(1000u, ids.size());
+
+  //remove every third item, remaining ones have to be still found
+  OpenAB::PIMItem::IDs removedIds;
+  for (unsigned int i = 0; i < ids.size(); i += 3)
+  {
+    removedIds.push_back(ids[i]);
+  }
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItems(removedIds));
+  ASSERT_EQ((int)(ids.size() - removedIds.size()), s->getTotalCount());
+
+  for (unsigned int i = 0; i < ids.size(); ++i)
+  {
+    OpenAB::SmartPtr<OpenAB::PIMItem> item;
+    OpenAB_Storage::Storage::eGetItem expected = (0 == i % 3) ? OpenAB_Storage::Storage::eGetItemFail :
+                                                                OpenAB_Storage::Storage::eGetItemOk;
+    ASSERT_EQ(expected, s->getItem(ids[i], item));
+  }
+
+  //iterator returns all items sorted by id
+  OpenAB_Storage::StorageItemIterator* it = s->newStorageItemIterator();
+  ASSERT_TRUE(it);
+  ASSERT_EQ((unsigned int)s->getTotalCount(), it->getSize());
+  std::string previousId;
+  int count = 0;
+  while (it->next())
+  {
+    ASSERT_LT(previousId, (*it)->id);
+    previousId = (*it)->id;
+    ++count;
+  }
+  ASSERT_EQ(s->getTotalCount(), count);
+  delete it;
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
+
+TEST_F(MemoryStorageTest, testChangedRevisions)
+{
+  OpenAB_Storage::Storage* s = createStorage();
+  ASSERT_TRUE(s);
+
+  OpenAB::PIMItem::ID id1, id2, id3;
+  OpenAB::PIMItem::Revision revision;
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(createContact("Surname1"), id1, revision));
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(createContact("Surname2"), id2, revision));
+
+  std::string token;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetSyncTokenOk, s->getLatestSyncToken(token));
+
+  std::map<std::string, std::string> revisions;
+  std::vector<OpenAB::PIMItem::ID> removed;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsOk, s->getChangedRevisions(token, revisions, removed));
+  ASSERT_TRUE(revisions.empty());
+  ASSERT_TRUE(removed.empty());
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eModifyItemOk, s->modifyItem(createContact("Surname3"), id1, revision));
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItem(id2));
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(createContact("Surname4"), id3, revision));
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsOk, s->getChangedRevisions(token, revisions, removed));
+  ASSERT_EQ(2u, revisions.size());
+  ASSERT_EQ(1u, revisions.count(id1));
+  ASSERT_EQ(revision, revisions[id3]);
+  ASSERT_EQ(1u, removed.size());
+  ASSERT_EQ(id2, removed[0]);
+
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsFail, s->getChangedRevisions("", revisions, removed));
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsFail, s->getChangedRevisions("other:1", revisions, removed));
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
+
+TEST_F(MemoryStorageTest, testTrimRemovals)
+{
+  OpenAB_Storage::Storage* s = createStorage("", 3);
+  ASSERT_TRUE(s);
+
+  std::vector<OpenAB::PIMItem::ID> ids;
+  OpenAB::PIMItem::Revision revision;
+  for (int i = 0; i < 5; ++i)
+  {
+    std::stringstream name;
+    name<<"Surname"<<i;
+    OpenAB::PIMItem::ID id;
+    ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(createContact(name.str()), id, revision));
+    ids.push_back(id);
+  }
+
+  std::string token;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetSyncTokenOk, s->getLatestSyncToken(token));
+  std::map<std::string, std::string> revisions;
+  std::vector<OpenAB::PIMItem::ID> removed;
+
+  //removals up to limit are still reported
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItem(ids[0]));
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItem(ids[1]));
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItem(ids[2]));
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsOk, s->getChangedRevisions(token, revisions, removed));
+  ASSERT_EQ(3u, removed.size());
+
+  //exceeding limit starts new generation, so old tokens are rejected
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItem(ids[3]));
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsFail, s->getChangedRevisions(token, revisions, removed));
+
+  std::string newToken;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetSyncTokenOk, s->getLatestSyncToken(newToken));
+  ASSERT_NE(token.substr(0, token.rfind(':')), newToken.substr(0, newToken.rfind(':')));
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItem(ids[4]));
+  removed.clear();
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsOk, s->getChangedRevisions(newToken, revisions, removed));
+  ASSERT_EQ(1u, removed.size());
+  ASSERT_EQ(ids[4], removed[0]);
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+}
+
+TEST_F(MemoryStorageTest, testSnapshot)
+{
+  char fileName[] = "/tmp/oab_memory_snapshotXXXXXX";
+  int fd = mkstemp(fileName);
+  ASSERT_NE(-1, fd);
+  close(fd);
+  unlink(fileName);
+
+  OpenAB_Storage::Storage* s = createStorage(fileName);
+  ASSERT_TRUE(s);
+  OpenAB::PIMItem::ID id1, id2;
+  OpenAB::PIMItem::Revision revision;
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(createContact("Surname1"), id1, revision));
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(createContact("Surname2"), id2, revision));
+  ASSERT_EQ(OpenAB_Storage::Storage::eRemoveItemOk, s->removeItem(id1));
+  std::string token;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetSyncTokenOk, s->getLatestSyncToken(token));
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+
+  s = createStorage(fileName);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(1, s->getTotalCount());
+  OpenAB::SmartPtr<OpenAB::PIMItem> item;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetItemOk, s->getItem(id2, item));
+  ASSERT_EQ(revision, item->getRevision());
+  ASSERT_NE(std::string::npos, item->getRawData().find("Surname2"));
+
+  //sync tokens stay valid and new ids do not collide with old ones
+  std::map<std::string, std::string> revisions;
+  std::vector<OpenAB::PIMItem::ID> removed;
+  ASSERT_EQ(OpenAB_Storage::Storage::eGetRevisionsOk, s->getChangedRevisions(token, revisions, removed));
+  ASSERT_TRUE(revisions.empty());
+  OpenAB::PIMItem::ID id3;
+  ASSERT_EQ(OpenAB_Storage::Storage::eAddItemOk, s->addItem(createContact("Surname3"), id3, revision));
+  ASSERT_NE(id1, id3);
+  ASSERT_NE(id2, id3);
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+
+  unlink(fileName);
+}
@@ -0,0 +1,130 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file delta_source_plugin.cpp
+ */
+
+#include <plugin/Plugin.hpp>
+#include <plugin/source/Source.hpp>
+#include <PIMItem/Contact/PIMContactItem.hpp>
+#include <helpers/StringHelper.hpp>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+namespace OpenAB_TESTS {
+
+/*
+ * Source providing vCards from "filename" that follow vCards already committed, number of committed
+ * vCards is stored in "cursor_file", like PBAP source providing call history with "cursor_file".
+ */
+class TestDeltaSourcePlugin : public OpenAB_Source::Source
+{
+  public:
+    TestDeltaSourcePlugin(const std::string& filename,
+                          const std::string& cursorFile) :
+      OpenAB_Source::Source(OpenAB::eContact),
+      filename(filename),
+      cursorFile(cursorFile),
+      position(0)
+    {
+    }
+    virtual ~TestDeltaSourcePlugin(){}
+
+    OpenAB_Source::Source::eInit init()
+    {
+      std::ifstream file(filename.c_str());
+      if (!file.is_open())
+      {
+        return OpenAB_Source::Source::eInitFail;
+      }
+      std::stringstream content;
+      content<<file.rdbuf();
+      std::string data = content.str();
+
+      vCards.clear();
+      const char* begin = data.c_str();
+      const char* end = begin + data.size();
+      const char* pos = begin;
+      const char* vCardEnd = NULL;
+      while (NULL != (vCardEnd = OpenAB::findAtLineStart(begin, end, pos, "END:VCARD", 9)))
+      {
+        std::string::size_type lineEnd = data.find('\n', vCardEnd - begin);
+        std::string::size_type next = (std::string::npos == lineEnd) ? data.size() : lineEnd + 1;
+        vCards.push_back(data.substr(pos - begin, next - (pos - begin)));
+        pos = begin + next;
+      }
+
+      position = 0;
+      std::ifstream cursor(cursorFile.c_str());
+      if (cursor.is_open())
+      {
+        cursor>>position;
+      }
+      return OpenAB_Source::Source::eInitOk;
+    }
+
+    OpenAB_Source::Source::eSuspendRet suspend() {return OpenAB_Source::Source::eSuspendRetNotSupported;}
+    OpenAB_Source::Source::eResumeRet resume() {return OpenAB_Source::Source::eResumeRetNotSupported;}
+    OpenAB_Source::Source::eCancelRet cancel() {return OpenAB_Source::Source::eCancelRetNotSupported;}
+
+    OpenAB_Source::Source::eGetItemRet getItem(OpenAB::SmartPtr<OpenAB::PIMItem> &item)
+    {
+      if (position >= vCards.size())
+      {
+        return OpenAB_Source::Source::eGetItemRetEnd;
+      }
+      OpenAB::PIMContactItem* contact = new OpenAB::PIMContactItem();
+      contact->parse(vCards[position++]);
+      item = contact;
+      return OpenAB_Source::Source::eGetItemRetOk;
+    }
+
+    int getTotalCount() const
+    {
+      return -1;
+    }
+
+    bool isDelta() const
+    {
+      return true;
+    }
+
+    void commitDelta()
+    {
+      std::ofstream cursor(cursorFile.c_str(), std::ios_base::out | std::ios_base::trunc);
+      cursor<<vCards.size()<<std::endl;
+    }
+
+  private:
+    std::string filename;
+    std::string cursorFile;
+    std::vector<std::string> vCards;
+    size_t position;
+};
+
+class TestDeltaSourcePluginFactory : OpenAB_Source::Factory
+{
+  public:
+    TestDeltaSourcePluginFactory() : OpenAB_Source::Factory("TestDelta"){};
+
+    virtual ~TestDeltaSourcePluginFactory(){}
+
+    OpenAB_Source::Source * newIstance(const OpenAB_Source::Parameters & params)
+    {
+      OpenAB::Variant filename = params.getValue("filename");
+      OpenAB::Variant cursorFile = params.getValue("cursor_file");
+      if (filename.invalid() || cursorFile.invalid())
+      {
+        return NULL;
+      }
+      return new TestDeltaSourcePlugin(filename.getString(), cursorFile.getString());
+    };
+} deltaFactory;
+
+} // namespace OpenAB_TESTS
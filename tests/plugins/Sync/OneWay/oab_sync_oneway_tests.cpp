@@ -8,6 +8,9 @@
  */
 #include <gtest/gtest.h>
 #include <string>
+#include <fstream>
+#include <stdio.h>
+#include <unistd.h>
 #include <sys/prctl.h>
 #include "OpenAB.hpp"
 #include "helpers/PluginManager.hpp"
@@ -148,12 +151,14 @@ public:
     bool& isSyncProgressCalled() {return syncProgressCalled;}
     bool& isSyncPhaseStartedCalled() {return syncPhaseStartedCalled;}
     bool& isSyncPhaseFinishedCalled() {return syncPhaseFinishedCalled;}
+    bool& isSyncProgressInRange() {return syncProgressInRange;}
     std::vector<std::string>& getFinishedSyncPhases() {return finishedSyncPhases;}
 protected: 
     bool syncEnded;
     bool syncProgressCalled;
     bool syncPhaseStartedCalled;
     bool syncPhaseFinishedCalled;
+    bool syncProgressInRange;
     OpenAB_Sync::Sync::eSync syncResult;
     std::vector<std::string> finishedSyncPhases;
 
@@ -164,6 +169,7 @@ protected:
       syncProgressCalled = false;
       syncPhaseStartedCalled = false;
       syncPhaseFinishedCalled = false;
+      syncProgressInRange = true;
       finishedSyncPhases.clear();
       OpenAB::Logger::OutLevel() = OpenAB::Logger::Debug;
 
@@ -205,6 +211,10 @@ protected:
       static_cast<void>(progress);
       static_cast<void>(numProcessedItems);
       syncProgressCalled = true;
+      if (!(progress >= 0.0 && progress <= 1.0))
+      {
+        syncProgressInRange = false;
+      }
     }
     
     void syncPhaseStarted(const std::string& name)
@@ -856,3 +866,84 @@ TEST_F(OneWaySyncTest, testSyncInProgress)
   ASSERT_EQ(0, removed);
   OpenAB::PluginManager::getInstance().freePluginInstance(s);
 }
+
+TEST_F(OneWaySyncTest, testSyncDeltaSource)
+{
+  char dirName[] = "/tmp/oab_oneway_deltaXXXXXX";
+  ASSERT_TRUE(NULL != mkdtemp(dirName));
+  std::string filename = std::string(dirName) + "/calls.vcf";
+  std::string cursorFile = std::string(dirName) + "/cursor";
+  FILE* f = fopen(filename.c_str(), "w");
+  ASSERT_TRUE(f);
+  fputs("BEGIN:VCARD\nVERSION:3.0\nN:Surname1;Name1;;;\nFN:Name1 Surname1\nEND:VCARD\n"
+        "BEGIN:VCARD\nVERSION:3.0\nN:Surname2;Name2;;;\nFN:Name2 Surname2\nEND:VCARD\n", f);
+  fclose(f);
+
+  OpenAB_Sync::Parameters p;
+  OpenAB::PluginManager::getInstance().scanDirectory("../src/.libs");
+  //test delta source plugin is built with tests
+  OpenAB::PluginManager::getInstance().scanDirectory(".libs");
+  p.setValue("remote_plugin", "TestDelta");
+  p.setValue("local_plugin", "Memory");
+  p.remoteSourcePluginParams.setValue("filename", filename);
+  p.remoteSourcePluginParams.setValue("cursor_file", cursorFile);
+  p.setValue("callback", (OpenAB_Sync::Sync::SyncCallback*)this);
+  OpenAB_Sync::Sync* s = OpenAB::PluginManager::getInstance().getPluginInstance<OpenAB_Sync::Sync>("OneWay", p);
+  ASSERT_TRUE(s);
+  ASSERT_EQ(OpenAB_Sync::Sync::eInitOk, s->init());
+
+  //source is initialized by each phase, second phase gets the same entries as first one
+  std::vector<std::string> ignoredFields;
+  ASSERT_TRUE(s->addPhase("TestPhase1", ignoredFields));
+  ASSERT_TRUE(s->addPhase("TestPhase2", ignoredFields));
+  s->synchronize();
+  WAIT_FOR_CONDITION(10000, this->isSyncFinished());
+  ASSERT_TRUE(this->isSyncFinished());
+  ASSERT_EQ(OpenAB_Sync::Sync::eSyncOkWithDataChange, this->getSyncResult());
+  ASSERT_TRUE(this->isSyncProgressCalled());
+  ASSERT_TRUE(this->isSyncProgressInRange());
+
+  //entries are committed only after last phase
+  unsigned int cursor = 0;
+  std::ifstream cursorStream(cursorFile.c_str());
+  cursorStream>>cursor;
+  cursorStream.close();
+  ASSERT_EQ(2, cursor);
+
+  unsigned int added,modified,removed,added2,modified2,removed2;
+  s->getStats(added, modified, removed, added2,modified2,removed2);
+  ASSERT_EQ(2, added);
+  ASSERT_EQ(0, modified);
+  ASSERT_EQ(0, removed);
+
+  //only new entry is provided, entries provided before are not removed from storage
+  f = fopen(filename.c_str(), "a");
+  ASSERT_TRUE(f);
+  fputs("BEGIN:VCARD\nVERSION:3.0\nN:Surname3;Name3;;;\nFN:Name3 Surname3\nEND:VCARD\n", f);
+  fclose(f);
+  this->isSyncFinished() = false;
+  s->synchronize();
+  WAIT_FOR_CONDITION(10000, this->isSyncFinished());
+  ASSERT_TRUE(this->isSyncFinished());
+  ASSERT_EQ(OpenAB_Sync::Sync::eSyncOkWithDataChange, this->getSyncResult());
+  ASSERT_TRUE(this->isSyncProgressInRange());
+  s->getStats(added, modified, removed, added2,modified2,removed2);
+  ASSERT_EQ(1, added);
+  ASSERT_EQ(0, modified);
+  ASSERT_EQ(0, removed);
+  cursorStream.open(cursorFile.c_str());
+  cursorStream>>cursor;
+  cursorStream.close();
+  ASSERT_EQ(3, cursor);
+
+  this->isSyncFinished() = false;
+  s->synchronize();
+  WAIT_FOR_CONDITION(10000, this->isSyncFinished());
+  ASSERT_TRUE(this->isSyncFinished());
+  ASSERT_EQ(OpenAB_Sync::Sync::eSyncOkWithoutDataChange, this->getSyncResult());
+
+  OpenAB::PluginManager::getInstance().freePluginInstance(s);
+  unlink(filename.c_str());
+  unlink(cursorFile.c_str());
+  rmdir(dirName);
+}
@@ -0,0 +1,66 @@
+/*
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ */
+/**
+ * @file TestHelpers.hpp
+ */
+
+#ifndef TESTHELPERS_HPP_
+#define TESTHELPERS_HPP_
+#include <string>
+#include <stdio.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+/*!
+ * @brief namespace OpenAB_TESTS
+ */
+namespace OpenAB_TESTS {
+
+/*!
+ * @brief Returns CPU time (user and system) used by process so far in milliseconds.
+ */
+inline double cpuTimeMs()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+/*!
+ * @brief Returns peak resident set size of process in kilobytes.
+ */
+inline long peakRSSKb()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+inline int removeEntry(const char* path, const struct stat* /*st*/, int /*flag*/, struct FTW* /*ftw*/)
+{
+  return remove(path);
+}
+
+/*!
+ * @brief Removes directory together with all its contents, symbolic links are not followed.
+ * @return true if directory was removed or did not exist, false otherwise.
+ */
+inline bool removeDirectory(const std::string& path)
+{
+  struct stat st;
+  if (0 != lstat(path.c_str(), &st))
+  {
+    return true;
+  }
+  return 0 == nftw(path.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+} // namespace OpenAB_TESTS
+
+#endif // TESTHELPERS_HPP_